@@ -39,7 +39,8 @@
  *
  *    The builtin_builder::create_builtins() function contains lists of all
  *    built-in function signatures, where they're available, what types they
- *    take, and so on.
+ *    take, and so on.  Only the intrinsics are created up front; a built-in
+ *    function's signatures are generated the first time it is looked up.
  *
  * 4. Implementations of built-in function signatures
  *
@@ -84,6 +85,7 @@
 #include <math.h>
 #include "builtin_functions.h"
 #include "util/hash_table.h"
+#include "util/set.h"
 
 #ifndef M_PIf
 #define M_PIf   ((float) M_PI)
@@ -1002,21 +1004,43 @@ public:
    ir_function_signature *find(_mesa_glsl_parse_state *state,
                                const char *name, exec_list *actual_parameters);
 
+   ir_function *get_function(const char *name);
+
    /**
-    * A shader to hold all the built-in signatures; created by this module.
+    * A shader to hold the built-in signatures; created by this module.
     *
-    * This includes signatures for every built-in, regardless of version or
-    * enabled extensions.  The availability predicate associated with each
-    * signature allows matching_signature() to filter out the irrelevant ones.
+    * This includes signatures for every built-in that has been looked up so
+    * far, regardless of version or enabled extensions.  The availability
+    * predicate associated with each signature allows matching_signature() to
+    * filter out the irrelevant ones.
     */
    gl_shader *shader;
 
 private:
    void *mem_ctx;
 
+   /**
+    * Names of the built-ins whose IR hasn't been generated yet.  Filled once
+    * by initialize(), so names that aren't built-ins never end up in here.
+    */
+   struct set *pending_functions;
+
+   /**
+    * While create_builtins() runs, the only function it should generate
+    * (NULL generates all of them).
+    */
+   const char *requested_function;
+
+   /**
+    * While create_builtins() runs, only record the names into
+    * pending_functions instead of generating anything.
+    */
+   bool collecting_names;
+
    void create_shader();
    void create_intrinsics();
    void create_builtins();
+   bool wants_function(const char *name);
 
    /**
     * IR builder helpers:
@@ -1395,7 +1419,8 @@ enum image_function_flags {
  *  @{
  */
 builtin_builder::builtin_builder()
-   : shader(NULL)
+   : shader(NULL), pending_functions(NULL), requested_function(NULL),
+     collecting_names(false)
 {
    mem_ctx = NULL;
 }
@@ -1426,7 +1451,7 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
     */
    state->uses_builtin_functions = true;
 
-   ir_function *f = shader->symbols->get_function(name);
+   ir_function *f = get_function(name);
    if (f == NULL)
       return NULL;
 
@@ -1438,6 +1463,37 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
    return sig;
 }
 
+/**
+ * Look up a built-in function by name, generating its signatures the first
+ * time it is asked for.
+ */
+ir_function *
+builtin_builder::get_function(const char *name)
+{
+   struct set_entry *entry = _mesa_set_search(pending_functions, name);
+   if (entry != NULL) {
+      _mesa_set_remove(pending_functions, entry);
+
+      requested_function = name;
+      create_builtins();
+      requested_function = NULL;
+   }
+
+   return shader->symbols->get_function(name);
+}
+
+bool
+builtin_builder::wants_function(const char *name)
+{
+   if (collecting_names) {
+      if (_mesa_set_search(pending_functions, name) == NULL)
+         _mesa_set_add(pending_functions, ralloc_strdup(mem_ctx, name));
+      return false;
+   }
+
+   return requested_function == NULL || strcmp(name, requested_function) == 0;
+}
+
 void
 builtin_builder::initialize()
 {
@@ -1448,9 +1504,14 @@ builtin_builder::initialize()
    glsl_type_singleton_init_or_ref();
 
    mem_ctx = ralloc_context(NULL);
+   pending_functions = _mesa_set_create(mem_ctx, _mesa_hash_string,
+                                        _mesa_key_string_equal);
    create_shader();
    create_intrinsics();
+
+   collecting_names = true;
    create_builtins();
+   collecting_names = false;
 }
 
 void
@@ -1458,6 +1519,7 @@ builtin_builder::release()
 {
    ralloc_free(mem_ctx);
    mem_ctx = NULL;
+   pending_functions = NULL;
 
    ralloc_free(shader);
    shader = NULL;
@@ -1736,6 +1798,15 @@ builtin_builder::create_intrinsics()
 void
 builtin_builder::create_builtins()
 {
+   /* Skip the functions that weren't requested without evaluating the
+    * arguments, which is where all the IR gets generated.
+    */
+#define add_function(NAME, ...)                          \
+   do {                                                  \
+      if (wants_function(NAME))                          \
+         this->add_function(NAME, __VA_ARGS__);          \
+   } while (0)
+
 #define F(NAME)                                 \
    add_function(#NAME,                          \
                 _##NAME(glsl_type::float_type), \
@@ -5445,6 +5516,7 @@ builtin_builder::create_builtins()
 #undef FIUD_VEC
 #undef FIUBD_VEC
 #undef FIU2_MIXED
+#undef add_function
 }
 
 void
@@ -5517,6 +5589,9 @@ builtin_builder::add_image_function(const char *name,
       glsl_type::uimage2DMSArray_type
    };
 
+   if (!wants_function(name))
+      return;
+
    ir_function *f = new(mem_ctx) ir_function(name);
 
    for (unsigned i = 0; i < ARRAY_SIZE(types); ++i) {
@@ -8718,7 +8793,7 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    ir_function *f;
    bool ret = false;
    mtx_lock(&builtins_lock);
-   f = builtins.shader->symbols->get_function(name);
+   f = builtins.get_function(name);
    if (f != NULL) {
       foreach_in_list(ir_function_signature, sig, &f->signatures) {
          if (sig->is_builtin_available(state)) {
@@ -8732,10 +8807,15 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    return ret;
 }
 
-gl_shader *
-_mesa_glsl_get_builtin_function_shader()
+ir_function *
+_mesa_glsl_get_builtin_function(const char *name)
 {
-   return builtins.shader;
+   ir_function *f;
+   mtx_lock(&builtins_lock);
+   f = builtins.get_function(name);
+   mtx_unlock(&builtins_lock);
+
+   return f;
 }
 
 
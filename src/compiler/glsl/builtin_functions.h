@@ -48,8 +48,12 @@ extern bool
 _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state,
                                 const char *name);
 
-extern gl_shader *
-_mesa_glsl_get_builtin_function_shader(void);
+/**
+ * Look up a built-in function by name, ignoring availability.  The returned
+ * function isn't modified afterwards, so it may be used without the lock.
+ */
+extern ir_function *
+_mesa_glsl_get_builtin_function(const char *name);
 
 extern ir_function_signature *
 _mesa_get_main_function_signature(glsl_symbol_table *symbols);
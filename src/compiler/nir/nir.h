@@ -92,6 +92,7 @@ extern bool nir_debug_print_shader[MESA_SHADER_KERNEL + 1];
 #define NIR_DEBUG_PRINT_KS               (1u << 19)
 #define NIR_DEBUG_PRINT_CONSTS           (1u << 20)
 #define NIR_DEBUG_VALIDATE_GC_LIST       (1u << 21)
+#define NIR_DEBUG_PASS_STATS             (1u << 22)
 
 #define NIR_DEBUG_PRINT (NIR_DEBUG_PRINT_VS  | \
                          NIR_DEBUG_PRINT_TCS | \
@@ -847,7 +848,6 @@ typedef enum PACKED {
 
 typedef struct nir_instr {
    struct exec_node node;
-   struct list_head gc_node;
    struct nir_block *block;
    nir_instr_type type;
 
@@ -2880,7 +2880,6 @@ typedef enum {
     *
     *   - nir_block::num_dom_children
     *   - nir_block::dom_children
-    *   - nir_block::dom_frontier
     *   - nir_block::dom_pre_index
     *   - nir_block::dom_post_index
     *
@@ -2932,6 +2931,19 @@ typedef enum {
     */
    nir_metadata_instr_index = 0x20,
 
+   /** Indicates that the dominance frontier is valid
+    *
+    * This includes:
+    *
+    *   - nir_block::dom_frontier
+    *
+    * Only a few passes need the dominance frontier so it is not computed
+    * along with the rest of the dominance information.  Requiring it also
+    * requires nir_metadata_dominance.  It only depends on the CFG, so it is
+    * preserved whenever nir_metadata_dominance is.
+    */
+   nir_metadata_dominance_frontier = 0x40,
+
    /** All metadata
     *
     * This includes all nir_metadata flags except not_properly_reset.  Passes
@@ -3612,7 +3624,8 @@ typedef struct nir_shader {
 
    struct exec_list functions; /** < list of nir_function */
 
-   struct list_head gc_list; /** < list of all nir_instrs allocated on the shader but not yet freed. */
+   /** Allocation context for the shader's instructions, see nir_sweep() */
+   gc_ctx *gctx;
 
    /**
     * The size of the variable space for load_input_*, load_uniform_*, etc.
@@ -3728,6 +3741,8 @@ nir_function_impl *nir_cf_node_get_function(nir_cf_node *node);
 void nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...);
 /** dirties all but the preserved metadata */
 void nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved);
+/** marks metadata the pass has kept up-to-date by itself as valid */
+void nir_metadata_set_valid(nir_function_impl *impl, nir_metadata valid);
 /** Preserves all metadata for the given shader */
 void nir_shader_preserve_all_metadata(nir_shader *shader);
 
@@ -4322,6 +4337,71 @@ static inline bool should_print_nir(UNUSED nir_shader *shader) { return false; }
 
 #define NIR_SKIP(name) should_skip_nir(#name)
 
+/** Progress tracking for optimization loops
+ *
+ * Optimization loops run the same list of passes over and over until none
+ * of them makes progress.  Most of those passes are idempotent, so once one
+ * has run without making progress it is pointless to run it again until some
+ * other pass has changed the shader.  A nir_pass_tracker remembers which
+ * passes are at such a fixed point and NIR_LOOP_PASS skips them.
+ *
+ * Passes are identified by their function pointer, so a pass that appears
+ * several times in a loop must always be called with the same arguments.
+ * Anything that changes the shader outside of NIR_LOOP_PASS must call
+ * nir_pass_tracker_invalidate().
+ *
+ * With NIR_DEBUG=pass_stats, the number of runs, skips, runs that made
+ * progress and the time spent in each pass are printed by
+ * nir_pass_tracker_fini().
+ */
+typedef struct nir_pass_tracker {
+   /** Set of passes that made no progress since the shader last changed */
+   struct set *fixed_point;
+
+   /** Pass function pointer -> nir_pass_stats, or NULL if disabled */
+   struct hash_table *stats;
+} nir_pass_tracker;
+
+typedef struct nir_pass_stats {
+   const char *name;
+   unsigned runs;
+   unsigned skips;
+   unsigned progress;
+   uint64_t time_ns;
+} nir_pass_stats;
+
+void nir_pass_tracker_init(nir_pass_tracker *tracker, void *mem_ctx);
+void nir_pass_tracker_fini(nir_pass_tracker *tracker, const nir_shader *nir);
+void nir_pass_tracker_invalidate(nir_pass_tracker *tracker);
+bool nir_pass_tracker_skip(nir_pass_tracker *tracker, const void *pass,
+                           const char *name);
+uint64_t nir_pass_tracker_start(const nir_pass_tracker *tracker);
+void nir_pass_tracker_end(nir_pass_tracker *tracker, const void *pass,
+                          const char *name, uint64_t start_ns,
+                          bool progress, bool idempotent);
+
+#define _NIR_LOOP_PASS(progress, tracker, nir, idempotent, pass, ...) do { \
+   if (!nir_pass_tracker_skip(tracker, (const void *)pass, #pass)) {       \
+      const uint64_t _start = nir_pass_tracker_start(tracker);             \
+      bool _progress = false;                                              \
+      NIR_PASS(_progress, nir, pass, ##__VA_ARGS__);                       \
+      nir_pass_tracker_end(tracker, (const void *)pass, #pass, _start,     \
+                           _progress, idempotent);                         \
+      if (_progress)                                                       \
+         progress = true;                                                  \
+   }                                                                       \
+} while (0)
+
+/* Run an idempotent pass: a second run right after a successful one is
+ * assumed to make no progress.
+ */
+#define NIR_LOOP_PASS(progress, tracker, nir, pass, ...) \
+   _NIR_LOOP_PASS(progress, tracker, nir, true, pass, ##__VA_ARGS__)
+
+/* Run a pass which may make further progress when run again. */
+#define NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, tracker, nir, pass, ...) \
+   _NIR_LOOP_PASS(progress, tracker, nir, false, pass, ##__VA_ARGS__)
+
 /** An instruction filtering callback with writemask
  *
  * Returns true if the instruction should be processed with the associated
@@ -4390,6 +4470,8 @@ bool nir_shader_lower_instructions(nir_shader *shader,
 
 void nir_calc_dominance_impl(nir_function_impl *impl);
 void nir_calc_dominance(nir_shader *shader);
+void nir_calc_dom_frontier_impl(nir_function_impl *impl);
+void nir_dominance_update_for_flattened_if(nir_if *nif);
 
 nir_block *nir_dominance_lca(nir_block *b1, nir_block *b2);
 bool nir_block_dominates(nir_block *parent, nir_block *child);
@@ -5268,6 +5350,7 @@ bool nir_normalize_cubemap_coords(nir_shader *shader);
 bool nir_shader_supports_implicit_lod(nir_shader *shader);
 
 void nir_live_ssa_defs_impl(nir_function_impl *impl);
+void nir_live_ssa_defs_update_for_flattened_if(nir_if *nif);
 
 const BITSET_WORD *nir_get_live_ssa_defs(nir_cursor cursor, void *mem_ctx);
 
@@ -46,8 +46,6 @@ init_block(nir_block *block, nir_function_impl *impl)
    block->dom_pre_index = UINT32_MAX;
    block->dom_post_index = 0;
 
-   _mesa_set_clear(block->dom_frontier, NULL);
-
    return true;
 }
 
@@ -93,17 +91,22 @@ calc_dominance(nir_block *block)
 }
 
 static bool
-calc_dom_frontier(nir_block *block)
+calc_dom_frontier(nir_block *block, nir_block *start_block)
 {
    if (block->predecessors->entries > 1) {
+      /* The start block has no immediate dominator, so it stops the walk
+       * up the tree for itself.
+       */
+      nir_block *idom = block == start_block ? block : block->imm_dom;
+
       set_foreach(block->predecessors, entry) {
          nir_block *runner = (nir_block *) entry->key;
 
          /* Skip unreachable predecessors */
-         if (runner->imm_dom == NULL)
+         if (runner->imm_dom == NULL && runner != start_block)
             continue;
 
-         while (runner != block->imm_dom) {
+         while (runner != idom) {
             _mesa_set_add(runner->dom_frontier, block);
             runner = runner->imm_dom;
          }
@@ -184,10 +187,6 @@ nir_calc_dominance_impl(nir_function_impl *impl)
       }
    }
 
-   nir_foreach_block_unstructured(block, impl) {
-      calc_dom_frontier(block);
-   }
-
    nir_block *start_block = nir_start_block(impl);
    start_block->imm_dom = NULL;
 
@@ -206,6 +205,65 @@ nir_calc_dominance(nir_shader *shader)
    }
 }
 
+void
+nir_calc_dom_frontier_impl(nir_function_impl *impl)
+{
+   if (impl->valid_metadata & nir_metadata_dominance_frontier)
+      return;
+
+   nir_metadata_require(impl, nir_metadata_block_index |
+                              nir_metadata_dominance);
+
+   /* The sets are only allocated once something asks for the frontier. */
+   nir_foreach_block_unstructured(block, impl) {
+      if (block->dom_frontier)
+         _mesa_set_clear(block->dom_frontier, NULL);
+      else
+         block->dom_frontier = _mesa_pointer_set_create(block);
+   }
+
+   nir_block *start_block = nir_start_block(impl);
+   nir_foreach_block_unstructured(block, impl) {
+      calc_dom_frontier(block, start_block);
+   }
+}
+
+/**
+ * Updates the dominance tree for flattening an if whose then and else lists
+ * are single blocks without jumps, i.e. for merging the block before the if,
+ * both branches and the block after it into the block before it.
+ *
+ * This has to be called before the if is removed.  The caller is responsible
+ * for marking nir_metadata_dominance as valid again once the CFG edit is done
+ * and the blocks are re-indexed.  Unlike a full recomputation, this is
+ * independent of the size of the shader.
+ */
+void
+nir_dominance_update_for_flattened_if(nir_if *nif)
+{
+   nir_block *before = nir_cf_node_as_block(nir_cf_node_prev(&nif->cf_node));
+   nir_block *after = nir_cf_node_as_block(nir_cf_node_next(&nif->cf_node));
+
+   assert(nir_if_first_then_block(nif) == nir_if_last_then_block(nif));
+   assert(nir_if_first_else_block(nif) == nir_if_last_else_block(nif));
+   assert(after->imm_dom == before || after->imm_dom == NULL);
+
+   /* The branches and the block after the if were the only children of the
+    * block before it.  The merged block keeps the pre/post-order interval of
+    * the block before the if, which contains the intervals of all of the
+    * adopted children, so nir_block_dominates() keeps working as well.
+    */
+   ralloc_free(before->dom_children);
+   before->dom_children = after->dom_children;
+   before->num_dom_children = after->num_dom_children;
+
+   for (unsigned i = 0; i < before->num_dom_children; i++)
+      before->dom_children[i]->imm_dom = before;
+
+   after->dom_children = NULL;
+   after->num_dom_children = 0;
+}
+
 static nir_block *
 block_return_if_reachable(nir_block *b)
 {
@@ -302,6 +360,8 @@ nir_dump_dom_tree(nir_shader *shader, FILE *fp)
 void
 nir_dump_dom_frontier_impl(nir_function_impl *impl, FILE *fp)
 {
+   nir_metadata_require(impl, nir_metadata_dominance_frontier);
+
    nir_foreach_block_unstructured(block, impl) {
       fprintf(fp, "DF(%u) = {", block->index);
       set_foreach(block->dom_frontier, entry) {
@@ -212,6 +212,34 @@ nir_live_ssa_defs_impl(nir_function_impl *impl)
    nir_block_worklist_fini(&state.worklist);
 }
 
+/**
+ * Updates liveness for flattening an if whose then and else lists are single
+ * blocks without jumps, i.e. for merging the block before the if, both
+ * branches and the block after it into the block before it.
+ *
+ * Every value which was live into the branches is still live into the merged
+ * block, so its live-in set doesn't change and the rest of the function
+ * isn't affected at all.  This only holds as long as the condition of the if
+ * is still used in the merged block, for instance by the selects replacing
+ * the phis in the block after the if, and those selects take over the SSA
+ * indices of the phis.  It has to be called before the if is removed and the
+ * caller is responsible for marking nir_metadata_live_ssa_defs as valid
+ * again once the CFG edit is done.
+ */
+void
+nir_live_ssa_defs_update_for_flattened_if(nir_if *nif)
+{
+   nir_function_impl *impl = nir_cf_node_get_function(&nif->cf_node);
+   nir_block *before = nir_cf_node_as_block(nir_cf_node_prev(&nif->cf_node));
+   nir_block *after = nir_cf_node_as_block(nir_cf_node_next(&nif->cf_node));
+
+   assert(nir_if_first_then_block(nif) == nir_if_last_then_block(nif));
+   assert(nir_if_first_else_block(nif) == nir_if_last_else_block(nif));
+
+   memcpy(before->live_out, after->live_out,
+          BITSET_WORDS(impl->ssa_alloc) * sizeof(BITSET_WORD));
+}
+
 /** Return the live set at a cursor
  *
  * Note: The bitset returned may be the live_in or live_out from the block in
@@ -929,7 +929,7 @@ nir_lower_goto_ifs_impl(nir_function_impl *impl)
       return false;
    }
 
-   nir_metadata_require(impl, nir_metadata_dominance);
+   nir_metadata_require(impl, nir_metadata_dominance_frontier);
 
    /* We're going to re-arrange blocks like crazy.  This is much easier to do
     * if we don't have any phi nodes to fix up.
@@ -41,6 +41,8 @@ nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...)
       nir_index_instrs(impl);
    if (NEEDS_UPDATE(nir_metadata_dominance))
       nir_calc_dominance_impl(impl);
+   if (NEEDS_UPDATE(nir_metadata_dominance_frontier))
+      nir_calc_dom_frontier_impl(impl);
    if (NEEDS_UPDATE(nir_metadata_live_ssa_defs))
       nir_live_ssa_defs_impl(impl);
    if (NEEDS_UPDATE(nir_metadata_loop_analysis)) {
@@ -58,9 +60,34 @@ nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...)
 void
 nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved)
 {
+   /* The dominance frontier is derived from the dominance tree and is only
+    * ever as valid as it.
+    */
+   if (preserved & nir_metadata_dominance)
+      preserved |= nir_metadata_dominance_frontier;
+   else
+      preserved &= ~nir_metadata_dominance_frontier;
+
    impl->valid_metadata &= preserved;
 }
 
+/**
+ * Marks metadata as valid again after the pass has updated it itself.
+ *
+ * The control-flow manipulation helpers throw away all metadata because they
+ * can't know what the caller is going to do with the CFG.  A pass which
+ * incrementally updates some of it across such an edit (see e.g.
+ * nir_dominance_update_for_flattened_if()) calls this after
+ * nir_metadata_preserve() to say exactly what is still valid, so that later
+ * passes don't have to recompute it from scratch.
+ */
+void
+nir_metadata_set_valid(nir_function_impl *impl, nir_metadata valid)
+{
+   assert(!(valid & nir_metadata_not_properly_reset));
+   impl->valid_metadata |= valid;
+}
+
 void
 nir_shader_preserve_all_metadata(nir_shader *shader)
 {
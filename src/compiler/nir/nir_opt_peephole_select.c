@@ -374,7 +374,7 @@ nir_opt_collapse_if(nir_if *if_stmt, nir_shader *shader, unsigned limit,
 static bool
 nir_opt_peephole_select_block(nir_block *block, nir_shader *shader,
                               unsigned limit, bool indirect_load_ok,
-                              bool expensive_alu_ok)
+                              bool expensive_alu_ok, nir_metadata *updated)
 {
    if (nir_cf_node_is_first(&block->cf_node))
       return false;
@@ -398,8 +398,10 @@ nir_opt_peephole_select_block(nir_block *block, nir_shader *shader,
 
    /* first, try to collapse the if */
    if (nir_opt_collapse_if(if_stmt, shader, limit,
-                           indirect_load_ok, expensive_alu_ok))
+                           indirect_load_ok, expensive_alu_ok)) {
+      *updated = nir_metadata_none;
       return true;
+   }
 
    if (if_stmt->control == nir_selection_control_dont_flatten)
       return false;
@@ -435,6 +437,18 @@ nir_opt_peephole_select_block(nir_block *block, nir_shader *shader,
     * selects.
     */
 
+   /* Dominance and liveness are cheap to update for this particular CFG
+    * edit, see nir_dominance_update_for_flattened_if() and
+    * nir_live_ssa_defs_update_for_flattened_if().  The live range of the
+    * condition may end here if there are no phis to turn into selects.
+    */
+   if (nir_block_ends_in_jump(prev_block))
+      *updated = nir_metadata_none;
+
+   nir_instr *first_instr = nir_block_first_instr(block);
+   if (first_instr == NULL || first_instr->type != nir_instr_type_phi)
+      *updated &= ~nir_metadata_live_ssa_defs;
+
    /* First, we move the remaining instructions from the blocks to the
     * block before.  We have already guaranteed that this is safe by
     * calling block_check_for_allowed_instrs()
@@ -475,6 +489,11 @@ nir_opt_peephole_select_block(nir_block *block, nir_shader *shader,
                         phi->dest.ssa.bit_size, NULL);
       sel->dest.write_mask = (1 << phi->dest.ssa.num_components) - 1;
 
+      /* Take over the index of the phi so that the liveness sets remain
+       * valid.
+       */
+      sel->dest.dest.ssa.index = phi->dest.ssa.index;
+
       nir_ssa_def_rewrite_uses(&phi->dest.ssa,
                                &sel->dest.dest.ssa);
 
@@ -482,6 +501,11 @@ nir_opt_peephole_select_block(nir_block *block, nir_shader *shader,
       nir_instr_remove(&phi->instr);
    }
 
+   if (*updated & nir_metadata_dominance)
+      nir_dominance_update_for_flattened_if(if_stmt);
+   if (*updated & nir_metadata_live_ssa_defs)
+      nir_live_ssa_defs_update_for_flattened_if(if_stmt);
+
    nir_cf_node_remove(&if_stmt->cf_node);
    return true;
 }
@@ -491,16 +515,24 @@ nir_opt_peephole_select_impl(nir_function_impl *impl, unsigned limit,
                              bool indirect_load_ok, bool expensive_alu_ok)
 {
    nir_shader *shader = impl->function->shader;
+   nir_metadata updated = impl->valid_metadata &
+                          (nir_metadata_dominance | nir_metadata_live_ssa_defs);
    bool progress = false;
 
    nir_foreach_block_safe(block, impl) {
       progress |= nir_opt_peephole_select_block(block, shader, limit,
                                                 indirect_load_ok,
-                                                expensive_alu_ok);
+                                                expensive_alu_ok, &updated);
    }
 
    if (progress) {
       nir_metadata_preserve(impl, nir_metadata_none);
+
+      /* The dominance tree relies on the blocks being numbered in order. */
+      if (updated) {
+         nir_index_blocks(impl);
+         nir_metadata_set_valid(impl, nir_metadata_block_index | updated);
+      }
    } else {
       nir_metadata_preserve(impl, nir_metadata_all);
    }
@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nir.h"
+#include "util/os_time.h"
+#include <stdlib.h>
+
+/*
+ * Implements the fixed-point tracking behind NIR_LOOP_PASS.
+ *
+ * The tracker only ever sees the progress reported by the passes it runs, so
+ * "the shader changed" simply means "some tracked pass made progress".  In
+ * that case every pass may have new work to do and the fixed-point set is
+ * cleared.
+ */
+
+void
+nir_pass_tracker_init(nir_pass_tracker *tracker, void *mem_ctx)
+{
+   tracker->fixed_point = _mesa_pointer_set_create(mem_ctx);
+   tracker->stats = NIR_DEBUG(PASS_STATS) ?
+                    _mesa_pointer_hash_table_create(mem_ctx) : NULL;
+}
+
+void
+nir_pass_tracker_invalidate(nir_pass_tracker *tracker)
+{
+   _mesa_set_clear(tracker->fixed_point, NULL);
+}
+
+static nir_pass_stats *
+get_stats(nir_pass_tracker *tracker, const void *pass, const char *name)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(tracker->stats, pass);
+   if (entry)
+      return entry->data;
+
+   nir_pass_stats *stats = rzalloc(tracker->stats, nir_pass_stats);
+   stats->name = name;
+   _mesa_hash_table_insert(tracker->stats, pass, stats);
+   return stats;
+}
+
+bool
+nir_pass_tracker_skip(nir_pass_tracker *tracker, const void *pass,
+                      const char *name)
+{
+   if (!_mesa_set_search(tracker->fixed_point, pass))
+      return false;
+
+   if (unlikely(tracker->stats))
+      get_stats(tracker, pass, name)->skips++;
+
+   return true;
+}
+
+uint64_t
+nir_pass_tracker_start(const nir_pass_tracker *tracker)
+{
+   return unlikely(tracker->stats) ? os_time_get_nano() : 0;
+}
+
+void
+nir_pass_tracker_end(nir_pass_tracker *tracker, const void *pass,
+                     const char *name, uint64_t start_ns,
+                     bool progress, bool idempotent)
+{
+   if (unlikely(tracker->stats)) {
+      nir_pass_stats *stats = get_stats(tracker, pass, name);
+      stats->time_ns += os_time_get_nano() - start_ns;
+      stats->runs++;
+      if (progress)
+         stats->progress++;
+   }
+
+   if (progress) {
+      _mesa_set_clear(tracker->fixed_point, NULL);
+      if (!idempotent)
+         return;
+   }
+
+   _mesa_set_add(tracker->fixed_point, pass);
+}
+
+static int
+compare_stats_time(const void *_a, const void *_b)
+{
+   const nir_pass_stats *a = *(const nir_pass_stats **)_a;
+   const nir_pass_stats *b = *(const nir_pass_stats **)_b;
+
+   if (a->time_ns != b->time_ns)
+      return a->time_ns < b->time_ns ? 1 : -1;
+
+   return strcmp(a->name, b->name);
+}
+
+static void
+print_stats(const nir_pass_tracker *tracker, const nir_shader *nir)
+{
+   unsigned count = _mesa_hash_table_num_entries(tracker->stats);
+   if (count == 0)
+      return;
+
+   nir_pass_stats **sorted = ralloc_array(NULL, nir_pass_stats *, count);
+   unsigned i = 0;
+   hash_table_foreach(tracker->stats, entry)
+      sorted[i++] = entry->data;
+   qsort(sorted, count, sizeof(*sorted), compare_stats_time);
+
+   unsigned runs = 0, skips = 0, progress = 0;
+   uint64_t time_ns = 0;
+
+   fprintf(stderr, "NIR pass statistics for %s shader%s%s:\n",
+           _mesa_shader_stage_to_string(nir->info.stage),
+           nir->info.name ? " " : "", nir->info.name ? nir->info.name : "");
+   fprintf(stderr, "  %-40s %8s %8s %8s %12s\n",
+           "pass", "runs", "skips", "progress", "time (us)");
+   for (i = 0; i < count; i++) {
+      const nir_pass_stats *s = sorted[i];
+      fprintf(stderr, "  %-40s %8u %8u %8u %12.1f\n",
+              s->name, s->runs, s->skips, s->progress, s->time_ns / 1000.0);
+      runs += s->runs;
+      skips += s->skips;
+      progress += s->progress;
+      time_ns += s->time_ns;
+   }
+   fprintf(stderr, "  %-40s %8u %8u %8u %12.1f\n",
+           "total", runs, skips, progress, time_ns / 1000.0);
+
+   ralloc_free(sorted);
+}
+
+void
+nir_pass_tracker_fini(nir_pass_tracker *tracker, const nir_shader *nir)
+{
+   if (unlikely(tracker->stats)) {
+      print_stats(tracker, nir);
+      _mesa_hash_table_destroy(tracker->stats, NULL);
+      tracker->stats = NULL;
+   }
+
+   _mesa_set_destroy(tracker->fixed_point, NULL);
+   tracker->fixed_point = NULL;
+}
@@ -97,6 +97,7 @@ nir_phi_builder_create(nir_function_impl *impl)
 
    assert(impl->valid_metadata & (nir_metadata_block_index |
                                   nir_metadata_dominance));
+   nir_metadata_require(impl, nir_metadata_dominance_frontier);
 
    pb->num_blocks = impl->num_blocks;
    pb->blocks = ralloc_array(pb, nir_block *, pb->num_blocks);
@@ -51,9 +51,12 @@ typedef struct {
     */
    struct util_dynarray phi_fixups;
 
-   /* The last serialized type. */
-   const struct glsl_type *last_type;
-   const struct glsl_type *last_interface_type;
+   /* Maps each type written so far to its 1-based index in the type
+    * table, see write_type().
+    */
+   struct hash_table *type_table;
+   uint32_t num_types;
+
    struct nir_variable_data last_var_data;
 
    /* For skipping equal ALU headers (typical after scalarization). */
@@ -82,9 +85,9 @@ typedef struct {
    /* List of phi sources. */
    struct list_head phi_srcs;
 
-   /* The last deserialized type. */
-   const struct glsl_type *last_type;
-   const struct glsl_type *last_interface_type;
+   /* Array of const struct glsl_type * in the order they were read. */
+   struct util_dynarray types;
+
    struct nir_variable_data last_var_data;
 } read_ctx;
 
@@ -172,29 +175,172 @@ decode_num_components_in_3bits(uint8_t value)
    return 0;
 }
 
+/* Types are written once into a type table that is built on the fly: a
+ * reference is the 1-based index of a previously written type, or 0 followed
+ * by the encoding of a new type which then gets the next index.  Besides
+ * being smaller, this avoids looking up the same (possibly large struct or
+ * interface) type in the glsl_type hash tables over and over on the read
+ * side.
+ */
+static void
+write_type(write_ctx *ctx, const struct glsl_type *type)
+{
+   struct hash_entry *entry = type ?
+      _mesa_hash_table_search(ctx->type_table, type) : NULL;
+   if (entry) {
+      blob_write_uleb128(ctx->blob, (uintptr_t) entry->data);
+      return;
+   }
+
+   blob_write_uleb128(ctx->blob, 0);
+   encode_type_to_blob(ctx->blob, type);
+
+   uint32_t index = ++ctx->num_types;
+   if (type) {
+      _mesa_hash_table_insert(ctx->type_table, type,
+                              (void *)(uintptr_t) index);
+   }
+}
+
+static const struct glsl_type *
+read_type(read_ctx *ctx)
+{
+   uint32_t index = blob_read_uleb128(ctx->blob);
+   if (index) {
+      /* Indices come from the blob, so one past the table means that it is
+       * corrupt.
+       */
+      if (index > util_dynarray_num_elements(&ctx->types,
+                                             const struct glsl_type *)) {
+         ctx->blob->overrun = true;
+         return NULL;
+      }
+      return *util_dynarray_element(&ctx->types, const struct glsl_type *,
+                                    index - 1);
+   }
+
+   const struct glsl_type *type = decode_type_from_blob(ctx->blob);
+   util_dynarray_append(&ctx->types, const struct glsl_type *, type);
+   return type;
+}
+
+static unsigned
+count_constants(const nir_constant *c)
+{
+   unsigned count = 1;
+   for (unsigned i = 0; i < c->num_elements; i++)
+      count += count_constants(c->elements[i]);
+   return count;
+}
+
+/* Only the non-zero components of a constant are written, as 32-bit values
+ * when they all fit.
+ */
 static void
 write_constant(write_ctx *ctx, const nir_constant *c)
 {
-   blob_write_bytes(ctx->blob, c->values, sizeof(c->values));
-   blob_write_uint32(ctx->blob, c->num_elements);
+   uint32_t nonzero_mask = 0;
+   bool values_32bit = true;
+   for (unsigned i = 0; i < ARRAY_SIZE(c->values); i++) {
+      if (c->values[i].u64) {
+         nir_const_value value_32bit = { .u32 = c->values[i].u32 };
+         nonzero_mask |= 1u << i;
+         values_32bit &= memcmp(&value_32bit, &c->values[i],
+                                sizeof(value_32bit)) == 0;
+      }
+   }
+
+   blob_write_uleb128(ctx->blob, nonzero_mask << 1 | values_32bit);
+   blob_write_uleb128(ctx->blob, c->num_elements);
+
+   u_foreach_bit(i, nonzero_mask) {
+      if (values_32bit)
+         blob_write_bytes(ctx->blob, &c->values[i].u32, sizeof(uint32_t));
+      else
+         blob_write_bytes(ctx->blob, &c->values[i].u64, sizeof(uint64_t));
+   }
+
    for (unsigned i = 0; i < c->num_elements; i++)
       write_constant(ctx, c->elements[i]);
 }
 
+typedef struct {
+   nir_constant *next_constant;
+   nir_constant **next_element;
+   unsigned constants_left;
+   unsigned elements_left;
+} read_constant_state;
+
+/* The counts come from the blob, so running out of preallocated constants
+ * or elements means that it is corrupt.  This is flagged as an overrun.
+ */
 static nir_constant *
-read_constant(read_ctx *ctx, nir_variable *nvar)
+read_constant_tree(read_ctx *ctx, read_constant_state *state)
 {
-   nir_constant *c = ralloc(nvar, nir_constant);
+   if (state->constants_left == 0) {
+      ctx->blob->overrun = true;
+      return NULL;
+   }
 
-   blob_copy_bytes(ctx->blob, (uint8_t *)c->values, sizeof(c->values));
-   c->num_elements = blob_read_uint32(ctx->blob);
-   c->elements = ralloc_array(nvar, nir_constant *, c->num_elements);
-   for (unsigned i = 0; i < c->num_elements; i++)
-      c->elements[i] = read_constant(ctx, nvar);
+   nir_constant *c = state->next_constant++;
+   state->constants_left--;
+
+   uint32_t header = blob_read_uleb128(ctx->blob);
+   uint32_t nonzero_mask = header >> 1;
+   bool values_32bit = header & 1;
+   uint32_t num_elements = blob_read_uleb128(ctx->blob);
+
+   u_foreach_bit(i, nonzero_mask) {
+      if (i >= ARRAY_SIZE(c->values))
+         break;
+
+      if (values_32bit)
+         blob_copy_bytes(ctx->blob, &c->values[i].u32, sizeof(uint32_t));
+      else
+         blob_copy_bytes(ctx->blob, &c->values[i].u64, sizeof(uint64_t));
+   }
+
+   if (num_elements > state->elements_left) {
+      ctx->blob->overrun = true;
+      return c;
+   }
+
+   if (num_elements > 0) {
+      c->elements = state->next_element;
+      state->next_element += num_elements;
+      state->elements_left -= num_elements;
+      for (unsigned i = 0; i < num_elements && !ctx->blob->overrun; i++) {
+         c->elements[i] = read_constant_tree(ctx, state);
+         if (c->elements[i])
+            c->num_elements = i + 1;
+      }
+   }
 
    return c;
 }
 
+/* The whole constant tree is allocated as a single block. */
+static nir_constant *
+read_constant(read_ctx *ctx, nir_variable *nvar)
+{
+   unsigned count = blob_read_uleb128(ctx->blob);
+
+   /* Every constant takes at least two bytes. */
+   if (count == 0 || count > (ctx->blob->end - ctx->blob->current) / 2) {
+      ctx->blob->overrun = true;
+      return NULL;
+   }
+
+   read_constant_state state;
+   state.next_constant = rzalloc_array(nvar, nir_constant, count);
+   state.next_element = count > 1 ?
+      ralloc_array(nvar, nir_constant *, count - 1) : NULL;
+   state.constants_left = count;
+   state.elements_left = count - 1;
+
+   return read_constant_tree(ctx, &state);
+}
+
 enum var_data_encoding {
    var_encode_full,
    var_encode_shader_temp,
@@ -211,9 +357,7 @@ union packed_var {
       unsigned has_interface_type:1;
       unsigned num_state_slots:7;
       unsigned data_encoding:2;
-      unsigned type_same_as_last:1;
-      unsigned interface_type_same_as_last:1;
-      unsigned _pad:1;
+      unsigned _pad:3;
       unsigned num_members:16;
    } u;
 };
@@ -242,9 +386,6 @@ write_variable(write_ctx *ctx, const nir_variable *var)
    flags.u.has_constant_initializer = !!(var->constant_initializer);
    flags.u.has_pointer_initializer = !!(var->pointer_initializer);
    flags.u.has_interface_type = !!(var->interface_type);
-   flags.u.type_same_as_last = var->type == ctx->last_type;
-   flags.u.interface_type_same_as_last =
-      var->interface_type && var->interface_type == ctx->last_interface_type;
    flags.u.num_state_slots = var->num_state_slots;
    flags.u.num_members = var->num_members;
 
@@ -286,15 +427,9 @@ write_variable(write_ctx *ctx, const nir_variable *var)
 
    blob_write_uint32(ctx->blob, flags.u32);
 
-   if (!flags.u.type_same_as_last) {
-      encode_type_to_blob(ctx->blob, var->type);
-      ctx->last_type = var->type;
-   }
-
-   if (var->interface_type && !flags.u.interface_type_same_as_last) {
-      encode_type_to_blob(ctx->blob, var->interface_type);
-      ctx->last_interface_type = var->interface_type;
-   }
+   write_type(ctx, var->type);
+   if (var->interface_type)
+      write_type(ctx, var->interface_type);
 
    if (flags.u.has_name)
       blob_write_string(ctx->blob, var->name);
@@ -324,8 +459,11 @@ write_variable(write_ctx *ctx, const nir_variable *var)
       blob_write_bytes(ctx->blob, &var->state_slots[i],
                        sizeof(var->state_slots[i]));
    }
-   if (var->constant_initializer)
+   if (var->constant_initializer) {
+      blob_write_uleb128(ctx->blob,
+                         count_constants(var->constant_initializer));
       write_constant(ctx, var->constant_initializer);
+   }
    if (var->pointer_initializer)
       write_lookup_object(ctx, var->pointer_initializer);
    if (var->num_members > 0) {
@@ -343,21 +481,9 @@ read_variable(read_ctx *ctx)
    union packed_var flags;
    flags.u32 = blob_read_uint32(ctx->blob);
 
-   if (flags.u.type_same_as_last) {
-      var->type = ctx->last_type;
-   } else {
-      var->type = decode_type_from_blob(ctx->blob);
-      ctx->last_type = var->type;
-   }
-
-   if (flags.u.has_interface_type) {
-      if (flags.u.interface_type_same_as_last) {
-         var->interface_type = ctx->last_interface_type;
-      } else {
-         var->interface_type = decode_type_from_blob(ctx->blob);
-         ctx->last_interface_type = var->interface_type;
-      }
-   }
+   var->type = read_type(ctx);
+   if (flags.u.has_interface_type)
+      var->interface_type = read_type(ctx);
 
    if (flags.u.has_name) {
       const char *name = blob_read_string(ctx->blob);
@@ -429,7 +555,7 @@ read_var_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
    unsigned num_vars = blob_read_uint32(ctx->blob);
-   for (unsigned i = 0; i < num_vars; i++) {
+   for (unsigned i = 0; i < num_vars && !ctx->blob->overrun; i++) {
       nir_variable *var = read_variable(ctx);
       exec_list_push_tail(dst, &var->node);
    }
@@ -439,10 +565,10 @@ static void
 write_register(write_ctx *ctx, const nir_register *reg)
 {
    write_add_object(ctx, reg);
-   blob_write_uint32(ctx->blob, reg->num_components);
-   blob_write_uint32(ctx->blob, reg->bit_size);
-   blob_write_uint32(ctx->blob, reg->num_array_elems);
-   blob_write_uint32(ctx->blob, reg->index);
+   blob_write_uleb128(ctx->blob, reg->num_components);
+   blob_write_uleb128(ctx->blob, reg->bit_size);
+   blob_write_uleb128(ctx->blob, reg->num_array_elems);
+   blob_write_uleb128(ctx->blob, reg->index);
    blob_write_uint8(ctx->blob, reg->divergent);
 }
 
@@ -451,10 +577,10 @@ read_register(read_ctx *ctx)
 {
    nir_register *reg = ralloc(ctx->nir, nir_register);
    read_add_object(ctx, reg);
-   reg->num_components = blob_read_uint32(ctx->blob);
-   reg->bit_size = blob_read_uint32(ctx->blob);
-   reg->num_array_elems = blob_read_uint32(ctx->blob);
-   reg->index = blob_read_uint32(ctx->blob);
+   reg->num_components = blob_read_uleb128(ctx->blob);
+   reg->bit_size = blob_read_uleb128(ctx->blob);
+   reg->num_array_elems = blob_read_uleb128(ctx->blob);
+   reg->index = blob_read_uleb128(ctx->blob);
    reg->divergent = blob_read_uint8(ctx->blob);
 
    list_inithead(&reg->uses);
@@ -553,7 +679,7 @@ read_src(read_ctx *ctx, nir_src *src, void *mem_ctx)
       src->reg.reg = read_lookup_object(ctx, header.any.object_idx);
       src->reg.base_offset = blob_read_uint32(ctx->blob);
       if (header.any.is_indirect) {
-         src->reg.indirect = malloc(sizeof(nir_src));
+         src->reg.indirect = gc_alloc(ctx->nir->gctx, nir_src, 1);
          read_src(ctx, src->reg.indirect, mem_ctx);
       } else {
          src->reg.indirect = NULL;
@@ -627,9 +753,8 @@ union packed_instr {
    struct {
       unsigned instr_type:4;
       unsigned deref_type:3;
-      unsigned cast_type_same_as_last:1;
       unsigned modes:5; /* See (de|en)code_deref_modes() */
-      unsigned _pad:10;
+      unsigned _pad:11;
       unsigned packed_src_ssa_16bit:1; /* deref_var redefines this */
       unsigned dest:8;
    } deref;
@@ -773,7 +898,7 @@ read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr,
       dst->reg.reg = read_object(ctx);
       dst->reg.base_offset = blob_read_uint32(ctx->blob);
       if (dest.reg.is_indirect) {
-         dst->reg.indirect = malloc(sizeof(nir_src));
+         dst->reg.indirect = gc_alloc(ctx->nir->gctx, nir_src, 1);
          read_src(ctx, dst->reg.indirect, instr);
       }
    }
@@ -1023,7 +1148,6 @@ write_deref(write_ctx *ctx, const nir_deref_instr *deref)
 
    if (deref->deref_type == nir_deref_type_cast) {
       header.deref.modes = encode_deref_modes(deref->modes);
-      header.deref.cast_type_same_as_last = deref->type == ctx->last_type;
    }
 
    unsigned var_idx = 0;
@@ -1068,13 +1192,10 @@ write_deref(write_ctx *ctx, const nir_deref_instr *deref)
 
    case nir_deref_type_cast:
       write_src(ctx, &deref->parent);
-      blob_write_uint32(ctx->blob, deref->cast.ptr_stride);
-      blob_write_uint32(ctx->blob, deref->cast.align_mul);
-      blob_write_uint32(ctx->blob, deref->cast.align_offset);
-      if (!header.deref.cast_type_same_as_last) {
-         encode_type_to_blob(ctx->blob, deref->type);
-         ctx->last_type = deref->type;
-      }
+      blob_write_uleb128(ctx->blob, deref->cast.ptr_stride);
+      blob_write_uleb128(ctx->blob, deref->cast.align_mul);
+      blob_write_uleb128(ctx->blob, deref->cast.align_offset);
+      write_type(ctx, deref->type);
       break;
 
    case nir_deref_type_array_wildcard:
@@ -1134,15 +1255,10 @@ read_deref(read_ctx *ctx, union packed_instr header)
 
    case nir_deref_type_cast:
       read_src(ctx, &deref->parent, &deref->instr);
-      deref->cast.ptr_stride = blob_read_uint32(ctx->blob);
-      deref->cast.align_mul = blob_read_uint32(ctx->blob);
-      deref->cast.align_offset = blob_read_uint32(ctx->blob);
-      if (header.deref.cast_type_same_as_last) {
-         deref->type = ctx->last_type;
-      } else {
-         deref->type = decode_type_from_blob(ctx->blob);
-         ctx->last_type = deref->type;
-      }
+      deref->cast.ptr_stride = blob_read_uleb128(ctx->blob);
+      deref->cast.align_mul = blob_read_uleb128(ctx->blob);
+      deref->cast.align_offset = blob_read_uleb128(ctx->blob);
+      deref->type = read_type(ctx);
       break;
 
    case nir_deref_type_array_wildcard:
@@ -2010,12 +2126,10 @@ write_function(write_ctx *ctx, const nir_function *fxn)
 
    write_add_object(ctx, fxn);
 
-   blob_write_uint32(ctx->blob, fxn->num_params);
+   blob_write_uleb128(ctx->blob, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      uint32_t val =
-         ((uint32_t)fxn->params[i].num_components) |
-         ((uint32_t)fxn->params[i].bit_size) << 8;
-      blob_write_uint32(ctx->blob, val);
+      blob_write_uint8(ctx->blob, fxn->params[i].num_components);
+      blob_write_uint8(ctx->blob, fxn->params[i].bit_size);
    }
 
    /* At first glance, it looks like we should write the function_impl here.
@@ -2036,12 +2150,11 @@ read_function(read_ctx *ctx)
 
    read_add_object(ctx, fxn);
 
-   fxn->num_params = blob_read_uint32(ctx->blob);
+   fxn->num_params = blob_read_uleb128(ctx->blob);
    fxn->params = ralloc_array(fxn, nir_parameter, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      uint32_t val = blob_read_uint32(ctx->blob);
-      fxn->params[i].num_components = val & 0xff;
-      fxn->params[i].bit_size = (val >> 8) & 0xff;
+      fxn->params[i].num_components = blob_read_uint8(ctx->blob);
+      fxn->params[i].bit_size = blob_read_uint8(ctx->blob);
    }
 
    fxn->is_entrypoint = flags & 0x1;
@@ -2062,6 +2175,7 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
 {
    write_ctx ctx = {0};
    ctx.remap_table = _mesa_pointer_hash_table_create(NULL);
+   ctx.type_table = _mesa_pointer_hash_table_create(NULL);
    ctx.blob = blob;
    ctx.nir = nir;
    ctx.strip = strip;
@@ -2107,6 +2221,7 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
    blob_overwrite_uint32(blob, idx_size_offset, ctx.next_idx);
 
    _mesa_hash_table_destroy(ctx.remap_table, NULL);
+   _mesa_hash_table_destroy(ctx.type_table, NULL);
    util_dynarray_fini(&ctx.phi_fixups);
 }
 
@@ -2118,6 +2233,7 @@ nir_deserialize(void *mem_ctx,
    read_ctx ctx = {0};
    ctx.blob = blob;
    list_inithead(&ctx.phi_srcs);
+   util_dynarray_init(&ctx.types, NULL);
    ctx.idx_table_len = blob_read_uint32(blob);
    ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
 
@@ -2136,6 +2252,8 @@ nir_deserialize(void *mem_ctx,
    ctx.nir->info = info;
 
    read_var_list(&ctx, &ctx.nir->variables);
+   if (blob->overrun)
+      goto fail;
 
    ctx.nir->num_inputs = blob_read_uint32(blob);
    ctx.nir->num_uniforms = blob_read_uint32(blob);
@@ -2159,11 +2277,21 @@ nir_deserialize(void *mem_ctx,
                       ctx.nir->constant_data_size);
    }
 
+   if (blob->overrun)
+      goto fail;
+
    free(ctx.idx_table);
+   util_dynarray_fini(&ctx.types);
 
    nir_validate_shader(ctx.nir, "after deserialize");
 
    return ctx.nir;
+
+fail:
+   free(ctx.idx_table);
+   util_dynarray_fini(&ctx.types);
+   ralloc_free(ctx.nir);
+   return NULL;
 }
 
 void
@@ -32,6 +32,7 @@ extern "C" {
 #endif
 
 void nir_serialize(struct blob *blob, const nir_shader *nir, bool strip);
+/* Returns NULL if the blob is truncated or otherwise corrupt. */
 nir_shader *nir_deserialize(void *mem_ctx,
                             const struct nir_shader_compiler_options *options,
                             struct blob_reader *blob);
@@ -30,6 +30,10 @@
  * memory - anything still connected to the program will be kept, and any dead memory
  * we dropped on the floor will be freed.
  *
+ * Instructions and the sources hanging off them live in the shader's gc_ctx
+ * and are marked live in place; everything else is ralloc'd and gets stolen
+ * back from a temporary context.
+ *
  * The expectation is that drivers should call this when finished compiling the shader
  * (after any optimization, lowering, and so on).  However, it's also fine to call it
  * earlier, and even many times, trading CPU cycles for memory savings.
@@ -40,6 +44,51 @@
 
 static void sweep_cf_node(nir_shader *nir, nir_cf_node *cf_node);
 
+static void
+mark_src_indirect(nir_shader *nir, nir_src *src)
+{
+   if (!src->is_ssa && src->reg.indirect)
+      gc_mark_live(nir->gctx, src->reg.indirect);
+}
+
+static bool
+mark_src_cb(nir_src *src, void *nir)
+{
+   mark_src_indirect(nir, src);
+   return true;
+}
+
+static bool
+mark_dest_cb(nir_dest *dest, void *nir)
+{
+   if (!dest->is_ssa && dest->reg.indirect)
+      gc_mark_live(((nir_shader *)nir)->gctx, dest->reg.indirect);
+   return true;
+}
+
+static void
+mark_instr(nir_shader *nir, nir_instr *instr)
+{
+   gc_mark_live(nir->gctx, instr);
+
+   switch (instr->type) {
+   case nir_instr_type_tex:
+      gc_mark_live(nir->gctx, nir_instr_as_tex(instr)->src);
+      break;
+
+   case nir_instr_type_phi:
+      nir_foreach_phi_src(src, nir_instr_as_phi(instr))
+         gc_mark_live(nir->gctx, src);
+      break;
+
+   default:
+      break;
+   }
+
+   nir_foreach_src(instr, mark_src_cb, nir);
+   nir_foreach_dest(instr, mark_dest_cb, nir);
+}
+
 static void
 sweep_block(nir_shader *nir, nir_block *block)
 {
@@ -55,8 +104,7 @@ sweep_block(nir_shader *nir, nir_block *block)
    block->live_out = NULL;
 
    nir_foreach_instr(instr, block) {
-      list_del(&instr->gc_node);
-      list_add(&instr->gc_node, &nir->gc_list);
+      mark_instr(nir, instr);
    }
 }
 
@@ -65,6 +113,8 @@ sweep_if(nir_shader *nir, nir_if *iff)
 {
    ralloc_steal(nir, iff);
 
+   mark_src_indirect(nir, &iff->condition);
+
    foreach_list_typed(nir_cf_node, cf_node, node, &iff->then_list) {
       sweep_cf_node(nir, cf_node);
    }
@@ -135,15 +185,13 @@ nir_sweep(nir_shader *nir)
 {
    void *rubbish = ralloc_context(NULL);
 
-   struct list_head instr_gc_list;
-   list_inithead(&instr_gc_list);
-
-   list_replace(&nir->gc_list, &instr_gc_list);
-   list_inithead(&nir->gc_list);
+   gc_sweep_start(nir->gctx);
 
    /* First, move ownership of all the memory to a temporary context; assume dead. */
    ralloc_adopt(rubbish, nir);
 
+   ralloc_steal(nir, nir->gctx);
+
    ralloc_steal(nir, (char *)nir->info.name);
    if (nir->info.label)
       ralloc_steal(nir, (char *)nir->info.label);
@@ -157,10 +205,7 @@ nir_sweep(nir_shader *nir)
    }
 
    /* Sweep instrs not found while walking the shader. */
-   list_for_each_entry_safe(nir_instr, instr, &instr_gc_list, gc_node) {
-      nir_instr_free(instr);
-   }
-   assert(list_is_empty(&instr_gc_list));
+   gc_sweep_end(nir->gctx);
 
    ralloc_steal(nir, nir->constant_data);
    ralloc_steal(nir, nir->printf_info);
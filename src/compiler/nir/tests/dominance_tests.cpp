@@ -0,0 +1,188 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "nir.h"
+#include "nir_builder.h"
+
+namespace {
+
+/* Everything the dominance and liveness metadata says about one block, in
+ * terms of block indices so that it can be compared across recomputations.
+ */
+struct block_info {
+   unsigned imm_dom;
+   unsigned num_dom_children;
+   std::vector<bool> dominates;
+   std::vector<BITSET_WORD> live_in;
+   std::vector<BITSET_WORD> live_out;
+};
+
+class nir_dominance_test : public ::testing::Test {
+protected:
+   nir_dominance_test();
+   ~nir_dominance_test();
+
+   std::vector<block_info> collect_info();
+
+   nir_builder b;
+
+   nir_ssa_def *in_def;
+   nir_variable *out_var;
+};
+
+nir_dominance_test::nir_dominance_test()
+{
+   glsl_type_singleton_init_or_ref();
+
+   static const nir_shader_compiler_options options = { };
+   b = nir_builder_init_simple_shader(MESA_SHADER_VERTEX, &options,
+                                     "dominance test");
+
+   nir_variable *var = nir_variable_create(b.shader, nir_var_shader_in,
+                                           glsl_int_type(), "in");
+   in_def = nir_load_var(&b, var);
+
+   out_var = nir_variable_create(b.shader, nir_var_shader_out,
+                                 glsl_int_type(), "out");
+}
+
+nir_dominance_test::~nir_dominance_test()
+{
+   ralloc_free(b.shader);
+   glsl_type_singleton_decref();
+}
+
+std::vector<block_info>
+nir_dominance_test::collect_info()
+{
+   unsigned words = BITSET_WORDS(b.impl->ssa_alloc);
+   std::vector<block_info> info;
+
+   nir_foreach_block(block, b.impl) {
+      EXPECT_EQ(block->index, info.size());
+
+      block_info bi;
+      bi.imm_dom = block->imm_dom ? block->imm_dom->index : ~0u;
+      bi.num_dom_children = block->num_dom_children;
+      nir_foreach_block(other, b.impl)
+         bi.dominates.push_back(nir_block_dominates(block, other));
+      bi.live_in.assign(block->live_in, block->live_in + words);
+      bi.live_out.assign(block->live_out, block->live_out + words);
+      info.push_back(bi);
+   }
+
+   return info;
+}
+
+/* Builds an if/else diamond whose result is selected by a phi. */
+static nir_ssa_def *
+build_diamond(nir_builder *b, nir_ssa_def *cond, nir_ssa_def *x)
+{
+   nir_push_if(b, cond);
+   nir_ssa_def *then_def = nir_iadd_imm(b, x, 1);
+   nir_push_else(b, NULL);
+   nir_ssa_def *else_def = nir_imul_imm(b, x, 3);
+   nir_pop_if(b, NULL);
+   return nir_if_phi(b, then_def, else_def);
+}
+
+} // namespace
+
+TEST_F(nir_dominance_test, frontier_is_computed_on_demand)
+{
+   nir_ssa_def *cond = nir_ieq_imm(&b, in_def, 0);
+   nir_if *nif = nir_push_if(&b, cond);
+   nir_pop_if(&b, nif);
+   nir_block *then_block = nir_if_first_then_block(nif);
+   nir_block *merge_block = nir_cf_node_as_block(nir_cf_node_next(&nif->cf_node));
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+   EXPECT_FALSE(b.impl->valid_metadata & nir_metadata_dominance_frontier);
+   EXPECT_EQ(then_block->dom_frontier, nullptr);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance_frontier);
+   ASSERT_NE(then_block->dom_frontier, nullptr);
+   EXPECT_TRUE(_mesa_set_search(then_block->dom_frontier, merge_block));
+   EXPECT_EQ(nir_start_block(b.impl)->dom_frontier->entries, 0u);
+
+   /* It goes away along with the rest of the dominance information. */
+   nir_metadata_preserve(b.impl, nir_metadata_block_index |
+                                 nir_metadata_dominance);
+   EXPECT_TRUE(b.impl->valid_metadata & nir_metadata_dominance_frontier);
+   nir_metadata_preserve(b.impl, nir_metadata_block_index);
+   EXPECT_FALSE(b.impl->valid_metadata & nir_metadata_dominance_frontier);
+}
+
+TEST_F(nir_dominance_test, peephole_select_updates_metadata)
+{
+   /* Two diamonds in a row inside a loop, followed by another one which
+    * keeps the loop from being trivial and a use of everything after it.
+    */
+   nir_ssa_def *cond = nir_ieq_imm(&b, in_def, 0);
+
+   nir_loop *loop = nir_push_loop(&b);
+   nir_ssa_def *x = build_diamond(&b, cond, in_def);
+   nir_ssa_def *y = build_diamond(&b, nir_ilt(&b, x, in_def), x);
+
+   nir_push_if(&b, nir_ige(&b, y, nir_imm_int(&b, 10)));
+   nir_jump(&b, nir_jump_break);
+   nir_pop_if(&b, NULL);
+
+   nir_ssa_def *z = build_diamond(&b, cond, y);
+   nir_store_var(&b, out_var, z, 1);
+   nir_pop_loop(&b, loop);
+
+   nir_store_var(&b, out_var, nir_iadd(&b, in_def, y), 1);
+
+   nir_validate_shader(b.shader, NULL);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance_frontier |
+                                nir_metadata_live_ssa_defs);
+
+   ASSERT_TRUE(nir_opt_peephole_select(b.shader, 8, true, true));
+   nir_validate_shader(b.shader, NULL);
+
+   const nir_metadata updated = nir_metadata_block_index |
+                                nir_metadata_dominance |
+                                nir_metadata_live_ssa_defs;
+   EXPECT_EQ(b.impl->valid_metadata & updated, updated);
+   EXPECT_FALSE(b.impl->valid_metadata & nir_metadata_dominance_frontier);
+
+   std::vector<block_info> incremental = collect_info();
+
+   nir_metadata_preserve(b.impl, nir_metadata_none);
+   nir_metadata_require(b.impl, updated);
+   std::vector<block_info> recomputed = collect_info();
+
+   ASSERT_EQ(incremental.size(), recomputed.size());
+   for (unsigned i = 0; i < incremental.size(); i++) {
+      EXPECT_EQ(incremental[i].imm_dom, recomputed[i].imm_dom) << "block " << i;
+      EXPECT_EQ(incremental[i].num_dom_children,
+                recomputed[i].num_dom_children) << "block " << i;
+      EXPECT_EQ(incremental[i].dominates, recomputed[i].dominates) << "block " << i;
+      EXPECT_EQ(incremental[i].live_in, recomputed[i].live_in) << "block " << i;
+      EXPECT_EQ(incremental[i].live_out, recomputed[i].live_out) << "block " << i;
+   }
+}
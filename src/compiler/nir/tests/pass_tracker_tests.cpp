@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+
+namespace {
+
+/* Fake passes which count how often they run and report progress for the
+ * first progress_left runs.
+ */
+struct fake_pass {
+   unsigned runs;
+   unsigned progress_left;
+};
+
+static fake_pass pass_a_state, pass_b_state;
+
+static bool
+run_fake_pass(nir_shader *shader, fake_pass *state)
+{
+   state->runs++;
+   if (state->progress_left == 0)
+      return false;
+
+   state->progress_left--;
+   nir_metadata_preserve(nir_shader_get_entrypoint(shader), nir_metadata_none);
+   return true;
+}
+
+static bool
+pass_a(nir_shader *shader)
+{
+   return run_fake_pass(shader, &pass_a_state);
+}
+
+static bool
+pass_b(nir_shader *shader)
+{
+   return run_fake_pass(shader, &pass_b_state);
+}
+
+class nir_pass_tracker_test : public ::testing::Test {
+protected:
+   nir_pass_tracker_test();
+   ~nir_pass_tracker_test();
+
+   nir_builder b;
+   nir_pass_tracker tracker;
+};
+
+nir_pass_tracker_test::nir_pass_tracker_test()
+{
+   glsl_type_singleton_init_or_ref();
+
+   static const nir_shader_compiler_options options = { };
+   b = nir_builder_init_simple_shader(MESA_SHADER_COMPUTE, &options,
+                                      "pass tracker test");
+   nir_pass_tracker_init(&tracker, NULL);
+
+   pass_a_state = fake_pass();
+   pass_b_state = fake_pass();
+}
+
+nir_pass_tracker_test::~nir_pass_tracker_test()
+{
+   nir_pass_tracker_fini(&tracker, b.shader);
+   ralloc_free(b.shader);
+   glsl_type_singleton_decref();
+}
+
+} // namespace
+
+TEST_F(nir_pass_tracker_test, idempotent)
+{
+   pass_a_state.progress_left = 1;
+
+   unsigned iterations = 0;
+   bool progress;
+   do {
+      progress = false;
+      NIR_LOOP_PASS(progress, &tracker, b.shader, pass_a);
+      NIR_LOOP_PASS(progress, &tracker, b.shader, pass_b);
+      iterations++;
+   } while (progress);
+
+   /* Neither pass can have anything left to do in the second iteration. */
+   EXPECT_EQ(iterations, 2u);
+   EXPECT_EQ(pass_a_state.runs, 1u);
+   EXPECT_EQ(pass_b_state.runs, 1u);
+}
+
+TEST_F(nir_pass_tracker_test, progress_reruns_other_passes)
+{
+   pass_b_state.progress_left = 1;
+
+   unsigned iterations = 0;
+   bool progress;
+   do {
+      progress = false;
+      NIR_LOOP_PASS(progress, &tracker, b.shader, pass_a);
+      NIR_LOOP_PASS(progress, &tracker, b.shader, pass_b);
+      iterations++;
+   } while (progress);
+
+   /* pass_b changed the shader after pass_a ran, so pass_a runs again. */
+   EXPECT_EQ(iterations, 2u);
+   EXPECT_EQ(pass_a_state.runs, 2u);
+   EXPECT_EQ(pass_b_state.runs, 1u);
+}
+
+TEST_F(nir_pass_tracker_test, not_idempotent)
+{
+   pass_a_state.progress_left = 2;
+
+   unsigned iterations = 0;
+   bool progress;
+   do {
+      progress = false;
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, &tracker, b.shader, pass_a);
+      NIR_LOOP_PASS(progress, &tracker, b.shader, pass_b);
+      iterations++;
+   } while (progress);
+
+   EXPECT_EQ(iterations, 3u);
+   EXPECT_EQ(pass_a_state.runs, 3u);
+   EXPECT_EQ(pass_b_state.runs, 2u);
+}
+
+TEST_F(nir_pass_tracker_test, invalidate)
+{
+   bool progress = false;
+   NIR_LOOP_PASS(progress, &tracker, b.shader, pass_a);
+   NIR_LOOP_PASS(progress, &tracker, b.shader, pass_a);
+   EXPECT_FALSE(progress);
+   EXPECT_EQ(pass_a_state.runs, 1u);
+
+   nir_pass_tracker_invalidate(&tracker);
+
+   NIR_LOOP_PASS(progress, &tracker, b.shader, pass_a);
+   EXPECT_EQ(pass_a_state.runs, 2u);
+}
@@ -100,6 +100,7 @@ nir_serialize_test::ASSERT_SWIZZLE_EQ(nir_alu_instr *a, nir_alu_instr *b, unsign
 
 class nir_serialize_all_test : public nir_serialize_test {};
 class nir_serialize_all_but_one_test : public nir_serialize_test {};
+class nir_serialize_var_test : public nir_serialize_test {};
 
 } // namespace
 
@@ -279,3 +280,150 @@ TEST_P(nir_serialize_all_but_one_test, single_channel)
 
    ASSERT_SWIZZLE_EQ(vec_alu, vec_alu_dup, 1, 0);
 }
+
+TEST_F(nir_serialize_var_test, types_and_constant_initializers)
+{
+   const glsl_type *array_type = glsl_array_type(glsl_vec4_type(), 3, 0);
+
+   nir_variable *a = nir_variable_create(b->shader, nir_var_shader_temp,
+                                         array_type, "a");
+   nir_variable *d = nir_variable_create(b->shader, nir_var_shader_temp,
+                                         glsl_dvec_type(2), "b");
+   nir_variable_create(b->shader, nir_var_shader_temp, array_type, "c");
+
+   nir_constant *init = rzalloc(a, nir_constant);
+   init->num_elements = 3;
+   init->elements = ralloc_array(a, nir_constant *, 3);
+   for (unsigned i = 0; i < 3; i++) {
+      init->elements[i] = rzalloc(a, nir_constant);
+      init->elements[i]->values[0].f32 = i;
+      init->elements[i]->values[3].f32 = -1.0f;
+   }
+   a->constant_initializer = init;
+
+   d->constant_initializer = rzalloc(d, nir_constant);
+   d->constant_initializer->values[1].u64 = 0x123456789abcdef0ull;
+
+   nir_ssa_def *addr = nir_imm_int64(b, 0x1000);
+   nir_build_deref_cast(b, addr, nir_var_mem_global, glsl_uint_type(), 4);
+   nir_build_deref_cast(b, addr, nir_var_mem_global, glsl_uint_type(), 4);
+
+   serialize();
+
+   nir_variable *var_dup[3];
+   unsigned num_vars = 0;
+   nir_foreach_variable_in_shader(var, dup) {
+      ASSERT_LT(num_vars, 3u);
+      var_dup[num_vars++] = var;
+   }
+   ASSERT_EQ(num_vars, 3u);
+
+   EXPECT_EQ(var_dup[0]->type, array_type);
+   EXPECT_EQ(var_dup[1]->type, glsl_dvec_type(2));
+   EXPECT_EQ(var_dup[2]->type, array_type);
+
+   nir_constant *init_dup = var_dup[0]->constant_initializer;
+   ASSERT_NE(init_dup, nullptr);
+   EXPECT_EQ(memcmp(init->values, init_dup->values, sizeof(init->values)), 0);
+   ASSERT_EQ(init_dup->num_elements, 3u);
+   for (unsigned i = 0; i < 3; i++) {
+      EXPECT_EQ(init_dup->elements[i]->num_elements, 0u);
+      EXPECT_EQ(memcmp(init->elements[i]->values,
+                       init_dup->elements[i]->values,
+                       sizeof(init->values)), 0);
+   }
+   ASSERT_NE(var_dup[1]->constant_initializer, nullptr);
+   EXPECT_EQ(var_dup[1]->constant_initializer->values[0].u64, 0u);
+   EXPECT_EQ(var_dup[1]->constant_initializer->values[1].u64,
+             0x123456789abcdef0ull);
+   EXPECT_EQ(var_dup[2]->constant_initializer, nullptr);
+
+   unsigned num_casts = 0;
+   nir_foreach_block(block, nir_shader_get_entrypoint(dup)) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_deref)
+            continue;
+
+         nir_deref_instr *cast = nir_instr_as_deref(instr);
+         EXPECT_EQ(cast->deref_type, nir_deref_type_cast);
+         EXPECT_EQ(cast->type, glsl_uint_type());
+         EXPECT_EQ(cast->cast.ptr_stride, 4u);
+         num_casts++;
+      }
+   }
+   EXPECT_EQ(num_casts, 2u);
+}
+
+TEST_F(nir_serialize_var_test, corrupt_constant_count)
+{
+   nir_variable *a = nir_variable_create(b->shader, nir_var_shader_temp,
+                                         glsl_array_type(glsl_uint_type(), 3, 0),
+                                         "a");
+   nir_constant *init = rzalloc(a, nir_constant);
+   init->num_elements = 3;
+   init->elements = ralloc_array(a, nir_constant *, 3);
+   for (unsigned i = 0; i < 3; i++)
+      init->elements[i] = rzalloc(a, nir_constant);
+   a->constant_initializer = init;
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize(&blob, b->shader, false);
+
+   /* The tree is written as its constant count (4), the header of the root
+    * (no values, 32-bit) and its element count (3).  Claim fewer constants
+    * than the tree has.
+    */
+   static const uint8_t tree[] = { 4, 1, 3 };
+   uint8_t *count = NULL;
+   for (size_t i = 0; i + sizeof(tree) <= blob.size; i++) {
+      if (memcmp(blob.data + i, tree, sizeof(tree)) == 0) {
+         count = blob.data + i;
+         break;
+      }
+   }
+   ASSERT_NE(count, nullptr);
+   *count = 2;
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob.data, blob.size);
+   EXPECT_EQ(nir_deserialize(NULL, &options, &reader), nullptr);
+   EXPECT_TRUE(reader.overrun);
+
+   /* A truncated blob fails as well. */
+   blob_reader_init(&reader, blob.data, blob.size / 2);
+   EXPECT_EQ(nir_deserialize(NULL, &options, &reader), nullptr);
+
+   blob_finish(&blob);
+}
+
+TEST_F(nir_serialize_var_test, corrupt_type_index)
+{
+   nir_variable_create(b->shader, nir_var_shader_temp, glsl_uint_type(), "a");
+   nir_variable_create(b->shader, nir_var_shader_temp, glsl_uint_type(), "b");
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize(&blob, b->shader, false);
+
+   /* The second variable refers to the type of the first one (index 1),
+    * followed by its name.  Point it past the end of the type table.
+    */
+   static const uint8_t ref[] = { 1, 'b', 0 };
+   uint8_t *index = NULL;
+   for (size_t i = 0; i + sizeof(ref) <= blob.size; i++) {
+      if (memcmp(blob.data + i, ref, sizeof(ref)) == 0) {
+         index = blob.data + i;
+         break;
+      }
+   }
+   ASSERT_NE(index, nullptr);
+   *index = 0x7f;
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob.data, blob.size);
+   EXPECT_EQ(nir_deserialize(NULL, &options, &reader), nullptr);
+   EXPECT_TRUE(reader.overrun);
+
+   blob_finish(&blob);
+}
@@ -46,6 +46,8 @@
 
 #include "tgsi/tgsi_scan.h"
 
+#include "util/u_queue.h"
+
 #ifdef DRAW_LLVM_AVAILABLE
 struct gallivm_state;
 #endif
@@ -90,6 +92,13 @@ struct gallivm_state;
 #define DRAW_EXTRA_VERTICES_PADDING \
    (DRAW_MAX_EXTRA_SHADER_OUTPUTS * sizeof(float[4]))
 
+/**
+ * Upper bound on the DRAW_VS_THREADS helper threads, and the smallest
+ * number of vertices worth handing to one of them.
+ */
+#define DRAW_MAX_VS_THREADS 16
+#define DRAW_VS_THREAD_MIN_VERTICES 256
+
 struct pipe_context;
 struct draw_vertex_shader;
 struct draw_context;
@@ -323,6 +332,10 @@ struct draw_context
       struct translate_cache *fetch_cache;
       struct translate *emit;
       struct translate_cache *emit_cache;
+
+      /** Threads shading chunks of large draws in parallel (LLVM only) */
+      unsigned num_threads;
+      struct util_queue queue;
    } vs;
 
    /** Geometry shader state */
@@ -39,6 +39,7 @@
 #include "draw/draw_llvm.h"
 #include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_debug.h"
+#include "compiler/nir/nir.h"
 
 
 struct llvm_middle_end {
@@ -565,6 +566,132 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * A chunk of a fetch shaded by one of the draw->vs.queue threads.
+ */
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   struct vertex_header *verts;
+   unsigned count;
+   unsigned start_or_maxelt;
+   unsigned vid_base;
+   const unsigned *elts;
+   boolean clipped;
+   struct util_queue_fence fence;
+};
+
+
+static boolean
+llvm_run_vs(struct llvm_middle_end *fpme,
+            struct vertex_header *verts,
+            unsigned count,
+            unsigned start_or_maxelt,
+            unsigned vid_base,
+            const unsigned *elts)
+{
+   struct draw_context *draw = fpme->draw;
+
+   return fpme->current_variant->jit_func(&fpme->llvm->jit_context,
+                                          verts,
+                                          draw->pt.user.vbuffer,
+                                          count,
+                                          start_or_maxelt,
+                                          fpme->vertex_size,
+                                          draw->pt.vertex_buffer,
+                                          draw->instance_id,
+                                          vid_base,
+                                          draw->start_instance,
+                                          elts, draw->pt.user.drawid,
+                                          draw->pt.user.viewid);
+}
+
+
+static void
+llvm_vs_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct llvm_vs_job *job = data;
+
+   job->clipped = llvm_run_vs(job->fpme, job->verts, job->count,
+                              job->start_or_maxelt, job->vid_base, job->elts);
+}
+
+
+/**
+ * Fetch and shade the vertices, splitting large fetches into chunks
+ * which are shaded in parallel.  Every chunk writes its own range of the
+ * output, so the vertices end up in fetch order as if shaded serially.
+ */
+static boolean
+llvm_fetch_shade(struct llvm_middle_end *fpme,
+                 struct vertex_header *verts,
+                 const struct draw_fetch_info *fetch_info,
+                 unsigned start_or_maxelt,
+                 unsigned vid_base,
+                 const unsigned *elts)
+{
+   struct draw_context *draw = fpme->draw;
+   const struct draw_vertex_shader *vs = draw->vs.vertex_shader;
+   struct llvm_vs_job jobs[DRAW_MAX_VS_THREADS];
+   unsigned num_chunks, chunk_size, i;
+   boolean clipped;
+
+   num_chunks = MIN2(draw->vs.num_threads + 1,
+                     fetch_info->count / DRAW_VS_THREAD_MIN_VERTICES);
+
+   /* In the linear path the chunk start also is the first vertex. */
+   if (fetch_info->linear && vs->state.type == PIPE_SHADER_IR_NIR &&
+       BITSET_TEST(((const nir_shader *)vs->state.ir.nir)->info.system_values_read,
+                   SYSTEM_VALUE_FIRST_VERTEX))
+      num_chunks = 1;
+
+   if (num_chunks <= 1)
+      return llvm_run_vs(fpme, verts, fetch_info->count,
+                         start_or_maxelt, vid_base, elts);
+
+   /* Keep chunks a multiple of the shader's vector length. */
+   chunk_size = align(DIV_ROUND_UP(fetch_info->count, num_chunks),
+                      lp_native_vector_width / 32);
+   num_chunks = DIV_ROUND_UP(fetch_info->count, chunk_size);
+
+   for (i = 0; i < num_chunks - 1; i++) {
+      struct llvm_vs_job *job = &jobs[i];
+      unsigned first = i * chunk_size;
+
+      job->fpme = fpme;
+      job->verts = (struct vertex_header *)
+         ((char *)verts + first * fpme->vertex_size);
+      job->count = chunk_size;
+      job->start_or_maxelt = elts ? start_or_maxelt : start_or_maxelt + first;
+      job->vid_base = vid_base;
+      job->elts = elts ? elts + first : NULL;
+      util_queue_fence_init(&job->fence);
+      util_queue_add_job(&draw->vs.queue, job, &job->fence,
+                         llvm_vs_job_execute, NULL, 0);
+   }
+
+   /* The last, possibly partial, chunk is shaded on this thread. */
+   {
+      unsigned first = i * chunk_size;
+
+      clipped = llvm_run_vs(fpme,
+                            (struct vertex_header *)
+                               ((char *)verts + first * fpme->vertex_size),
+                            fetch_info->count - first,
+                            elts ? start_or_maxelt : start_or_maxelt + first,
+                            vid_base,
+                            elts ? elts + first : NULL);
+   }
+
+   for (i = 0; i < num_chunks - 1; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+      clipped |= jobs[i].clipped;
+   }
+
+   return clipped;
+}
+
+
 static void
 llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                       const struct draw_fetch_info *fetch_info,
@@ -627,18 +754,8 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       vid_base = draw->pt.user.eltBias;
       elts = fetch_info->elts;
    }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts, draw->pt.user.drawid,
-                                             draw->pt.user.viewid);
+   clipped = llvm_fetch_shade(fpme, llvm_vert_info.verts, fetch_info,
+                              start_or_maxelt, vid_base, elts);
 
    /* Finished with fetch and vs:
     */
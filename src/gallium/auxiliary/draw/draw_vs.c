@@ -51,6 +51,7 @@
 #include "nir/nir_to_tgsi.h"
 
 DEBUG_GET_ONCE_BOOL_OPTION(gallium_dump_vs, "GALLIUM_DUMP_VS", FALSE)
+DEBUG_GET_ONCE_NUM_OPTION(draw_vs_threads, "DRAW_VS_THREADS", 0)
 
 
 struct draw_vertex_shader *
@@ -178,6 +179,17 @@ draw_vs_init( struct draw_context *draw )
    if (!draw->vs.fetch_cache) 
       return FALSE;
 
+   /* Only the LLVM path can shade a draw in independent chunks. */
+   if (draw->llvm) {
+      unsigned num_threads = MIN2(debug_get_option_draw_vs_threads(),
+                                  DRAW_MAX_VS_THREADS);
+
+      if (num_threads &&
+          util_queue_init(&draw->vs.queue, "draw_vs", DRAW_MAX_VS_THREADS,
+                          num_threads, 0, NULL))
+         draw->vs.num_threads = num_threads;
+   }
+
    return TRUE;
 }
 
@@ -192,6 +204,9 @@ draw_vs_destroy( struct draw_context *draw )
 
    if (!draw->llvm)
       tgsi_exec_machine_destroy(draw->vs.tgsi.machine);
+
+   if (draw->vs.num_threads)
+      util_queue_destroy(&draw->vs.queue);
 }
 
 
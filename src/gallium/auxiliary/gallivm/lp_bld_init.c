@@ -84,6 +84,11 @@ static boolean gallivm_initialized = FALSE;
 
 unsigned lp_native_vector_width;
 
+#if GALLIVM_HAVE_LAZY_JIT
+static boolean gallivm_lazy_jit = FALSE;
+static unsigned gallivm_lazy_jit_threads = 0;
+#endif
+
 
 /*
  * Optimization values are:
@@ -102,6 +107,55 @@ enum LLVM_CodeGenOpt_Level {
 };
 
 
+/**
+ * Add the IR optimization passes to a function pass manager.
+ */
+static void
+add_optimization_passes(LLVMPassManagerRef passmgr, boolean optimize)
+{
+   if (optimize) {
+      /*
+       * TODO: Evaluate passes some more - keeping in mind
+       * both quality of generated code and compile times.
+       */
+      /*
+       * NOTE: if you change this, don't forget to change the output
+       * with GALLIVM_DEBUG_DUMP_BC in gallivm_compile_module.
+       */
+      LLVMAddScalarReplAggregatesPass(passmgr);
+      LLVMAddEarlyCSEPass(passmgr);
+      LLVMAddCFGSimplificationPass(passmgr);
+      /*
+       * FIXME: LICM is potentially quite useful. However, for some
+       * rather crazy shaders the compile time can reach _hours_ per shader,
+       * due to licm implying lcssa (since llvm 3.5), which can take forever.
+       * Even for sane shaders, the cost of licm is rather high (and not just
+       * due to lcssa, licm itself too), though mostly only in cases when it
+       * can actually move things, so having to disable it is a pity.
+       * LLVMAddLICMPass(passmgr);
+       */
+      LLVMAddReassociatePass(passmgr);
+      LLVMAddPromoteMemoryToRegisterPass(passmgr);
+#if LLVM_VERSION_MAJOR <= 11
+      LLVMAddConstantPropagationPass(passmgr);
+#else
+      LLVMAddInstructionSimplifyPass(passmgr);
+#endif
+      LLVMAddInstructionCombiningPass(passmgr);
+      LLVMAddGVNPass(passmgr);
+   }
+   else {
+      /* We need at least this pass to prevent the backends to fail in
+       * unexpected ways.
+       */
+      LLVMAddPromoteMemoryToRegisterPass(passmgr);
+   }
+#if GALLIVM_HAVE_CORO
+   LLVMAddCoroCleanupPass(passmgr);
+#endif
+}
+
+
 /**
  * Create the LLVM (optimization) pass manager and install
  * relevant optimization passes.
@@ -144,47 +198,8 @@ create_pass_manager(struct gallivm_state *gallivm)
    LLVMAddCoroElidePass(gallivm->cgpassmgr);
 #endif
 
-   if ((gallivm_perf & GALLIVM_PERF_NO_OPT) == 0) {
-      /*
-       * TODO: Evaluate passes some more - keeping in mind
-       * both quality of generated code and compile times.
-       */
-      /*
-       * NOTE: if you change this, don't forget to change the output
-       * with GALLIVM_DEBUG_DUMP_BC in gallivm_compile_module.
-       */
-      LLVMAddScalarReplAggregatesPass(gallivm->passmgr);
-      LLVMAddEarlyCSEPass(gallivm->passmgr);
-      LLVMAddCFGSimplificationPass(gallivm->passmgr);
-      /*
-       * FIXME: LICM is potentially quite useful. However, for some
-       * rather crazy shaders the compile time can reach _hours_ per shader,
-       * due to licm implying lcssa (since llvm 3.5), which can take forever.
-       * Even for sane shaders, the cost of licm is rather high (and not just
-       * due to lcssa, licm itself too), though mostly only in cases when it
-       * can actually move things, so having to disable it is a pity.
-       * LLVMAddLICMPass(gallivm->passmgr);
-       */
-      LLVMAddReassociatePass(gallivm->passmgr);
-      LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
-#if LLVM_VERSION_MAJOR <= 11
-      LLVMAddConstantPropagationPass(gallivm->passmgr);
-#else
-      LLVMAddInstructionSimplifyPass(gallivm->passmgr);
-#endif
-      LLVMAddInstructionCombiningPass(gallivm->passmgr);
-      LLVMAddGVNPass(gallivm->passmgr);
-   }
-   else {
-      /* We need at least this pass to prevent the backends to fail in
-       * unexpected ways.
-       */
-      LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
-   }
-#if GALLIVM_HAVE_CORO
-   LLVMAddCoroCleanupPass(gallivm->passmgr);
-#endif
-
+   add_optimization_passes(gallivm->passmgr,
+                           (gallivm_perf & GALLIVM_PERF_NO_OPT) == 0 && !gallivm->no_opt);
    return TRUE;
 }
 
@@ -248,6 +263,10 @@ gallivm_free_code(struct gallivm_state *gallivm)
 {
    assert(!gallivm->module);
    assert(!gallivm->engine);
+#if GALLIVM_HAVE_LAZY_JIT
+   lp_free_lazy_jit(gallivm->lazy_jit);
+   gallivm->lazy_jit = NULL;
+#endif
    lp_free_generated_code(gallivm->code);
    gallivm->code = NULL;
    lp_free_memory_manager(gallivm->memorymgr);
@@ -263,7 +282,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_perf & GALLIVM_PERF_NO_OPT) {
+      if ((gallivm_perf & GALLIVM_PERF_NO_OPT) || gallivm->no_opt) {
          optlevel = None;
       }
       else {
@@ -312,13 +331,53 @@ fail:
 }
 
 
+#if GALLIVM_HAVE_LAZY_JIT
+/**
+ * Optimize one partition of a module handed to the lazy JIT, right before
+ * it gets compiled.  May run on one of the JIT's compile threads.
+ */
+static void
+lazy_jit_optimize_module(LLVMModuleRef module)
+{
+   LLVMPassManagerRef passmgr;
+   LLVMValueRef func;
+
+   passmgr = LLVMCreateFunctionPassManagerForModule(module);
+   add_optimization_passes(passmgr, (gallivm_perf & GALLIVM_PERF_NO_OPT) == 0);
+
+   LLVMInitializeFunctionPassManager(passmgr);
+   for (func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func))
+      LLVMRunFunctionPassManager(passmgr, func);
+   LLVMFinalizeFunctionPassManager(passmgr);
+   LLVMDisposePassManager(passmgr);
+}
+
+
+static boolean
+init_gallivm_lazy_jit(struct gallivm_state *gallivm)
+{
+   char *error = NULL;
+
+   if (lp_build_create_lazy_jit_for_module(&gallivm->lazy_jit,
+                                           gallivm->module, &error)) {
+      _debug_printf("%s\n", error);
+      free(error);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+#endif
+
+
 /**
  * Allocate gallivm LLVM objects.
  * \return  TRUE for success, FALSE for failure
  */
 static boolean
 init_gallivm_state(struct gallivm_state *gallivm, const char *name,
-                   LLVMContextRef context, struct lp_cached_code *cache)
+                   LLVMContextRef context, struct lp_cached_code *cache,
+                   boolean no_opt)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -328,6 +387,7 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
 
    gallivm->context = context;
    gallivm->cache = cache;
+   gallivm->no_opt = no_opt;
    if (!gallivm->context)
       goto fail;
 
@@ -496,6 +556,21 @@ lp_build_init(void)
    }
 #endif
 
+#if GALLIVM_HAVE_LAZY_JIT
+   /* After all the util_cpu_caps tweaks, which decide the target features. */
+   if (!strcmp(debug_get_option("GALLIVM_JIT", "mcjit"), "orc")) {
+      enum LLVM_CodeGenOpt_Level optlevel =
+         (gallivm_perf & GALLIVM_PERF_NO_OPT) ? None : Default;
+
+      gallivm_lazy_jit_threads = debug_get_num_option("GALLIVM_JIT_THREADS", 0);
+      gallivm_lazy_jit = lp_build_init_lazy_jit((unsigned) optlevel,
+                                                gallivm_lazy_jit_threads,
+                                                lazy_jit_optimize_module);
+      if (!gallivm_lazy_jit)
+         _debug_printf("gallivm: ORC lazy JIT unavailable, using MCJIT\n");
+   }
+#endif
+
    gallivm_initialized = TRUE;
 
    return TRUE;
@@ -514,7 +589,30 @@ gallivm_create(const char *name, LLVMContextRef context,
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm, name, context, cache)) {
+      if (!init_gallivm_state(gallivm, name, context, cache, FALSE)) {
+         FREE(gallivm);
+         gallivm = NULL;
+      }
+   }
+
+   assert(gallivm != NULL);
+   return gallivm;
+}
+
+
+/**
+ * Create a new gallivm_state object whose module is compiled without IR
+ * optimization passes and with -O0 codegen, i.e. as GALLIVM_PERF=nopt
+ * does globally.  Useful for throw-away code which must be ready fast.
+ */
+struct gallivm_state *
+gallivm_create_unoptimized(const char *name, LLVMContextRef context)
+{
+   struct gallivm_state *gallivm;
+
+   gallivm = CALLOC_STRUCT(gallivm_state);
+   if (gallivm) {
+      if (!init_gallivm_state(gallivm, name, context, NULL, TRUE)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -571,6 +669,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 {
    LLVMValueRef func;
    int64_t time_begin = 0;
+   boolean lazy = FALSE;
 
    assert(!gallivm->compiled);
 
@@ -583,6 +682,15 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       goto skip_cached;
    }
 
+#if GALLIVM_HAVE_LAZY_JIT
+   /* The lazy JIT never produces an object for the whole module, so the
+    * disassembly dumps need MCJIT.  Throw-away -O0 modules also stay on
+    * MCJIT, as the lazy JIT optimizes everything it compiles.
+    */
+   lazy = gallivm_lazy_jit && !gallivm->no_opt &&
+          !(gallivm_debug & GALLIVM_DEBUG_ASM);
+#endif
+
    /* Dump bitcode to a file */
    if (gallivm_debug & GALLIVM_DEBUG_DUMP_BC) {
       char filename[256];
@@ -620,7 +728,9 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       LLVMAddTargetDependentFunctionAttr(func, "no-frame-pointer-elim-non-leaf", "true");
 #endif
 
-      LLVMRunFunctionPassManager(gallivm->passmgr, func);
+      /* The lazy JIT optimizes each function when it gets compiled. */
+      if (!lazy)
+         LLVMRunFunctionPassManager(gallivm->passmgr, func);
       func = LLVMGetNextFunction(func);
    }
    LLVMFinalizeFunctionPassManager(gallivm->passmgr);
@@ -653,15 +763,25 @@ gallivm_compile_module(struct gallivm_state *gallivm)
  skip_cached:
    LLVMSetDataLayout(gallivm->module, "");
    assert(!gallivm->engine);
-   if (!init_gallivm_engine(gallivm)) {
-      assert(0);
+#if GALLIVM_HAVE_LAZY_JIT
+   if (lazy) {
+      if (!init_gallivm_lazy_jit(gallivm)) {
+         assert(0);
+      }
+      assert(gallivm->lazy_jit);
+   } else
+#endif
+   {
+      if (!init_gallivm_engine(gallivm)) {
+         assert(0);
+      }
+      assert(gallivm->engine);
    }
-   assert(gallivm->engine);
 
    ++gallivm->compiled;
 
    if (gallivm->debug_printf_hook)
-      LLVMAddGlobalMapping(gallivm->engine, gallivm->debug_printf_hook, debug_printf);
+      gallivm_add_global_mapping(gallivm, gallivm->debug_printf_hook, debug_printf);
 
    if (gallivm_debug & GALLIVM_DEBUG_ASM) {
       LLVMValueRef llvm_func = LLVMGetFirstFunction(gallivm->module);
@@ -681,7 +801,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    }
 
 #if defined(PROFILE)
-   {
+   if (gallivm->engine) {
       LLVMValueRef llvm_func = LLVMGetFirstFunction(gallivm->module);
 
       while (llvm_func) {
@@ -706,12 +826,18 @@ gallivm_jit_function(struct gallivm_state *gallivm,
    int64_t time_begin = 0;
 
    assert(gallivm->compiled);
-   assert(gallivm->engine);
+   assert(gallivm->engine || gallivm->lazy_jit);
 
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
-   code = LLVMGetPointerToGlobal(gallivm->engine, func);
+#if GALLIVM_HAVE_LAZY_JIT
+   /* This returns a stub, the function is compiled on its first call. */
+   if (gallivm->lazy_jit)
+      code = lp_lazy_jit_lookup(gallivm->lazy_jit, LLVMGetValueName(func));
+   else
+#endif
+      code = LLVMGetPointerToGlobal(gallivm->engine, func);
    assert(code);
    jit_func = pointer_to_func(code);
 
@@ -725,6 +851,25 @@ gallivm_jit_function(struct gallivm_state *gallivm,
    return jit_func;
 }
 
+/**
+ * Map an external function declared in the module to an address in the
+ * process.  Must be called after gallivm_compile_module().
+ */
+void
+gallivm_add_global_mapping(struct gallivm_state *gallivm,
+                           LLVMValueRef global, void *addr)
+{
+   assert(gallivm->compiled);
+
+#if GALLIVM_HAVE_LAZY_JIT
+   if (gallivm->lazy_jit) {
+      lp_lazy_jit_add_symbol(gallivm->lazy_jit, LLVMGetValueName(global), addr);
+      return;
+   }
+#endif
+   LLVMAddGlobalMapping(gallivm->engine, global, addr);
+}
+
 unsigned gallivm_get_perf_flags(void)
 {
    return gallivm_perf;
@@ -40,11 +40,13 @@ extern "C" {
 #endif
 
 struct lp_cached_code;
+struct lp_lazy_jit;
 struct gallivm_state
 {
    char *module_name;
    LLVMModuleRef module;
    LLVMExecutionEngineRef engine;
+   struct lp_lazy_jit *lazy_jit;   /**< ORC lazy JIT, used instead of engine */
    LLVMTargetDataRef target;
    LLVMPassManagerRef passmgr;
    LLVMPassManagerRef cgpassmgr;
@@ -54,6 +56,7 @@ struct gallivm_state
    struct lp_generated_code *code;
    struct lp_cached_code *cache;
    unsigned compiled;
+   boolean no_opt;   /**< skip IR optimization, codegen at -O0 */
    LLVMValueRef coro_malloc_hook;
    LLVMValueRef coro_free_hook;
    LLVMValueRef debug_printf_hook;
@@ -68,6 +71,9 @@ struct gallivm_state *
 gallivm_create(const char *name, LLVMContextRef context,
                struct lp_cached_code *cache);
 
+struct gallivm_state *
+gallivm_create_unoptimized(const char *name, LLVMContextRef context);
+
 void
 gallivm_destroy(struct gallivm_state *gallivm);
 
@@ -85,6 +91,10 @@ func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func);
 
+void
+gallivm_add_global_mapping(struct gallivm_state *gallivm,
+                           LLVMValueRef global, void *addr);
+
 unsigned gallivm_get_perf_flags(void);
 
 #ifdef __cplusplus
@@ -75,6 +75,20 @@
 #include <llvm/IR/Module.h>
 #include <llvm/Support/CBindingWrapping.h>
 
+#if LLVM_VERSION_MAJOR >= 13
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <mutex>
+#include <vector>
+#endif
+
 #include <llvm/Config/llvm-config.h>
 #if LLVM_USE_INTEL_JITEVENTS
 #include <llvm/ExecutionEngine/JITEventListener.h>
@@ -89,6 +103,7 @@
 #include "os/os_thread.h"
 #include "pipe/p_config.h"
 #include "util/u_debug.h"
+#include "util/u_atomic.h"
 #include "util/u_cpu_detect.h"
 
 #include "lp_bld_misc.h"
@@ -324,61 +339,17 @@ public:
 };
 
 /**
- * Same as LLVMCreateJITCompilerForModule, but:
- * - allows using MCJIT and enabling AVX feature where available.
- * - set target options
+ * Compute the CPU name and the feature attributes to generate code for.
  *
- * See also:
- * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
- * - llvm/tools/lli/lli.cpp
- * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ * This applies the util_cpu_caps overrides and the per-architecture
+ * workarounds below, so every JIT should use it rather than the plain host
+ * CPU and features.
  */
-extern "C"
-LLVMBool
-lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
-                                        lp_generated_code **OutCode,
-                                        struct lp_cached_code *cache_out,
-                                        LLVMModuleRef M,
-                                        LLVMMCJITMemoryManagerRef CMM,
-                                        unsigned OptLevel,
-                                        char **OutError)
+static std::string
+lp_get_target_cpu_features(llvm::SmallVectorImpl<std::string> &MAttrs)
 {
    using namespace llvm;
 
-   std::string Error;
-   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
-
-   /**
-    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
-    * friends for configuring code generation options, like stack alignment.
-    */
-   TargetOptions options;
-#if defined(PIPE_ARCH_X86) && LLVM_VERSION_MAJOR < 13
-   options.StackAlignmentOverride = 4;
-#endif
-
-   builder.setEngineKind(EngineKind::JIT)
-          .setErrorStr(&Error)
-          .setTargetOptions(options)
-          .setOptLevel((CodeGenOpt::Level)OptLevel);
-
-#ifdef _WIN32
-    /*
-     * MCJIT works on Windows, but currently only through ELF object format.
-     *
-     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
-     * different strings for MinGW/MSVC, so better play it safe and be
-     * explicit.
-     */
-#  ifdef _WIN64
-    LLVMSetTarget(M, "x86_64-pc-win32-elf");
-#  else
-    LLVMSetTarget(M, "i686-pc-win32-elf");
-#  endif
-#endif
-
-   llvm::SmallVector<std::string, 16> MAttrs;
-
 #if LLVM_VERSION_MAJOR >= 4 && (defined(PIPE_ARCH_X86) || defined(PIPE_ARCH_X86_64) || defined(PIPE_ARCH_ARM))
    /* llvm-3.3+ implements sys::getHostCPUFeatures for Arm
     * and llvm-3.7+ for x86, which allows us to enable/disable
@@ -473,8 +444,6 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    MAttrs.push_back("+fp64");
 #endif
 
-   builder.setMAttrs(MAttrs);
-
    if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
       int n = MAttrs.size();
       if (n > 0) {
@@ -499,19 +468,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
     * can't handle. Not entirely sure if we really need to do anything yet.
     */
 
-#ifdef PIPE_ARCH_PPC_64
-   /*
-    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
-    * of the Medium code model once dynamically generated JIT-compiled shader
-    * programs are linked in and relocated.  Yet the default code model as of
-    * LLVM 8 is Medium or even Small.
-    * The cost of changing from Medium to Large is negligible:
-    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
-    * - change an add-immediate (addis) instruction to a load (ld).
-    */
-   builder.setCodeModel(CodeModel::Large);
-
-#if UTIL_ARCH_LITTLE_ENDIAN
+#if defined(PIPE_ARCH_PPC_64) && UTIL_ARCH_LITTLE_ENDIAN
    /*
     * Versions of LLVM prior to 4.0 lacked a table entry for "POWER8NVL",
     * resulting in (big-endian) "generic" being returned on
@@ -524,7 +481,6 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    if (MCPU == "generic")
       MCPU = "pwr8";
 #endif
-#endif
 
 #if defined(PIPE_ARCH_MIPS64)
       /*
@@ -538,11 +494,87 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       MCPU = util_get_cpu_caps()->has_msa ? "mips64r5" : "mips64r2";
 #endif
 
-   builder.setMCPU(MCPU);
    if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
       debug_printf("llc -mcpu option: %s\n", MCPU.str().c_str());
    }
 
+   return MCPU.str();
+}
+
+
+/**
+ * Same as LLVMCreateJITCompilerForModule, but:
+ * - allows using MCJIT and enabling AVX feature where available.
+ * - set target options
+ *
+ * See also:
+ * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
+ * - llvm/tools/lli/lli.cpp
+ * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ */
+extern "C"
+LLVMBool
+lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
+                                        lp_generated_code **OutCode,
+                                        struct lp_cached_code *cache_out,
+                                        LLVMModuleRef M,
+                                        LLVMMCJITMemoryManagerRef CMM,
+                                        unsigned OptLevel,
+                                        char **OutError)
+{
+   using namespace llvm;
+
+   std::string Error;
+   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
+
+   /**
+    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
+    * friends for configuring code generation options, like stack alignment.
+    */
+   TargetOptions options;
+#if defined(PIPE_ARCH_X86) && LLVM_VERSION_MAJOR < 13
+   options.StackAlignmentOverride = 4;
+#endif
+
+   builder.setEngineKind(EngineKind::JIT)
+          .setErrorStr(&Error)
+          .setTargetOptions(options)
+          .setOptLevel((CodeGenOpt::Level)OptLevel);
+
+#ifdef _WIN32
+    /*
+     * MCJIT works on Windows, but currently only through ELF object format.
+     *
+     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
+     * different strings for MinGW/MSVC, so better play it safe and be
+     * explicit.
+     */
+#  ifdef _WIN64
+    LLVMSetTarget(M, "x86_64-pc-win32-elf");
+#  else
+    LLVMSetTarget(M, "i686-pc-win32-elf");
+#  endif
+#endif
+
+   llvm::SmallVector<std::string, 16> MAttrs;
+   std::string MCPU = lp_get_target_cpu_features(MAttrs);
+
+   builder.setMAttrs(MAttrs);
+   builder.setMCPU(MCPU);
+
+#ifdef PIPE_ARCH_PPC_64
+   /*
+    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
+    * of the Medium code model once dynamically generated JIT-compiled shader
+    * programs are linked in and relocated.  Yet the default code model as of
+    * LLVM 8 is Medium or even Small.
+    * The cost of changing from Medium to Large is negligible:
+    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
+    * - change an add-immediate (addis) instruction to a load (ld).
+    */
+   builder.setCodeModel(CodeModel::Large);
+#endif
+
    ShaderMemoryManager *MM = NULL;
    BaseMemoryManager* JMM = reinterpret_cast<BaseMemoryManager*>(CMM);
    MM = new ShaderMemoryManager(JMM);
@@ -577,6 +609,210 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 }
 
 
+#if GALLIVM_HAVE_LAZY_JIT
+
+/*
+ * ORC based lazy JIT.
+ *
+ * A single LLLazyJIT instance is shared by all modules, each module gets
+ * its own JITDylib so symbol names don't clash and its code can be freed
+ * on its own.  Functions are only optimized and compiled when they are
+ * first called, through the lazy call-through stubs which lookups return.
+ */
+struct lp_lazy_jit {
+   llvm::orc::JITDylib *JD;
+};
+
+static llvm::orc::LLLazyJIT *lazy_jit;
+static lp_lazy_jit_optimize_func lazy_jit_optimize;
+static unsigned lazy_jit_dylib_count;
+
+/*
+ * JITDylibs are never removed, only cleared and reused: CompileOnDemandLayer
+ * keeps per-dylib state keyed on the JITDylib address, which a removed and
+ * reallocated dylib would wrongly inherit.
+ */
+static std::mutex lazy_jit_free_mutex;
+static std::vector<llvm::orc::JITDylib *> lazy_jit_free_dylibs;
+
+/**
+ * Create the lazy JIT.  Must be called once, before any module is added.
+ */
+extern "C" bool
+lp_build_init_lazy_jit(unsigned OptLevel,
+                       unsigned NumThreads,
+                       lp_lazy_jit_optimize_func Optimize)
+{
+   using namespace llvm;
+
+   assert(!lazy_jit);
+
+   /* Not detectHost(), which would enable every host feature. */
+   orc::JITTargetMachineBuilder JTMB{Triple(sys::getProcessTriple())};
+   SmallVector<std::string, 16> MAttrs;
+
+   JTMB.setCPU(lp_get_target_cpu_features(MAttrs));
+   JTMB.addFeatures(std::vector<std::string>(MAttrs.begin(), MAttrs.end()));
+   JTMB.setCodeGenOptLevel((CodeGenOpt::Level)OptLevel);
+#ifdef PIPE_ARCH_PPC_64
+   JTMB.setCodeModel(CodeModel::Large);
+#endif
+
+   auto J = orc::LLLazyJITBuilder()
+               .setJITTargetMachineBuilder(std::move(JTMB))
+               .setNumCompileThreads(NumThreads)
+               .create();
+   if (!J) {
+      _debug_printf("gallivm: %s\n", toString(J.takeError()).c_str());
+      return false;
+   }
+
+   /* Only extract the function being called into each partition. */
+   (*J)->setPartitionFunction(orc::CompileOnDemandLayer::compileRequested);
+
+   /* Run the IR optimizations on each partition right before codegen. */
+   (*J)->getIRTransformLayer().setTransform(
+      [](orc::ThreadSafeModule TSM, orc::MaterializationResponsibility &R)
+         -> Expected<orc::ThreadSafeModule> {
+         TSM.withModuleDo([](Module &M) { lazy_jit_optimize(wrap(&M)); });
+         return std::move(TSM);
+      });
+
+   lazy_jit_optimize = Optimize;
+   lazy_jit = J->release();
+   return true;
+}
+
+/**
+ * Free the code of a JITDylib, including the partitions which were emitted
+ * into its implementation dylib, and put it back on the free list.
+ */
+static void
+lp_lazy_jit_release_dylib(llvm::orc::JITDylib *JD)
+{
+   auto &ES = lazy_jit->getExecutionSession();
+
+   if (llvm::Error Err = JD->clear())
+      _debug_printf("gallivm: %s\n", llvm::toString(std::move(Err)).c_str());
+   if (auto *ImplD = ES.getJITDylibByName(JD->getName() + ".impl")) {
+      if (llvm::Error Err = ImplD->clear())
+         _debug_printf("gallivm: %s\n", llvm::toString(std::move(Err)).c_str());
+   }
+
+   std::lock_guard<std::mutex> lock(lazy_jit_free_mutex);
+   lazy_jit_free_dylibs.push_back(JD);
+}
+
+extern "C" int
+lp_build_create_lazy_jit_for_module(struct lp_lazy_jit **OutJIT,
+                                    LLVMModuleRef M,
+                                    char **OutError)
+{
+   using namespace llvm;
+
+   assert(lazy_jit);
+
+   /*
+    * The JIT needs to own the LLVMContext of the modules it compiles, while
+    * gallivm contexts are shared, so hand it a copy of the module in a
+    * context of its own.
+    */
+   SmallVector<char, 0> Bitcode;
+   raw_svector_ostream OS(Bitcode);
+   WriteBitcodeToFile(*unwrap(M), OS);
+
+   auto Ctx = std::make_unique<LLVMContext>();
+   auto Mod = parseBitcodeFile(MemoryBufferRef(StringRef(Bitcode.data(), Bitcode.size()),
+                                               unwrap(M)->getModuleIdentifier()),
+                               *Ctx);
+   if (!Mod) {
+      *OutError = strdup(toString(Mod.takeError()).c_str());
+      return 1;
+   }
+
+   orc::JITDylib *JD = NULL;
+   {
+      std::lock_guard<std::mutex> lock(lazy_jit_free_mutex);
+      if (!lazy_jit_free_dylibs.empty()) {
+         JD = lazy_jit_free_dylibs.back();
+         lazy_jit_free_dylibs.pop_back();
+      }
+   }
+
+   if (!JD) {
+      char name[32];
+      snprintf(name, sizeof(name), "gallivm%u",
+               p_atomic_inc_return(&lazy_jit_dylib_count));
+      auto NewJD = lazy_jit->createJITDylib(name);
+      if (!NewJD) {
+         *OutError = strdup(toString(NewJD.takeError()).c_str());
+         return 1;
+      }
+      JD = &*NewJD;
+
+      /* For libcalls (memcpy, libm, ...) which the backend may emit. */
+      auto Gen = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                    lazy_jit->getDataLayout().getGlobalPrefix());
+      if (Gen)
+         JD->addGenerator(std::move(*Gen));
+      else
+         consumeError(Gen.takeError());
+   }
+
+   if (Error Err = lazy_jit->addLazyIRModule(*JD, orc::ThreadSafeModule(std::move(*Mod),
+                                                                       std::move(Ctx)))) {
+      *OutError = strdup(toString(std::move(Err)).c_str());
+      lp_lazy_jit_release_dylib(JD);
+      return 1;
+   }
+
+   *OutJIT = new lp_lazy_jit;
+   (*OutJIT)->JD = JD;
+   return 0;
+}
+
+extern "C" void
+lp_lazy_jit_add_symbol(struct lp_lazy_jit *jit, const char *name, void *addr)
+{
+   using namespace llvm;
+
+   orc::SymbolMap Symbols;
+   Symbols[lazy_jit->mangleAndIntern(name)] =
+      JITEvaluatedSymbol(pointerToJITTargetAddress(addr),
+                         JITSymbolFlags::Exported | JITSymbolFlags::Callable);
+   if (Error Err = jit->JD->define(orc::absoluteSymbols(std::move(Symbols))))
+      _debug_printf("gallivm: %s\n", toString(std::move(Err)).c_str());
+}
+
+extern "C" void *
+lp_lazy_jit_lookup(struct lp_lazy_jit *jit, const char *name)
+{
+   using namespace llvm;
+
+   auto Sym = lazy_jit->lookup(*jit->JD, name);
+   if (!Sym) {
+      _debug_printf("gallivm: %s\n", toString(Sym.takeError()).c_str());
+      return NULL;
+   }
+#if LLVM_VERSION_MAJOR >= 15
+   return Sym->toPtr<void *>();
+#else
+   return jitTargetAddressToPointer<void *>(Sym->getAddress());
+#endif
+}
+
+extern "C" void
+lp_free_lazy_jit(struct lp_lazy_jit *jit)
+{
+   if (!jit)
+      return;
+   lp_lazy_jit_release_dylib(jit->JD);
+   delete jit;
+}
+
+#endif /* GALLIVM_HAVE_LAZY_JIT */
+
+
 extern "C"
 void
 lp_free_generated_code(struct lp_generated_code *code)
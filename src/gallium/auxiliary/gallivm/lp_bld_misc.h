@@ -77,6 +77,32 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 extern void
 lp_free_generated_code(struct lp_generated_code *code);
 
+#if GALLIVM_HAVE_LAZY_JIT
+struct lp_lazy_jit;
+
+/* Called on each partition of a module before it gets compiled. */
+typedef void (*lp_lazy_jit_optimize_func)(LLVMModuleRef M);
+
+extern bool
+lp_build_init_lazy_jit(unsigned OptLevel,
+                       unsigned NumThreads,
+                       lp_lazy_jit_optimize_func Optimize);
+
+extern int
+lp_build_create_lazy_jit_for_module(struct lp_lazy_jit **OutJIT,
+                                    LLVMModuleRef M,
+                                    char **OutError);
+
+extern void
+lp_lazy_jit_add_symbol(struct lp_lazy_jit *jit, const char *name, void *addr);
+
+extern void *
+lp_lazy_jit_lookup(struct lp_lazy_jit *jit, const char *name);
+
+extern void
+lp_free_lazy_jit(struct lp_lazy_jit *jit);
+#endif
+
 extern LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager();
 
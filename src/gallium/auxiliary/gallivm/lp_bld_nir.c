@@ -2503,14 +2503,21 @@ void lp_build_opt_nir(struct nir_shader *nir)
 
    NIR_PASS_V(nir, nir_lower_flrp, 16|32|64, true);
    NIR_PASS_V(nir, nir_lower_fp16_casts);
+
+   nir_pass_tracker tracker;
+   nir_pass_tracker_init(&tracker, NULL);
    do {
       progress = false;
-      NIR_PASS(progress, nir, nir_opt_constant_folding);
-      NIR_PASS(progress, nir, nir_opt_algebraic);
-      NIR_PASS(progress, nir, nir_lower_pack);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_constant_folding);
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, &tracker, nir, nir_opt_algebraic);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_lower_pack);
 
+      /* These only do something on the first iteration, but they have to
+       * go through the tracker so that what they change is seen by the
+       * passes above.
+       */
       nir_lower_tex_options options = { 0, };
-      NIR_PASS_V(nir, nir_lower_tex, &options);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_lower_tex, &options);
 
       const nir_lower_subgroups_options subgroups_options = {
 	.subgroup_size = lp_native_vector_width / 32,
@@ -2519,9 +2526,10 @@ void lp_build_opt_nir(struct nir_shader *nir)
 	.lower_to_scalar = true,
 	.lower_subgroup_masks = true,
       };
-      NIR_PASS_V(nir, nir_lower_subgroups, &subgroups_options);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_lower_subgroups, &subgroups_options);
 
    } while (progress);
+   nir_pass_tracker_fini(&tracker, nir);
 
    do {
       progress = false;
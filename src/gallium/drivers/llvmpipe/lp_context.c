@@ -38,12 +38,14 @@
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "util/u_upload_mgr.h"
+#include "util/u_threaded_context.h"
 #include "lp_clear.h"
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_perf.h"
 #include "lp_state.h"
 #include "lp_surface.h"
+#include "lp_texture.h"
 #include "lp_query.h"
 #include "lp_setup.h"
 #include "lp_screen.h"
@@ -116,9 +118,27 @@ do_flush( struct pipe_context *pipe,
           struct pipe_fence_handle **fence,
           unsigned flags)
 {
+   /* The threaded context created the fence ahead of this flush. */
+   if ((flags & TC_FLUSH_ASYNC) && fence && *fence) {
+      struct pipe_fence_handle *flushed = NULL;
+
+      llvmpipe_flush(pipe, &flushed, __FUNCTION__);
+      lp_fence_set_flushed((struct lp_fence *)*fence,
+                           (struct lp_fence *)flushed);
+      pipe->screen->fence_reference(pipe->screen, &flushed, NULL);
+      return;
+   }
+
    llvmpipe_flush(pipe, fence, __FUNCTION__);
 }
 
+static struct pipe_fence_handle *
+llvmpipe_create_tc_fence(struct pipe_context *pipe,
+                         struct tc_unflushed_batch_token *token)
+{
+   return (struct pipe_fence_handle *)lp_fence_create_deferred(token);
+}
+
 static void
 llvmpipe_fence_server_sync(struct pipe_context *pipe,
                            struct pipe_fence_handle *fence)
@@ -307,7 +327,17 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
     */
    llvmpipe->dirty |= LP_NEW_SCISSOR;
 
-   return &llvmpipe->pipe;
+   if (!(flags & PIPE_CONTEXT_PREFER_THREADED) ||
+       !llvmpipe_screen(screen)->threaded_context)
+      return &llvmpipe->pipe;
+
+   return threaded_context_create(&llvmpipe->pipe,
+                                  &llvmpipe_screen(screen)->transfer_pool,
+                                  llvmpipe_replace_buffer_storage,
+                                  &(struct threaded_context_options) {
+                                     .create_fence = llvmpipe_create_tc_fence,
+                                  },
+                                  NULL);
 
  fail:
    llvmpipe_destroy(&llvmpipe->pipe);
@@ -28,10 +28,57 @@
  * based on threadpool.c but modified heavily to be compute shader tuned.
  */
 
+#include "util/u_atomic.h"
+#include "util/u_math.h"
 #include "util/u_thread.h"
 #include "util/u_memory.h"
 #include "lp_cs_tpool.h"
 
+/* Number of batches each thread gets, on average, out of a task.
+ * More batches balance uneven work groups better, fewer batches mean
+ * less contention on the iteration counter.
+ */
+#define LP_CS_TPOOL_BATCHES_PER_THREAD 8
+
+/**
+ * Claim and execute batches of iterations until the task has none left.
+ * Doesn't touch the pool lock.
+ */
+static void
+lp_cs_tpool_run_task(struct lp_cs_tpool_task *task,
+                     struct lp_cs_local_mem *lmem)
+{
+   while (1) {
+      unsigned start = p_atomic_add_return(&task->iter_next, task->iter_batch) -
+                       task->iter_batch;
+      if (start >= task->iter_total)
+         break;
+
+      unsigned end = MIN2(start + task->iter_batch, task->iter_total);
+      for (unsigned i = start; i < end; i++)
+         task->work(task->data, i, lmem);
+
+      p_atomic_add(&task->iter_finished, end - start);
+   }
+}
+
+/**
+ * Called with pool->m held once a thread ran out of iterations to claim.
+ */
+static void
+lp_cs_tpool_leave_task(struct lp_cs_tpool_task *task)
+{
+   if (task->queued) {
+      list_del(&task->list);
+      task->queued = false;
+   }
+
+   task->active--;
+   if (task->active == 0 &&
+       p_atomic_read(&task->iter_finished) == task->iter_total)
+      cnd_broadcast(&task->finish);
+}
+
 static int
 lp_cs_tpool_worker(void *data)
 {
@@ -43,7 +90,6 @@ lp_cs_tpool_worker(void *data)
 
    while (!pool->shutdown) {
       struct lp_cs_tpool_task *task;
-      unsigned iter_per_thread;
 
       while (list_is_empty(&pool->workqueue) && !pool->shutdown)
          cnd_wait(&pool->new_work, &pool->m);
@@ -53,30 +99,13 @@ lp_cs_tpool_worker(void *data)
 
       task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
                               list);
-
-      unsigned this_iter = task->iter_start;
-
-      iter_per_thread = task->iter_per_thread;
-
-      if (task->iter_remainder &&
-          task->iter_start + task->iter_remainder == task->iter_total) {
-         task->iter_remainder--;
-         iter_per_thread = 1;
-      }
-
-      task->iter_start += iter_per_thread;
-
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
-
+      task->active++;
       mtx_unlock(&pool->m);
-      for (unsigned i = 0; i < iter_per_thread; i++)
-         task->work(task->data, this_iter + i, &lmem);
+
+      lp_cs_tpool_run_task(task, &lmem);
 
       mtx_lock(&pool->m);
-      task->iter_finished += iter_per_thread;
-      if (task->iter_finished == task->iter_total)
-         cnd_broadcast(&task->finish);
+      lp_cs_tpool_leave_task(task);
    }
    mtx_unlock(&pool->m);
    FREE(lmem.local_mem_ptr);
@@ -147,14 +176,16 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
    task->data = data;
    task->iter_total = num_iters;
 
-   task->iter_per_thread = num_iters / pool->num_threads;
-   task->iter_remainder = num_iters % pool->num_threads;
+   /* The thread waiting for the task runs iterations too. */
+   task->iter_batch = DIV_ROUND_UP(num_iters, (pool->num_threads + 1) *
+                                              LP_CS_TPOOL_BATCHES_PER_THREAD);
 
    cnd_init(&task->finish);
 
    mtx_lock(&pool->m);
 
    list_addtail(&task->list, &pool->workqueue);
+   task->queued = true;
 
    cnd_broadcast(&pool->new_work);
    mtx_unlock(&pool->m);
@@ -170,11 +201,24 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
    if (!pool || !task)
       return;
 
+   struct lp_cs_local_mem lmem;
+   memset(&lmem, 0, sizeof(lmem));
+
+   mtx_lock(&pool->m);
+   task->active++;
+   mtx_unlock(&pool->m);
+
+   lp_cs_tpool_run_task(task, &lmem);
+
    mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
+   lp_cs_tpool_leave_task(task);
+   while (task->active ||
+          p_atomic_read(&task->iter_finished) < task->iter_total)
       cnd_wait(&task->finish, &pool->m);
    mtx_unlock(&pool->m);
 
+   FREE(lmem.local_mem_ptr);
+
    cnd_destroy(&task->finish);
    FREE(task);
    *task_handle = NULL;
@@ -28,6 +28,9 @@
  * The item is added to the work queue once, but it must execute
  * number of iterations times. This saves storing a bunch of queue
  * structs with just unique indexes in them.
+ * Iterations are claimed in batches with an atomic counter, so the
+ * pool lock is only taken when a thread joins or leaves a task, and the
+ * thread waiting for a task helps executing it.
  * It also supports a local memory support struct to be passed from
  * outside the thread exec function.
  */
@@ -64,10 +67,11 @@ struct lp_cs_tpool_task {
    struct list_head list;
    cnd_t finish;
    unsigned iter_total;
-   unsigned iter_start;
-   unsigned iter_finished;
-   unsigned iter_per_thread;
-   unsigned iter_remainder;
+   unsigned iter_batch;
+   unsigned iter_next;        /**< next unclaimed iteration, atomic */
+   unsigned iter_finished;    /**< atomic */
+   unsigned active;           /**< threads executing the task, under pool->m */
+   bool queued;               /**< on pool->workqueue, under pool->m */
 };
 
 struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
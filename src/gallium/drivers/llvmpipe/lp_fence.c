@@ -28,6 +28,7 @@
 
 #include "pipe/p_screen.h"
 #include "util/u_memory.h"
+#include "util/u_threaded_context.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
 
@@ -65,6 +66,41 @@ lp_fence_create(unsigned rank)
 }
 
 
+/**
+ * Create a fence for a flush which the threaded context has queued but
+ * not executed yet.  It gets signalled by lp_fence_set_flushed().
+ */
+struct lp_fence *
+lp_fence_create_deferred(struct tc_unflushed_batch_token *tc_token)
+{
+   struct lp_fence *fence = lp_fence_create(1);
+
+   if (!fence)
+      return NULL;
+
+   fence->issued = TRUE;
+   tc_unflushed_batch_token_reference(&fence->tc_token, tc_token);
+
+   return fence;
+}
+
+
+/**
+ * Called when the flush of a deferred fence is executed, with the fence
+ * returned by that flush.
+ */
+void
+lp_fence_set_flushed(struct lp_fence *fence, struct lp_fence *flushed)
+{
+   mtx_lock(&fence->mutex);
+   assert(!fence->flushed);
+   lp_fence_reference(&fence->flushed, flushed);
+   mtx_unlock(&fence->mutex);
+
+   lp_fence_signal(fence);
+}
+
+
 /** Destroy a fence.  Called when refcount hits zero. */
 void
 lp_fence_destroy(struct lp_fence *fence)
@@ -72,6 +108,9 @@ lp_fence_destroy(struct lp_fence *fence)
    if (LP_DEBUG & DEBUG_FENCE)
       debug_printf("%s %d\n", __FUNCTION__, fence->id);
 
+   lp_fence_reference(&fence->flushed, NULL);
+   tc_unflushed_batch_token_reference(&fence->tc_token, NULL);
+
    mtx_destroy(&fence->mutex);
    cnd_destroy(&fence->signalled);
    FREE(fence);
@@ -107,7 +146,10 @@ lp_fence_signal(struct lp_fence *fence)
 boolean
 lp_fence_signalled(struct lp_fence *f)
 {
-   return f->count == f->rank;
+   if (f->count != f->rank)
+      return FALSE;
+
+   return !f->flushed || lp_fence_signalled(f->flushed);
 }
 
 void
@@ -122,35 +164,50 @@ lp_fence_wait(struct lp_fence *f)
       cnd_wait(&f->signalled, &f->mutex);
    }
    mtx_unlock(&f->mutex);
+
+   if (f->flushed && !lp_fence_signalled(f->flushed))
+      lp_fence_wait(f->flushed);
 }
 
 
-boolean
-lp_fence_timedwait(struct lp_fence *f, uint64_t timeout)
+static boolean
+lp_fence_wait_until(struct lp_fence *f, const struct timespec *ts)
 {
-   struct timespec ts;
    int ret;
 
-   timespec_get(&ts, TIME_UTC);
-
-   ts.tv_nsec += timeout % 1000000000L;
-   ts.tv_sec += timeout / 1000000000L;
-   if (ts.tv_nsec >= 1000000000L) {
-      ts.tv_sec++;
-      ts.tv_nsec -= 1000000000L;
-   }
-
    if (LP_DEBUG & DEBUG_FENCE)
       debug_printf("%s %d\n", __FUNCTION__, f->id);
 
    mtx_lock(&f->mutex);
    assert(f->issued);
    while (f->count < f->rank) {
-      ret = cnd_timedwait(&f->signalled, &f->mutex, &ts);
+      ret = cnd_timedwait(&f->signalled, &f->mutex, ts);
       if (ret != thrd_success)
          break;
    }
    const boolean result = (f->count >= f->rank);
    mtx_unlock(&f->mutex);
+
+   if (result && f->flushed && !lp_fence_signalled(f->flushed))
+      return lp_fence_wait_until(f->flushed, ts);
+
    return result;
 }
+
+
+boolean
+lp_fence_timedwait(struct lp_fence *f, uint64_t timeout)
+{
+   struct timespec ts;
+
+   timespec_get(&ts, TIME_UTC);
+
+   ts.tv_nsec += timeout % 1000000000L;
+   ts.tv_sec += timeout / 1000000000L;
+   if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+   }
+
+   return lp_fence_wait_until(f, &ts);
+}
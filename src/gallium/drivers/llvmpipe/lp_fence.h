@@ -36,6 +36,7 @@
 
 
 struct pipe_screen;
+struct tc_unflushed_batch_token;
 
 
 struct lp_fence
@@ -49,12 +50,25 @@ struct lp_fence
    boolean issued;
    unsigned rank;
    unsigned count;
+
+   /* Fences created by the threaded context ahead of their flush are
+    * signalled once the flush is executed, and then complete with the
+    * fence of that flush.
+    */
+   struct lp_fence *flushed;
+   struct tc_unflushed_batch_token *tc_token;
 };
 
 
 struct lp_fence *
 lp_fence_create(unsigned rank);
 
+struct lp_fence *
+lp_fence_create_deferred(struct tc_unflushed_batch_token *tc_token);
+
+void
+lp_fence_set_flushed(struct lp_fence *fence, struct lp_fence *flushed);
+
 
 void
 lp_fence_signal(struct lp_fence *fence);
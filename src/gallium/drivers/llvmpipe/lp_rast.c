@@ -74,7 +74,7 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, rast->tile_sched, rast->num_threads );
 }
 
 
@@ -1089,7 +1089,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                              &i, &j))) {
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
          }
@@ -1318,6 +1319,11 @@ lp_rast_create( unsigned num_threads )
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
+   if (strcmp(debug_get_option("LP_TILE_SCHED", "steal"), "scanline") == 0)
+      rast->tile_sched = LP_TILE_SCHED_SCANLINE;
+   else
+      rast->tile_sched = LP_TILE_SCHED_STEAL;
+
    create_rast_threads(rast);
 
    /* for synchronizing rasterization threads */
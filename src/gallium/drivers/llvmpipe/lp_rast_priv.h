@@ -115,6 +115,9 @@ struct lp_rasterizer
    boolean exit_flag;
    boolean no_rast;  /**< For debugging/profiling */
 
+   /** How threads pick bins, see LP_TILE_SCHED */
+   enum lp_tile_sched tile_sched;
+
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
 
@@ -29,6 +29,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
+#include "util/u_atomic.h"
 #include "util/simple_list.h"
 #include "util/format/u_format.h"
 #include "lp_scene.h"
@@ -102,6 +103,7 @@ lp_scene_destroy(struct lp_scene *scene)
 {
    lp_scene_end_rasterization(scene);
    mtx_destroy(&scene->mutex);
+   FREE(scene->bin_order);
    assert(scene->data.head == &scene->data.first);
    slab_free_st(&scene->setup->scene_slab, scene);
 }
@@ -564,24 +566,149 @@ next_bin(struct lp_scene *scene)
 }
 
 
+/**
+ * Build the Morton (Z-order) walk of the scene's bins.  Consecutive
+ * entries are spatially close, so slicing this array into per-thread
+ * runs gives each thread a compact block of tiles.  The array only
+ * depends on the tile counts and is kept across scenes.
+ */
+static boolean
+build_bin_order(struct lp_scene *scene)
+{
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+   const unsigned dim = util_next_power_of_two(MAX2(scene->tiles_x,
+                                                    scene->tiles_y));
+   unsigned m, n = 0;
+
+   if (scene->bin_order &&
+       scene->bin_order_tiles_x == scene->tiles_x &&
+       scene->bin_order_tiles_y == scene->tiles_y)
+      return TRUE;
+
+   FREE(scene->bin_order);
+   scene->bin_order = MALLOC(num_bins * sizeof(*scene->bin_order));
+   if (!scene->bin_order)
+      return FALSE;
+
+   for (m = 0; m < dim * dim && n < num_bins; m++) {
+      unsigned x = 0, y = 0, b;
+
+      /* de-interleave the even (x) and odd (y) bits of m */
+      for (b = 0; (1u << (2 * b)) < dim * dim; b++) {
+         x |= ((m >> (2 * b)) & 1) << b;
+         y |= ((m >> (2 * b + 1)) & 1) << b;
+      }
+
+      if (x < scene->tiles_x && y < scene->tiles_y)
+         scene->bin_order[n++] = x | (y << 16);
+   }
+   assert(n == num_bins);
+
+   scene->bin_order_tiles_x = scene->tiles_x;
+   scene->bin_order_tiles_y = scene->tiles_y;
+   return TRUE;
+}
+
+
+/**
+ * Prepare the scene for lp_scene_bin_iter_next().
+ * Called once per scene by one thread, before any thread starts
+ * pulling bins.
+ * \param sched  the bin scheduling policy to use for this scene
+ * \param num_threads  number of threads that will pull bins
+ */
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+lp_scene_bin_iter_begin( struct lp_scene *scene,
+                         enum lp_tile_sched sched,
+                         unsigned num_threads )
 {
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+   unsigned i;
+
    scene->curr_x = scene->curr_y = -1;
+
+   scene->tile_sched = sched;
+   if (sched == LP_TILE_SCHED_STEAL && !build_bin_order(scene))
+      scene->tile_sched = LP_TILE_SCHED_SCANLINE;
+
+   if (scene->tile_sched != LP_TILE_SCHED_STEAL)
+      return;
+
+   /* Give each thread an equal, contiguous run of the Morton order. */
+   scene->num_bin_queues = CLAMP(num_threads, 1, LP_MAX_THREADS);
+   for (i = 0; i < scene->num_bin_queues; i++) {
+      uint64_t head = (uint64_t)num_bins * i / scene->num_bin_queues;
+      uint64_t tail = (uint64_t)num_bins * (i + 1) / scene->num_bin_queues;
+      scene->bin_queues[i].range = head | (tail << 32);
+   }
+}
+
+
+/**
+ * Claim one bin index from a queue, from the head if we own the queue or
+ * from the tail when stealing.  Lock-free: a failed compare-and-swap just
+ * means another thread claimed a bin from the same queue first.
+ */
+static boolean
+bin_queue_pop(struct lp_bin_queue *queue, boolean steal, unsigned *index)
+{
+   uint64_t old = p_atomic_read(&queue->range);
+
+   while (1) {
+      uint32_t head = (uint32_t)old;
+      uint32_t tail = (uint32_t)(old >> 32);
+      uint64_t new_range, cur;
+
+      if (head >= tail)
+         return FALSE;
+
+      if (steal) {
+         *index = tail - 1;
+         new_range = head | ((uint64_t)(tail - 1) << 32);
+      } else {
+         *index = head;
+         new_range = old + 1;
+      }
+
+      cur = p_atomic_cmpxchg(&queue->range, old, new_range);
+      if (cur == old)
+         return TRUE;
+      old = cur;
+   }
 }
 
 
 /**
  * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
  * Multiple rendering threads will call this function to get a chunk
  * of work (a bin) to work on.
+ *
+ * With LP_TILE_SCHED_SCANLINE the lp_scene::curr_x and ::curr_y fields
+ * will be advanced under the scene mutex.  With LP_TILE_SCHED_STEAL the
+ * thread first drains its own queue and then steals from the others.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y )
 {
    struct cmd_bin *bin = NULL;
 
+   if (scene->tile_sched == LP_TILE_SCHED_STEAL) {
+      const unsigned num_queues = scene->num_bin_queues;
+      unsigned index, i;
+
+      for (i = 0; i < num_queues; i++) {
+         unsigned q = (thread_index + i) % num_queues;
+         if (bin_queue_pop(&scene->bin_queues[q], i != 0, &index)) {
+            uint32_t coord = scene->bin_order[index];
+            *x = coord & 0xffff;
+            *y = coord >> 16;
+            return lp_scene_get_bin(scene, *x, *y);
+         }
+      }
+      return NULL;
+   }
+
    mtx_lock(&scene->mutex);
 
    if (scene->curr_x < 0) {
@@ -38,6 +38,7 @@
 #include "os/os_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
+#include "lp_limits.h"
 
 struct lp_scene_queue;
 struct lp_rast_state;
@@ -120,6 +121,29 @@ struct resource_ref;
 
 struct shader_ref;
 
+/**
+ * How the rasterizer threads pick the next bin to execute.
+ * Selected at runtime with LP_TILE_SCHED.
+ */
+enum lp_tile_sched {
+   /** single shared cursor walking the bins in scanline order */
+   LP_TILE_SCHED_SCANLINE,
+   /** per-thread runs of Morton-ordered bins, idle threads steal */
+   LP_TILE_SCHED_STEAL,
+};
+
+/**
+ * A contiguous run of lp_scene::bin_order owned by one rasterizer thread.
+ * The owner pops from the head, other threads steal from the tail.  Both
+ * indices are packed into a single 64-bit word (tail in the upper half)
+ * so that either end can be claimed with one compare-and-swap.
+ * Padded to a cache line to keep the owners from false sharing.
+ */
+struct lp_bin_queue {
+   uint64_t range;
+   uint8_t pad[64 - sizeof(uint64_t)];
+};
+
 struct lp_scene_surface {
    uint8_t *map;
    unsigned stride;
@@ -197,6 +221,15 @@ struct lp_scene {
    int curr_x, curr_y;  /**< for iterating over bins */
    mtx_t mutex;
 
+   /** Bin scheduling state, see lp_scene_bin_iter_begin() */
+   enum lp_tile_sched tile_sched;
+   unsigned num_bin_queues;
+   struct lp_bin_queue bin_queues[LP_MAX_THREADS];
+
+   /** Packed (x | y << 16) bin coordinates in Morton order */
+   uint32_t *bin_order;
+   unsigned bin_order_tiles_x, bin_order_tiles_y;
+
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
 };
@@ -394,10 +427,13 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene,
+                         enum lp_tile_sched sched,
+                         unsigned num_threads );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y );
 
 
 
@@ -31,6 +31,7 @@
 #include "util/u_cpu_detect.h"
 #include "util/format/u_format.h"
 #include "util/u_screen.h"
+#include "util/u_threaded_context.h"
 #include "util/u_string.h"
 #include "util/format/u_format_s3tc.h"
 #include "pipe/p_defines.h"
@@ -95,6 +96,7 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "no_coarse_bin",  PERF_NO_COARSE_BIN, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -845,6 +847,9 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
 
+   if (util_queue_is_initialized(&screen->compile_queue))
+      util_queue_destroy(&screen->compile_queue);
+
    if (screen->cs_tpool)
       lp_cs_tpool_destroy(screen->cs_tpool);
 
@@ -862,6 +867,8 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
 
    glsl_type_singleton_decref();
 
+   slab_destroy_parent(&screen->transfer_pool);
+
    mtx_destroy(&screen->rast_mutex);
    mtx_destroy(&screen->cs_mutex);
    FREE(screen);
@@ -896,6 +903,12 @@ llvmpipe_fence_finish(struct pipe_screen *screen,
 {
    struct lp_fence *f = (struct lp_fence *) fence_handle;
 
+   /* Make sure the threaded context executes the flush of a deferred
+    * fence if it was created by this context.
+    */
+   if (f->tc_token && ctx && !lp_fence_signalled(f))
+      threaded_context_flush(ctx, f->tc_token, timeout == 0);
+
    if (!timeout)
       return lp_fence_signalled(f);
 
@@ -938,6 +951,8 @@ static void lp_disk_cache_create(struct llvmpipe_screen *screen)
       return;
 
    _mesa_sha1_update(&ctx, &gallivm_perf, sizeof(gallivm_perf));
+   _mesa_sha1_update(&ctx, &lp_native_vector_width,
+                     sizeof(lp_native_vector_width));
    update_cache_sha1_cpu(&ctx);
    _mesa_sha1_final(&ctx, sha1);
    disk_cache_format_hex_id(cache_id, sha1, 20 * 2);
@@ -986,6 +1001,52 @@ void lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
    disk_cache_put(screen->disk_shader_cache, sha1, cache->data, cache->data_size, NULL);
 }
 
+static void
+llvmpipe_set_max_shader_compiler_threads(struct pipe_screen *_screen,
+                                         unsigned max_threads)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   unsigned num_cpus = MAX2(util_get_cpu_caps()->nr_cpus, 1);
+
+   mtx_lock(&screen->late_mutex);
+
+   /* 0xffffffff lets the implementation pick, which is one per CPU. */
+   max_threads = MIN2(max_threads, num_cpus);
+
+   if (max_threads && !util_queue_is_initialized(&screen->compile_queue) &&
+       !util_queue_init(&screen->compile_queue, "lpcomp", 64, num_cpus,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, NULL))
+      max_threads = 0;
+
+   if (max_threads)
+      util_queue_adjust_num_threads(&screen->compile_queue,
+                                    MAX2(max_threads,
+                                         screen->num_compile_threads));
+
+   screen->num_parallel_compile_threads = max_threads;
+   mtx_unlock(&screen->late_mutex);
+}
+
+
+static bool
+llvmpipe_is_parallel_shader_compilation_finished(struct pipe_screen *_screen,
+                                                 void *shader,
+                                                 enum pipe_shader_type shader_type)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   /* Only fragment shaders get compiled ahead of their first draw.  The
+    * shader handle is the draw module's wrapper for the aaline, aapoint
+    * and pstipple stages, so we can only tell whether any precompilation
+    * is still running.
+    */
+   if (shader_type == PIPE_SHADER_FRAGMENT)
+      return p_atomic_read(&screen->num_fs_precompiles) == 0;
+   return true;
+}
+
+
 bool
 llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
 {
@@ -1001,13 +1062,27 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
       goto out;
    }
 
-   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads);
+   /* The dispatching thread runs work groups too, so one less worker
+    * keeps compute at num_threads cores, like rasterization.
+    */
+   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads ?
+                                         screen->num_threads - 1 : 0);
    if (!screen->cs_tpool) {
       lp_rast_destroy(screen->rast);
       ret = false;
       goto out;
    }
 
+   if (screen->num_compile_threads &&
+       !util_queue_is_initialized(&screen->compile_queue) &&
+       !util_queue_init(&screen->compile_queue, "lpcomp", 64,
+                        screen->num_compile_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, NULL)) {
+      /* fall back to compiling on the calling thread */
+      screen->num_compile_threads = 0;
+   }
+
    lp_disk_cache_create(screen);
    screen->late_init_done = true;
 out:
@@ -1068,6 +1143,10 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.finalize_nir = llvmpipe_finalize_nir;
 
    screen->base.get_disk_shader_cache = lp_get_disk_shader_cache;
+   screen->base.set_max_shader_compiler_threads =
+      llvmpipe_set_max_shader_compiler_threads;
+   screen->base.is_parallel_shader_compilation_finished =
+      llvmpipe_is_parallel_shader_compilation_finished;
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
    screen->allow_cl = !!getenv("LP_CL");
@@ -1078,6 +1157,11 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 #endif
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
+   screen->num_compile_threads = debug_get_num_option("LP_ASYNC_COMPILE", 0);
+   screen->threaded_context = debug_get_bool_option("LP_THREADED_CONTEXT", false);
+
+   slab_create_parent(&screen->transfer_pool,
+                      sizeof(struct llvmpipe_transfer), 16);
 
    lp_build_init(); /* get lp_native_vector_width initialised */
 
@@ -37,6 +37,8 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/u_queue.h"
+#include "util/slab.h"
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_misc.h"
 
@@ -61,12 +63,24 @@ struct llvmpipe_screen
    struct lp_cs_tpool *cs_tpool;
    mtx_t cs_mutex;
 
+   /** Background shader compilation, see LP_ASYNC_COMPILE */
+   unsigned num_compile_threads;
+   struct util_queue compile_queue;
+
+   /** Threads allowed by glMaxShaderCompilerThreadsKHR, 0 if unused */
+   unsigned num_parallel_compile_threads;
+   unsigned num_fs_precompiles;
+
    bool use_tgsi;
    bool allow_cl;
 
    mtx_t late_mutex;
    bool late_init_done;
 
+   /** Wrap contexts in u_threaded_context, see LP_THREADED_CONTEXT */
+   bool threaded_context;
+   struct slab_parent_pool transfer_pool;
+
    char renderer_string[100];
 
    struct disk_cache *disk_shader_cache;
@@ -65,19 +65,41 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
                              const char *reason);
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
+/**
+ * Wait for the oldest scene in flight to be rasterized and return its
+ * index.  The rasterizer processes scenes in the order they were queued,
+ * so this is the scene which becomes available first; waiting on any
+ * other could drain the whole pipeline.
+ */
 static unsigned
 lp_setup_wait_empty_scene(struct lp_setup_context *setup)
 {
-   /* just use the first scene if we run out */
-   if (setup->scenes[0]->fence) {
+   unsigned oldest = 0;
+
+   for (unsigned i = 1;
+        i < setup->num_active_scenes && setup->scenes[oldest]->fence; i++) {
+      struct lp_fence *fence = setup->scenes[i]->fence;
+      if (fence && fence->id < setup->scenes[oldest]->fence->id)
+         oldest = i;
+   }
+
+   if (setup->scenes[oldest]->fence) {
       debug_printf("%s: wait for scene %d\n",
-                   __FUNCTION__, setup->scenes[0]->fence->id);
-      lp_fence_wait(setup->scenes[0]->fence);
-      lp_scene_end_rasterization(setup->scenes[0]);
+                   __FUNCTION__, setup->scenes[oldest]->fence->id);
+      lp_fence_wait(setup->scenes[oldest]->fence);
+      lp_scene_end_rasterization(setup->scenes[oldest]);
    }
-   return 0;
+   return oldest;
 }
 
+/**
+ * Pick the scene to bin the next draws into, reusing an idle one if there
+ * is any.
+ *
+ * Binning still runs on the thread calling into the draw module, so it
+ * only overlaps with the rasterization of earlier scenes; there is no
+ * separate binning thread.
+ */
 static void
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
@@ -95,11 +117,15 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
          break;
    }
 
-   if (setup->num_active_scenes + 1 > MAX_SCENES)
-      i = lp_setup_wait_empty_scene(setup);
-   else if (i == setup->num_active_scenes) {
-      /* allocate a new scene */
-      struct lp_scene *scene = lp_scene_create(setup);
+   /* Only block on the rasterizer when all scenes are busy and no more
+    * can be allocated.
+    */
+   if (i == setup->num_active_scenes) {
+      struct lp_scene *scene = NULL;
+
+      if (setup->num_active_scenes < MAX_SCENES)
+         scene = lp_scene_create(setup);
+
       if (!scene) {
          /* block and reuse scenes */
          i = lp_setup_wait_empty_scene(setup);
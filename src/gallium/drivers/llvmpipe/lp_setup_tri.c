@@ -33,6 +33,7 @@
 #include "util/u_memory.h"
 #include "util/u_rect.h"
 #include "util/u_sse.h"
+#include "lp_debug.h"
 #include "lp_perf.h"
 #include "lp_setup_context.h"
 #include "lp_rast.h"
@@ -178,6 +179,9 @@ lp_setup_print_triangle(struct lp_setup_context *setup,
 
 
 #define MAX_PLANES 8
+
+/* Large triangles are first binned in blocks of 4x4 tiles. */
+#define COARSE_TILES 4
 static unsigned
 lp_rast_tri_tab[MAX_PLANES+1] = {
    0,               /* should be impossible */
@@ -771,6 +775,174 @@ floor_pot(uint32_t n)
 }
 
 
+/**
+ * Bin a triangle into the tile at (x, y), given the plane values at the
+ * tile's top-left corner and the per-tile eo/ei offsets.
+ * \param touched  returns whether the triangle overlaps the tile
+ * \return FALSE if the scene ran out of memory
+ */
+static boolean
+lp_setup_bin_tile(struct lp_setup_context *setup,
+                  struct lp_rast_triangle *tri,
+                  boolean use_32bits,
+                  boolean opaque,
+                  int nr_planes,
+                  const int64_t *cx,
+                  const int64_t *eo,
+                  const int64_t *ei,
+                  int x, int y,
+                  boolean *touched)
+{
+   int out = 0;
+   int partial = 0;
+   unsigned cmd;
+   int i;
+
+   for (i = 0; i < nr_planes; i++) {
+      int64_t planeout = cx[i] + eo[i];
+      int64_t planepartial = cx[i] + ei[i] - 1;
+      out |= (int) (planeout >> 63);
+      partial |= ((int) (planepartial >> 63)) & (1<<i);
+   }
+
+   *touched = !out;
+
+   if (out) {
+      /* do nothing */
+      LP_COUNT(nr_empty_64);
+      return TRUE;
+   }
+
+   if (partial) {
+      /* Not trivially accepted by at least one plane -
+       * rasterize/shade partial tile
+       */
+      int count = util_bitcount(partial);
+
+      if (setup->multisample)
+         cmd = lp_rast_ms_tri_tab[count];
+      else
+         cmd = use_32bits ? lp_rast_32_tri_tab[count] : lp_rast_tri_tab[count];
+
+      LP_COUNT(nr_partially_covered_64);
+      return lp_scene_bin_cmd_with_state( setup->scene, x, y,
+                                          setup->fs.stored, cmd,
+                                          lp_rast_arg_triangle(tri, partial) );
+   }
+
+   /* triangle covers the whole tile- shade whole tile */
+   LP_COUNT(nr_fully_covered_64);
+   return lp_setup_whole_tile(setup, &tri->inputs, x, y, opaque);
+}
+
+
+/**
+ * Bin a triangle spanning many tiles.  The bounding box is first walked
+ * in blocks of COARSE_TILES x COARSE_TILES tiles: blocks entirely outside
+ * the triangle are skipped and blocks entirely inside get whole-tile
+ * commands, both without testing the individual tiles.  Only blocks
+ * crossing an edge are binned tile by tile.
+ *
+ * c holds the plane values at the top-left corner of tile (ix0, iy0);
+ * eo, ei, xstep and ystep are the per-tile values.
+ */
+static boolean
+lp_setup_bin_coarse(struct lp_setup_context *setup,
+                    struct lp_rast_triangle *tri,
+                    boolean use_32bits,
+                    boolean opaque,
+                    int nr_planes,
+                    int ix0, int iy0, int ix1, int iy1,
+                    const int64_t *c,
+                    const int64_t *eo,
+                    const int64_t *ei,
+                    const int64_t *xstep,
+                    const int64_t *ystep)
+{
+   int64_t cy[MAX_PLANES];
+   int64_t coarse_eo[MAX_PLANES];
+   int64_t coarse_ei[MAX_PLANES];
+   int bx, by, i;
+
+   for (i = 0; i < nr_planes; i++) {
+      cy[i] = c[i];
+      coarse_eo[i] = eo[i] * COARSE_TILES;
+      coarse_ei[i] = ei[i] * COARSE_TILES;
+   }
+
+   for (by = iy0; by <= iy1; by += COARSE_TILES) {
+      const int ny = MIN2(COARSE_TILES, iy1 - by + 1);
+      int64_t cx[MAX_PLANES];
+
+      for (i = 0; i < nr_planes; i++)
+         cx[i] = cy[i];
+
+      for (bx = ix0; bx <= ix1; bx += COARSE_TILES) {
+         const int nx = MIN2(COARSE_TILES, ix1 - bx + 1);
+         int out = 0;
+         int partial = 0;
+         int x, y;
+
+         for (i = 0; i < nr_planes; i++) {
+            int64_t planeout = cx[i] + coarse_eo[i];
+            int64_t planepartial = cx[i] + coarse_ei[i] - 1;
+            out |= (int) (planeout >> 63);
+            partial |= (int) (planepartial >> 63);
+         }
+
+         if (out) {
+            LP_COUNT_ADD(nr_empty_64, nx * ny);
+         }
+         else if (!partial) {
+            for (y = by; y < by + ny; y++) {
+               for (x = bx; x < bx + nx; x++) {
+                  LP_COUNT(nr_fully_covered_64);
+                  if (!lp_setup_whole_tile(setup, &tri->inputs, x, y, opaque))
+                     return FALSE;
+               }
+            }
+         }
+         else {
+            int64_t ty[MAX_PLANES];
+
+            for (i = 0; i < nr_planes; i++)
+               ty[i] = cx[i];
+
+            for (y = by; y < by + ny; y++) {
+               int64_t tx[MAX_PLANES];
+
+               for (i = 0; i < nr_planes; i++)
+                  tx[i] = ty[i];
+
+               for (x = bx; x < bx + nx; x++) {
+                  boolean touched;
+
+                  if (!lp_setup_bin_tile(setup, tri, use_32bits, opaque,
+                                         nr_planes, tx, eo, ei, x, y,
+                                         &touched))
+                     return FALSE;
+
+                  for (i = 0; i < nr_planes; i++)
+                     tx[i] += xstep[i];
+               }
+
+               for (i = 0; i < nr_planes; i++)
+                  ty[i] += ystep[i];
+            }
+         }
+
+         for (i = 0; i < nr_planes; i++)
+            cx[i] += xstep[i] * COARSE_TILES;
+      }
+
+      for (i = 0; i < nr_planes; i++)
+         cy[i] += ystep[i] * COARSE_TILES;
+   }
+
+   return TRUE;
+}
+
+
 boolean
 lp_setup_bin_triangle(struct lp_setup_context *setup,
                       struct lp_rast_triangle *tri,
@@ -924,7 +1096,15 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       }
 
       tri->inputs.is_blit = lp_setup_is_blit(setup, &tri->inputs);
-     
+
+      if (!(LP_PERF & PERF_NO_COARSE_BIN) &&
+          (ix1 - ix0 >= COARSE_TILES || iy1 - iy0 >= COARSE_TILES)) {
+         if (!lp_setup_bin_coarse(setup, tri, use_32bits, opaque, nr_planes,
+                                  ix0, iy0, ix1, iy1, c, eo, ei, xstep, ystep))
+            goto fail;
+         return TRUE;
+      }
+
       /* Test tile-sized blocks against the triangle.
        * Discard blocks fully outside the tri.  If the block is fully
        * contained inside the tri, bin an lp_rast_shade_tile command.
@@ -940,47 +1120,16 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
 
          for (x = ix0; x <= ix1; x++)
          {
-            int out = 0;
-            int partial = 0;
-
-            for (i = 0; i < nr_planes; i++) {
-               int64_t planeout = cx[i] + eo[i];
-               int64_t planepartial = cx[i] + ei[i] - 1;
-               out |= (int) (planeout >> 63);
-               partial |= ((int) (planepartial >> 63)) & (1<<i);
-            }
-
-            if (out) {
-               /* do nothing */
-               if (in)
-                  break;  /* exiting triangle, all done with this row */
-               LP_COUNT(nr_empty_64);
-            }
-            else if (partial) {
-               /* Not trivially accepted by at least one plane -
-                * rasterize/shade partial tile
-                */
-               int count = util_bitcount(partial);
-               in = TRUE;
+            boolean touched;
 
-               if (setup->multisample)
-                  cmd = lp_rast_ms_tri_tab[count];
-               else
-                  cmd = use_32bits ? lp_rast_32_tri_tab[count] : lp_rast_tri_tab[count];
-               if (!lp_scene_bin_cmd_with_state( scene, x, y,
-                                                 setup->fs.stored, cmd,
-                                                 lp_rast_arg_triangle(tri, partial) ))
-                  goto fail;
+            if (!lp_setup_bin_tile(setup, tri, use_32bits, opaque, nr_planes,
+                                   cx, eo, ei, x, y, &touched))
+               goto fail;
 
-               LP_COUNT(nr_partially_covered_64);
-            }
-            else {
-               /* triangle covers the whole tile- shade whole tile */
-               LP_COUNT(nr_fully_covered_64);
+            if (touched)
                in = TRUE;
-               if (!lp_setup_whole_tile(setup, &tri->inputs, x, y, opaque))
-                  goto fail;
-            }
+            else if (in)
+               break;  /* exiting triangle, all done with this row */
 
             /* Iterate cx values across the region: */
             for (i = 0; i < nr_planes; i++)
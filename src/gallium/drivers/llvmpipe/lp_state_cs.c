@@ -747,9 +747,15 @@ lp_cs_get_ir_cache_key(struct lp_compute_shader_variant *variant,
    void *ir_binary;
 
    blob_init(&blob);
-   nir_serialize(&blob, variant->shader->base.ir.nir, true);
-   ir_binary = blob.data;
-   ir_size = blob.size;
+   if (variant->shader->base.ir.nir) {
+      nir_serialize(&blob, variant->shader->base.ir.nir, true);
+      ir_binary = blob.data;
+      ir_size = blob.size;
+   } else {
+      ir_binary = (void *)variant->shader->base.tokens;
+      ir_size = tgsi_num_tokens(variant->shader->base.tokens) *
+                sizeof(struct tgsi_token);
+   }
 
    struct mesa_sha1 ctx;
    _mesa_sha1_init(&ctx);
@@ -782,7 +788,7 @@ generate_variant(struct llvmpipe_context *lp,
    variant->shader = shader;
    memcpy(&variant->key, key, shader->variant_key_size);
 
-   if (shader->base.ir.nir) {
+   if (shader->base.ir.nir || shader->base.tokens) {
       lp_cs_get_ir_cache_key(variant, ir_sha1_cache_key);
 
       lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
@@ -3550,9 +3550,15 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
    void *ir_binary;
 
    blob_init(&blob);
-   nir_serialize(&blob, variant->shader->base.ir.nir, true);
-   ir_binary = blob.data;
-   ir_size = blob.size;
+   if (variant->shader->base.ir.nir) {
+      nir_serialize(&blob, variant->shader->base.ir.nir, true);
+      ir_binary = blob.data;
+      ir_size = blob.size;
+   } else {
+      ir_binary = (void *)variant->shader->base.tokens;
+      ir_size = tgsi_num_tokens(variant->shader->base.tokens) *
+                sizeof(struct tgsi_token);
+   }
 
    struct mesa_sha1 ctx;
    _mesa_sha1_init(&ctx);
@@ -3563,16 +3569,175 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
    blob_finish(&blob);
 }
 
+/**
+ * Background compilation of the optimized code for a variant which is
+ * already usable with unoptimized code.  The job owns a private copy of
+ * the shader, so that NIR passes run by the gallivm NIR translation don't
+ * race with the context thread, and a private LLVMContext, as those can't
+ * be shared between threads.
+ */
+struct lp_fs_async_job {
+   struct llvmpipe_screen *screen;
+   struct lp_fragment_shader_variant *variant;
+   struct lp_fragment_shader shader;
+   unsigned char ir_sha1_cache_key[20];
+   bool needs_caching;
+};
+
+
+static void
+generate_variant_async(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_async_job *job = data;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fragment_shader_variant *opt;
+   const size_t size = sizeof *variant + job->shader.variant_key_size -
+                       sizeof variant->key;
+   struct lp_cached_code cached = { 0 };
+   lp_jit_frag_func jit_function[2] = { NULL, NULL };
+   LLVMContextRef context;
+   char module_name[64];
+
+   context = LLVMContextCreate();
+   if (!context)
+      return;
+
+   /* Build into a scratch copy so the live variant is never touched
+    * until the new code is ready.
+    */
+   opt = MALLOC(size);
+   if (!opt) {
+      LLVMContextDispose(context);
+      return;
+   }
+   memcpy(opt, variant, size);
+   opt->shader = &job->shader;
+   opt->jit_context_ptr_type = NULL;
+   opt->jit_thread_data_ptr_type = NULL;
+   opt->jit_linear_context_ptr_type = NULL;
+   opt->function[RAST_EDGE_TEST] = NULL;
+   opt->function[RAST_WHOLE] = NULL;
+
+   snprintf(module_name, sizeof(module_name), "fs%u_variant%u_opt",
+            job->shader.no, variant->no);
+
+   opt->gallivm = gallivm_create(module_name, context, &cached);
+   if (!opt->gallivm) {
+      FREE(opt);
+      LLVMContextDispose(context);
+      return;
+   }
+
+   lp_jit_init_types(opt);
+
+   /* Only replace the entry points which were generated by LLVM, not the
+    * ones coming from llvmpipe_fs_variant_fastpath().
+    */
+   if (variant->function[RAST_EDGE_TEST])
+      generate_fragment(NULL, &job->shader, opt, RAST_EDGE_TEST);
+   if (variant->function[RAST_WHOLE])
+      generate_fragment(NULL, &job->shader, opt, RAST_WHOLE);
+
+   gallivm_compile_module(opt->gallivm);
+
+   if (opt->function[RAST_EDGE_TEST])
+      jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(opt->gallivm, opt->function[RAST_EDGE_TEST]);
+   if (opt->function[RAST_WHOLE])
+      jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+            gallivm_jit_function(opt->gallivm, opt->function[RAST_WHOLE]);
+
+   if (job->needs_caching)
+      lp_disk_cache_insert_shader(job->screen, &cached, job->ir_sha1_cache_key);
+
+   gallivm_free_ir(opt->gallivm);
+   LLVMContextDispose(context);
+
+   variant->async_gallivm = opt->gallivm;
+
+   /* Rasterizer threads may be calling the old code right now, which is
+    * fine as the unoptimized code lives until the variant is destroyed.
+    */
+   if (jit_function[RAST_EDGE_TEST]) {
+      if (variant->jit_function[RAST_WHOLE] ==
+          variant->jit_function[RAST_EDGE_TEST])
+         p_atomic_set(&variant->jit_function[RAST_WHOLE],
+                      jit_function[RAST_EDGE_TEST]);
+      p_atomic_set(&variant->jit_function[RAST_EDGE_TEST],
+                   jit_function[RAST_EDGE_TEST]);
+   }
+   if (jit_function[RAST_WHOLE])
+      p_atomic_set(&variant->jit_function[RAST_WHOLE],
+                   jit_function[RAST_WHOLE]);
+
+   FREE(opt);
+}
+
+
+static void
+generate_variant_async_cleanup(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_async_job *job = data;
+
+   if (job->shader.base.ir.nir)
+      ralloc_free(job->shader.base.ir.nir);
+   FREE(job);
+}
+
+
+/**
+ * Hand the optimized compilation of a variant over to the screen's
+ * compile queue.  Returns false if the caller should compile it now.
+ */
+static bool
+queue_variant_async(struct llvmpipe_screen *screen,
+                    struct lp_fragment_shader *shader,
+                    struct lp_fragment_shader_variant *variant,
+                    const unsigned char ir_sha1_cache_key[20],
+                    bool needs_caching)
+{
+   struct lp_fs_async_job *job = CALLOC_STRUCT(lp_fs_async_job);
+   if (!job)
+      return false;
+
+   job->screen = screen;
+   job->variant = variant;
+   job->shader = *shader;
+   if (shader->base.ir.nir) {
+      job->shader.base.ir.nir = nir_shader_clone(NULL, shader->base.ir.nir);
+      if (!job->shader.base.ir.nir) {
+         FREE(job);
+         return false;
+      }
+   }
+   memcpy(job->ir_sha1_cache_key, ir_sha1_cache_key,
+          sizeof(job->ir_sha1_cache_key));
+   job->needs_caching = needs_caching;
+
+   util_queue_add_job(&screen->compile_queue, job, &variant->async_fence,
+                      generate_variant_async, generate_variant_async_cleanup,
+                      0);
+   return true;
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
- * other state indicated by the key.
+ * other state indicated by the key, in the given LLVM context.
+ * This doesn't touch any llvmpipe_context state, so it may run on the
+ * compile queue as long as nothing else uses the shader meanwhile.
+ * If \p nir isn't NULL, the code is generated from it instead of the
+ * shader's own NIR, which code generation modifies.
  */
 static struct lp_fragment_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+build_variant(struct llvmpipe_screen *screen,
+              LLVMContextRef context,
+              struct lp_fragment_shader *shader,
+              struct nir_shader *nir,
+              const struct lp_fragment_shader_variant_key *key,
+              bool allow_async)
 {
-   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fragment_shader gen_shader = *shader;
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc = NULL;
    boolean fullcolormask;
@@ -3582,27 +3747,54 @@ generate_variant(struct llvmpipe_context *lp,
    unsigned char ir_sha1_cache_key[20];
    struct lp_cached_code cached = { 0 };
    bool needs_caching = false;
+   bool async;
+
+   if (nir)
+      gen_shader.base.ir.nir = nir;
+
    variant = MALLOC(sizeof *variant + shader->variant_key_size - sizeof variant->key);
    if (!variant)
       return NULL;
 
    memset(variant, 0, sizeof(*variant));
+   util_queue_fence_init(&variant->async_fence);
    snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
             shader->no, shader->variants_created);
 
    pipe_reference_init(&variant->reference, 1);
-   lp_fs_reference(lp, &variant->shader, shader);
+   lp_fs_reference(NULL, &variant->shader, shader);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
-   if (shader->base.ir.nir) {
+   if (shader->base.ir.nir || shader->base.tokens) {
       lp_fs_get_ir_cache_key(variant, ir_sha1_cache_key);
 
       lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
       if (!cached.data_size)
          needs_caching = true;
    }
-   variant->gallivm = gallivm_create(module_name, lp->context, &cached);
+   /* Whether this is a candidate for the linear path */
+   linear =
+         !key->stencil[0].enabled &&
+         !key->depth.enabled &&
+         !shader->info.base.uses_kill &&
+         !key->blend.logicop_enable &&
+         (key->cbuf_format[0] == PIPE_FORMAT_B8G8R8A8_UNORM ||
+          key->cbuf_format[0] == PIPE_FORMAT_B8G8R8X8_UNORM);
+
+   /*
+    * On a cache miss, optionally get something drawable out quickly with
+    * unoptimized code and let the compile queue produce the real thing.
+    * The linear path inspects its JIT'ed code at variant creation, so
+    * keep those variants synchronous.
+    */
+   async = allow_async && screen->num_compile_threads && !linear &&
+           !cached.data_size;
+
+   if (async)
+      variant->gallivm = gallivm_create_unoptimized(module_name, context);
+   else
+      variant->gallivm = gallivm_create(module_name, context, &cached);
    if (!variant->gallivm) {
       FREE(variant);
       return NULL;
@@ -3694,15 +3886,6 @@ generate_variant(struct llvmpipe_context *lp,
    }
 
 
-   /* Whether this is a candidate for the linear path */
-   linear =
-         !key->stencil[0].enabled &&
-         !key->depth.enabled &&
-         !shader->info.base.uses_kill &&
-         !key->blend.logicop_enable &&
-         (key->cbuf_format[0] == PIPE_FORMAT_B8G8R8A8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_B8G8R8X8_UNORM);
-
    memcpy(&variant->key, key, sizeof *key);
 
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
@@ -3714,12 +3897,12 @@ generate_variant(struct llvmpipe_context *lp,
    lp_jit_init_types(variant);
    
    if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+      generate_fragment(NULL, &gen_shader, variant, RAST_EDGE_TEST);
 
    if (variant->jit_function[RAST_WHOLE] == NULL) {
       if (variant->opaque) {
          /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
+         generate_fragment(NULL, &gen_shader, variant, RAST_WHOLE);
       }
    }
 
@@ -3743,7 +3926,7 @@ generate_variant(struct llvmpipe_context *lp,
          if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
              shader->kind == LP_FS_KIND_BLIT_RGB1 ||
              shader->kind == LP_FS_KIND_LLVM_LINEAR) {
-            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
+            llvmpipe_fs_variant_linear_llvm(NULL, &gen_shader, variant);
          }
       }
    } else {
@@ -3788,7 +3971,12 @@ generate_variant(struct llvmpipe_context *lp,
       lp_linear_check_variant(variant);
    }
 
-   if (needs_caching) {
+   if (async) {
+      /* The optimized build inserts into the disk cache itself. */
+      if (variant->function[RAST_EDGE_TEST] || variant->function[RAST_WHOLE])
+         queue_variant_async(screen, shader, variant, ir_sha1_cache_key,
+                             needs_caching);
+   } else if (needs_caching) {
       lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
    }
 
@@ -3798,11 +3986,151 @@ generate_variant(struct llvmpipe_context *lp,
 }
 
 
+static struct lp_fragment_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key)
+{
+   return build_variant(llvmpipe_screen(lp->pipe.screen), lp->context,
+                        shader, NULL, key, true);
+}
+
+
+static struct lp_fragment_shader_variant_key *
+make_variant_key(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 char *store);
+
+
+/**
+ * Background compilation of the variant the shader will most likely be
+ * drawn with, keyed on the context state at the time it was created.
+ */
+struct lp_fs_precompile_job {
+   struct llvmpipe_screen *screen;
+   struct lp_fragment_shader *shader;
+   char key[LP_FS_MAX_VARIANT_KEY_SIZE];
+};
+
+
+static void
+precompile_variant(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_precompile_job *job = data;
+   struct lp_fragment_shader_variant *variant;
+   struct nir_shader *nir = NULL;
+   LLVMContextRef context;
+
+   /* Code generation modifies the NIR, and the context may be building
+    * other variants of the shader from it meanwhile.
+    */
+   if (job->shader->base.ir.nir) {
+      nir = nir_shader_clone(NULL, job->shader->base.ir.nir);
+      if (!nir)
+         return;
+   }
+
+   context = LLVMContextCreate();
+   if (!context) {
+      ralloc_free(nir);
+      return;
+   }
+
+   variant = build_variant(job->screen, context, job->shader, nir,
+                           (const struct lp_fragment_shader_variant_key *)
+                           job->key, false);
+   LLVMContextDispose(context);
+   ralloc_free(nir);
+
+   if (variant) {
+      /* The types belonged to the context we just disposed of. */
+      variant->jit_context_ptr_type = NULL;
+      variant->jit_thread_data_ptr_type = NULL;
+      variant->jit_linear_context_ptr_type = NULL;
+   }
+
+   job->shader->precompiled = variant;
+}
+
+
+static void
+precompile_variant_cleanup(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_precompile_job *job = data;
+
+   p_atomic_dec(&job->screen->num_fs_precompiles);
+   FREE(job);
+}
+
+
+/**
+ * Start compiling the shader on the compile queue with the key of the
+ * current context state, which is what most applications draw with
+ * right after creating their shaders.
+ */
+static void
+queue_precompile(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fs_precompile_job *job;
+
+   /* No state to guess the key from yet */
+   if (!lp->rasterizer || !lp->blend || !lp->depth_stencil)
+      return;
+
+   job = CALLOC_STRUCT(lp_fs_precompile_job);
+   if (!job)
+      return;
+
+   job->screen = screen;
+   job->shader = shader;
+   make_variant_key(lp, shader, job->key);
+   p_atomic_inc(&screen->num_fs_precompiles);
+
+   util_queue_add_job(&screen->compile_queue, job, &shader->precompile_fence,
+                      precompile_variant, precompile_variant_cleanup, 0);
+}
+
+
+/**
+ * Add a variant to the shader's and the context's variant lists.
+ */
+static void
+llvmpipe_insert_shader_variant(struct llvmpipe_context *lp,
+                               struct lp_fragment_shader_variant *variant)
+{
+   insert_at_head(&variant->shader->variants, &variant->list_item_local);
+   insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
+   lp->nr_fs_variants++;
+   lp->nr_fs_instrs += variant->nr_instrs;
+   variant->shader->variants_cached++;
+}
+
+
+/**
+ * Wait for the shader's precompiled variant, if any, and make it
+ * available to this context.
+ */
+static void
+llvmpipe_adopt_precompiled_variant(struct llvmpipe_context *lp,
+                                   struct lp_fragment_shader *shader)
+{
+   util_queue_fence_wait(&shader->precompile_fence);
+
+   if (shader->precompiled) {
+      llvmpipe_insert_shader_variant(lp, shader->precompiled);
+      shader->precompiled = NULL;
+   }
+}
+
+
 static void *
 llvmpipe_create_fs_state(struct pipe_context *pipe,
                          const struct pipe_shader_state *templ)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct lp_fragment_shader *shader;
    int nr_samplers;
    int nr_sampler_views;
@@ -3816,6 +4144,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    pipe_reference_init(&shader->reference, 1);
    shader->no = fs_no++;
    make_empty_list(&shader->variants);
+   util_queue_fence_init(&shader->precompile_fence);
 
    shader->base.type = templ->type;
    if (templ->type == PIPE_SHADER_IR_TGSI) {
@@ -3903,6 +4232,9 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    else
      llvmpipe_fs_analyse_nir(shader);
 
+   if (screen->num_parallel_compile_threads)
+      queue_precompile(llvmpipe, shader);
+
    return shader;
 }
 
@@ -3958,6 +4290,12 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
+   /* The compile queue may still be building code for this variant. */
+   util_queue_fence_wait(&variant->async_fence);
+   util_queue_fence_destroy(&variant->async_fence);
+   if (variant->async_gallivm)
+      gallivm_destroy(variant->async_gallivm);
+
    gallivm_destroy(variant->gallivm);
 
    lp_fs_reference(lp, &variant->shader, NULL);
@@ -3971,6 +4309,7 @@ llvmpipe_destroy_fs(struct llvmpipe_context *llvmpipe,
 {
    /* Delete draw module's data */
    draw_delete_fragment_shader(llvmpipe->draw, shader->draw_data);
+   util_queue_fence_destroy(&shader->precompile_fence);
 
    if (shader->base.ir.nir)
       ralloc_free(shader->base.ir.nir);
@@ -3986,6 +4325,11 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    struct lp_fragment_shader *shader = fs;
    struct lp_fs_variant_list_item *li;
 
+   /* The compile queue may still be building a variant for this shader. */
+   util_queue_fence_wait(&shader->precompile_fence);
+   if (shader->precompiled)
+      lp_fs_variant_reference(llvmpipe, &shader->precompiled, NULL);
+
    /* Delete all the variants */
    li = first_elem(&shader->variants);
    while(!at_end(&shader->variants, li)) {
@@ -4395,6 +4739,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    struct lp_fs_variant_list_item *li;
    char store[LP_FS_MAX_VARIANT_KEY_SIZE];
 
+   llvmpipe_adopt_precompiled_variant(lp, shader);
+
    key = make_variant_key(lp, shader, store);
 
    /* Search the variants for one which matches the key */
@@ -4472,13 +4818,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
       /* Put the new variant into the list */
-      if (variant) {
-         insert_at_head(&shader->variants, &variant->list_item_local);
-         insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
-         lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
-         shader->variants_cached++;
-      }
+      if (variant)
+         llvmpipe_insert_shader_variant(lp, variant);
    }
 
    /* Bind this variant */
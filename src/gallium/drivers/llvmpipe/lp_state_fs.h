@@ -37,6 +37,7 @@
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 #include "util/u_inlines.h"
+#include "util/u_queue.h"
 #include "lp_jit.h"
 
 struct tgsi_token;
@@ -192,6 +193,13 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /* With LP_ASYNC_COMPILE the variant first runs unoptimized code, and
+    * jit_function[] is switched to the optimized code from async_gallivm
+    * once the compile queue signals async_fence.
+    */
+   struct gallivm_state *async_gallivm;
+   struct util_queue_fence async_fence;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -228,6 +236,14 @@ struct lp_fragment_shader
    unsigned variants_created;
    unsigned variants_cached;
 
+   /*
+    * Variant built on the compile queue at creation time for
+    * KHR_parallel_shader_compile, waiting to be adopted by the first
+    * context which draws with the shader.
+    */
+   struct util_queue_fence precompile_fence;
+   struct lp_fragment_shader_variant *precompiled;
+
    /** Fragment shader input interpolation info */
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
 };
@@ -0,0 +1,374 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * Triangle binning test and benchmark.
+ *
+ * Renders the same mix of large and small triangles with coarse binning
+ * enabled and disabled (LP_PERF=no_coarse_bin), checks that both images
+ * match and reports the time taken by each at several render target sizes.
+ */
+
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "util/os_time.h"
+#include "util/u_draw.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_debug.h"
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+#define NUM_BIG_TRIS 16
+
+
+struct bin_test {
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   void *vs, *fs, *velems, *rast, *blend, *dsa;
+   float (*verts)[2][4];
+   unsigned num_verts;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "size\t"
+           "triangles\t"
+           "fine_ms\t"
+           "coarse_ms\n");
+
+   fflush(fp);
+}
+
+
+static void
+set_vertex(float (*v)[4], float x, float y, const float color[4])
+{
+   v[0][0] = x;
+   v[0][1] = y;
+   v[0][2] = 0.0f;
+   v[0][3] = 1.0f;
+   memcpy(v[1], color, sizeof(float[4]));
+}
+
+
+/**
+ * A few triangles overhanging the render target, followed by num_small
+ * triangles a couple of pixels wide.
+ */
+static void
+make_triangles(struct bin_test *t, unsigned size, unsigned num_small)
+{
+   const float small = 8.0f / size;
+   unsigned i, j;
+
+   t->num_verts = (NUM_BIG_TRIS + num_small) * 3;
+   t->verts = MALLOC(t->num_verts * sizeof(*t->verts));
+
+   for (i = 0; i < NUM_BIG_TRIS + num_small; i++) {
+      float color[4] = { random_float(), random_float(), random_float(), 1.0f };
+      float x = random_float() * 2.0f - 1.0f;
+      float y = random_float() * 2.0f - 1.0f;
+
+      for (j = 0; j < 3; j++) {
+         float vx, vy;
+
+         if (i < NUM_BIG_TRIS) {
+            vx = random_float() * 3.0f - 1.5f;
+            vy = random_float() * 3.0f - 1.5f;
+         } else {
+            vx = x + random_float() * small;
+            vy = y + random_float() * small;
+         }
+         set_vertex(t->verts[i * 3 + j], vx, vy, color);
+      }
+   }
+}
+
+
+static boolean
+create_state(struct bin_test *t)
+{
+   static const enum tgsi_semantic semantic_names[] =
+      { TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR };
+   static const uint semantic_indexes[] = { 0, 0 };
+   struct pipe_vertex_element velems[2];
+   struct pipe_rasterizer_state rast;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   unsigned i;
+
+   t->screen = llvmpipe_create_screen(null_sw_create());
+   if (!t->screen)
+      return FALSE;
+
+   t->pipe = t->screen->context_create(t->screen, NULL, 0);
+   if (!t->pipe)
+      return FALSE;
+
+   memset(velems, 0, sizeof velems);
+   for (i = 0; i < 2; i++) {
+      velems[i].src_offset = i * sizeof(float[4]);
+      velems[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   }
+
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast.flatshade = 1;
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+   memset(&dsa, 0, sizeof dsa);
+
+   t->vs = util_make_vertex_passthrough_shader(t->pipe, 2, semantic_names,
+                                               semantic_indexes, false);
+   t->fs = util_make_fragment_passthrough_shader(t->pipe, TGSI_SEMANTIC_COLOR,
+                                                 TGSI_INTERPOLATE_CONSTANT,
+                                                 FALSE);
+   t->velems = t->pipe->create_vertex_elements_state(t->pipe, 2, velems);
+   t->rast = t->pipe->create_rasterizer_state(t->pipe, &rast);
+   t->blend = t->pipe->create_blend_state(t->pipe, &blend);
+   t->dsa = t->pipe->create_depth_stencil_alpha_state(t->pipe, &dsa);
+
+   t->pipe->bind_vs_state(t->pipe, t->vs);
+   t->pipe->bind_fs_state(t->pipe, t->fs);
+   t->pipe->bind_vertex_elements_state(t->pipe, t->velems);
+   t->pipe->bind_rasterizer_state(t->pipe, t->rast);
+   t->pipe->bind_blend_state(t->pipe, t->blend);
+   t->pipe->bind_depth_stencil_alpha_state(t->pipe, t->dsa);
+   t->pipe->set_sample_mask(t->pipe, ~0);
+
+   return TRUE;
+}
+
+
+static void
+destroy_state(struct bin_test *t)
+{
+   if (t->pipe) {
+      t->pipe->delete_vs_state(t->pipe, t->vs);
+      t->pipe->delete_fs_state(t->pipe, t->fs);
+      t->pipe->delete_vertex_elements_state(t->pipe, t->velems);
+      t->pipe->delete_rasterizer_state(t->pipe, t->rast);
+      t->pipe->delete_blend_state(t->pipe, t->blend);
+      t->pipe->delete_depth_stencil_alpha_state(t->pipe, t->dsa);
+      t->pipe->destroy(t->pipe);
+   }
+   if (t->screen)
+      t->screen->destroy(t->screen);
+}
+
+
+/**
+ * Draw the triangles into a size x size render target and return the
+ * time it took in nanoseconds.  The rendered image is copied to image.
+ */
+static int64_t
+render(struct bin_test *t, struct pipe_resource *tex, uint8_t *image)
+{
+   struct pipe_context *pipe = t->pipe;
+   const union pipe_color_union clear_color = { .f = { 0.0f, 0.0f, 0.0f, 1.0f } };
+   struct pipe_vertex_buffer vb;
+   struct pipe_fence_handle *fence = NULL;
+   struct pipe_transfer *transfer;
+   int64_t time_begin, time_end;
+   const uint8_t *map;
+   unsigned y;
+
+   memset(&vb, 0, sizeof vb);
+   vb.stride = sizeof(*t->verts);
+   vb.is_user_buffer = true;
+   vb.buffer.user = t->verts;
+
+   time_begin = os_time_get_nano();
+
+   pipe->clear(pipe, PIPE_CLEAR_COLOR0, NULL, &clear_color, 0.0, 0);
+   pipe->set_vertex_buffers(pipe, 0, 1, 0, false, &vb);
+   util_draw_arrays(pipe, PIPE_PRIM_TRIANGLES, 0, t->num_verts);
+   pipe->flush(pipe, &fence, 0);
+   t->screen->fence_finish(t->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+   t->screen->fence_reference(t->screen, &fence, NULL);
+
+   time_end = os_time_get_nano();
+
+   map = pipe_texture_map(pipe, tex, 0, 0, PIPE_MAP_READ,
+                          0, 0, tex->width0, tex->height0, &transfer);
+   for (y = 0; y < tex->height0; y++)
+      memcpy(image + y * tex->width0 * 4, map + y * transfer->stride,
+             tex->width0 * 4);
+   pipe_texture_unmap(pipe, transfer);
+
+   return time_end - time_begin;
+}
+
+
+static boolean
+test_one(struct bin_test *t, unsigned verbose, FILE *fp,
+         unsigned size, unsigned num_small)
+{
+   struct pipe_context *pipe = t->pipe;
+   struct pipe_resource templ, *tex;
+   struct pipe_surface surf_templ, *surf;
+   struct pipe_framebuffer_state fb;
+   struct pipe_viewport_state vp;
+   uint8_t *fine_image, *coarse_image;
+   int64_t fine_time, coarse_time;
+   const int saved_perf = LP_PERF;
+   boolean success;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = size;
+   templ.height0 = size;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+
+   tex = t->screen->resource_create(t->screen, &templ);
+   if (!tex)
+      return FALSE;
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = templ.format;
+   surf = pipe->create_surface(pipe, tex, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = size;
+   fb.height = size;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = vp.translate[0] = size / 2.0f;
+   vp.scale[1] = vp.translate[1] = size / 2.0f;
+   vp.scale[2] = vp.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   make_triangles(t, size, num_small);
+
+   fine_image = MALLOC(size * size * 4);
+   coarse_image = MALLOC(size * size * 4);
+
+   /* Warm up: compile the shaders and fault the render target in. */
+   render(t, tex, fine_image);
+
+   LP_PERF = saved_perf | PERF_NO_COARSE_BIN;
+   fine_time = render(t, tex, fine_image);
+
+   LP_PERF = saved_perf & ~PERF_NO_COARSE_BIN;
+   coarse_time = render(t, tex, coarse_image);
+
+   LP_PERF = saved_perf;
+
+   success = memcmp(fine_image, coarse_image, size * size * 4) == 0;
+
+   if (verbose || !success) {
+      fprintf(stderr, "%5ux%-5u %6u triangles: fine %8.3f ms, coarse %8.3f ms%s\n",
+              size, size, t->num_verts / 3,
+              fine_time / 1e6, coarse_time / 1e6,
+              success ? "" : " -- images differ");
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%u\t%f\t%f\n",
+              success ? "pass" : "fail",
+              size, t->num_verts / 3,
+              fine_time / 1e6, coarse_time / 1e6);
+      fflush(fp);
+   }
+
+   FREE(fine_image);
+   FREE(coarse_image);
+   FREE(t->verts);
+   t->verts = NULL;
+
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe_surface_reference(&surf, NULL);
+   pipe_resource_reference(&tex, NULL);
+
+   return success;
+}
+
+
+static boolean
+test_sizes(unsigned verbose, FILE *fp, unsigned max_size, unsigned num_small)
+{
+   struct bin_test t;
+   boolean success = TRUE;
+   unsigned size;
+
+   memset(&t, 0, sizeof t);
+
+   if (!create_state(&t)) {
+      destroy_state(&t);
+      return FALSE;
+   }
+
+   for (size = 256; size <= max_size; size *= 2) {
+      if (!test_one(&t, verbose, fp, size, num_small))
+         success = FALSE;
+   }
+
+   destroy_state(&t);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_sizes(verbose, fp, 8192, 100000);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_sizes(verbose, fp, 4096, n);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_sizes(verbose, fp, 256, 1000);
+}
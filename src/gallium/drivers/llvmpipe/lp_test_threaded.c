@@ -0,0 +1,458 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file
+ * Threaded context (LP_THREADED_CONTEXT) test and benchmark.
+ *
+ * Checks that writes to a bound fragment constant buffer are seen by the
+ * following draws, also after the buffer has been invalidated, and that
+ * asynchronous and deferred flushes return fences which complete.  The
+ * benchmark times many small draws with changing constants, with and
+ * without the threaded context.
+ */
+
+
+#include <stdlib.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_text.h"
+#include "util/os_time.h"
+#include "util/u_draw.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_public.h"
+#include "lp_screen.h"
+#include "lp_test.h"
+
+
+#define RT_SIZE 16
+
+
+struct threaded_test {
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct pipe_resource *rt, *vbuf, *cbuf;
+   struct pipe_surface *surf;
+   void *vs, *fs, *velems, *rast, *blend, *dsa;
+};
+
+
+static const char fs_text[] =
+   "FRAG\n"
+   "DCL OUT[0], COLOR\n"
+   "DCL CONST[0][0]\n"
+   "  0: MOV OUT[0], CONST[0][0]\n"
+   "  1: END\n";
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "draws\t"
+           "direct_ms\t"
+           "threaded_ms\n");
+
+   fflush(fp);
+}
+
+
+static void
+destroy_state(struct threaded_test *t)
+{
+   if (t->pipe) {
+      t->pipe->bind_vs_state(t->pipe, NULL);
+      t->pipe->bind_fs_state(t->pipe, NULL);
+      if (t->vs)
+         t->pipe->delete_vs_state(t->pipe, t->vs);
+      if (t->fs)
+         t->pipe->delete_fs_state(t->pipe, t->fs);
+      if (t->velems)
+         t->pipe->delete_vertex_elements_state(t->pipe, t->velems);
+      if (t->rast)
+         t->pipe->delete_rasterizer_state(t->pipe, t->rast);
+      if (t->blend)
+         t->pipe->delete_blend_state(t->pipe, t->blend);
+      if (t->dsa)
+         t->pipe->delete_depth_stencil_alpha_state(t->pipe, t->dsa);
+      pipe_surface_reference(&t->surf, NULL);
+      t->pipe->destroy(t->pipe);
+   }
+   pipe_resource_reference(&t->rt, NULL);
+   pipe_resource_reference(&t->vbuf, NULL);
+   pipe_resource_reference(&t->cbuf, NULL);
+   if (t->screen)
+      t->screen->destroy(t->screen);
+}
+
+
+/**
+ * Set up a context which fills either half of the render target with the
+ * first constant of the fragment constant buffer.
+ */
+static boolean
+create_state(struct threaded_test *t, boolean threaded)
+{
+   static const enum tgsi_semantic semantic_names[] = { TGSI_SEMANTIC_POSITION };
+   static const uint semantic_indexes[] = { 0 };
+   /* Left and right half of the render target. */
+   static const float verts[8][4] = {
+      { -1.0f, -1.0f, 0.0f, 1.0f },
+      {  0.0f, -1.0f, 0.0f, 1.0f },
+      { -1.0f,  1.0f, 0.0f, 1.0f },
+      {  0.0f,  1.0f, 0.0f, 1.0f },
+      {  0.0f, -1.0f, 0.0f, 1.0f },
+      {  1.0f, -1.0f, 0.0f, 1.0f },
+      {  0.0f,  1.0f, 0.0f, 1.0f },
+      {  1.0f,  1.0f, 0.0f, 1.0f },
+   };
+   static char gallium_thread[] = "GALLIUM_THREAD=1";
+   struct tgsi_token tokens[64];
+   struct pipe_shader_state fs_state;
+   struct pipe_resource templ;
+   struct pipe_surface surf_templ;
+   struct pipe_framebuffer_state fb;
+   struct pipe_viewport_state vp;
+   struct pipe_vertex_element velem;
+   struct pipe_vertex_buffer vb;
+   struct pipe_constant_buffer cb;
+   struct pipe_rasterizer_state rast;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_context *pipe;
+
+   memset(t, 0, sizeof *t);
+
+   t->screen = llvmpipe_create_screen(null_sw_create());
+   if (!t->screen)
+      return FALSE;
+
+   /* The threaded context is otherwise skipped on single CPU systems. */
+   putenv(gallium_thread);
+
+   llvmpipe_screen(t->screen)->threaded_context = threaded;
+   t->pipe = pipe = t->screen->context_create(t->screen, NULL,
+                                              PIPE_CONTEXT_PREFER_THREADED);
+   if (!pipe)
+      return FALSE;
+
+   if (!tgsi_text_translate(fs_text, tokens, ARRAY_SIZE(tokens)))
+      return FALSE;
+   memset(&fs_state, 0, sizeof fs_state);
+   fs_state.type = PIPE_SHADER_IR_TGSI;
+   fs_state.tokens = tokens;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = RT_SIZE;
+   templ.height0 = RT_SIZE;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   t->rt = t->screen->resource_create(t->screen, &templ);
+   t->vbuf = pipe_buffer_create(t->screen, PIPE_BIND_VERTEX_BUFFER,
+                                PIPE_USAGE_DEFAULT, sizeof verts);
+   t->cbuf = pipe_buffer_create(t->screen, PIPE_BIND_CONSTANT_BUFFER,
+                                PIPE_USAGE_DEFAULT, sizeof(float[4]));
+   if (!t->rt || !t->vbuf || !t->cbuf)
+      return FALSE;
+
+   pipe_buffer_write(pipe, t->vbuf, 0, sizeof verts, verts);
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = templ.format;
+   t->surf = pipe->create_surface(pipe, t->rt, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = RT_SIZE;
+   fb.height = RT_SIZE;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = t->surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = vp.translate[0] = RT_SIZE / 2.0f;
+   vp.scale[1] = vp.translate[1] = RT_SIZE / 2.0f;
+   vp.scale[2] = vp.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   memset(&velem, 0, sizeof velem);
+   velem.src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+   memset(&dsa, 0, sizeof dsa);
+
+   t->vs = util_make_vertex_passthrough_shader(pipe, 1, semantic_names,
+                                               semantic_indexes, false);
+   t->fs = pipe->create_fs_state(pipe, &fs_state);
+   t->velems = pipe->create_vertex_elements_state(pipe, 1, &velem);
+   t->rast = pipe->create_rasterizer_state(pipe, &rast);
+   t->blend = pipe->create_blend_state(pipe, &blend);
+   t->dsa = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+
+   pipe->bind_vs_state(pipe, t->vs);
+   pipe->bind_fs_state(pipe, t->fs);
+   pipe->bind_vertex_elements_state(pipe, t->velems);
+   pipe->bind_rasterizer_state(pipe, t->rast);
+   pipe->bind_blend_state(pipe, t->blend);
+   pipe->bind_depth_stencil_alpha_state(pipe, t->dsa);
+   pipe->set_sample_mask(pipe, ~0);
+
+   memset(&vb, 0, sizeof vb);
+   vb.stride = sizeof(verts[0]);
+   vb.buffer.resource = t->vbuf;
+   pipe->set_vertex_buffers(pipe, 0, 1, 0, false, &vb);
+
+   memset(&cb, 0, sizeof cb);
+   cb.buffer = t->cbuf;
+   cb.buffer_size = sizeof(float[4]);
+   pipe->set_constant_buffer(pipe, PIPE_SHADER_FRAGMENT, 0, false, &cb);
+
+   return TRUE;
+}
+
+
+static void
+write_color(struct threaded_test *t, unsigned usage, const float color[4])
+{
+   struct pipe_transfer *transfer;
+   float *map;
+
+   map = pipe_buffer_map_range(t->pipe, t->cbuf, 0, sizeof(float[4]),
+                               PIPE_MAP_WRITE | usage, &transfer);
+   memcpy(map, color, sizeof(float[4]));
+   pipe_buffer_unmap(t->pipe, transfer);
+}
+
+
+static uint32_t
+pack_color(const float color[4])
+{
+   return (uint32_t)(color[3] * 255.0f) << 24 |
+          (uint32_t)(color[0] * 255.0f) << 16 |
+          (uint32_t)(color[1] * 255.0f) << 8 |
+          (uint32_t)(color[2] * 255.0f);
+}
+
+
+/**
+ * Draw the left half with the left color written to the constant buffer
+ * with the given map flags, then the right half after writing the right
+ * color with a plain map.  Both draws end up in the same scene.  Check the
+ * rendered colors.
+ */
+static boolean
+draw_and_check(struct threaded_test *t, unsigned usage,
+               const float left[4], const float right[4],
+               unsigned verbose, const char *name)
+{
+   const uint32_t expected[2] = { pack_color(left), pack_color(right) };
+   struct pipe_transfer *transfer;
+   const uint8_t *map;
+   boolean success = TRUE;
+   unsigned x, y;
+
+   write_color(t, usage, left);
+   util_draw_arrays(t->pipe, PIPE_PRIM_TRIANGLE_STRIP, 0, 4);
+   write_color(t, 0, right);
+   util_draw_arrays(t->pipe, PIPE_PRIM_TRIANGLE_STRIP, 4, 4);
+
+   map = pipe_texture_map(t->pipe, t->rt, 0, 0, PIPE_MAP_READ,
+                          0, 0, RT_SIZE, RT_SIZE, &transfer);
+   for (y = 0; y < RT_SIZE; y++) {
+      const uint32_t *row = (const uint32_t *)(map + y * transfer->stride);
+      for (x = 0; x < RT_SIZE; x++) {
+         if (row[x] != expected[x >= RT_SIZE / 2])
+            success = FALSE;
+      }
+   }
+   pipe_texture_unmap(t->pipe, transfer);
+
+   if (verbose || !success)
+      fprintf(stderr, "%-40s %s\n", name, success ? "pass" : "FAIL");
+
+   return success;
+}
+
+
+static boolean
+wait_fence(struct threaded_test *t, unsigned flags, unsigned verbose,
+           const char *name)
+{
+   struct pipe_fence_handle *fence = NULL;
+   boolean success;
+
+   util_draw_arrays(t->pipe, PIPE_PRIM_TRIANGLE_STRIP, 0, 4);
+   t->pipe->flush(t->pipe, &fence, flags);
+
+   success = fence &&
+             t->screen->fence_finish(t->screen, t->pipe, fence,
+                                     PIPE_TIMEOUT_INFINITE) &&
+             t->screen->fence_finish(t->screen, NULL, fence, 0);
+   t->screen->fence_reference(t->screen, &fence, NULL);
+
+   if (verbose || !success)
+      fprintf(stderr, "%-40s %s\n", name, success ? "pass" : "FAIL");
+
+   return success;
+}
+
+
+static boolean
+test_correctness(unsigned verbose)
+{
+   static const float red[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+   static const float green[4] = { 0.0f, 1.0f, 0.0f, 1.0f };
+   static const float blue[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+   struct threaded_test t;
+   boolean success = TRUE;
+
+   if (!create_state(&t, TRUE)) {
+      destroy_state(&t);
+      return FALSE;
+   }
+
+   success &= draw_and_check(&t, 0, red, blue, verbose, "constants");
+
+   /* Discarding makes the threaded context replace the buffer's storage.
+    * Later maps go to the buffer which provided the new storage, not to
+    * the bound one.
+    */
+   success &= draw_and_check(&t, PIPE_MAP_DISCARD_WHOLE_RESOURCE, green, red,
+                             verbose, "constants, discarded");
+   success &= draw_and_check(&t, 0, blue, green, verbose,
+                             "constants after discard");
+
+   success &= wait_fence(&t, PIPE_FLUSH_ASYNC, verbose, "async flush fence");
+   success &= wait_fence(&t, PIPE_FLUSH_DEFERRED, verbose,
+                         "deferred flush fence");
+
+   destroy_state(&t);
+
+   return success;
+}
+
+
+/**
+ * Time num_draws draws, each with new constants, and return the time it
+ * took in nanoseconds.
+ */
+static int64_t
+time_draws(boolean threaded, unsigned long num_draws)
+{
+   struct threaded_test t;
+   struct pipe_fence_handle *fence = NULL;
+   struct pipe_constant_buffer cb;
+   int64_t time_begin, time_end;
+   unsigned long i;
+
+   if (!create_state(&t, threaded)) {
+      destroy_state(&t);
+      return -1;
+   }
+
+   memset(&cb, 0, sizeof cb);
+   cb.buffer_size = sizeof(float[4]);
+
+   time_begin = os_time_get_nano();
+
+   for (i = 0; i < num_draws; i++) {
+      const float color[4] = { (i & 0xff) / 255.0f, 0.0f, 0.0f, 1.0f };
+
+      cb.user_buffer = color;
+      t.pipe->set_constant_buffer(t.pipe, PIPE_SHADER_FRAGMENT, 0, false, &cb);
+      util_draw_arrays(t.pipe, PIPE_PRIM_TRIANGLE_STRIP, 0, 4);
+   }
+   t.pipe->flush(t.pipe, &fence, 0);
+   t.screen->fence_finish(t.screen, t.pipe, fence, PIPE_TIMEOUT_INFINITE);
+   t.screen->fence_reference(t.screen, &fence, NULL);
+
+   time_end = os_time_get_nano();
+
+   destroy_state(&t);
+
+   return time_end - time_begin;
+}
+
+
+static boolean
+test_draws(unsigned verbose, FILE *fp, unsigned long num_draws)
+{
+   int64_t direct_time, threaded_time;
+   boolean success = test_correctness(verbose);
+
+   direct_time = time_draws(FALSE, num_draws);
+   threaded_time = time_draws(TRUE, num_draws);
+   if (direct_time < 0 || threaded_time < 0)
+      return FALSE;
+
+   if (verbose) {
+      fprintf(stderr, "%lu draws: direct %.3f ms, threaded %.3f ms\n",
+              num_draws, direct_time / 1e6, threaded_time / 1e6);
+   }
+
+   if (fp) {
+      fprintf(fp, "%lu\t%f\t%f\n",
+              num_draws, direct_time / 1e6, threaded_time / 1e6);
+      fflush(fp);
+   }
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_draws(verbose, fp, 100000);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_draws(verbose, fp, n * 10);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_correctness(verbose);
+}
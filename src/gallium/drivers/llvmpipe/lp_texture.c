@@ -43,6 +43,8 @@
 #include "util/simple_list.h"
 #include "util/u_transfer.h"
 
+#include "draw/draw_context.h"
+
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
@@ -75,7 +77,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
                         struct llvmpipe_resource *lpr,
                         boolean allocate)
 {
-   struct pipe_resource *pt = &lpr->base;
+   struct pipe_resource *pt = &lpr->base.b;
    unsigned level;
    unsigned width = pt->width0;
    unsigned height = pt->height0;
@@ -114,7 +116,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
          align_x = align_y = 1;
       else {
          align_x = LP_RASTER_BLOCK_SIZE;
-         if (llvmpipe_resource_is_1d(&lpr->base))
+         if (llvmpipe_resource_is_1d(&lpr->base.b))
             align_y = 1;
          else
             align_y = LP_RASTER_BLOCK_SIZE;
@@ -134,16 +136,16 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       lpr->img_stride[level] = (uint64_t)lpr->row_stride[level] * nblocksy;
 
       /* Number of 3D image slices, cube faces or texture array layers */
-      if (lpr->base.target == PIPE_TEXTURE_CUBE) {
+      if (lpr->base.b.target == PIPE_TEXTURE_CUBE) {
          assert(layers == 6);
       }
 
-      if (lpr->base.target == PIPE_TEXTURE_3D)
+      if (lpr->base.b.target == PIPE_TEXTURE_3D)
          num_slices = depth;
-      else if (lpr->base.target == PIPE_TEXTURE_1D_ARRAY ||
-               lpr->base.target == PIPE_TEXTURE_2D_ARRAY ||
-               lpr->base.target == PIPE_TEXTURE_CUBE ||
-               lpr->base.target == PIPE_TEXTURE_CUBE_ARRAY)
+      else if (lpr->base.b.target == PIPE_TEXTURE_1D_ARRAY ||
+               lpr->base.b.target == PIPE_TEXTURE_2D_ARRAY ||
+               lpr->base.b.target == PIPE_TEXTURE_CUBE ||
+               lpr->base.b.target == PIPE_TEXTURE_CUBE_ARRAY)
          num_slices = layers;
       else
          num_slices = 1;
@@ -193,7 +195,7 @@ llvmpipe_can_create_resource(struct pipe_screen *screen,
 {
    struct llvmpipe_resource lpr;
    memset(&lpr, 0, sizeof(lpr));
-   lpr.base = *res;
+   lpr.base.b = *res;
    if (!llvmpipe_texture_layout(llvmpipe_screen(screen), &lpr, false))
       return false;
 
@@ -211,12 +213,12 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
    /* Round up the surface size to a multiple of the tile size to
     * avoid tile clipping.
     */
-   const unsigned width = MAX2(1, align(lpr->base.width0, TILE_SIZE));
-   const unsigned height = MAX2(1, align(lpr->base.height0, TILE_SIZE));
+   const unsigned width = MAX2(1, align(lpr->base.b.width0, TILE_SIZE));
+   const unsigned height = MAX2(1, align(lpr->base.b.height0, TILE_SIZE));
 
    lpr->dt = winsys->displaytarget_create(winsys,
-                                          lpr->base.bind,
-                                          lpr->base.format,
+                                          lpr->base.b.bind,
+                                          lpr->base.b.format,
                                           width, height,
                                           64,
                                           map_front_private,
@@ -236,17 +238,17 @@ llvmpipe_resource_create_all(struct pipe_screen *_screen,
    if (!lpr)
       return NULL;
 
-   lpr->base = *templat;
+   lpr->base.b = *templat;
    lpr->screen = screen;
-   pipe_reference_init(&lpr->base.reference, 1);
-   lpr->base.screen = &screen->base;
+   pipe_reference_init(&lpr->base.b.reference, 1);
+   lpr->base.b.screen = &screen->base;
 
-   /* assert(lpr->base.bind); */
+   /* assert(lpr->base.b.bind); */
 
-   if (llvmpipe_resource_is_texture(&lpr->base)) {
-      if (lpr->base.bind & (PIPE_BIND_DISPLAY_TARGET |
-                            PIPE_BIND_SCANOUT |
-                            PIPE_BIND_SHARED)) {
+   if (llvmpipe_resource_is_texture(&lpr->base.b)) {
+      if (lpr->base.b.bind & (PIPE_BIND_DISPLAY_TARGET |
+                              PIPE_BIND_SCANOUT |
+                              PIPE_BIND_SHARED)) {
          /* displayable surface */
          if (!llvmpipe_displaytarget_layout(screen, lpr, map_front_private))
             goto fail;
@@ -291,13 +293,16 @@ llvmpipe_resource_create_all(struct pipe_screen *_screen,
 
    lpr->id = id_counter++;
 
+   threaded_resource_init(&lpr->base.b, false);
+   lpr->base.is_shared = lpr->dt != NULL;
+
 #ifdef DEBUG
    mtx_lock(&resource_list_mutex);
    insert_at_tail(&resource_list, lpr);
    mtx_unlock(&resource_list_mutex);
 #endif
 
-   return &lpr->base;
+   return &lpr->base.b;
 
  fail:
    FREE(lpr);
@@ -376,13 +381,13 @@ llvmpipe_resource_from_memobj(struct pipe_screen *pscreen,
    struct llvmpipe_screen *screen = llvmpipe_screen(pscreen);
    struct llvmpipe_memory_object *lpmo = llvmpipe_memory_object(memobj);
    struct llvmpipe_resource *lpr = CALLOC_STRUCT(llvmpipe_resource);
-   lpr->base = *templat;
+   lpr->base.b = *templat;
 
    lpr->screen = screen;
-   pipe_reference_init(&lpr->base.reference, 1);
-   lpr->base.screen = &screen->base;
+   pipe_reference_init(&lpr->base.b.reference, 1);
+   lpr->base.b.screen = &screen->base;
 
-   if (llvmpipe_resource_is_texture(&lpr->base)) {
+   if (llvmpipe_resource_is_texture(&lpr->base.b)) {
       /* texture map */
       if (!llvmpipe_texture_layout(screen, lpr, false))
          goto fail;
@@ -420,13 +425,16 @@ llvmpipe_resource_from_memobj(struct pipe_screen *pscreen,
    lpr->id = id_counter++;
    lpr->imported_memory = true;
 
+   threaded_resource_init(&lpr->base.b, false);
+   lpr->base.is_shared = true;
+
 #ifdef DEBUG
    mtx_lock(&resource_list_mutex);
    insert_at_tail(&resource_list, lpr);
    mtx_unlock(&resource_list_mutex);
 #endif
 
-   return &lpr->base;
+   return &lpr->base.b;
 
 fail:
    free(lpr);
@@ -466,6 +474,7 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
    mtx_unlock(&resource_list_mutex);
 #endif
 
+   threaded_resource_deinit(pt);
    FREE(lpr);
 }
 
@@ -575,18 +584,18 @@ llvmpipe_resource_from_handle(struct pipe_screen *_screen,
       goto no_lpr;
    }
 
-   lpr->base = *template;
+   lpr->base.b = *template;
    lpr->screen = screen;
-   pipe_reference_init(&lpr->base.reference, 1);
-   lpr->base.screen = _screen;
+   pipe_reference_init(&lpr->base.b.reference, 1);
+   lpr->base.b.screen = _screen;
 
    /*
     * Looks like unaligned displaytargets work just fine,
     * at least sampler/render ones.
     */
 #if 0
-   assert(lpr->base.width0 == width);
-   assert(lpr->base.height0 == height);
+   assert(lpr->base.b.width0 == width);
+   assert(lpr->base.b.height0 == height);
 #endif
 
    lpr->dt = winsys->displaytarget_from_handle(winsys,
@@ -599,13 +608,16 @@ llvmpipe_resource_from_handle(struct pipe_screen *_screen,
 
    lpr->id = id_counter++;
 
+   threaded_resource_init(&lpr->base.b, false);
+   lpr->base.is_shared = true;
+
 #ifdef DEBUG
    mtx_lock(&resource_list_mutex);
    insert_at_tail(&resource_list, lpr);
    mtx_unlock(&resource_list_mutex);
 #endif
 
-   return &lpr->base;
+   return &lpr->base.b;
 
 no_dt:
    FREE(lpr);
@@ -644,12 +656,12 @@ llvmpipe_resource_from_user_memory(struct pipe_screen *_screen,
       return NULL;
    }
 
-   lpr->base = *resource;
+   lpr->base.b = *resource;
    lpr->screen = screen;
-   pipe_reference_init(&lpr->base.reference, 1);
-   lpr->base.screen = _screen;
+   pipe_reference_init(&lpr->base.b.reference, 1);
+   lpr->base.b.screen = _screen;
 
-   if (llvmpipe_resource_is_texture(&lpr->base)) {
+   if (llvmpipe_resource_is_texture(&lpr->base.b)) {
       if (!llvmpipe_texture_layout(screen, lpr, false))
          goto fail;
 
@@ -657,12 +669,47 @@ llvmpipe_resource_from_user_memory(struct pipe_screen *_screen,
    } else
       lpr->data = user_memory;
    lpr->user_ptr = true;
-   return &lpr->base;
+
+   threaded_resource_init(&lpr->base.b, false);
+   lpr->base.is_user_ptr = true;
+   util_range_add(&lpr->base.b, &lpr->base.valid_buffer_range,
+                  0, lpr->base.b.width0);
+   return &lpr->base.b;
 fail:
    FREE(lpr);
    return NULL;
 }
 
+/**
+ * Flag the fragment shader constants as dirty if a constant buffer bound to
+ * the fragment stage is written through a transfer.
+ *
+ * After a buffer invalidation, the threaded context maps its latest
+ * version rather than the bound resource, so compare the storage.
+ */
+static void
+llvmpipe_check_fs_constants(struct llvmpipe_context *llvmpipe,
+                            struct pipe_resource *resource)
+{
+   unsigned i;
+
+   if (resource->target != PIPE_BUFFER ||
+       !(resource->bind & PIPE_BIND_CONSTANT_BUFFER))
+      return;
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]); ++i) {
+      struct pipe_resource *buffer =
+         llvmpipe->constants[PIPE_SHADER_FRAGMENT][i].buffer;
+
+      if (buffer &&
+          llvmpipe_resource_data(buffer) == llvmpipe_resource_data(resource)) {
+         /* constants may have changed */
+         llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
+         break;
+      }
+   }
+}
+
 void *
 llvmpipe_transfer_map_ms( struct pipe_context *pipe,
                           struct pipe_resource *resource,
@@ -706,23 +753,18 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
       }
    }
 
-   /* Check if we're mapping a current constant buffer */
+   /* Check if we're mapping a current constant buffer.  Maps done by the
+    * threaded context on the application thread must not touch the context
+    * state, so those are checked when the unmap gets executed instead.
+    */
    if ((usage & PIPE_MAP_WRITE) &&
-       (resource->bind & PIPE_BIND_CONSTANT_BUFFER)) {
-      unsigned i;
-      for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]); ++i) {
-         if (resource == llvmpipe->constants[PIPE_SHADER_FRAGMENT][i].buffer) {
-            /* constants may have changed */
-            llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
-            break;
-         }
-      }
-   }
+       !(usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
+      llvmpipe_check_fs_constants(llvmpipe, resource);
 
    lpt = CALLOC_STRUCT(llvmpipe_transfer);
    if (!lpt)
       return NULL;
-   pt = &lpt->base;
+   pt = &lpt->base.b;
    pipe_resource_reference(&pt->resource, resource);
    pt->box = *box;
    pt->level = level;
@@ -754,7 +796,7 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
       printf("transfer map tex %u  mode %s\n", lpr->id, mode);
    }
 
-   format = lpr->base.format;
+   format = lpr->base.b.format;
 
    map = llvmpipe_resource_map(resource,
                                level,
@@ -796,6 +838,10 @@ llvmpipe_transfer_unmap(struct pipe_context *pipe,
 {
    assert(transfer->resource);
 
+   if ((transfer->usage & PIPE_MAP_WRITE) &&
+       (transfer->usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
+      llvmpipe_check_fs_constants(llvmpipe_context(pipe), transfer->resource);
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
@@ -809,6 +855,68 @@ llvmpipe_transfer_unmap(struct pipe_context *pipe,
    FREE(transfer);
 }
 
+/**
+ * Called by the threaded context when a buffer gets invalidated: \p dst
+ * takes over the storage of the freshly allocated \p src, and every place
+ * which cached a pointer to the old storage needs to be updated.
+ *
+ * The threaded context keeps mapping \p src directly, so it goes on
+ * pointing at the same storage, but only \p dst frees it.
+ */
+void
+llvmpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src,
+                                unsigned num_rebinds,
+                                uint32_t rebind_mask,
+                                uint32_t delete_buffer_id)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_resource *lp_dst = llvmpipe_resource(dst);
+   struct llvmpipe_resource *lp_src = llvmpipe_resource(src);
+   unsigned sh, i;
+
+   assert(!llvmpipe_resource_is_texture(dst));
+   assert(!lp_dst->user_ptr && !lp_dst->imported_memory);
+   assert(lp_dst->size_required == lp_src->size_required);
+
+   llvmpipe_flush_resource(pipe, dst, 0, FALSE, TRUE, FALSE, __FUNCTION__);
+   draw_flush(llvmpipe->draw);
+
+   align_free(lp_dst->data);
+   lp_dst->data = lp_src->data;
+   lp_src->user_ptr = true;
+
+   /* The draw module keeps mapped pointers for the vertex processing
+    * stages; everything else is looked up again through the dirty flags.
+    */
+   for (sh = 0; sh < PIPE_SHADER_TYPES; sh++) {
+      if (sh == PIPE_SHADER_FRAGMENT || sh == PIPE_SHADER_COMPUTE)
+         continue;
+
+      for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[sh]); i++) {
+         const struct pipe_constant_buffer *cb = &llvmpipe->constants[sh][i];
+         if (cb->buffer == dst)
+            draw_set_mapped_constant_buffer(llvmpipe->draw, sh, i,
+                                            (ubyte *)lp_dst->data + cb->buffer_offset,
+                                            cb->buffer_size);
+      }
+
+      for (i = 0; i < ARRAY_SIZE(llvmpipe->ssbos[sh]); i++) {
+         const struct pipe_shader_buffer *sb = &llvmpipe->ssbos[sh][i];
+         if (sb->buffer == dst)
+            draw_set_mapped_shader_buffer(llvmpipe->draw, sh, i,
+                                          (ubyte *)lp_dst->data + sb->buffer_offset,
+                                          sb->buffer_size);
+      }
+   }
+
+   llvmpipe->dirty |= LP_NEW_FS_CONSTANTS | LP_NEW_FS_SSBOS |
+                      LP_NEW_FS_IMAGES | LP_NEW_SAMPLER_VIEW;
+   llvmpipe->cs_dirty |= LP_CSNEW_CONSTANTS | LP_CSNEW_SSBOS |
+                         LP_CSNEW_IMAGES | LP_CSNEW_SAMPLER_VIEW;
+}
+
 unsigned int
 llvmpipe_is_resource_referenced( struct pipe_context *pipe,
                                  struct pipe_resource *presource,
@@ -872,20 +980,24 @@ llvmpipe_user_buffer_create(struct pipe_screen *screen,
       return NULL;
 
    buffer->screen = llvmpipe_screen(screen);
-   pipe_reference_init(&buffer->base.reference, 1);
-   buffer->base.screen = screen;
-   buffer->base.format = PIPE_FORMAT_R8_UNORM; /* ?? */
-   buffer->base.bind = bind_flags;
-   buffer->base.usage = PIPE_USAGE_IMMUTABLE;
-   buffer->base.flags = 0;
-   buffer->base.width0 = bytes;
-   buffer->base.height0 = 1;
-   buffer->base.depth0 = 1;
-   buffer->base.array_size = 1;
+   pipe_reference_init(&buffer->base.b.reference, 1);
+   buffer->base.b.screen = screen;
+   buffer->base.b.format = PIPE_FORMAT_R8_UNORM; /* ?? */
+   buffer->base.b.bind = bind_flags;
+   buffer->base.b.usage = PIPE_USAGE_IMMUTABLE;
+   buffer->base.b.flags = 0;
+   buffer->base.b.width0 = bytes;
+   buffer->base.b.height0 = 1;
+   buffer->base.b.depth0 = 1;
+   buffer->base.b.array_size = 1;
    buffer->user_ptr = true;
    buffer->data = ptr;
 
-   return &buffer->base;
+   threaded_resource_init(&buffer->base.b, false);
+   buffer->base.is_user_ptr = true;
+   util_range_add(&buffer->base.b, &buffer->base.valid_buffer_range, 0, bytes);
+
+   return &buffer->base.b;
 }
 
 
@@ -910,7 +1022,7 @@ llvmpipe_get_texture_image_address(struct llvmpipe_resource *lpr,
 {
    unsigned offset;
 
-   assert(llvmpipe_resource_is_texture(&lpr->base));
+   assert(llvmpipe_resource_is_texture(&lpr->base.b));
 
    offset = lpr->mip_offsets[level];
 
@@ -997,7 +1109,7 @@ static bool llvmpipe_resource_bind_backing(struct pipe_screen *screen,
    if (!lpr->backable)
       return FALSE;
 
-   if (llvmpipe_resource_is_texture(&lpr->base)) {
+   if (llvmpipe_resource_is_texture(&lpr->base.b)) {
       if (lpr->size_required > LP_MAX_TEXTURE_SIZE)
          return FALSE;
 
@@ -1030,11 +1142,11 @@ llvmpipe_print_resources(void)
    debug_printf("LLVMPIPE: current resources:\n");
    mtx_lock(&resource_list_mutex);
    foreach(lpr, &resource_list) {
-      unsigned size = llvmpipe_resource_size(&lpr->base);
+      unsigned size = llvmpipe_resource_size(&lpr->base.b);
       debug_printf("resource %u at %p, size %ux%ux%u: %u bytes, refcount %u\n",
                    lpr->id, (void *) lpr,
-                   lpr->base.width0, lpr->base.height0, lpr->base.depth0,
-                   size, lpr->base.reference.count);
+                   lpr->base.b.width0, lpr->base.b.height0, lpr->base.b.depth0,
+                   size, lpr->base.b.reference.count);
       total += size;
       n++;
    }
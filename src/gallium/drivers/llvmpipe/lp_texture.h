@@ -31,6 +31,7 @@
 
 #include "pipe/p_state.h"
 #include "util/u_debug.h"
+#include "util/u_threaded_context.h"
 #include "lp_limits.h"
 
 
@@ -59,7 +60,7 @@ struct sw_displaytarget;
  */
 struct llvmpipe_resource
 {
-   struct pipe_resource base;
+   struct threaded_resource base;
 
    /** an extra screen pointer to avoid crashing in driver trace */
    struct llvmpipe_screen *screen;
@@ -109,7 +110,7 @@ struct llvmpipe_resource
 
 struct llvmpipe_transfer
 {
-   struct pipe_transfer base;
+   struct threaded_transfer base;
 };
 
 struct llvmpipe_memory_object
@@ -271,4 +272,12 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
 			  unsigned sample,
 			  const struct pipe_box *box,
 			  struct pipe_transfer **transfer );
+
+void
+llvmpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src,
+                                unsigned num_rebinds,
+                                uint32_t rebind_mask,
+                                uint32_t delete_buffer_id);
 #endif /* LP_TEXTURE_H */
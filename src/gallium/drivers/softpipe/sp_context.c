@@ -342,7 +342,14 @@ softpipe_create_context(struct pipe_screen *screen,
 
    sp_init_surface_functions(softpipe);
 
-   return &softpipe->pipe;
+   if (!(flags & PIPE_CONTEXT_PREFER_THREADED) ||
+       !(sp_debug & SP_DBG_THREADED))
+      return &softpipe->pipe;
+
+   return threaded_context_create(&softpipe->pipe, &sp_screen->transfer_pool,
+                                  softpipe_replace_buffer_storage,
+                                  NULL, /* flushes stay synchronous */
+                                  NULL);
 
  fail:
    softpipe_destroy(&softpipe->pipe);
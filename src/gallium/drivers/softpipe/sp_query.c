@@ -33,11 +33,13 @@
 #include "util/os_time.h"
 #include "pipe/p_defines.h"
 #include "util/u_memory.h"
+#include "util/u_threaded_context.h"
 #include "sp_context.h"
 #include "sp_query.h"
 #include "sp_state.h"
 
 struct softpipe_query {
+   struct threaded_query b;         /* must be first */
    unsigned type;
    unsigned index;
    uint64_t start;
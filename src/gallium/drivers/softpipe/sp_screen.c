@@ -55,6 +55,7 @@ static const struct debug_named_value sp_debug_options[] = {
    {"no_rast",   SP_DBG_NO_RAST,    "no-ops rasterization, for profiling purposes"},
    {"use_llvm",  SP_DBG_USE_LLVM,   "Use LLVM if available for shaders"},
    {"use_tgsi",  SP_DBG_USE_TGSI,   "Request TGSI from the API instead of NIR"},
+   {"threaded",  SP_DBG_THREADED,   "Wrap contexts in u_threaded_context"},
    DEBUG_NAMED_VALUE_END
 };
 
@@ -493,6 +494,7 @@ softpipe_destroy_screen( struct pipe_screen *screen )
    if(winsys->destroy)
       winsys->destroy(winsys);
 
+   slab_destroy_parent(&sp_screen->transfer_pool);
    FREE(screen);
 }
 
@@ -607,6 +609,9 @@ softpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_compiler_options = softpipe_get_compiler_options;
    screen->use_llvm = sp_debug & SP_DBG_USE_LLVM;
 
+   slab_create_parent(&screen->transfer_pool,
+                      sizeof(struct softpipe_transfer), 16);
+
    softpipe_init_screen_texture_funcs(&screen->base);
    softpipe_init_screen_fence_funcs(&screen->base);
 
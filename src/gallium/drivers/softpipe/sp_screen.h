@@ -33,6 +33,7 @@
 
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
+#include "util/slab.h"
 
 
 struct sw_winsys;
@@ -47,6 +48,8 @@ struct softpipe_screen {
     */
    unsigned timestamp;
    boolean use_llvm;
+
+   struct slab_parent_pool transfer_pool;
 };
 
 static inline struct softpipe_screen *
@@ -65,6 +68,7 @@ enum sp_debug_flag {
    SP_DBG_USE_LLVM        = BITFIELD_BIT(6),
    SP_DBG_NO_RAST         = BITFIELD_BIT(7),
    SP_DBG_USE_TGSI        = BITFIELD_BIT(8),
+   SP_DBG_THREADED        = BITFIELD_BIT(9),
 };
 
 extern int sp_debug;
@@ -38,11 +38,13 @@
 #include "util/u_memory.h"
 #include "util/u_transfer.h"
 #include "util/u_surface.h"
+#include "draw/draw_context.h"
 
 #include "sp_context.h"
 #include "sp_flush.h"
 #include "sp_texture.h"
 #include "sp_screen.h"
+#include "sp_state.h"
 
 #include "frontend/sw_winsys.h"
 
@@ -56,7 +58,7 @@ softpipe_resource_layout(struct pipe_screen *screen,
                          struct softpipe_resource *spr,
                          boolean allocate)
 {
-   struct pipe_resource *pt = &spr->base;
+   struct pipe_resource *pt = &spr->base.b;
    unsigned level;
    unsigned width = pt->width0;
    unsigned height = pt->height0;
@@ -118,7 +120,7 @@ softpipe_can_create_resource(struct pipe_screen *screen,
 {
    struct softpipe_resource spr;
    memset(&spr, 0, sizeof(spr));
-   spr.base = *res;
+   spr.base.b = *res;
    return softpipe_resource_layout(screen, &spr, FALSE);
 }
 
@@ -136,10 +138,10 @@ softpipe_displaytarget_layout(struct pipe_screen *screen,
    /* Round up the surface size to a multiple of the tile size?
     */
    spr->dt = winsys->displaytarget_create(winsys,
-                                          spr->base.bind,
-                                          spr->base.format,
-                                          spr->base.width0, 
-                                          spr->base.height0,
+                                          spr->base.b.bind,
+                                          spr->base.b.format,
+                                          spr->base.b.width0, 
+                                          spr->base.b.height0,
                                           64,
                                           map_front_private,
                                           &spr->stride[0] );
@@ -162,15 +164,15 @@ softpipe_resource_create_front(struct pipe_screen *screen,
 
    assert(templat->format != PIPE_FORMAT_NONE);
 
-   spr->base = *templat;
-   pipe_reference_init(&spr->base.reference, 1);
-   spr->base.screen = screen;
+   spr->base.b = *templat;
+   pipe_reference_init(&spr->base.b.reference, 1);
+   spr->base.b.screen = screen;
 
    spr->pot = (util_is_power_of_two_or_zero(templat->width0) &&
                util_is_power_of_two_or_zero(templat->height0) &&
                util_is_power_of_two_or_zero(templat->depth0));
 
-   if (spr->base.bind & (PIPE_BIND_DISPLAY_TARGET |
+   if (spr->base.b.bind & (PIPE_BIND_DISPLAY_TARGET |
 			 PIPE_BIND_SCANOUT |
 			 PIPE_BIND_SHARED)) {
       if (!softpipe_displaytarget_layout(screen, spr, map_front_private))
@@ -180,8 +182,11 @@ softpipe_resource_create_front(struct pipe_screen *screen,
       if (!softpipe_resource_layout(screen, spr, TRUE))
          goto fail;
    }
-    
-   return &spr->base;
+
+   threaded_resource_init(&spr->base.b, false);
+   spr->base.is_shared = spr->dt != NULL;
+
+   return &spr->base.b;
 
  fail:
    FREE(spr);
@@ -212,6 +217,7 @@ softpipe_resource_destroy(struct pipe_screen *pscreen,
       align_free(spr->data);
    }
 
+   threaded_resource_deinit(pt);
    FREE(spr);
 }
 
@@ -227,9 +233,9 @@ softpipe_resource_from_handle(struct pipe_screen *screen,
    if (!spr)
       return NULL;
 
-   spr->base = *templat;
-   pipe_reference_init(&spr->base.reference, 1);
-   spr->base.screen = screen;
+   spr->base.b = *templat;
+   pipe_reference_init(&spr->base.b.reference, 1);
+   spr->base.b.screen = screen;
 
    spr->pot = (util_is_power_of_two_or_zero(templat->width0) &&
                util_is_power_of_two_or_zero(templat->height0) &&
@@ -242,7 +248,10 @@ softpipe_resource_from_handle(struct pipe_screen *screen,
    if (!spr->dt)
       goto fail;
 
-   return &spr->base;
+   threaded_resource_init(&spr->base.b, false);
+   spr->base.is_shared = true;
+
+   return &spr->base.b;
 
  fail:
    FREE(spr);
@@ -415,7 +424,7 @@ softpipe_transfer_map(struct pipe_context *pipe,
    if (!spt)
       return NULL;
 
-   pt = &spt->base;
+   pt = &spt->base.b;
 
    pipe_resource_reference(&pt->resource, resource);
    pt->level = level;
@@ -427,7 +436,7 @@ softpipe_transfer_map(struct pipe_context *pipe,
    spt->offset = softpipe_get_tex_image_offset(spr, level, box->z);
 
    spt->offset +=
-         box->y / util_format_get_blockheight(format) * spt->base.stride +
+         box->y / util_format_get_blockheight(format) * spt->base.b.stride +
          box->x / util_format_get_blockwidth(format) * util_format_get_blocksize(format);
 
    /* resources backed by display target treated specially:
@@ -477,6 +486,62 @@ softpipe_transfer_unmap(struct pipe_context *pipe,
    FREE(transfer);
 }
 
+/**
+ * Called by the threaded context when a buffer gets invalidated: \p dst
+ * takes over the storage of the freshly allocated \p src, which keeps
+ * pointing at it for the threaded context's direct maps without owning it.
+ * Only constant buffers keep a pointer into the storage around, everything
+ * else looks the data up again at draw time.
+ */
+void
+softpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src,
+                                unsigned num_rebinds,
+                                uint32_t rebind_mask,
+                                uint32_t delete_buffer_id)
+{
+   struct softpipe_context *softpipe = softpipe_context(pipe);
+   struct softpipe_resource *sp_dst = softpipe_resource(dst);
+   struct softpipe_resource *sp_src = softpipe_resource(src);
+   void *old_data = sp_dst->data;
+   unsigned sh, i;
+
+   assert(dst->target == PIPE_BUFFER);
+   assert(!sp_dst->userBuffer);
+
+   softpipe_flush_resource(pipe, dst, 0, -1, 0, FALSE, TRUE, FALSE);
+   draw_flush(softpipe->draw);
+
+   sp_dst->data = sp_src->data;
+   sp_src->userBuffer = TRUE;
+
+   for (sh = 0; sh < PIPE_SHADER_TYPES; sh++) {
+      for (i = 0; i < PIPE_MAX_CONSTANT_BUFFERS; i++) {
+         const void *data;
+
+         if (softpipe->constants[sh][i] != dst)
+            continue;
+
+         data = (const char *) sp_dst->data +
+                ((const char *) softpipe->mapped_constants[sh][i] -
+                 (const char *) old_data);
+         softpipe->mapped_constants[sh][i] = data;
+
+         if (sh == PIPE_SHADER_VERTEX || sh == PIPE_SHADER_GEOMETRY)
+            draw_set_mapped_constant_buffer(softpipe->draw, sh, i, data,
+                                            softpipe->const_buffer_size[sh][i]);
+      }
+   }
+
+   align_free(old_data);
+
+   /* Expire any texture tiles cached from the old storage. */
+   sp_dst->timestamp++;
+   softpipe->dirty |= SP_NEW_CONSTANTS | SP_NEW_TEXTURE;
+}
+
+
 /**
  * Create buffer which wraps user-space data.
  */
@@ -492,20 +557,24 @@ softpipe_user_buffer_create(struct pipe_screen *screen,
    if (!spr)
       return NULL;
 
-   pipe_reference_init(&spr->base.reference, 1);
-   spr->base.screen = screen;
-   spr->base.format = PIPE_FORMAT_R8_UNORM; /* ?? */
-   spr->base.bind = bind_flags;
-   spr->base.usage = PIPE_USAGE_IMMUTABLE;
-   spr->base.flags = 0;
-   spr->base.width0 = bytes;
-   spr->base.height0 = 1;
-   spr->base.depth0 = 1;
-   spr->base.array_size = 1;
+   pipe_reference_init(&spr->base.b.reference, 1);
+   spr->base.b.screen = screen;
+   spr->base.b.format = PIPE_FORMAT_R8_UNORM; /* ?? */
+   spr->base.b.bind = bind_flags;
+   spr->base.b.usage = PIPE_USAGE_IMMUTABLE;
+   spr->base.b.flags = 0;
+   spr->base.b.width0 = bytes;
+   spr->base.b.height0 = 1;
+   spr->base.b.depth0 = 1;
+   spr->base.b.array_size = 1;
    spr->userBuffer = TRUE;
    spr->data = ptr;
 
-   return &spr->base;
+   threaded_resource_init(&spr->base.b, false);
+   spr->base.is_user_ptr = true;
+   util_range_add(&spr->base.b, &spr->base.valid_buffer_range, 0, bytes);
+
+   return &spr->base.b;
 }
 
 
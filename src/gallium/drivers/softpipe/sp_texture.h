@@ -30,6 +30,7 @@
 
 
 #include "pipe/p_state.h"
+#include "util/u_threaded_context.h"
 #include "sp_limits.h"
 
 
@@ -43,7 +44,7 @@ struct softpipe_context;
  */
 struct softpipe_resource
 {
-   struct pipe_resource base;
+   struct threaded_resource base;
 
    unsigned long level_offset[SP_MAX_TEXTURE_2D_LEVELS];
    unsigned stride[SP_MAX_TEXTURE_2D_LEVELS];
@@ -74,7 +75,7 @@ struct softpipe_resource
  */
 struct softpipe_transfer
 {
-   struct pipe_transfer base;
+   struct threaded_transfer base;
 
    unsigned long offset;
 };
@@ -119,4 +120,12 @@ softpipe_init_texture_funcs(struct pipe_context *pipe);
 unsigned
 softpipe_get_tex_image_offset(const struct softpipe_resource *spr,
                               unsigned level, unsigned layer);
+
+void
+softpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src,
+                                unsigned num_rebinds,
+                                uint32_t rebind_mask,
+                                uint32_t delete_buffer_id);
 #endif /* SP_TEXTURE */
@@ -25,6 +25,7 @@
 #include "vk_descriptors.h"
 #include "vk_util.h"
 #include "u_math.h"
+#include "util/u_inlines.h"
 
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDescriptorSetLayout(
     VkDevice                                    _device,
@@ -361,6 +362,172 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyPipelineLayout(
    lvp_pipeline_layout_unref(device, pipeline_layout);
 }
 
+/* Points the per-stage tables of set into mem and returns their total size.
+ * With a NULL set this only computes the size.
+ */
+static size_t
+layout_descriptor_tables(const struct lvp_descriptor_set_layout *layout,
+                         struct lvp_descriptor_set *set, uint8_t *mem)
+{
+   size_t offset = 0;
+
+#define TABLE_ARRAY(field, count) do {                                  \
+      if (set)                                                          \
+         set->tables[s].field = (void *)(mem + offset);                 \
+      offset += align((count) * sizeof(*set->tables[s].field), 8);      \
+   } while (0)
+
+   for (unsigned s = 0; s < MESA_SHADER_STAGES; s++) {
+      TABLE_ARRAY(const_buffers, layout->stage[s].const_buffer_count);
+      TABLE_ARRAY(shader_buffers, layout->stage[s].shader_buffer_count);
+      TABLE_ARRAY(sampler_views, layout->stage[s].sampler_view_count);
+      TABLE_ARRAY(images, layout->stage[s].image_count);
+      TABLE_ARRAY(samplers, layout->stage[s].sampler_count);
+      TABLE_ARRAY(uniform_blocks, layout->stage[s].uniform_block_count);
+   }
+
+#undef TABLE_ARRAY
+
+   return offset;
+}
+
+static void
+bake_buffer(const union lvp_descriptor_info *info,
+            struct pipe_resource **buffer,
+            unsigned *buffer_offset, unsigned *buffer_size)
+{
+   if (!info->buffer) {
+      *buffer = NULL;
+      *buffer_offset = *buffer_size = 0;
+      return;
+   }
+
+   *buffer = info->buffer->bo;
+   *buffer_offset = info->offset + info->buffer->offset;
+   if (info->range == VK_WHOLE_SIZE)
+      *buffer_size = info->buffer->bo->width0 - *buffer_offset;
+   else
+      *buffer_size = info->range;
+}
+
+/* Translates one descriptor into the gallium tables of every stage that
+ * can see it.
+ */
+static void
+bake_descriptor(struct lvp_descriptor_set *set,
+                const struct lvp_descriptor_set_binding_layout *binding,
+                uint32_t array_idx)
+{
+   const union lvp_descriptor_info *info =
+      &set->descriptors[binding->descriptor_index + array_idx].info;
+
+   lvp_foreach_stage(s, set->layout->shader_stages) {
+      struct lvp_descriptor_table *table = &set->tables[s];
+      int idx;
+
+      switch (binding->type) {
+      case VK_DESCRIPTOR_TYPE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: {
+         idx = binding->stage[s].sampler_index;
+         if (idx == -1)
+            break;
+         const struct lvp_sampler *sampler = binding->immutable_samplers ?
+            binding->immutable_samplers[array_idx] : info->sampler;
+         if (sampler)
+            table->samplers[idx + array_idx] = sampler->pstate;
+         else
+            memset(&table->samplers[idx + array_idx], 0, sizeof(struct pipe_sampler_state));
+         break;
+      }
+      default:
+         break;
+      }
+
+      switch (binding->type) {
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+         idx = binding->stage[s].sampler_view_index;
+         if (idx == -1)
+            break;
+         pipe_sampler_view_reference(&table->sampler_views[idx + array_idx],
+                                     info->iview ? info->iview->sv : NULL);
+         break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+         idx = binding->stage[s].sampler_view_index;
+         if (idx == -1)
+            break;
+         pipe_sampler_view_reference(&table->sampler_views[idx + array_idx],
+                                     info->buffer_view ? info->buffer_view->sv : NULL);
+         break;
+      case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+         idx = binding->stage[s].image_index;
+         if (idx == -1)
+            break;
+         if (info->iview)
+            table->images[idx + array_idx] = info->iview->iv;
+         else
+            memset(&table->images[idx + array_idx], 0, sizeof(struct pipe_image_view));
+         break;
+      case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+         idx = binding->stage[s].image_index;
+         if (idx == -1)
+            break;
+         if (info->buffer_view)
+            table->images[idx + array_idx] = info->buffer_view->iv;
+         else
+            memset(&table->images[idx + array_idx], 0, sizeof(struct pipe_image_view));
+         break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC: {
+         idx = binding->stage[s].const_buffer_index;
+         if (idx == -1)
+            break;
+         struct pipe_constant_buffer *cb = &table->const_buffers[idx + array_idx];
+         bake_buffer(info, &cb->buffer, &cb->buffer_offset, &cb->buffer_size);
+         cb->user_buffer = NULL;
+         break;
+      }
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: {
+         idx = binding->stage[s].shader_buffer_index;
+         if (idx == -1)
+            break;
+         struct pipe_shader_buffer *sb = &table->shader_buffers[idx + array_idx];
+         bake_buffer(info, &sb->buffer, &sb->buffer_offset, &sb->buffer_size);
+         break;
+      }
+      default:
+         break;
+      }
+   }
+}
+
+/* Re-translates count descriptors starting at binding_idx/array_elem,
+ * following the rules for updates that run past the end of a binding.
+ */
+static void
+bake_descriptors(struct lvp_descriptor_set *set, uint32_t binding_idx,
+                 uint32_t array_elem, uint32_t count)
+{
+   const struct lvp_descriptor_set_layout *layout = set->layout;
+
+   while (count && binding_idx < layout->binding_count) {
+      const struct lvp_descriptor_set_binding_layout *binding =
+         &layout->binding[binding_idx];
+
+      if (!binding->valid || array_elem >= binding->array_size) {
+         binding_idx++;
+         array_elem = 0;
+         continue;
+      }
+
+      bake_descriptor(set, binding, array_elem);
+      array_elem++;
+      count--;
+   }
+}
+
 VkResult
 lvp_descriptor_set_create(struct lvp_device *device,
                           struct lvp_descriptor_set_layout *layout,
@@ -368,7 +535,8 @@ lvp_descriptor_set_create(struct lvp_device *device,
 {
    struct lvp_descriptor_set *set;
    size_t base_size = sizeof(*set) + layout->size * sizeof(set->descriptors[0]);
-   size_t size = base_size;
+   size_t tables_size = layout_descriptor_tables(layout, NULL, NULL);
+   size_t size = base_size + tables_size;
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
       size += layout->stage[i].uniform_block_size;
    set = vk_alloc(&device->vk.alloc /* XXX: Use the pool */, size, 8,
@@ -385,19 +553,26 @@ lvp_descriptor_set_create(struct lvp_device *device,
                        VK_OBJECT_TYPE_DESCRIPTOR_SET);
    set->layout = layout;
    lvp_descriptor_set_layout_ref(layout);
+   layout_descriptor_tables(layout, set, (uint8_t*)(set) + base_size);
 
    /* Go through and fill out immutable samplers if we have any */
    struct lvp_descriptor *desc = set->descriptors;
-   uint8_t *uniform_mem = (uint8_t*)(set) + base_size;
+   uint8_t *uniform_mem = (uint8_t*)(set) + base_size + tables_size;
    for (uint32_t b = 0; b < layout->binding_count; b++) {
       if (layout->binding[b].type == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK) {
          desc->info.uniform = uniform_mem;
+         lvp_foreach_stage(s, layout->shader_stages) {
+            int idx = layout->binding[b].stage[s].uniform_block_index;
+            if (idx != -1)
+               set->tables[s].uniform_blocks[idx] = uniform_mem;
+         }
          uniform_mem += layout->binding[b].array_size;
          desc++;
       } else {
          if (layout->binding[b].immutable_samplers) {
             for (uint32_t i = 0; i < layout->binding[b].array_size; i++)
                desc[i].info.sampler = layout->binding[b].immutable_samplers[i];
+            bake_descriptors(set, b, 0, layout->binding[b].array_size);
          }
          desc += layout->binding[b].array_size;
       }
@@ -412,6 +587,10 @@ void
 lvp_descriptor_set_destroy(struct lvp_device *device,
                            struct lvp_descriptor_set *set)
 {
+   for (unsigned s = 0; s < MESA_SHADER_STAGES; s++) {
+      for (unsigned i = 0; i < set->layout->stage[s].sampler_view_count; i++)
+         pipe_sampler_view_reference(&set->tables[s].sampler_views[i], NULL);
+   }
    lvp_descriptor_set_layout_unref(device, set->layout);
    vk_object_base_finish(&set->base);
    vk_free(&device->vk.alloc, set);
@@ -572,6 +751,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_UpdateDescriptorSets(
       default:
          break;
       }
+
+      bake_descriptors(set, write->dstBinding, write->dstArrayElement,
+                       write->descriptorCount);
    }
 
    for (uint32_t i = 0; i < descriptorCopyCount; i++) {
@@ -600,6 +782,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_UpdateDescriptorSets(
 
          for (uint32_t j = 0; j < copy->descriptorCount; j++)
             dst_desc[j] = src_desc[j];
+
+         bake_descriptors(dst, copy->dstBinding, copy->dstArrayElement,
+                          copy->descriptorCount);
       }
    }
 }
@@ -631,9 +816,8 @@ static void lvp_reset_descriptor_pool(struct lvp_device *device,
 {
    struct lvp_descriptor_set *set, *tmp;
    LIST_FOR_EACH_ENTRY_SAFE(set, tmp, &pool->sets, link) {
-      lvp_descriptor_set_layout_unref(device, set->layout);
       list_del(&set->link);
-      vk_free(&device->vk.alloc, set);
+      lvp_descriptor_set_destroy(device, set);
    }
 }
 
@@ -806,5 +990,8 @@ VKAPI_ATTR void VKAPI_CALL lvp_UpdateDescriptorSetWithTemplate(VkDevice _device,
          }
          pSrc += entry->stride;
       }
+
+      bake_descriptors(set, entry->dstBinding, entry->dstArrayElement,
+                       entry->descriptorCount);
    }
 }
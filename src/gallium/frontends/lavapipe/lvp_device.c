@@ -22,6 +22,7 @@
  */
 
 #include "lvp_private.h"
+#include "lvp_conv.h"
 
 #include "pipe-loader/pipe_loader.h"
 #include "git_sha1.h"
@@ -37,6 +38,7 @@
 #include "util/os_memory.h"
 #include "util/u_thread.h"
 #include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/timespec.h"
 #include "util/ptralloc.h"
 #include "os_time.h"
@@ -1280,7 +1282,17 @@ VKAPI_ATTR void VKAPI_CALL lvp_GetPhysicalDeviceQueueFamilyProperties2(
          .queueFlags = VK_QUEUE_GRAPHICS_BIT |
          VK_QUEUE_COMPUTE_BIT |
          VK_QUEUE_TRANSFER_BIT,
-         .queueCount = 1,
+         .queueCount = LVP_MAX_QUEUES_PER_FAMILY,
+         .timestampValidBits = 64,
+         .minImageTransferGranularity = (VkExtent3D) { 1, 1, 1 },
+      };
+   }
+
+   vk_outarray_append_typed(VkQueueFamilyProperties2, &out, p) {
+      p->queueFamilyProperties = (VkQueueFamilyProperties) {
+         .queueFlags = VK_QUEUE_COMPUTE_BIT |
+         VK_QUEUE_TRANSFER_BIT,
+         .queueCount = LVP_MAX_QUEUES_PER_FAMILY,
          .timestampValidBits = 64,
          .minImageTransferGranularity = (VkExtent3D) { 1, 1, 1 },
       };
@@ -1390,6 +1402,7 @@ lvp_queue_submit(struct vk_queue *vk_queue,
    if (result != VK_SUCCESS)
       return result;
 
+   simple_mtx_lock(&queue->lock);
    for (uint32_t i = 0; i < submit->command_buffer_count; i++) {
       struct lvp_cmd_buffer *cmd_buffer =
          container_of(submit->command_buffers[i], struct lvp_cmd_buffer, vk);
@@ -1399,6 +1412,7 @@ lvp_queue_submit(struct vk_queue *vk_queue,
 
    if (submit->command_buffer_count > 0)
       queue->ctx->flush(queue->ctx, &queue->last_fence, 0);
+   simple_mtx_unlock(&queue->lock);
 
    for (uint32_t i = 0; i < submit->signal_count; i++) {
       struct lvp_pipe_sync *sync =
@@ -1419,14 +1433,24 @@ lvp_queue_init(struct lvp_device *device, struct lvp_queue *queue,
    if (result != VK_SUCCESS)
       return result;
 
+   queue->state = vk_alloc(&device->vk.alloc, lvp_get_rendering_state_size(), 8,
+                           VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+   if (!queue->state) {
+      vk_queue_finish(&queue->vk);
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
    result = vk_queue_enable_submit_thread(&queue->vk);
    if (result != VK_SUCCESS) {
+      vk_free(&device->vk.alloc, queue->state);
       vk_queue_finish(&queue->vk);
       return result;
    }
 
    queue->device = device;
+   queue->index = queue - device->queues;
 
+   simple_mtx_init(&queue->lock, mtx_plain);
    queue->ctx = device->pscreen->context_create(device->pscreen, NULL, PIPE_CONTEXT_ROBUST_BUFFER_ACCESS);
    queue->cso = cso_create_context(queue->ctx, CSO_NO_VBUF);
    queue->uploader = u_upload_create(queue->ctx, 1024 * 1024, PIPE_BIND_CONSTANT_BUFFER, PIPE_USAGE_STREAM, 0);
@@ -1439,9 +1463,13 @@ lvp_queue_init(struct lvp_device *device, struct lvp_queue *queue,
 static void
 lvp_queue_finish(struct lvp_queue *queue)
 {
+   if (queue->last_fence)
+      queue->device->pscreen->fence_reference(queue->device->pscreen, &queue->last_fence, NULL);
    u_upload_destroy(queue->uploader);
    cso_destroy_context(queue->cso);
    queue->ctx->destroy(queue->ctx);
+   simple_mtx_destroy(&queue->lock);
+   vk_free(&queue->device->vk.alloc, queue->state);
 
    vk_queue_finish(&queue->vk);
 }
@@ -1477,14 +1505,12 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO);
 
-   size_t state_size = lvp_get_rendering_state_size();
    device = vk_zalloc2(&physical_device->vk.instance->alloc, pAllocator,
-                       sizeof(*device) + state_size, 8,
+                       sizeof(*device), 8,
                        VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
    if (!device)
       return vk_error(instance, VK_ERROR_OUT_OF_HOST_MEMORY);
 
-   device->queue.state = device + 1;
    device->poison_mem = debug_get_bool_option("LVP_POISON_MEMORY", false);
 
    struct vk_device_dispatch_table dispatch_table;
@@ -1504,6 +1530,13 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    vk_device_enable_threaded_submit(&device->vk);
 
+   result = vk_device_enable_spirv_nir_cache(&device->vk);
+   if (result != VK_SUCCESS) {
+      vk_device_finish(&device->vk);
+      vk_free(&device->vk.alloc, device);
+      return result;
+   }
+
    device->instance = (struct lvp_instance *)physical_device->vk.instance;
    device->physical_device = physical_device;
 
@@ -1512,10 +1545,47 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    device->pscreen = physical_device->pscreen;
 
-   assert(pCreateInfo->queueCreateInfoCount == 1);
-   assert(pCreateInfo->pQueueCreateInfos[0].queueFamilyIndex == 0);
-   assert(pCreateInfo->pQueueCreateInfos[0].queueCount == 1);
-   lvp_queue_init(device, &device->queue, pCreateInfo->pQueueCreateInfos, 0);
+   uint32_t queue_count = 0;
+   for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++) {
+      assert(pCreateInfo->pQueueCreateInfos[i].queueFamilyIndex < LVP_QUEUE_FAMILY_COUNT);
+      assert(pCreateInfo->pQueueCreateInfos[i].queueCount <= LVP_MAX_QUEUES_PER_FAMILY);
+      queue_count += pCreateInfo->pQueueCreateInfos[i].queueCount;
+   }
+   assert(queue_count > 0 && queue_count <= LVP_MAX_QUEUES);
+
+   device->queues = vk_zalloc(&device->vk.alloc,
+                              queue_count * sizeof(*device->queues), 8,
+                              VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+   if (!device->queues) {
+      vk_device_finish(&device->vk);
+      vk_free(&device->vk.alloc, device);
+      return vk_error(instance, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
+   for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++) {
+      const VkDeviceQueueCreateInfo *queue_create = &pCreateInfo->pQueueCreateInfos[i];
+      for (uint32_t q = 0; q < queue_create->queueCount; q++) {
+         result = lvp_queue_init(device, &device->queues[device->queue_count],
+                                 queue_create, q);
+         if (result != VK_SUCCESS) {
+            for (uint32_t j = 0; j < device->queue_count; j++)
+               lvp_queue_finish(&device->queues[j]);
+            vk_free(&device->vk.alloc, device->queues);
+            vk_device_finish(&device->vk);
+            vk_free(&device->vk.alloc, device);
+            return result;
+         }
+         device->queue_count++;
+      }
+   }
+
+   unsigned pipeline_threads =
+      debug_get_num_option("LVP_PIPELINE_THREADS", util_get_cpu_caps()->nr_cpus);
+   if (pipeline_threads > 1)
+      util_queue_init(&device->pipeline_queue, "lvp_pipe", 64,
+                      pipeline_threads,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_SCALE_THREADS, NULL);
 
    *pDevice = lvp_device_to_handle(device);
 
@@ -1529,9 +1599,11 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
 {
    LVP_FROM_HANDLE(lvp_device, device, _device);
 
-   if (device->queue.last_fence)
-      device->pscreen->fence_reference(device->pscreen, &device->queue.last_fence, NULL);
-   lvp_queue_finish(&device->queue);
+   if (util_queue_is_initialized(&device->pipeline_queue))
+      util_queue_destroy(&device->pipeline_queue);
+   for (uint32_t i = 0; i < device->queue_count; i++)
+      lvp_queue_finish(&device->queues[i]);
+   vk_free(&device->vk.alloc, device->queues);
    vk_device_finish(&device->vk);
    vk_free(&device->vk.alloc, device);
 }
@@ -2162,6 +2234,29 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateSampler(
    if (reduction_mode_create_info)
       sampler->reduction_mode = reduction_mode_create_info->reductionMode;
 
+   struct pipe_sampler_state *ss = &sampler->pstate;
+   memset(ss, 0, sizeof(*ss));
+   ss->wrap_s = vk_conv_wrap_mode(pCreateInfo->addressModeU);
+   ss->wrap_t = vk_conv_wrap_mode(pCreateInfo->addressModeV);
+   ss->wrap_r = vk_conv_wrap_mode(pCreateInfo->addressModeW);
+   ss->min_img_filter = pCreateInfo->minFilter == VK_FILTER_LINEAR ? PIPE_TEX_FILTER_LINEAR : PIPE_TEX_FILTER_NEAREST;
+   ss->min_mip_filter = pCreateInfo->mipmapMode == VK_SAMPLER_MIPMAP_MODE_LINEAR ? PIPE_TEX_MIPFILTER_LINEAR : PIPE_TEX_MIPFILTER_NEAREST;
+   ss->mag_img_filter = pCreateInfo->magFilter == VK_FILTER_LINEAR ? PIPE_TEX_FILTER_LINEAR : PIPE_TEX_FILTER_NEAREST;
+   ss->min_lod = pCreateInfo->minLod;
+   ss->max_lod = pCreateInfo->maxLod;
+   ss->lod_bias = pCreateInfo->mipLodBias;
+   if (pCreateInfo->anisotropyEnable)
+      ss->max_anisotropy = pCreateInfo->maxAnisotropy;
+   else
+      ss->max_anisotropy = 1;
+   ss->normalized_coords = !pCreateInfo->unnormalizedCoordinates;
+   ss->compare_mode = pCreateInfo->compareEnable ? PIPE_TEX_COMPARE_R_TO_TEXTURE : PIPE_TEX_COMPARE_NONE;
+   ss->compare_func = pCreateInfo->compareOp;
+   ss->seamless_cube_map = true;
+   ss->reduction_mode = sampler->reduction_mode;
+   memcpy(&ss->border_color, &sampler->border_color,
+          sizeof(union pipe_color_union));
+
    *pSampler = lvp_sampler_to_handle(sampler);
 
    return VK_SUCCESS;
@@ -67,6 +67,7 @@ struct lvp_render_attachment {
 };
 
 struct rendering_state {
+   struct lvp_queue *queue;
    struct pipe_context *pctx;
    struct u_upload_mgr *uploader;
    struct cso_context *cso;
@@ -160,6 +161,12 @@ struct rendering_state {
       uint16_t count;
    } uniform_blocks[PIPE_SHADER_TYPES];
 
+   /* descriptor sets whose tables were last copied into the slots above */
+   struct {
+      const struct lvp_pipeline_layout *layout;
+      const struct lvp_descriptor_set *sets[MAX_SETS];
+   } bound_sets[2]; //gfx, compute
+
    VkRect2D render_area;
    bool suspending;
    uint32_t color_att_count;
@@ -447,7 +454,7 @@ static void handle_compute_pipeline(struct vk_cmd_queue_entry *cmd,
    state->dispatch_info.block[0] = pipeline->pipeline_nir[MESA_SHADER_COMPUTE]->info.workgroup_size[0];
    state->dispatch_info.block[1] = pipeline->pipeline_nir[MESA_SHADER_COMPUTE]->info.workgroup_size[1];
    state->dispatch_info.block[2] = pipeline->pipeline_nir[MESA_SHADER_COMPUTE]->info.workgroup_size[2];
-   state->pctx->bind_compute_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_COMPUTE]);
+   state->pctx->bind_compute_state(state->pctx, lvp_pipeline_get_shader_cso(pipeline, state->queue, PIPE_SHADER_COMPUTE));
 }
 
 static void
@@ -597,24 +604,24 @@ static void handle_graphics_pipeline(struct vk_cmd_queue_entry *cmd,
          const VkPipelineShaderStageCreateInfo *sh = &pipeline->graphics_create_info.pStages[i];
          switch (sh->stage) {
          case VK_SHADER_STAGE_FRAGMENT_BIT:
-            state->pctx->bind_fs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_FRAGMENT]);
+            state->pctx->bind_fs_state(state->pctx, lvp_pipeline_get_shader_cso(pipeline, state->queue, PIPE_SHADER_FRAGMENT));
             has_stage[PIPE_SHADER_FRAGMENT] = true;
             break;
          case VK_SHADER_STAGE_VERTEX_BIT:
-            state->pctx->bind_vs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_VERTEX]);
+            state->pctx->bind_vs_state(state->pctx, lvp_pipeline_get_shader_cso(pipeline, state->queue, PIPE_SHADER_VERTEX));
             has_stage[PIPE_SHADER_VERTEX] = true;
             break;
          case VK_SHADER_STAGE_GEOMETRY_BIT:
-            state->pctx->bind_gs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_GEOMETRY]);
+            state->pctx->bind_gs_state(state->pctx, lvp_pipeline_get_shader_cso(pipeline, state->queue, PIPE_SHADER_GEOMETRY));
             state->gs_output_lines = pipeline->gs_output_lines ? GS_OUTPUT_LINES : GS_OUTPUT_NOT_LINES;
             has_stage[PIPE_SHADER_GEOMETRY] = true;
             break;
          case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
-            state->pctx->bind_tcs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_TESS_CTRL]);
+            state->pctx->bind_tcs_state(state->pctx, lvp_pipeline_get_shader_cso(pipeline, state->queue, PIPE_SHADER_TESS_CTRL));
             has_stage[PIPE_SHADER_TESS_CTRL] = true;
             break;
          case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
-            state->pctx->bind_tes_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_TESS_EVAL]);
+            state->pctx->bind_tes_state(state->pctx, lvp_pipeline_get_shader_cso(pipeline, state->queue, PIPE_SHADER_TESS_EVAL));
             has_stage[PIPE_SHADER_TESS_EVAL] = true;
             break;
          default:
@@ -626,7 +633,7 @@ static void handle_graphics_pipeline(struct vk_cmd_queue_entry *cmd,
 
    /* there should always be a dummy fs. */
    if (!has_stage[PIPE_SHADER_FRAGMENT])
-      state->pctx->bind_fs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_FRAGMENT]);
+      state->pctx->bind_fs_state(state->pctx, lvp_pipeline_get_shader_cso(pipeline, state->queue, PIPE_SHADER_FRAGMENT));
    if (state->pctx->bind_gs_state && !has_stage[PIPE_SHADER_GEOMETRY])
       state->pctx->bind_gs_state(state->pctx, NULL);
    if (state->pctx->bind_tcs_state && !has_stage[PIPE_SHADER_TESS_CTRL])
@@ -1029,29 +1036,20 @@ struct dyn_info {
    uint32_t dynamic_offset_count;
 };
 
-static void fill_sampler(struct pipe_sampler_state *ss,
-                         struct lvp_sampler *samp)
-{
-   ss->wrap_s = vk_conv_wrap_mode(samp->create_info.addressModeU);
-   ss->wrap_t = vk_conv_wrap_mode(samp->create_info.addressModeV);
-   ss->wrap_r = vk_conv_wrap_mode(samp->create_info.addressModeW);
-   ss->min_img_filter = samp->create_info.minFilter == VK_FILTER_LINEAR ? PIPE_TEX_FILTER_LINEAR : PIPE_TEX_FILTER_NEAREST;
-   ss->min_mip_filter = samp->create_info.mipmapMode == VK_SAMPLER_MIPMAP_MODE_LINEAR ? PIPE_TEX_MIPFILTER_LINEAR : PIPE_TEX_MIPFILTER_NEAREST;
-   ss->mag_img_filter = samp->create_info.magFilter == VK_FILTER_LINEAR ? PIPE_TEX_FILTER_LINEAR : PIPE_TEX_FILTER_NEAREST;
-   ss->min_lod = samp->create_info.minLod;
-   ss->max_lod = samp->create_info.maxLod;
-   ss->lod_bias = samp->create_info.mipLodBias;
-   if (samp->create_info.anisotropyEnable)
-      ss->max_anisotropy = samp->create_info.maxAnisotropy;
-   else
-      ss->max_anisotropy = 1;
-   ss->normalized_coords = !samp->create_info.unnormalizedCoordinates;
-   ss->compare_mode = samp->create_info.compareEnable ? PIPE_TEX_COMPARE_R_TO_TEXTURE : PIPE_TEX_COMPARE_NONE;
-   ss->compare_func = samp->create_info.compareOp;
-   ss->seamless_cube_map = true;
-   ss->reduction_mode = samp->reduction_mode;
-   memcpy(&ss->border_color, &samp->border_color,
-          sizeof(union pipe_color_union));
+/* Descriptor views are created on the first queue's context, other queues
+ * get their own copy.
+ */
+static void bind_sampler_view(struct rendering_state *state,
+                              struct pipe_sampler_view **dst,
+                              struct pipe_sampler_view *sv)
+{
+   if (likely(!sv || sv->context == state->pctx)) {
+      pipe_sampler_view_reference(dst, sv);
+      return;
+   }
+
+   pipe_sampler_view_reference(dst, NULL);
+   *dst = state->pctx->create_sampler_view(state->pctx, sv->texture, sv);
 }
 
 static void fill_sampler_stage(struct rendering_state *state,
@@ -1067,21 +1065,13 @@ static void fill_sampler_stage(struct rendering_state *state,
       return;
    ss_idx += array_idx;
    ss_idx += dyn_info->stage[stage].sampler_count;
-   fill_sampler(&state->ss[p_stage][ss_idx], binding->immutable_samplers ? binding->immutable_samplers[array_idx] : descriptor->sampler);
+   state->ss[p_stage][ss_idx] = binding->immutable_samplers ?
+      binding->immutable_samplers[array_idx]->pstate : descriptor->sampler->pstate;
    if (state->num_sampler_states[p_stage] <= ss_idx)
       state->num_sampler_states[p_stage] = ss_idx + 1;
    state->ss_dirty[p_stage] = true;
 }
 
-#define fix_depth_swizzle(x) do { \
-  if (x > PIPE_SWIZZLE_X && x < PIPE_SWIZZLE_0) \
-    x = PIPE_SWIZZLE_0;				\
-  } while (0)
-#define fix_depth_swizzle_a(x) do { \
-  if (x > PIPE_SWIZZLE_X && x < PIPE_SWIZZLE_0) \
-    x = PIPE_SWIZZLE_1;				\
-  } while (0)
-
 static void fill_sampler_view_stage(struct rendering_state *state,
                                     struct dyn_info *dyn_info,
                                     gl_shader_stage stage,
@@ -1095,53 +1085,7 @@ static void fill_sampler_view_stage(struct rendering_state *state,
       return;
    sv_idx += array_idx;
    sv_idx += dyn_info->stage[stage].sampler_view_count;
-   struct lvp_image_view *iv = descriptor->iview;
-   struct pipe_sampler_view templ;
-
-   enum pipe_format pformat;
-   if (iv->vk.aspects == VK_IMAGE_ASPECT_DEPTH_BIT)
-      pformat = lvp_vk_format_to_pipe_format(iv->vk.format);
-   else if (iv->vk.aspects == VK_IMAGE_ASPECT_STENCIL_BIT)
-      pformat = util_format_stencil_only(lvp_vk_format_to_pipe_format(iv->vk.format));
-   else
-      pformat = lvp_vk_format_to_pipe_format(iv->vk.format);
-   u_sampler_view_default_template(&templ,
-                                   iv->image->bo,
-                                   pformat);
-   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_1D)
-      templ.target = PIPE_TEXTURE_1D;
-   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_2D)
-      templ.target = PIPE_TEXTURE_2D;
-   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_CUBE)
-      templ.target = PIPE_TEXTURE_CUBE;
-   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY)
-      templ.target = PIPE_TEXTURE_CUBE_ARRAY;
-   templ.u.tex.first_layer = iv->vk.base_array_layer;
-   templ.u.tex.last_layer = iv->vk.base_array_layer + iv->vk.layer_count - 1;
-   templ.u.tex.first_level = iv->vk.base_mip_level;
-   templ.u.tex.last_level = iv->vk.base_mip_level + iv->vk.level_count - 1;
-   templ.swizzle_r = vk_conv_swizzle(iv->vk.swizzle.r);
-   templ.swizzle_g = vk_conv_swizzle(iv->vk.swizzle.g);
-   templ.swizzle_b = vk_conv_swizzle(iv->vk.swizzle.b);
-   templ.swizzle_a = vk_conv_swizzle(iv->vk.swizzle.a);
-
-   /* depth stencil swizzles need special handling to pass VK CTS
-    * but also for zink GL tests.
-    * piping A swizzle into R fixes GL_ALPHA depth texture mode
-    * only swizzling from R/0/1 (for alpha) fixes VK CTS tests
-    * and a bunch of zink tests.
-   */
-   if (iv->vk.aspects == VK_IMAGE_ASPECT_DEPTH_BIT ||
-       iv->vk.aspects == VK_IMAGE_ASPECT_STENCIL_BIT) {
-      fix_depth_swizzle(templ.swizzle_r);
-      fix_depth_swizzle(templ.swizzle_g);
-      fix_depth_swizzle(templ.swizzle_b);
-      fix_depth_swizzle_a(templ.swizzle_a);
-   }
-
-   if (state->sv[p_stage][sv_idx])
-      pipe_sampler_view_reference(&state->sv[p_stage][sv_idx], NULL);
-   state->sv[p_stage][sv_idx] = state->pctx->create_sampler_view(state->pctx, iv->image->bo, &templ);
+   bind_sampler_view(state, &state->sv[p_stage][sv_idx], descriptor->iview->sv);
    if (state->num_sampler_views[p_stage] <= sv_idx)
       state->num_sampler_views[p_stage] = sv_idx + 1;
    state->sv_dirty[p_stage] = true;
@@ -1160,23 +1104,7 @@ static void fill_sampler_buffer_view_stage(struct rendering_state *state,
       return;
    sv_idx += array_idx;
    sv_idx += dyn_info->stage[stage].sampler_view_count;
-   struct lvp_buffer_view *bv = descriptor->buffer_view;
-   struct pipe_sampler_view templ;
-   memset(&templ, 0, sizeof(templ));
-   templ.target = PIPE_BUFFER;
-   templ.swizzle_r = PIPE_SWIZZLE_X;
-   templ.swizzle_g = PIPE_SWIZZLE_Y;
-   templ.swizzle_b = PIPE_SWIZZLE_Z;
-   templ.swizzle_a = PIPE_SWIZZLE_W;
-   templ.format = bv->pformat;
-   templ.u.buf.offset = bv->offset + bv->buffer->offset;
-   templ.u.buf.size = bv->range == VK_WHOLE_SIZE ? (bv->buffer->size - bv->offset) : bv->range;
-   templ.texture = bv->buffer->bo;
-   templ.context = state->pctx;
-
-   if (state->sv[p_stage][sv_idx])
-      pipe_sampler_view_reference(&state->sv[p_stage][sv_idx], NULL);
-   state->sv[p_stage][sv_idx] = state->pctx->create_sampler_view(state->pctx, bv->buffer->bo, &templ);
+   bind_sampler_view(state, &state->sv[p_stage][sv_idx], descriptor->buffer_view->sv);
    if (state->num_sampler_views[p_stage] <= sv_idx)
       state->num_sampler_views[p_stage] = sv_idx + 1;
    state->sv_dirty[p_stage] = true;
@@ -1196,24 +1124,7 @@ static void fill_image_view_stage(struct rendering_state *state,
       return;
    idx += array_idx;
    idx += dyn_info->stage[stage].image_count;
-   state->iv[p_stage][idx].resource = iv->image->bo;
-   if (iv->vk.aspects == VK_IMAGE_ASPECT_DEPTH_BIT)
-      state->iv[p_stage][idx].format = lvp_vk_format_to_pipe_format(iv->vk.format);
-   else if (iv->vk.aspects == VK_IMAGE_ASPECT_STENCIL_BIT)
-      state->iv[p_stage][idx].format = util_format_stencil_only(lvp_vk_format_to_pipe_format(iv->vk.format));
-   else
-      state->iv[p_stage][idx].format = lvp_vk_format_to_pipe_format(iv->vk.format);
-
-   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_3D) {
-      state->iv[p_stage][idx].u.tex.first_layer = 0;
-      state->iv[p_stage][idx].u.tex.last_layer = iv->vk.extent.depth - 1;
-   } else {
-      state->iv[p_stage][idx].u.tex.first_layer = iv->vk.base_array_layer,
-      state->iv[p_stage][idx].u.tex.last_layer = iv->vk.base_array_layer + iv->vk.layer_count - 1;
-   }
-   state->iv[p_stage][idx].u.tex.level = iv->vk.base_mip_level;
-   state->iv[p_stage][idx].access = PIPE_IMAGE_ACCESS_READ_WRITE;
-   state->iv[p_stage][idx].shader_access = PIPE_IMAGE_ACCESS_READ_WRITE;
+   state->iv[p_stage][idx] = iv->iv;
    if (state->num_shader_images[p_stage] <= idx)
       state->num_shader_images[p_stage] = idx + 1;
 
@@ -1234,10 +1145,7 @@ static void fill_image_buffer_view_stage(struct rendering_state *state,
       return;
    idx += array_idx;
    idx += dyn_info->stage[stage].image_count;
-   state->iv[p_stage][idx].resource = bv->buffer->bo;
-   state->iv[p_stage][idx].format = bv->pformat;
-   state->iv[p_stage][idx].u.buf.offset = bv->offset + bv->buffer->offset;
-   state->iv[p_stage][idx].u.buf.size = bv->range == VK_WHOLE_SIZE ? (bv->buffer->size - bv->offset): bv->range;
+   state->iv[p_stage][idx] = bv->iv;
    if (state->num_shader_images[p_stage] <= idx)
       state->num_shader_images[p_stage] = idx + 1;
    state->iv_dirty[p_stage] = true;
@@ -1340,26 +1248,145 @@ static void handle_descriptor(struct rendering_state *state,
    }
 }
 
+static void apply_dynamic_offsets(struct rendering_state *state,
+                                  struct dyn_info *dyn_info,
+                                  const struct lvp_descriptor_set *set,
+                                  gl_shader_stage stage,
+                                  enum pipe_shader_type p_stage)
+{
+   for (unsigned j = 0; j < set->layout->binding_count; j++) {
+      const struct lvp_descriptor_set_binding_layout *binding = &set->layout->binding[j];
+      struct pipe_resource *buffer;
+      unsigned *buffer_offset, *buffer_size;
+      int idx;
+
+      if (!binding->valid)
+         continue;
+
+      for (unsigned i = 0; i < binding->array_size; i++) {
+         const union lvp_descriptor_info *info = &set->descriptors[binding->descriptor_index + i].info;
+
+         switch (binding->type) {
+         case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+            idx = binding->stage[stage].const_buffer_index;
+            if (idx == -1)
+               continue;
+            idx += dyn_info->stage[stage].const_buffer_count + i;
+            buffer = state->const_buffer[p_stage][idx].buffer;
+            buffer_offset = &state->const_buffer[p_stage][idx].buffer_offset;
+            buffer_size = &state->const_buffer[p_stage][idx].buffer_size;
+            break;
+         case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+            idx = binding->stage[stage].shader_buffer_index;
+            if (idx == -1)
+               continue;
+            idx += dyn_info->stage[stage].shader_buffer_count + i;
+            buffer = state->sb[p_stage][idx].buffer;
+            buffer_offset = &state->sb[p_stage][idx].buffer_offset;
+            buffer_size = &state->sb[p_stage][idx].buffer_size;
+            break;
+         default:
+            continue;
+         }
+
+         if (!buffer)
+            continue;
+         *buffer_offset += dyn_info->dynamic_offsets[dyn_info->dyn_index + binding->dynamic_index + i];
+         if (info->range == VK_WHOLE_SIZE)
+            *buffer_size = buffer->width0 - *buffer_offset;
+      }
+   }
+}
+
 static void handle_set_stage(struct rendering_state *state,
                              struct dyn_info *dyn_info,
                              const struct lvp_descriptor_set *set,
                              gl_shader_stage stage,
                              enum pipe_shader_type p_stage)
 {
-   int j;
-   for (j = 0; j < set->layout->binding_count; j++) {
-      const struct lvp_descriptor_set_binding_layout *binding;
-      const struct lvp_descriptor *descriptor;
-      binding = &set->layout->binding[j];
-
-      if (binding->valid) {
-         unsigned array_size = binding->type == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK ? 1 : binding->array_size;
-         for (int i = 0; i < array_size; i++) {
-            descriptor = &set->descriptors[binding->descriptor_index + i];
-            handle_descriptor(state, dyn_info, binding, stage, p_stage, i, descriptor->type, &descriptor->info);
-         }
-      }
+   const struct lvp_descriptor_table *table = &set->tables[stage];
+   const struct lvp_descriptor_set_layout *layout = set->layout;
+   unsigned base, count;
+
+   count = layout->stage[stage].const_buffer_count;
+   if (count) {
+      base = dyn_info->stage[stage].const_buffer_count;
+      memcpy(&state->const_buffer[p_stage][base], table->const_buffers,
+             count * sizeof(table->const_buffers[0]));
+      state->num_const_bufs[p_stage] = MAX2(state->num_const_bufs[p_stage], base + count);
+      state->constbuf_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].shader_buffer_count;
+   if (count) {
+      base = dyn_info->stage[stage].shader_buffer_count;
+      memcpy(&state->sb[p_stage][base], table->shader_buffers,
+             count * sizeof(table->shader_buffers[0]));
+      state->num_shader_buffers[p_stage] = MAX2(state->num_shader_buffers[p_stage], base + count);
+      state->sb_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].image_count;
+   if (count) {
+      base = dyn_info->stage[stage].image_count;
+      memcpy(&state->iv[p_stage][base], table->images,
+             count * sizeof(table->images[0]));
+      state->num_shader_images[p_stage] = MAX2(state->num_shader_images[p_stage], base + count);
+      state->iv_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].sampler_count;
+   if (count) {
+      base = dyn_info->stage[stage].sampler_count;
+      memcpy(&state->ss[p_stage][base], table->samplers,
+             count * sizeof(table->samplers[0]));
+      state->num_sampler_states[p_stage] = MAX2(state->num_sampler_states[p_stage], base + count);
+      state->ss_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].sampler_view_count;
+   if (count) {
+      base = dyn_info->stage[stage].sampler_view_count;
+      for (unsigned i = 0; i < count; i++)
+         bind_sampler_view(state, &state->sv[p_stage][base + i], table->sampler_views[i]);
+      state->num_sampler_views[p_stage] = MAX2(state->num_sampler_views[p_stage], base + count);
+      state->sv_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].uniform_block_count;
+   if (count) {
+      base = dyn_info->stage[stage].uniform_block_count;
+      memcpy(&state->uniform_blocks[p_stage].block[base], table->uniform_blocks,
+             count * sizeof(table->uniform_blocks[0]));
+      state->pcbuf_dirty[p_stage] = true;
    }
+
+   if (layout->dynamic_offset_count)
+      apply_dynamic_offsets(state, dyn_info, set, stage, p_stage);
+}
+
+/* Returns true if the tables of set are still in the slots they would be
+ * copied to, and records that they are from now on.
+ */
+static bool descriptor_set_is_bound(struct rendering_state *state,
+                                    unsigned bind_point,
+                                    const struct lvp_pipeline_layout *layout,
+                                    unsigned set_idx,
+                                    const struct lvp_descriptor_set *set)
+{
+   if (state->bound_sets[bind_point].layout != layout) {
+      /* other layouts may map the sets to overlapping slots */
+      memset(&state->bound_sets[bind_point], 0, sizeof(state->bound_sets[bind_point]));
+      state->bound_sets[bind_point].layout = layout;
+   }
+
+   /* dynamic offsets may change between binds */
+   if (state->bound_sets[bind_point].sets[set_idx] == set &&
+       !set->layout->dynamic_offset_count)
+      return true;
+
+   state->bound_sets[bind_point].sets[set_idx] = set;
+   return false;
 }
 
 static void increment_dyn_info(struct dyn_info *dyn_info,
@@ -1391,6 +1418,11 @@ static void handle_compute_descriptor_sets(struct vk_cmd_queue_entry *cmd,
    for (i = 0; i < bds->descriptor_set_count; i++) {
       const struct lvp_descriptor_set *set = lvp_descriptor_set_from_handle(bds->descriptor_sets[i]);
 
+      if (descriptor_set_is_bound(state, 1, layout, bds->first_set + i, set)) {
+         increment_dyn_info(dyn_info, layout->set[bds->first_set + i].layout, true);
+         continue;
+      }
+
       if (set->layout->shader_stages & VK_SHADER_STAGE_COMPUTE_BIT)
          handle_set_stage(state, dyn_info, set, MESA_SHADER_COMPUTE, PIPE_SHADER_COMPUTE);
       increment_dyn_info(dyn_info, layout->set[bds->first_set + i].layout, true);
@@ -1432,6 +1464,11 @@ static void handle_descriptor_sets(struct vk_cmd_queue_entry *cmd,
              /* or that the total number of offsets required is <= the number remaining */
              set->layout->dynamic_offset_count <= dyn_info.dynamic_offset_count - dyn_info.dyn_index);
 
+      if (descriptor_set_is_bound(state, 0, layout, bds->first_set + i, set)) {
+         increment_dyn_info(&dyn_info, layout->set[bds->first_set + i].layout, true);
+         continue;
+      }
+
       if (set->layout->shader_stages & VK_SHADER_STAGE_VERTEX_BIT)
          handle_set_stage(state, &dyn_info, set, MESA_SHADER_VERTEX, PIPE_SHADER_VERTEX);
 
@@ -2722,6 +2759,7 @@ static void handle_begin_query(struct vk_cmd_queue_entry *cmd,
       enum pipe_query_type qtype = pool->base_type;
       pool->queries[qcmd->query] = state->pctx->create_query(state->pctx,
                                                              qtype, 0);
+      pool->owners[qcmd->query] = state->queue;
    }
 
    state->pctx->begin_query(state->pctx, pool->queries[qcmd->query]);
@@ -2754,6 +2792,7 @@ static void handle_begin_query_indexed_ext(struct vk_cmd_queue_entry *cmd,
       enum pipe_query_type qtype = pool->base_type;
       pool->queries[qcmd->query] = state->pctx->create_query(state->pctx,
                                                              qtype, qcmd->index);
+      pool->owners[qcmd->query] = state->queue;
    }
 
    state->pctx->begin_query(state->pctx, pool->queries[qcmd->query]);
@@ -2776,7 +2815,12 @@ static void handle_reset_query_pool(struct vk_cmd_queue_entry *cmd,
    LVP_FROM_HANDLE(lvp_query_pool, pool, qcmd->query_pool);
    for (unsigned i = qcmd->first_query; i < qcmd->first_query + qcmd->query_count; i++) {
       if (pool->queries[i]) {
-         state->pctx->destroy_query(state->pctx, pool->queries[i]);
+         /* The query may have been created on another queue.  Its commands
+          * have completed and been flushed by now, so destroying it doesn't
+          * touch that queue's context, and we don't take its lock.
+          */
+         struct pipe_context *ctx = pool->owners[i]->ctx;
+         ctx->destroy_query(ctx, pool->queries[i]);
          pool->queries[i] = NULL;
       }
    }
@@ -2790,6 +2834,7 @@ static void handle_write_timestamp2(struct vk_cmd_queue_entry *cmd,
    if (!pool->queries[qcmd->query]) {
       pool->queries[qcmd->query] = state->pctx->create_query(state->pctx,
                                                              PIPE_QUERY_TIMESTAMP, 0);
+      pool->owners[qcmd->query] = state->queue;
    }
 
    if (!(qcmd->stage == VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT))
@@ -3184,6 +3229,9 @@ static void handle_push_descriptor_set_generic(struct vk_cmd_push_descriptor_set
    pds = create_push_descriptor_set(_pds);
    layout = pds->layout->set[pds->set].layout;
 
+   /* push descriptors overwrite the slots of bound sets */
+   memset(state->bound_sets, 0, sizeof(state->bound_sets));
+
    memset(&dyn_info.stage, 0, sizeof(dyn_info.stage));
    dyn_info.dyn_index = 0;
    if (pds->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE) {
@@ -3992,6 +4040,7 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
 {
    struct rendering_state *state = queue->state;
    memset(state, 0, sizeof(*state));
+   state->queue = queue;
    state->pctx = queue->ctx;
    state->uploader = queue->uploader;
    state->cso = queue->cso;
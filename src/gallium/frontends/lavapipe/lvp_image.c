@@ -22,8 +22,10 @@
  */
 
 #include "lvp_private.h"
+#include "lvp_conv.h"
 #include "util/format/u_format.h"
 #include "util/u_inlines.h"
+#include "util/u_sampler.h"
 #include "pipe/p_state.h"
 
 static VkResult
@@ -168,6 +170,94 @@ lvp_DestroyImage(VkDevice _device, VkImage _image,
    vk_image_destroy(&device->vk, pAllocator, &image->vk);
 }
 
+#define fix_depth_swizzle(x) do { \
+  if (x > PIPE_SWIZZLE_X && x < PIPE_SWIZZLE_0) \
+    x = PIPE_SWIZZLE_0;				\
+  } while (0)
+#define fix_depth_swizzle_a(x) do { \
+  if (x > PIPE_SWIZZLE_X && x < PIPE_SWIZZLE_0) \
+    x = PIPE_SWIZZLE_1;				\
+  } while (0)
+
+static struct pipe_sampler_view *
+lvp_create_image_sampler_view(struct lvp_device *device,
+                              struct lvp_image_view *iv)
+{
+   struct pipe_context *ctx = device->queues[0].ctx;
+   struct pipe_sampler_view templ;
+
+   enum pipe_format pformat;
+   if (iv->vk.aspects == VK_IMAGE_ASPECT_DEPTH_BIT)
+      pformat = lvp_vk_format_to_pipe_format(iv->vk.format);
+   else if (iv->vk.aspects == VK_IMAGE_ASPECT_STENCIL_BIT)
+      pformat = util_format_stencil_only(lvp_vk_format_to_pipe_format(iv->vk.format));
+   else
+      pformat = lvp_vk_format_to_pipe_format(iv->vk.format);
+   u_sampler_view_default_template(&templ,
+                                   iv->image->bo,
+                                   pformat);
+   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_1D)
+      templ.target = PIPE_TEXTURE_1D;
+   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_2D)
+      templ.target = PIPE_TEXTURE_2D;
+   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_CUBE)
+      templ.target = PIPE_TEXTURE_CUBE;
+   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY)
+      templ.target = PIPE_TEXTURE_CUBE_ARRAY;
+   templ.u.tex.first_layer = iv->vk.base_array_layer;
+   templ.u.tex.last_layer = iv->vk.base_array_layer + iv->vk.layer_count - 1;
+   templ.u.tex.first_level = iv->vk.base_mip_level;
+   templ.u.tex.last_level = iv->vk.base_mip_level + iv->vk.level_count - 1;
+   templ.swizzle_r = vk_conv_swizzle(iv->vk.swizzle.r);
+   templ.swizzle_g = vk_conv_swizzle(iv->vk.swizzle.g);
+   templ.swizzle_b = vk_conv_swizzle(iv->vk.swizzle.b);
+   templ.swizzle_a = vk_conv_swizzle(iv->vk.swizzle.a);
+
+   /* depth stencil swizzles need special handling to pass VK CTS
+    * but also for zink GL tests.
+    * piping A swizzle into R fixes GL_ALPHA depth texture mode
+    * only swizzling from R/0/1 (for alpha) fixes VK CTS tests
+    * and a bunch of zink tests.
+   */
+   if (iv->vk.aspects == VK_IMAGE_ASPECT_DEPTH_BIT ||
+       iv->vk.aspects == VK_IMAGE_ASPECT_STENCIL_BIT) {
+      fix_depth_swizzle(templ.swizzle_r);
+      fix_depth_swizzle(templ.swizzle_g);
+      fix_depth_swizzle(templ.swizzle_b);
+      fix_depth_swizzle_a(templ.swizzle_a);
+   }
+
+   simple_mtx_lock(&device->queues[0].lock);
+   struct pipe_sampler_view *sv = ctx->create_sampler_view(ctx, iv->image->bo, &templ);
+   simple_mtx_unlock(&device->queues[0].lock);
+   return sv;
+}
+
+static void
+lvp_fill_image_view(struct pipe_image_view *piv,
+                    const struct lvp_image_view *iv)
+{
+   memset(piv, 0, sizeof(*piv));
+   piv->resource = iv->image->bo;
+   if (iv->vk.aspects == VK_IMAGE_ASPECT_DEPTH_BIT)
+      piv->format = lvp_vk_format_to_pipe_format(iv->vk.format);
+   else if (iv->vk.aspects == VK_IMAGE_ASPECT_STENCIL_BIT)
+      piv->format = util_format_stencil_only(lvp_vk_format_to_pipe_format(iv->vk.format));
+   else
+      piv->format = lvp_vk_format_to_pipe_format(iv->vk.format);
+
+   if (iv->vk.view_type == VK_IMAGE_VIEW_TYPE_3D) {
+      piv->u.tex.first_layer = 0;
+      piv->u.tex.last_layer = iv->vk.extent.depth - 1;
+   } else {
+      piv->u.tex.first_layer = iv->vk.base_array_layer,
+      piv->u.tex.last_layer = iv->vk.base_array_layer + iv->vk.layer_count - 1;
+   }
+   piv->u.tex.level = iv->vk.base_mip_level;
+   piv->access = PIPE_IMAGE_ACCESS_READ_WRITE;
+   piv->shader_access = PIPE_IMAGE_ACCESS_READ_WRITE;
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL
 lvp_CreateImageView(VkDevice _device,
                     const VkImageViewCreateInfo *pCreateInfo,
@@ -185,6 +275,16 @@ lvp_CreateImageView(VkDevice _device,
    view->pformat = lvp_vk_format_to_pipe_format(view->vk.format);
    view->image = image;
    view->surface = NULL;
+
+   view->sv = NULL;
+   if (view->vk.usage & VK_IMAGE_USAGE_SAMPLED_BIT) {
+      view->sv = lvp_create_image_sampler_view(device, view);
+      if (!view->sv) {
+         vk_image_view_destroy(&device->vk, pAllocator, &view->vk);
+         return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+      }
+   }
+   lvp_fill_image_view(&view->iv, view);
    *pView = lvp_image_view_to_handle(view);
 
    return VK_SUCCESS;
@@ -201,6 +301,7 @@ lvp_DestroyImageView(VkDevice _device, VkImageView _iview,
      return;
 
    pipe_surface_reference(&iview->surface, NULL);
+   pipe_sampler_view_reference(&iview->sv, NULL);
    vk_image_view_destroy(&device->vk, pAllocator, &iview->vk);
 }
 
@@ -385,6 +486,40 @@ lvp_CreateBufferView(VkDevice _device,
    view->pformat = lvp_vk_format_to_pipe_format(pCreateInfo->format);
    view->offset = pCreateInfo->offset;
    view->range = pCreateInfo->range;
+
+   uint64_t size = view->range == VK_WHOLE_SIZE ? (buffer->size - view->offset) : view->range;
+
+   view->sv = NULL;
+   if (buffer->bo->bind & PIPE_BIND_SAMPLER_VIEW) {
+      struct pipe_context *ctx = device->queues[0].ctx;
+      struct pipe_sampler_view templ;
+      memset(&templ, 0, sizeof(templ));
+      templ.target = PIPE_BUFFER;
+      templ.swizzle_r = PIPE_SWIZZLE_X;
+      templ.swizzle_g = PIPE_SWIZZLE_Y;
+      templ.swizzle_b = PIPE_SWIZZLE_Z;
+      templ.swizzle_a = PIPE_SWIZZLE_W;
+      templ.format = view->pformat;
+      templ.u.buf.offset = view->offset + buffer->offset;
+      templ.u.buf.size = size;
+      templ.texture = buffer->bo;
+      templ.context = ctx;
+
+      simple_mtx_lock(&device->queues[0].lock);
+      view->sv = ctx->create_sampler_view(ctx, buffer->bo, &templ);
+      simple_mtx_unlock(&device->queues[0].lock);
+      if (!view->sv) {
+         vk_object_base_finish(&view->base);
+         vk_free2(&device->vk.alloc, pAllocator, view);
+         return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+      }
+   }
+
+   memset(&view->iv, 0, sizeof(view->iv));
+   view->iv.resource = buffer->bo;
+   view->iv.format = view->pformat;
+   view->iv.u.buf.offset = view->offset + buffer->offset;
+   view->iv.u.buf.size = size;
    *pView = lvp_buffer_view_to_handle(view);
 
    return VK_SUCCESS;
@@ -399,6 +534,7 @@ lvp_DestroyBufferView(VkDevice _device, VkBufferView bufferView,
 
    if (!bufferView)
      return;
+   pipe_sampler_view_reference(&view->sv, NULL);
    vk_object_base_finish(&view->base);
    vk_free2(&device->vk.alloc, pAllocator, view);
 }
@@ -22,6 +22,7 @@
  */
 
 #include "lvp_private.h"
+#include "vk_nir.h"
 #include "vk_render_pass.h"
 #include "vk_util.h"
 #include "glsl_types.h"
@@ -32,6 +33,9 @@
 #include "pipe/p_state.h"
 #include "pipe/p_context.h"
 #include "nir/nir_xfb_info.h"
+#include "tgsi/tgsi_from_mesa.h"
+#include "nir/nir_serialize.h"
+#include "util/mesa-sha1.h"
 
 #define SPIR_V_MAGIC_NUMBER 0x07230203
 
@@ -53,18 +57,26 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyPipeline(
    if (!_pipeline)
       return;
 
-   if (pipeline->shader_cso[PIPE_SHADER_VERTEX])
-      device->queue.ctx->delete_vs_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_VERTEX]);
-   if (pipeline->shader_cso[PIPE_SHADER_FRAGMENT])
-      device->queue.ctx->delete_fs_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_FRAGMENT]);
-   if (pipeline->shader_cso[PIPE_SHADER_GEOMETRY])
-      device->queue.ctx->delete_gs_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_GEOMETRY]);
-   if (pipeline->shader_cso[PIPE_SHADER_TESS_CTRL])
-      device->queue.ctx->delete_tcs_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_TESS_CTRL]);
-   if (pipeline->shader_cso[PIPE_SHADER_TESS_EVAL])
-      device->queue.ctx->delete_tes_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_TESS_EVAL]);
-   if (pipeline->shader_cso[PIPE_SHADER_COMPUTE])
-      device->queue.ctx->delete_compute_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_COMPUTE]);
+   for (unsigned q = 0; q < device->queue_count; q++) {
+      struct lvp_queue *queue = &device->queues[q];
+      struct pipe_context *ctx = queue->ctx;
+      void **shader_cso = pipeline->shader_cso[q];
+
+      simple_mtx_lock(&queue->lock);
+      if (shader_cso[PIPE_SHADER_VERTEX])
+         ctx->delete_vs_state(ctx, shader_cso[PIPE_SHADER_VERTEX]);
+      if (shader_cso[PIPE_SHADER_FRAGMENT])
+         ctx->delete_fs_state(ctx, shader_cso[PIPE_SHADER_FRAGMENT]);
+      if (shader_cso[PIPE_SHADER_GEOMETRY])
+         ctx->delete_gs_state(ctx, shader_cso[PIPE_SHADER_GEOMETRY]);
+      if (shader_cso[PIPE_SHADER_TESS_CTRL])
+         ctx->delete_tcs_state(ctx, shader_cso[PIPE_SHADER_TESS_CTRL]);
+      if (shader_cso[PIPE_SHADER_TESS_EVAL])
+         ctx->delete_tes_state(ctx, shader_cso[PIPE_SHADER_TESS_EVAL]);
+      if (shader_cso[PIPE_SHADER_COMPUTE])
+         ctx->delete_compute_state(ctx, shader_cso[PIPE_SHADER_COMPUTE]);
+      simple_mtx_unlock(&queue->lock);
+   }
 
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
       ralloc_free(pipeline->pipeline_nir[i]);
@@ -755,56 +767,129 @@ lvp_nir_fixup_indirect_tex(nir_shader *shader)
 static void
 optimize(nir_shader *nir)
 {
+   nir_pass_tracker tracker;
+   nir_pass_tracker_init(&tracker, NULL);
+
    bool progress = false;
    do {
       progress = false;
 
-      NIR_PASS(progress, nir, nir_lower_flrp, 32|64, true);
-      NIR_PASS(progress, nir, nir_split_array_vars, nir_var_function_temp);
-      NIR_PASS(progress, nir, nir_shrink_vec_array_vars, nir_var_function_temp);
-      NIR_PASS(progress, nir, nir_opt_deref);
-      NIR_PASS(progress, nir, nir_lower_vars_to_ssa);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_lower_flrp, 32|64, true);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_split_array_vars, nir_var_function_temp);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_shrink_vec_array_vars, nir_var_function_temp);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_deref);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_lower_vars_to_ssa);
 
-      NIR_PASS(progress, nir, nir_opt_copy_prop_vars);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_copy_prop_vars);
 
-      NIR_PASS(progress, nir, nir_copy_prop);
-      NIR_PASS(progress, nir, nir_opt_dce);
-      NIR_PASS(progress, nir, nir_opt_peephole_select, 8, true, true);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_copy_prop);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_dce);
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, &tracker, nir, nir_opt_peephole_select, 8, true, true);
 
-      NIR_PASS(progress, nir, nir_opt_algebraic);
-      NIR_PASS(progress, nir, nir_opt_constant_folding);
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, &tracker, nir, nir_opt_algebraic);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_constant_folding);
 
-      NIR_PASS(progress, nir, nir_opt_remove_phis);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_remove_phis);
       bool trivial_continues = false;
-      NIR_PASS(trivial_continues, nir, nir_opt_trivial_continues);
+      NIR_LOOP_PASS(trivial_continues, &tracker, nir, nir_opt_trivial_continues);
       progress |= trivial_continues;
       if (trivial_continues) {
          /* If nir_opt_trivial_continues makes progress, then we need to clean
           * things up if we want any hope of nir_opt_if or nir_opt_loop_unroll
           * to make progress.
           */
-         NIR_PASS(progress, nir, nir_copy_prop);
-         NIR_PASS(progress, nir, nir_opt_dce);
-         NIR_PASS(progress, nir, nir_opt_remove_phis);
+         NIR_LOOP_PASS(progress, &tracker, nir, nir_copy_prop);
+         NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_dce);
+         NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_remove_phis);
       }
-      NIR_PASS(progress, nir, nir_opt_if, true);
-      NIR_PASS(progress, nir, nir_opt_dead_cf);
-      NIR_PASS(progress, nir, nir_opt_conditional_discard);
-      NIR_PASS(progress, nir, nir_opt_remove_phis);
-      NIR_PASS(progress, nir, nir_opt_cse);
-      NIR_PASS(progress, nir, nir_opt_undef);
-
-      NIR_PASS(progress, nir, nir_opt_deref);
-      NIR_PASS(progress, nir, nir_lower_alu_to_scalar, NULL, NULL);
-      NIR_PASS(progress, nir, nir_opt_loop_unroll);
-      NIR_PASS(progress, nir, lvp_nir_fixup_indirect_tex);
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, &tracker, nir, nir_opt_if, true);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_dead_cf);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_conditional_discard);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_remove_phis);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_cse);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_undef);
+
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_opt_deref);
+      NIR_LOOP_PASS(progress, &tracker, nir, nir_lower_alu_to_scalar, NULL, NULL);
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, &tracker, nir, nir_opt_loop_unroll);
+      NIR_LOOP_PASS(progress, &tracker, nir, lvp_nir_fixup_indirect_tex);
    } while (progress);
+
+   nir_pass_tracker_fini(&tracker, nir);
+}
+
+static void
+lvp_pipeline_layout_hash(struct mesa_sha1 *ctx,
+                         const struct lvp_pipeline_layout *layout)
+{
+   bool has_layout = layout != NULL;
+
+   _mesa_sha1_update(ctx, &has_layout, sizeof(has_layout));
+   if (!layout)
+      return;
+
+   _mesa_sha1_update(ctx, &layout->num_sets, sizeof(layout->num_sets));
+   _mesa_sha1_update(ctx, &layout->push_constant_size, sizeof(layout->push_constant_size));
+   _mesa_sha1_update(ctx, &layout->push_constant_stages, sizeof(layout->push_constant_stages));
+   _mesa_sha1_update(ctx, layout->stage, sizeof(layout->stage));
+   for (unsigned s = 0; s < layout->num_sets; s++) {
+      const struct lvp_descriptor_set_layout *set_layout = layout->set[s].layout;
+      uint16_t binding_count = set_layout ? set_layout->binding_count : 0;
+
+      _mesa_sha1_update(ctx, &binding_count, sizeof(binding_count));
+      if (!set_layout)
+         continue;
+      _mesa_sha1_update(ctx, set_layout->stage, sizeof(set_layout->stage));
+      for (unsigned b = 0; b < set_layout->binding_count; b++) {
+         const struct lvp_descriptor_set_binding_layout *binding = &set_layout->binding[b];
+
+         /* Skip the immutable sampler pointers, the lowering only looks at
+          * the binding indices.
+          */
+         _mesa_sha1_update(ctx, &binding->descriptor_index, sizeof(binding->descriptor_index));
+         _mesa_sha1_update(ctx, &binding->type, sizeof(binding->type));
+         _mesa_sha1_update(ctx, &binding->array_size, sizeof(binding->array_size));
+         _mesa_sha1_update(ctx, &binding->valid, sizeof(binding->valid));
+         _mesa_sha1_update(ctx, &binding->dynamic_index, sizeof(binding->dynamic_index));
+         _mesa_sha1_update(ctx, binding->stage, sizeof(binding->stage));
+      }
+   }
+}
+
+static void
+lvp_shader_get_cache_key(struct lvp_pipeline *pipeline,
+                         uint32_t size,
+                         const void *module,
+                         const char *entrypoint_name,
+                         gl_shader_stage stage,
+                         const VkSpecializationInfo *spec_info,
+                         unsigned char *sha1)
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, module, size);
+   _mesa_sha1_update(&ctx, entrypoint_name, strlen(entrypoint_name) + 1);
+   _mesa_sha1_update(&ctx, &stage, sizeof(stage));
+   if (spec_info) {
+      for (unsigned i = 0; i < spec_info->mapEntryCount; i++) {
+         const VkSpecializationMapEntry *entry = &spec_info->pMapEntries[i];
+         _mesa_sha1_update(&ctx, &entry->constantID, sizeof(entry->constantID));
+         _mesa_sha1_update(&ctx, &entry->offset, sizeof(entry->offset));
+         _mesa_sha1_update(&ctx, &entry->size, sizeof(entry->size));
+      }
+      _mesa_sha1_update(&ctx, spec_info->pData, spec_info->dataSize);
+   }
+   lvp_pipeline_layout_hash(&ctx, pipeline->layout);
+   _mesa_sha1_final(&ctx, sha1);
 }
 
 static void
 lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline,
+                         struct lvp_pipeline_cache *cache,
                          uint32_t size,
                          const void *module,
+                         const unsigned char *module_sha1,
                          const char *entrypoint_name,
                          gl_shader_stage stage,
                          const VkSpecializationInfo *spec_info)
@@ -812,12 +897,26 @@ lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline,
    nir_shader *nir;
    const nir_shader_compiler_options *drv_options = pipeline->device->pscreen->get_compiler_options(pipeline->device->pscreen, PIPE_SHADER_IR_NIR, st_shader_stage_to_ptarget(stage));
    const uint32_t *spirv = module;
+   unsigned char sha1[20];
    assert(spirv[0] == SPIR_V_MAGIC_NUMBER);
    assert(size % 4 == 0);
 
-   uint32_t num_spec_entries = 0;
-   struct nir_spirv_specialization *spec_entries =
-      vk_spec_info_to_nir_spirv(spec_info, &num_spec_entries);
+   if (cache) {
+      lvp_shader_get_cache_key(pipeline, size, module, entrypoint_name,
+                               stage, spec_info, sha1);
+      struct lvp_pipeline_cache_entry *entry =
+         lvp_pipeline_cache_search(cache, sha1);
+      if (entry) {
+         struct blob_reader blob;
+         blob_reader_init(&blob, entry->nir, entry->nir_size);
+         nir = nir_deserialize(NULL, drv_options, &blob);
+         if (nir) {
+            pipeline->access[stage] = entry->access;
+            pipeline->pipeline_nir[stage] = nir;
+            return;
+         }
+      }
+   }
 
    struct lvp_device *pdevice = pipeline->device;
    const struct spirv_to_nir_options spirv_options = {
@@ -863,17 +962,19 @@ lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline,
       .shared_addr_format = nir_address_format_32bit_offset,
    };
 
-   nir = spirv_to_nir(spirv, size / 4,
-                      spec_entries, num_spec_entries,
-                      stage, entrypoint_name, &spirv_options, drv_options);
-
-   if (!nir) {
-      free(spec_entries);
+   /* Translation and the common lowering only depend on the module, the
+    * specialization constants and the options above, so they are shared
+    * between all pipelines using the same shader through the device's
+    * SPIR-V to NIR cache.  Compared to the lowering lavapipe used to do by
+    * itself, the common one also removes dead shader call data and ray hit
+    * attribute variables, and runs nir_propagate_invariant.
+    */
+   nir = vk_spirv_to_nir_cached(&pdevice->vk, module_sha1,
+                                (uint32_t *)spirv, size,
+                                stage, entrypoint_name, spec_info,
+                                &spirv_options, drv_options, NULL);
+   if (!nir)
       return;
-   }
-   nir_validate_shader(nir, NULL);
-
-   free(spec_entries);
 
    if (nir->info.stage != MESA_SHADER_TESS_CTRL)
       NIR_PASS_V(nir, remove_scoped_barriers, nir->info.stage == MESA_SHADER_COMPUTE);
@@ -884,26 +985,6 @@ lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline,
    };
    NIR_PASS_V(nir, nir_lower_sysvals_to_varyings, &sysvals_to_varyings);
 
-   NIR_PASS_V(nir, nir_lower_variable_initializers, nir_var_function_temp);
-   NIR_PASS_V(nir, nir_lower_returns);
-   NIR_PASS_V(nir, nir_inline_functions);
-   NIR_PASS_V(nir, nir_copy_prop);
-   NIR_PASS_V(nir, nir_opt_deref);
-
-   /* Pick off the single entrypoint that we want */
-   foreach_list_typed_safe(nir_function, func, node, &nir->functions) {
-      if (!func->is_entrypoint)
-         exec_node_remove(&func->node);
-   }
-   assert(exec_list_length(&nir->functions) == 1);
-
-   NIR_PASS_V(nir, nir_lower_variable_initializers, ~0);
-   NIR_PASS_V(nir, nir_split_var_copies);
-   NIR_PASS_V(nir, nir_split_per_member_structs);
-
-   NIR_PASS_V(nir, nir_remove_dead_variables,
-              nir_var_shader_in | nir_var_shader_out | nir_var_system_value, NULL);
-
    if (stage == MESA_SHADER_FRAGMENT)
       lvp_lower_input_attachments(nir, false);
    NIR_PASS_V(nir, nir_lower_is_helper_invocation);
@@ -973,6 +1054,17 @@ lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline,
    }
    nir_assign_io_var_locations(nir, nir_var_shader_out, &nir->num_outputs,
                                nir->info.stage);
+
+   if (cache) {
+      struct blob blob;
+      blob_init(&blob);
+      nir_serialize(&blob, nir, false);
+      if (!blob.out_of_memory)
+         lvp_pipeline_cache_insert(cache, sha1, &pipeline->access[stage],
+                                   blob.data, blob.size);
+      blob_finish(&blob);
+   }
+
    pipeline->pipeline_nir[stage] = nir;
 }
 
@@ -1043,80 +1135,105 @@ lvp_shader_stage(VkShaderStageFlagBits stage)
    }
 }
 
-static VkResult
-lvp_pipeline_compile(struct lvp_pipeline *pipeline,
-                     gl_shader_stage stage)
+static void *
+lvp_pipeline_create_shader_cso(struct lvp_pipeline *pipeline,
+                               struct pipe_context *ctx,
+                               gl_shader_stage stage)
 {
-   struct lvp_device *device = pipeline->device;
-   device->physical_device->pscreen->finalize_nir(device->physical_device->pscreen, pipeline->pipeline_nir[stage]);
    if (stage == MESA_SHADER_COMPUTE) {
       struct pipe_compute_state shstate = {0};
       shstate.prog = (void *)nir_shader_clone(NULL, pipeline->pipeline_nir[MESA_SHADER_COMPUTE]);
       shstate.ir_type = PIPE_SHADER_IR_NIR;
       shstate.req_local_mem = pipeline->pipeline_nir[MESA_SHADER_COMPUTE]->info.shared_size;
-      pipeline->shader_cso[PIPE_SHADER_COMPUTE] = device->queue.ctx->create_compute_state(device->queue.ctx, &shstate);
-   } else {
-      struct pipe_shader_state shstate = {0};
-      fill_shader_prog(&shstate, stage, pipeline);
-
-      if (stage == MESA_SHADER_VERTEX ||
-          stage == MESA_SHADER_GEOMETRY ||
-          stage == MESA_SHADER_TESS_EVAL) {
-         nir_xfb_info *xfb_info = nir_gather_xfb_info(pipeline->pipeline_nir[stage], NULL);
-         if (xfb_info) {
-            uint8_t output_mapping[VARYING_SLOT_TESS_MAX];
-            memset(output_mapping, 0, sizeof(output_mapping));
-
-            nir_foreach_shader_out_variable(var, pipeline->pipeline_nir[stage]) {
-               unsigned slots = var->data.compact ? DIV_ROUND_UP(glsl_get_length(var->type), 4)
-                                                  : glsl_count_attribute_slots(var->type, false);
-               for (unsigned i = 0; i < slots; i++)
-                  output_mapping[var->data.location + i] = var->data.driver_location + i;
-            }
+      return ctx->create_compute_state(ctx, &shstate);
+   }
 
-            shstate.stream_output.num_outputs = xfb_info->output_count;
-            for (unsigned i = 0; i < PIPE_MAX_SO_BUFFERS; i++) {
-               if (xfb_info->buffers_written & (1 << i)) {
-                  shstate.stream_output.stride[i] = xfb_info->buffers[i].stride / 4;
-               }
-            }
-            for (unsigned i = 0; i < xfb_info->output_count; i++) {
-               shstate.stream_output.output[i].output_buffer = xfb_info->outputs[i].buffer;
-               shstate.stream_output.output[i].dst_offset = xfb_info->outputs[i].offset / 4;
-               shstate.stream_output.output[i].register_index = output_mapping[xfb_info->outputs[i].location];
-               shstate.stream_output.output[i].num_components = util_bitcount(xfb_info->outputs[i].component_mask);
-               shstate.stream_output.output[i].start_component = ffs(xfb_info->outputs[i].component_mask) - 1;
-               shstate.stream_output.output[i].stream = xfb_info->buffer_to_stream[xfb_info->outputs[i].buffer];
-            }
+   struct pipe_shader_state shstate = {0};
+   fill_shader_prog(&shstate, stage, pipeline);
+
+   if (stage == MESA_SHADER_VERTEX ||
+       stage == MESA_SHADER_GEOMETRY ||
+       stage == MESA_SHADER_TESS_EVAL) {
+      nir_xfb_info *xfb_info = nir_gather_xfb_info(pipeline->pipeline_nir[stage], NULL);
+      if (xfb_info) {
+         uint8_t output_mapping[VARYING_SLOT_TESS_MAX];
+         memset(output_mapping, 0, sizeof(output_mapping));
+
+         nir_foreach_shader_out_variable(var, pipeline->pipeline_nir[stage]) {
+            unsigned slots = var->data.compact ? DIV_ROUND_UP(glsl_get_length(var->type), 4)
+                                               : glsl_count_attribute_slots(var->type, false);
+            for (unsigned i = 0; i < slots; i++)
+               output_mapping[var->data.location + i] = var->data.driver_location + i;
+         }
 
-            ralloc_free(xfb_info);
+         shstate.stream_output.num_outputs = xfb_info->output_count;
+         for (unsigned i = 0; i < PIPE_MAX_SO_BUFFERS; i++) {
+            if (xfb_info->buffers_written & (1 << i)) {
+               shstate.stream_output.stride[i] = xfb_info->buffers[i].stride / 4;
+            }
+         }
+         for (unsigned i = 0; i < xfb_info->output_count; i++) {
+            shstate.stream_output.output[i].output_buffer = xfb_info->outputs[i].buffer;
+            shstate.stream_output.output[i].dst_offset = xfb_info->outputs[i].offset / 4;
+            shstate.stream_output.output[i].register_index = output_mapping[xfb_info->outputs[i].location];
+            shstate.stream_output.output[i].num_components = util_bitcount(xfb_info->outputs[i].component_mask);
+            shstate.stream_output.output[i].start_component = ffs(xfb_info->outputs[i].component_mask) - 1;
+            shstate.stream_output.output[i].stream = xfb_info->buffer_to_stream[xfb_info->outputs[i].buffer];
          }
-      }
 
-      switch (stage) {
-      case MESA_SHADER_FRAGMENT:
-         pipeline->shader_cso[PIPE_SHADER_FRAGMENT] = device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
-         break;
-      case MESA_SHADER_VERTEX:
-         pipeline->shader_cso[PIPE_SHADER_VERTEX] = device->queue.ctx->create_vs_state(device->queue.ctx, &shstate);
-         break;
-      case MESA_SHADER_GEOMETRY:
-         pipeline->shader_cso[PIPE_SHADER_GEOMETRY] = device->queue.ctx->create_gs_state(device->queue.ctx, &shstate);
-         break;
-      case MESA_SHADER_TESS_CTRL:
-         pipeline->shader_cso[PIPE_SHADER_TESS_CTRL] = device->queue.ctx->create_tcs_state(device->queue.ctx, &shstate);
-         break;
-      case MESA_SHADER_TESS_EVAL:
-         pipeline->shader_cso[PIPE_SHADER_TESS_EVAL] = device->queue.ctx->create_tes_state(device->queue.ctx, &shstate);
-         break;
-      default:
-         unreachable("illegal shader");
-         break;
+         ralloc_free(xfb_info);
       }
    }
+
+   switch (stage) {
+   case MESA_SHADER_FRAGMENT:
+      return ctx->create_fs_state(ctx, &shstate);
+   case MESA_SHADER_VERTEX:
+      return ctx->create_vs_state(ctx, &shstate);
+   case MESA_SHADER_GEOMETRY:
+      return ctx->create_gs_state(ctx, &shstate);
+   case MESA_SHADER_TESS_CTRL:
+      return ctx->create_tcs_state(ctx, &shstate);
+   case MESA_SHADER_TESS_EVAL:
+      return ctx->create_tes_state(ctx, &shstate);
+   default:
+      unreachable("illegal shader");
+      return NULL;
+   }
+}
+
+static VkResult
+lvp_pipeline_compile(struct lvp_pipeline *pipeline,
+                     gl_shader_stage stage)
+{
+   struct lvp_device *device = pipeline->device;
+   struct lvp_queue *queue = &device->queues[0];
+   device->physical_device->pscreen->finalize_nir(device->physical_device->pscreen, pipeline->pipeline_nir[stage]);
+
+   simple_mtx_lock(&queue->lock);
+   pipeline->shader_cso[0][pipe_shader_type_from_mesa(stage)] =
+      lvp_pipeline_create_shader_cso(pipeline, queue->ctx, stage);
+   simple_mtx_unlock(&queue->lock);
    return VK_SUCCESS;
 }
 
+/* Shaders are not shared between contexts: llvmpipe keeps the variants of a
+ * shader in the shader itself, which must not be used by two queues at once.
+ * Must be called from the queue's submit thread with queue->lock held.
+ */
+void *
+lvp_pipeline_get_shader_cso(struct lvp_pipeline *pipeline,
+                            struct lvp_queue *queue,
+                            enum pipe_shader_type pstage)
+{
+   void **cso = &pipeline->shader_cso[queue->index][pstage];
+   if (!*cso && pipeline->shader_cso[0][pstage]) {
+      *cso = lvp_pipeline_create_shader_cso(pipeline, queue->ctx,
+                                            tgsi_processor_to_shader_stage(pstage));
+   }
+   return *cso;
+}
+
 #ifndef NDEBUG
 static bool
 layouts_equal(const struct lvp_descriptor_set_layout *a, const struct lvp_descriptor_set_layout *b)
@@ -1275,14 +1392,16 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
             continue;
       }
       if (module) {
-         lvp_shader_compile_to_ir(pipeline, module->size, module->data,
+         lvp_shader_compile_to_ir(pipeline, cache, module->size, module->data,
+                                  module->sha1,
                                   pCreateInfo->pStages[i].pName,
                                   stage,
                                   pCreateInfo->pStages[i].pSpecializationInfo);
       } else {
          const VkShaderModuleCreateInfo *info = vk_find_struct_const(pCreateInfo->pStages[i].pNext, SHADER_MODULE_CREATE_INFO);
          assert(info);
-         lvp_shader_compile_to_ir(pipeline, info->codeSize, info->pCode,
+         lvp_shader_compile_to_ir(pipeline, cache, info->codeSize, info->pCode,
+                                  NULL,
                                   pCreateInfo->pStages[i].pName,
                                   stage,
                                   pCreateInfo->pStages[i].pSpecializationInfo);
@@ -1386,7 +1505,9 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          struct pipe_shader_state shstate = {0};
          shstate.type = PIPE_SHADER_IR_NIR;
          shstate.ir.nir = nir_shader_clone(NULL, pipeline->pipeline_nir[MESA_SHADER_FRAGMENT]);
-         pipeline->shader_cso[PIPE_SHADER_FRAGMENT] = device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
+         simple_mtx_lock(&device->queues[0].lock);
+         pipeline->shader_cso[0][PIPE_SHADER_FRAGMENT] = device->queues[0].ctx->create_fs_state(device->queues[0].ctx, &shstate);
+         simple_mtx_unlock(&device->queues[0].lock);
       }
    }
    return VK_SUCCESS;
@@ -1434,6 +1555,106 @@ lvp_graphics_pipeline_create(
    return VK_SUCCESS;
 }
 
+static VkResult
+lvp_compute_pipeline_create(VkDevice _device,
+                            VkPipelineCache _cache,
+                            const VkComputePipelineCreateInfo *pCreateInfo,
+                            const VkAllocationCallbacks *pAllocator,
+                            VkPipeline *pPipeline);
+
+struct lvp_pipeline_create_job {
+   VkDevice device;
+   VkPipelineCache cache;
+   const VkGraphicsPipelineCreateInfo *graphics_info;
+   const VkComputePipelineCreateInfo *compute_info;
+   const VkAllocationCallbacks *alloc;
+   VkPipeline *pipeline;
+   VkResult result;
+   struct util_queue_fence fence;
+};
+
+static void
+lvp_pipeline_create_job(void *data, void *gdata, int thread_index)
+{
+   struct lvp_pipeline_create_job *job = data;
+
+   if (job->graphics_info)
+      job->result = lvp_graphics_pipeline_create(job->device, job->cache,
+                                                 job->graphics_info,
+                                                 job->alloc, job->pipeline);
+   else
+      job->result = lvp_compute_pipeline_create(job->device, job->cache,
+                                                job->compute_info,
+                                                job->alloc, job->pipeline);
+}
+
+static bool
+lvp_pipeline_batch_threaded(struct lvp_device *device, uint32_t count,
+                            bool early_return)
+{
+   /* An early return has to stop at the first failing pipeline, which
+    * only the serial path can do.
+    */
+   return count > 1 && !early_return &&
+          util_queue_is_initialized(&device->pipeline_queue);
+}
+
+/* Creates a batch of pipelines on the device's pipeline queue.  Shader
+ * translation runs fully in parallel, only the CSO creation is serialized
+ * on the queue lock.
+ */
+static VkResult
+lvp_create_pipelines_threaded(struct lvp_device *device,
+                              VkPipelineCache pipelineCache,
+                              uint32_t count,
+                              const VkGraphicsPipelineCreateInfo *graphics_infos,
+                              const VkComputePipelineCreateInfo *compute_infos,
+                              const VkAllocationCallbacks *pAllocator,
+                              VkPipeline *pPipelines)
+{
+   VkResult result = VK_SUCCESS;
+   struct lvp_pipeline_create_job *jobs;
+
+   jobs = vk_zalloc(&device->vk.alloc, sizeof(*jobs) * count, 8,
+                    VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   if (!jobs) {
+      for (unsigned i = 0; i < count; i++)
+         pPipelines[i] = VK_NULL_HANDLE;
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      struct lvp_pipeline_create_job *job = &jobs[i];
+      VkPipelineCreateFlags flags = graphics_infos ? graphics_infos[i].flags :
+                                                     compute_infos[i].flags;
+
+      job->device = lvp_device_to_handle(device);
+      job->cache = pipelineCache;
+      job->graphics_info = graphics_infos ? &graphics_infos[i] : NULL;
+      job->compute_info = compute_infos ? &compute_infos[i] : NULL;
+      job->alloc = pAllocator;
+      job->pipeline = &pPipelines[i];
+      job->result = VK_PIPELINE_COMPILE_REQUIRED;
+      util_queue_fence_init(&job->fence);
+
+      if (!(flags & VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT))
+         util_queue_add_job(&device->pipeline_queue, job, &job->fence,
+                            lvp_pipeline_create_job, NULL, 0);
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+      if (jobs[i].result != VK_SUCCESS) {
+         result = jobs[i].result;
+         pPipelines[i] = VK_NULL_HANDLE;
+      }
+   }
+
+   vk_free(&device->vk.alloc, jobs);
+   return result;
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
    VkDevice                                    _device,
    VkPipelineCache                             pipelineCache,
@@ -1442,10 +1663,19 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
    const VkAllocationCallbacks*                pAllocator,
    VkPipeline*                                 pPipelines)
 {
+   LVP_FROM_HANDLE(lvp_device, device, _device);
    VkResult result = VK_SUCCESS;
+   bool early_return = false;
    unsigned i = 0;
 
-   for (; i < count; i++) {
+   for (i = 0; i < count; i++)
+      early_return |= !!(pCreateInfos[i].flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT);
+   if (lvp_pipeline_batch_threaded(device, count, early_return))
+      return lvp_create_pipelines_threaded(device, pipelineCache, count,
+                                           pCreateInfos, NULL,
+                                           pAllocator, pPipelines);
+
+   for (i = 0; i < count; i++) {
       VkResult r = VK_PIPELINE_COMPILE_REQUIRED;
       if (!(pCreateInfos[i].flags & VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT))
          r = lvp_graphics_pipeline_create(_device,
@@ -1488,8 +1718,8 @@ lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
                                  &pipeline->compute_create_info, pCreateInfo);
    pipeline->is_compute_pipeline = true;
 
-   lvp_shader_compile_to_ir(pipeline, module->size, module->data,
-                            pCreateInfo->stage.pName,
+   lvp_shader_compile_to_ir(pipeline, cache, module->size, module->data,
+                            module->sha1, pCreateInfo->stage.pName,
                             MESA_SHADER_COMPUTE,
                             pCreateInfo->stage.pSpecializationInfo);
    if (!pipeline->pipeline_nir[MESA_SHADER_COMPUTE])
@@ -1548,10 +1778,19 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateComputePipelines(
    const VkAllocationCallbacks*                pAllocator,
    VkPipeline*                                 pPipelines)
 {
+   LVP_FROM_HANDLE(lvp_device, device, _device);
    VkResult result = VK_SUCCESS;
+   bool early_return = false;
    unsigned i = 0;
 
-   for (; i < count; i++) {
+   for (i = 0; i < count; i++)
+      early_return |= !!(pCreateInfos[i].flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT);
+   if (lvp_pipeline_batch_threaded(device, count, early_return))
+      return lvp_create_pipelines_threaded(device, pipelineCache, count,
+                                           NULL, pCreateInfos,
+                                           pAllocator, pPipelines);
+
+   for (i = 0; i < count; i++) {
       VkResult r = VK_PIPELINE_COMPILE_REQUIRED;
       if (!(pCreateInfos[i].flags & VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT))
          r = lvp_compute_pipeline_create(_device,
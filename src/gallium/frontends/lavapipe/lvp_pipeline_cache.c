@@ -22,6 +22,115 @@
  */
 
 #include "lvp_private.h"
+#include "util/blob.h"
+#include "util/hash_table.h"
+
+static uint32_t
+sha1_hash(const void *key)
+{
+   return _mesa_hash_data(key, 20);
+}
+
+static bool
+sha1_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, 20) == 0;
+}
+
+struct lvp_pipeline_cache_entry *
+lvp_pipeline_cache_search(struct lvp_pipeline_cache *cache,
+                          const unsigned char *sha1)
+{
+   struct hash_entry *he;
+
+   simple_mtx_lock(&cache->mutex);
+   he = _mesa_hash_table_search(cache->table, sha1);
+   simple_mtx_unlock(&cache->mutex);
+
+   /* Entries are only freed together with the cache. */
+   return he ? he->data : NULL;
+}
+
+static void
+lvp_pipeline_cache_add_entry(struct lvp_pipeline_cache *cache,
+                             const unsigned char *sha1,
+                             const struct lvp_access_info *access,
+                             const void *nir, uint32_t nir_size)
+{
+   struct lvp_pipeline_cache_entry *entry;
+
+   if (_mesa_hash_table_search(cache->table, sha1))
+      return;
+
+   entry = vk_alloc(&cache->alloc, sizeof(*entry) + nir_size, 8,
+                    VK_SYSTEM_ALLOCATION_SCOPE_CACHE);
+   if (!entry)
+      return;
+
+   memcpy(entry->sha1, sha1, sizeof(entry->sha1));
+   entry->access = *access;
+   entry->nir_size = nir_size;
+   memcpy(entry->nir, nir, nir_size);
+   _mesa_hash_table_insert(cache->table, entry->sha1, entry);
+}
+
+void
+lvp_pipeline_cache_insert(struct lvp_pipeline_cache *cache,
+                          const unsigned char *sha1,
+                          const struct lvp_access_info *access,
+                          const void *nir, uint32_t nir_size)
+{
+   simple_mtx_lock(&cache->mutex);
+   lvp_pipeline_cache_add_entry(cache, sha1, access, nir, nir_size);
+   simple_mtx_unlock(&cache->mutex);
+}
+
+static void
+lvp_pipeline_cache_load(struct lvp_pipeline_cache *cache,
+                        const void *data, size_t size)
+{
+   struct blob_reader blob;
+   uint8_t uuid[VK_UUID_SIZE];
+   uint8_t cache_uuid[VK_UUID_SIZE];
+
+   blob_reader_init(&blob, data, size);
+
+   uint32_t header_size = blob_read_uint32(&blob);
+   uint32_t header_version = blob_read_uint32(&blob);
+   uint32_t vendor_id = blob_read_uint32(&blob);
+   uint32_t device_id = blob_read_uint32(&blob);
+   blob_copy_bytes(&blob, uuid, VK_UUID_SIZE);
+   if (blob.overrun || header_size < 32 || header_size > size)
+      return;
+   if (header_version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+       vendor_id != VK_VENDOR_ID_MESA || device_id != 0)
+      return;
+   lvp_device_get_cache_uuid(cache_uuid);
+   if (memcmp(uuid, cache_uuid, VK_UUID_SIZE))
+      return;
+
+   blob_skip_bytes(&blob, header_size - 32);
+   while (blob.current < blob.end) {
+      const unsigned char *sha1 = blob_read_bytes(&blob, 20);
+      struct lvp_access_info access;
+      blob_copy_bytes(&blob, &access, sizeof(access));
+      uint32_t nir_size = 0;
+      blob_copy_bytes(&blob, &nir_size, sizeof(nir_size));
+      const void *nir = blob_read_bytes(&blob, nir_size);
+      if (blob.overrun)
+         break;
+      lvp_pipeline_cache_add_entry(cache, sha1, &access, nir, nir_size);
+   }
+}
+
+static void
+lvp_pipeline_cache_finish(struct lvp_pipeline_cache *cache)
+{
+   hash_table_foreach(cache->table, he)
+      vk_free(&cache->alloc, he->data);
+   _mesa_hash_table_destroy(cache->table, NULL);
+   simple_mtx_destroy(&cache->mutex);
+}
 
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreatePipelineCache(
     VkDevice                                    _device,
@@ -40,6 +149,12 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreatePipelineCache(
    if (cache == NULL)
       return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
 
+   cache->table = _mesa_hash_table_create(NULL, sha1_hash, sha1_equal);
+   if (cache->table == NULL) {
+      vk_free2(&device->vk.alloc, pAllocator, cache);
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
    vk_object_base_init(&device->vk, &cache->base,
                        VK_OBJECT_TYPE_PIPELINE_CACHE);
    if (pAllocator)
@@ -48,6 +163,12 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreatePipelineCache(
      cache->alloc = device->vk.alloc;
 
    cache->device = device;
+   simple_mtx_init(&cache->mutex, mtx_plain);
+
+   if (pCreateInfo->initialDataSize)
+      lvp_pipeline_cache_load(cache, pCreateInfo->pInitialData,
+                              pCreateInfo->initialDataSize);
+
    *pPipelineCache = lvp_pipeline_cache_to_handle(cache);
 
    return VK_SUCCESS;
@@ -63,7 +184,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyPipelineCache(
 
    if (!_cache)
       return;
-//   lvp_pipeline_cache_finish(cache);
+   lvp_pipeline_cache_finish(cache);
    vk_object_base_finish(&cache->base);
    vk_free2(&device->vk.alloc, pAllocator, cache);
 }
@@ -74,21 +195,46 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_GetPipelineCacheData(
         size_t*                                     pDataSize,
         void*                                       pData)
 {
+   LVP_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
    VkResult result = VK_SUCCESS;
-   if (pData) {
-      if (*pDataSize < 32) {
-         *pDataSize = 0;
+   struct blob blob;
+   uint8_t uuid[VK_UUID_SIZE];
+
+   if (pData)
+      blob_init_fixed(&blob, pData, *pDataSize);
+   else
+      blob_init_fixed(&blob, NULL, SIZE_MAX);
+
+   lvp_device_get_cache_uuid(uuid);
+   blob_write_uint32(&blob, 32);
+   blob_write_uint32(&blob, VK_PIPELINE_CACHE_HEADER_VERSION_ONE);
+   blob_write_uint32(&blob, VK_VENDOR_ID_MESA);
+   blob_write_uint32(&blob, 0);
+   blob_write_bytes(&blob, uuid, VK_UUID_SIZE);
+   if (blob.out_of_memory) {
+      *pDataSize = 0;
+      return VK_INCOMPLETE;
+   }
+
+   simple_mtx_lock(&cache->mutex);
+   hash_table_foreach(cache->table, he) {
+      const struct lvp_pipeline_cache_entry *entry = he->data;
+      size_t entry_size = sizeof(entry->sha1) + sizeof(entry->access) +
+                          sizeof(entry->nir_size) + entry->nir_size;
+
+      /* Only write out whole entries. */
+      if (blob.size + entry_size > blob.allocated) {
          result = VK_INCOMPLETE;
-      } else {
-         uint32_t *hdr = (uint32_t *)pData;
-         hdr[0] = 32;
-         hdr[1] = 1;
-         hdr[2] = VK_VENDOR_ID_MESA;
-         hdr[3] = 0;
-         lvp_device_get_cache_uuid(&hdr[4]);
+         break;
       }
-   } else
-      *pDataSize = 32;
+      blob_write_bytes(&blob, entry->sha1, sizeof(entry->sha1));
+      blob_write_bytes(&blob, &entry->access, sizeof(entry->access));
+      blob_write_bytes(&blob, &entry->nir_size, sizeof(entry->nir_size));
+      blob_write_bytes(&blob, entry->nir, entry->nir_size);
+   }
+   simple_mtx_unlock(&cache->mutex);
+
+   *pDataSize = blob.size;
    return result;
 }
 
@@ -98,5 +244,21 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_MergePipelineCaches(
         uint32_t                                    srcCacheCount,
         const VkPipelineCache*                      pSrcCaches)
 {
+   LVP_FROM_HANDLE(lvp_pipeline_cache, dst, destCache);
+
+   simple_mtx_lock(&dst->mutex);
+   for (uint32_t i = 0; i < srcCacheCount; i++) {
+      LVP_FROM_HANDLE(lvp_pipeline_cache, src, pSrcCaches[i]);
+
+      simple_mtx_lock(&src->mutex);
+      hash_table_foreach(src->table, he) {
+         const struct lvp_pipeline_cache_entry *entry = he->data;
+         lvp_pipeline_cache_add_entry(dst, entry->sha1, &entry->access,
+                                      entry->nir, entry->nir_size);
+      }
+      simple_mtx_unlock(&src->mutex);
+   }
+   simple_mtx_unlock(&dst->mutex);
+
    return VK_SUCCESS;
 }
@@ -82,6 +82,12 @@ extern "C" {
 #define MAX_DESCRIPTOR_UNIFORM_BLOCK_SIZE 4096
 #define MAX_PER_STAGE_DESCRIPTOR_UNIFORM_BLOCKS 8
 
+#define LVP_QUEUE_FAMILY_GENERAL 0
+#define LVP_QUEUE_FAMILY_COMPUTE 1
+#define LVP_QUEUE_FAMILY_COUNT   2
+#define LVP_MAX_QUEUES_PER_FAMILY 4
+#define LVP_MAX_QUEUES (LVP_QUEUE_FAMILY_COUNT * LVP_MAX_QUEUES_PER_FAMILY)
+
 #ifdef _WIN32
 #define lvp_printflike(a, b)
 #else
@@ -169,27 +175,42 @@ bool lvp_physical_device_extension_supported(struct lvp_physical_device *dev,
 struct lvp_queue {
    struct vk_queue vk;
    struct lvp_device *                         device;
+   /* index into lvp_device::queues */
+   uint32_t index;
    struct pipe_context *ctx;
    struct cso_context *cso;
    struct u_upload_mgr *uploader;
    struct pipe_fence_handle *last_fence;
    void *state;
+   /* serializes use of ctx between the submit thread and object creation */
+   simple_mtx_t lock;
 };
 
 struct lvp_pipeline_cache {
    struct vk_object_base                        base;
    struct lvp_device *                          device;
    VkAllocationCallbacks                        alloc;
+
+   simple_mtx_t                                 mutex;
+   /* sha1 -> struct lvp_pipeline_cache_entry */
+   struct hash_table *                          table;
 };
 
 struct lvp_device {
    struct vk_device vk;
 
-   struct lvp_queue queue;
+   /* every queue has its own context; queues[0] is also used to create and
+    * destroy objects outside of command buffer execution
+    */
+   uint32_t queue_count;
+   struct lvp_queue *queues;
    struct lvp_instance *                       instance;
    struct lvp_physical_device *physical_device;
    struct pipe_screen *pscreen;
    bool poison_mem;
+
+   /* worker threads used to create batches of pipelines */
+   struct util_queue pipeline_queue;
 };
 
 void lvp_device_get_cache_uuid(void *uuid);
@@ -249,6 +270,10 @@ struct lvp_image_view {
    enum pipe_format pformat;
 
    struct pipe_surface *surface; /* have we created a pipe surface for this? */
+
+   /* gallium views used when this view is bound through a descriptor */
+   struct pipe_sampler_view *sv;
+   struct pipe_image_view iv;
 };
 
 struct lvp_sampler {
@@ -257,6 +282,7 @@ struct lvp_sampler {
    union pipe_color_union border_color;
    VkSamplerReductionMode reduction_mode;
    uint32_t state[4];
+   struct pipe_sampler_state pstate;
 };
 
 struct lvp_descriptor_set_binding_layout {
@@ -359,10 +385,26 @@ struct lvp_descriptor {
    union lvp_descriptor_info info;
 };
 
+/* The gallium bindings of one shader stage of a descriptor set, indexed
+ * like lvp_descriptor_set_binding_layout::stage.  These are kept up to date
+ * by the descriptor updates so that binding the set only has to copy them
+ * into the context's slots.  The table holds a reference on each sampler
+ * view.  Dynamic buffer offsets are applied when the set is bound.
+ */
+struct lvp_descriptor_table {
+   struct pipe_constant_buffer *const_buffers;
+   struct pipe_shader_buffer *shader_buffers;
+   struct pipe_sampler_state *samplers;
+   struct pipe_sampler_view **sampler_views;
+   struct pipe_image_view *images;
+   uint8_t **uniform_blocks;
+};
+
 struct lvp_descriptor_set {
    struct vk_object_base base;
    struct lvp_descriptor_set_layout *layout;
    struct list_head link;
+   struct lvp_descriptor_table tables[MESA_SHADER_STAGES];
    struct lvp_descriptor descriptors[0];
 };
 
@@ -439,6 +481,25 @@ struct lvp_access_info {
    uint32_t buffers_written;
 };
 
+/* A single shader stage as produced by lvp_shader_compile_to_ir, stored in
+ * serialized NIR form so that it can be handed back to the application.
+ */
+struct lvp_pipeline_cache_entry {
+   unsigned char sha1[20];
+   struct lvp_access_info access;
+   uint32_t nir_size;
+   uint8_t nir[0];
+};
+
+struct lvp_pipeline_cache_entry *
+lvp_pipeline_cache_search(struct lvp_pipeline_cache *cache,
+                          const unsigned char *sha1);
+void
+lvp_pipeline_cache_insert(struct lvp_pipeline_cache *cache,
+                          const unsigned char *sha1,
+                          const struct lvp_access_info *access,
+                          const void *nir, uint32_t nir_size);
+
 struct lvp_pipeline {
    struct vk_object_base base;
    struct lvp_device *                          device;
@@ -450,7 +511,10 @@ struct lvp_pipeline {
    bool is_compute_pipeline;
    bool force_min_sample;
    nir_shader *pipeline_nir[MESA_SHADER_STAGES];
-   void *shader_cso[PIPE_SHADER_TYPES];
+   /* indexed by lvp_queue::index; shaders are created for queues[0] along
+    * with the pipeline and on first use for the other queues
+    */
+   void *shader_cso[LVP_MAX_QUEUES][PIPE_SHADER_TYPES];
    VkGraphicsPipelineCreateInfo graphics_create_info;
    VkComputePipelineCreateInfo compute_create_info;
    VkGraphicsPipelineLibraryFlagsEXT stages;
@@ -491,6 +555,10 @@ struct lvp_buffer_view {
    struct lvp_buffer *buffer;
    uint32_t offset;
    uint64_t range;
+
+   /* gallium views used when this view is bound through a descriptor */
+   struct pipe_sampler_view *sv;
+   struct pipe_image_view iv;
 };
 
 struct lvp_query_pool {
@@ -499,6 +567,8 @@ struct lvp_query_pool {
    uint32_t count;
    VkQueryPipelineStatisticFlags pipeline_stats;
    enum pipe_query_type base_type;
+   /* the queue whose context created each query, after queries[] */
+   struct lvp_queue **owners;
    struct pipe_query *queries[0];
 };
 
@@ -590,6 +660,9 @@ struct lvp_cmd_push_descriptor_set {
 
 void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp);
 
+void *lvp_pipeline_get_shader_cso(struct lvp_pipeline *pipeline,
+                                   struct lvp_queue *queue,
+                                   enum pipe_shader_type pstage);
 VkResult lvp_execute_cmds(struct lvp_device *device,
                           struct lvp_queue *queue,
                           struct lvp_cmd_buffer *cmd_buffer);
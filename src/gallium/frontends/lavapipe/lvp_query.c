@@ -24,6 +24,20 @@
 #include "lvp_private.h"
 #include "pipe/p_context.h"
 
+/* Queries belong to the context of the queue that created them, which its
+ * submit thread may be using at the same time.
+ */
+static void
+destroy_query(struct lvp_query_pool *pool, uint32_t idx)
+{
+   struct lvp_queue *queue = pool->owners[idx];
+
+   simple_mtx_lock(&queue->lock);
+   queue->ctx->destroy_query(queue->ctx, pool->queries[idx]);
+   simple_mtx_unlock(&queue->lock);
+   pool->queries[idx] = NULL;
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateQueryPool(
     VkDevice                                    _device,
     const VkQueryPoolCreateInfo*                pCreateInfo,
@@ -53,7 +67,9 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateQueryPool(
       return VK_ERROR_FEATURE_NOT_PRESENT;
    }
    struct lvp_query_pool *pool;
-   uint32_t pool_size = sizeof(*pool) + pCreateInfo->queryCount * sizeof(struct pipe_query *);
+   uint32_t pool_size = sizeof(*pool) +
+      pCreateInfo->queryCount * (sizeof(struct pipe_query *) +
+                                 sizeof(struct lvp_queue *));
 
    pool = vk_zalloc2(&device->vk.alloc, pAllocator,
                     pool_size, 8,
@@ -67,6 +83,7 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateQueryPool(
    pool->count = pCreateInfo->queryCount;
    pool->base_type = pipeq;
    pool->pipeline_stats = pCreateInfo->pipelineStatistics;
+   pool->owners = (struct lvp_queue **)&pool->queries[pool->count];
 
    *pQueryPool = lvp_query_pool_to_handle(pool);
    return VK_SUCCESS;
@@ -85,7 +102,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyQueryPool(
 
    for (unsigned i = 0; i < pool->count; i++)
       if (pool->queries[i])
-         device->queue.ctx->destroy_query(device->queue.ctx, pool->queries[i]);
+         destroy_query(pool, i);
    vk_object_base_finish(&pool->base);
    vk_free2(&device->vk.alloc, pAllocator, pool);
 }
@@ -111,10 +128,14 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_GetQueryPoolResults(
       union pipe_query_result result;
       bool ready = false;
       if (pool->queries[i]) {
-        ready = device->queue.ctx->get_query_result(device->queue.ctx,
-                                                    pool->queries[i],
-                                                    (flags & VK_QUERY_RESULT_WAIT_BIT),
-                                                    &result);
+        struct lvp_queue *queue = pool->owners[i];
+
+        simple_mtx_lock(&queue->lock);
+        ready = queue->ctx->get_query_result(queue->ctx,
+                                             pool->queries[i],
+                                             (flags & VK_QUERY_RESULT_WAIT_BIT),
+                                             &result);
+        simple_mtx_unlock(&queue->lock);
       } else {
         result.u64 = 0;
       }
@@ -203,15 +224,12 @@ VKAPI_ATTR void VKAPI_CALL lvp_ResetQueryPool(
    uint32_t                                    firstQuery,
    uint32_t                                    queryCount)
 {
-   LVP_FROM_HANDLE(lvp_device, device, _device);
    LVP_FROM_HANDLE(lvp_query_pool, pool, queryPool);
 
    for (uint32_t i = 0; i < queryCount; i++) {
       uint32_t idx = i + firstQuery;
 
-      if (pool->queries[idx]) {
-         device->queue.ctx->destroy_query(device->queue.ctx, pool->queries[idx]);
-         pool->queries[idx] = NULL;
-      }
+      if (pool->queries[idx])
+         destroy_query(pool, idx);
    }
 }
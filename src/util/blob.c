@@ -211,6 +211,23 @@ BLOB_WRITE_TYPE(blob_write_uint32, uint32_t)
 BLOB_WRITE_TYPE(blob_write_uint64, uint64_t)
 BLOB_WRITE_TYPE(blob_write_intptr, intptr_t)
 
+bool
+blob_write_uleb128(struct blob *blob, uint32_t value)
+{
+   uint8_t bytes[5];
+   unsigned len = 0;
+
+   do {
+      bytes[len] = value & 0x7f;
+      value >>= 7;
+      if (value)
+         bytes[len] |= 0x80;
+      len++;
+   } while (value);
+
+   return blob_write_bytes(blob, bytes, len);
+}
+
 #define ASSERT_ALIGNED(_offset, _align) \
    assert(align64((_offset), (_align)) == (_offset))
 
@@ -333,6 +350,26 @@ BLOB_READ_TYPE(blob_read_uint32, uint32_t)
 BLOB_READ_TYPE(blob_read_uint64, uint64_t)
 BLOB_READ_TYPE(blob_read_intptr, intptr_t)
 
+uint32_t
+blob_read_uleb128(struct blob_reader *blob)
+{
+   uint32_t value = 0;
+
+   for (unsigned shift = 0; shift < 35; shift += 7) {
+      if (!ensure_can_read(blob, 1))
+         return 0;
+
+      uint8_t byte = *blob->current++;
+      value |= (uint32_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+         return value;
+   }
+
+   /* More than 5 bytes can't be a valid 32-bit value. */
+   blob->overrun = true;
+   return 0;
+}
+
 char *
 blob_read_string(struct blob_reader *blob)
 {
@@ -340,8 +377,10 @@ blob_read_string(struct blob_reader *blob)
    char *ret;
    uint8_t *nul;
 
-   /* If we're already at the end, then this is an overrun. */
-   if (blob->current >= blob->end) {
+   /* If we're already at the end, or an earlier read overran, then this is
+    * an overrun.
+    */
+   if (blob->overrun || blob->current >= blob->end) {
       blob->overrun = true;
       return NULL;
    }
@@ -264,6 +264,20 @@ blob_overwrite_uint32(struct blob *blob,
 bool
 blob_write_uint64(struct blob *blob, uint64_t value);
 
+/**
+ * Add a uint32_t to a blob using a variable-length (unsigned LEB128)
+ * encoding: 7 bits per byte, least significant group first, with the high
+ * bit set on all but the last byte.
+ *
+ * Small values take a single byte, and no alignment padding is inserted, so
+ * this is meant for values that are usually small and are surrounded by other
+ * unaligned data.
+ *
+ * \return True unless allocation failed.
+ */
+bool
+blob_write_uleb128(struct blob *blob, uint32_t value);
+
 /**
  * Add an intptr_t to a blob.
  *
@@ -387,6 +401,16 @@ blob_read_uint32(struct blob_reader *blob);
 uint64_t
 blob_read_uint64(struct blob_reader *blob);
 
+/**
+ * Read a uint32_t written by blob_write_uleb128 from the current location,
+ * (and update the current location to just past it).
+ *
+ * \return The uint32_t read, or 0 if the encoding runs past the end of the
+ * blob or does not fit in 32 bits (in which case the overrun flag is set).
+ */
+uint32_t
+blob_read_uleb128(struct blob_reader *blob);
+
 /**
  * Read an intptr_t value from the current location, (and update the
  * current location to just past this intptr_t).
@@ -111,11 +111,6 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
    if (cache->path == NULL)
       goto path_fail;
 
-   if (env_var_as_boolean("MESA_DISK_CACHE_SINGLE_FILE", false)) {
-      if (!disk_cache_load_cache_index(local, cache))
-         goto path_fail;
-   }
-
    if (!disk_cache_mmap_cache_index(local, cache, path))
       goto path_fail;
 
@@ -169,6 +164,16 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
 
    cache->max_size = max_size;
 
+   /* The single file cache enforces max_size itself, so load it once we
+    * know that.
+    */
+   if (env_var_as_boolean("MESA_DISK_CACHE_SINGLE_FILE", false)) {
+      if (!disk_cache_load_cache_index(local, cache)) {
+         disk_cache_destroy_mmap(cache);
+         goto path_fail;
+      }
+   }
+
    /* 4 threads were chosen below because just about all modern CPUs currently
     * available that run Mesa have *at least* 4 cores. For these CPUs allowing
     * more threads can result in the queue being processed faster, thus
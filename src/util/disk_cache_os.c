@@ -455,7 +455,7 @@ disk_cache_evict_item(struct disk_cache *cache, char *filename)
 }
 
 static void *
-parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
+parse_and_validate_cache_item(struct disk_cache *cache, const void *cache_item,
                               size_t cache_item_size, size_t *size)
 {
    uint8_t *uncompressed_data = NULL;
@@ -891,15 +891,11 @@ disk_cache_load_item_foz(struct disk_cache *cache, const cache_key key,
                          size_t *size)
 {
    size_t cache_tem_size = 0;
-   void *cache_item = foz_read_entry(&cache->foz_db, key, &cache_tem_size);
+   const void *cache_item = foz_map_entry(&cache->foz_db, key, &cache_tem_size);
    if (!cache_item)
       return NULL;
 
-   uint8_t *uncompressed_data =
-       parse_and_validate_cache_item(cache, cache_item, cache_tem_size, size);
-   free(cache_item);
-
-   return uncompressed_data;
+   return parse_and_validate_cache_item(cache, cache_item, cache_tem_size, size);
 }
 
 bool
@@ -922,6 +918,7 @@ bool
 disk_cache_load_cache_index(void *mem_ctx, struct disk_cache *cache)
 {
    /* Load cache index into a hash map (from fossilise files) */
+   cache->foz_db.max_size = cache->max_size;
    return foz_prepare(&cache->foz_db, cache->path);
 }
 
@@ -1146,6 +1146,27 @@ util_format_unpack_table_init(void)
       }
 #endif
 
+#if defined(USE_SSE41) && !defined(NO_FORMAT_ASM)
+      /* The x86 code is built with extra -m flags, so check the CPU before
+       * even looking at its tables.
+       */
+      if (util_get_cpu_caps()->has_avx2 && util_get_cpu_caps()->has_f16c) {
+         const struct util_format_unpack_description *unpack = util_format_unpack_description_avx2(format);
+         if (unpack) {
+            util_format_unpack_table[format] = unpack;
+            continue;
+         }
+      }
+
+      if (util_get_cpu_caps()->has_sse4_1) {
+         const struct util_format_unpack_description *unpack = util_format_unpack_description_sse41(format);
+         if (unpack) {
+            util_format_unpack_table[format] = unpack;
+            continue;
+         }
+      }
+#endif
+
       util_format_unpack_table[format] = util_format_unpack_description_generic(format);
    }
 }
@@ -1159,6 +1180,43 @@ util_format_unpack_description(enum pipe_format format)
    return util_format_unpack_table[format];
 }
 
+static const struct util_format_pack_description *util_format_pack_table[PIPE_FORMAT_COUNT];
+
+static void
+util_format_pack_table_init(void)
+{
+   for (enum pipe_format format = PIPE_FORMAT_NONE; format < PIPE_FORMAT_COUNT; format++) {
+#if defined(USE_SSE41) && !defined(NO_FORMAT_ASM)
+      if (util_get_cpu_caps()->has_avx2 && util_get_cpu_caps()->has_f16c) {
+         const struct util_format_pack_description *pack = util_format_pack_description_avx2(format);
+         if (pack) {
+            util_format_pack_table[format] = pack;
+            continue;
+         }
+      }
+
+      if (util_get_cpu_caps()->has_sse4_1) {
+         const struct util_format_pack_description *pack = util_format_pack_description_sse41(format);
+         if (pack) {
+            util_format_pack_table[format] = pack;
+            continue;
+         }
+      }
+#endif
+
+      util_format_pack_table[format] = util_format_pack_description_generic(format);
+   }
+}
+
+const struct util_format_pack_description *
+util_format_pack_description(enum pipe_format format)
+{
+   static once_flag flag = ONCE_FLAG_INIT;
+   call_once(&flag, util_format_pack_table_init);
+
+   return util_format_pack_table[format];
+}
+
 enum pipe_format
 util_format_snorm_to_unorm(enum pipe_format format)
 {
@@ -412,9 +412,14 @@ typedef void (*util_format_fetch_rgba_func_ptr)(void *restrict dst, const uint8_
 const struct util_format_description *
 util_format_description(enum pipe_format format) ATTRIBUTE_CONST;
 
+/* Lookup with CPU detection for choosing optimized paths. */
 const struct util_format_pack_description *
 util_format_pack_description(enum pipe_format format) ATTRIBUTE_CONST;
 
+/* Codegenned table of CPU-agnostic pack code. */
+const struct util_format_pack_description *
+util_format_pack_description_generic(enum pipe_format format) ATTRIBUTE_CONST;
+
 /* Lookup with CPU detection for choosing optimized paths. */
 const struct util_format_unpack_description *
 util_format_unpack_description(enum pipe_format format) ATTRIBUTE_CONST;
@@ -426,6 +431,18 @@ util_format_unpack_description_generic(enum pipe_format format) ATTRIBUTE_CONST;
 const struct util_format_unpack_description *
 util_format_unpack_description_neon(enum pipe_format format) ATTRIBUTE_CONST;
 
+const struct util_format_unpack_description *
+util_format_unpack_description_sse41(enum pipe_format format) ATTRIBUTE_CONST;
+
+const struct util_format_pack_description *
+util_format_pack_description_sse41(enum pipe_format format) ATTRIBUTE_CONST;
+
+const struct util_format_unpack_description *
+util_format_unpack_description_avx2(enum pipe_format format) ATTRIBUTE_CONST;
+
+const struct util_format_pack_description *
+util_format_pack_description_avx2(enum pipe_format format) ATTRIBUTE_CONST;
+
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
 #endif
@@ -0,0 +1,361 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * AVX2/F16C versions of the pack/unpack functions of the most common
+ * formats.  See u_format_sse41.c for the ground rules; this file is built
+ * with -mavx2 -mf16c and must only be used when util_get_cpu_caps() reports
+ * both.
+ */
+
+#include <immintrin.h>
+
+#include <u_format.h>
+#include "u_format_pack.h"
+
+/* See float4_to_ubyte4() in u_format_sse41.c. */
+static inline __m256i
+float8_to_ubyte8(__m256 f)
+{
+   f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()),
+                     _mm256_set1_ps(1.0f));
+   f = _mm256_add_ps(_mm256_mul_ps(f, _mm256_set1_ps(255.0f / 256.0f)),
+                     _mm256_set1_ps(32768.0f));
+   return _mm256_and_si256(_mm256_castps_si256(f), _mm256_set1_epi32(0xff));
+}
+
+static inline __m256
+ubyte8_to_float8(__m128i bytes)
+{
+   return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)),
+                        _mm256_set1_ps(1.0f / 255.0f));
+}
+
+static inline __m128i
+swap_rb_8unorm(__m128i pixels)
+{
+   return _mm_shuffle_epi8(pixels, _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                                 10, 9, 8, 11, 14, 13, 12, 15));
+}
+
+/*
+ * R8G8B8A8_UNORM and B8G8R8A8_UNORM
+ */
+
+static unsigned
+copy_8unorm(uint8_t *restrict dst, const uint8_t *restrict src,
+            unsigned width, bool swap_rb)
+{
+   const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15,
+                                         2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15);
+   unsigned x;
+
+   for (x = 0; x + 8 <= width; x += 8) {
+      __m256i pixels = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+      if (swap_rb)
+         pixels = _mm256_shuffle_epi8(pixels, swap);
+      _mm256_storeu_si256((__m256i *)(dst + x * 4), pixels);
+   }
+
+   return x;
+}
+
+static unsigned
+unpack_8unorm_float(float *restrict dst, const uint8_t *restrict src,
+                    unsigned width, bool swap_rb)
+{
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      if (swap_rb)
+         pixels = swap_rb_8unorm(pixels);
+
+      _mm256_storeu_ps(dst + x * 4, ubyte8_to_float8(pixels));
+      _mm256_storeu_ps(dst + x * 4 + 8,
+                       ubyte8_to_float8(_mm_srli_si128(pixels, 8)));
+   }
+
+   return x;
+}
+
+static unsigned
+pack_8unorm_float(uint8_t *restrict dst, const float *restrict src,
+                  unsigned width, bool swap_rb)
+{
+   /* The packs work within 128-bit lanes, which leaves pixels 0 and 2 at the
+    * bottom of the low lane and pixels 1 and 3 at the bottom of the high one.
+    */
+   const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0);
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      __m256i p01 = float8_to_ubyte8(_mm256_loadu_ps(src + x * 4));
+      __m256i p23 = float8_to_ubyte8(_mm256_loadu_ps(src + x * 4 + 8));
+      __m256i packed = _mm256_packus_epi32(p01, p23);
+      packed = _mm256_packus_epi16(packed, packed);
+      packed = _mm256_permutevar8x32_epi32(packed, order);
+
+      __m128i pixels = _mm256_castsi256_si128(packed);
+      if (swap_rb)
+         pixels = swap_rb_8unorm(pixels);
+      _mm_storeu_si128((__m128i *)(dst + x * 4), pixels);
+   }
+
+   return x;
+}
+
+#define DEFINE_8UNORM_FUNCS(sn, swap_rb)                                      \
+static void                                                                   \
+util_format_##sn##_unpack_rgba_8unorm_avx2(uint8_t *restrict dst,             \
+                                           const uint8_t *restrict src,       \
+                                           unsigned width)                    \
+{                                                                             \
+   unsigned x = copy_8unorm(dst, src, width, swap_rb);                        \
+   if (x < width)                                                             \
+      util_format_##sn##_unpack_rgba_8unorm(dst + x * 4, src + x * 4,         \
+                                            width - x);                       \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+util_format_##sn##_unpack_rgba_float_avx2(void *restrict dst,                 \
+                                          const uint8_t *restrict src,        \
+                                          unsigned width)                     \
+{                                                                             \
+   unsigned x = unpack_8unorm_float(dst, src, width, swap_rb);                \
+   if (x < width)                                                             \
+      util_format_##sn##_unpack_rgba_float((float *)dst + x * 4, src + x * 4, \
+                                           width - x);                        \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+util_format_##sn##_pack_rgba_8unorm_avx2(uint8_t *restrict dst_row,           \
+                                         unsigned dst_stride,                 \
+                                         const uint8_t *restrict src_row,     \
+                                         unsigned src_stride,                 \
+                                         unsigned width, unsigned height)     \
+{                                                                             \
+   for (unsigned y = 0; y < height; y++) {                                    \
+      unsigned x = copy_8unorm(dst_row, src_row, width, swap_rb);             \
+      if (x < width)                                                          \
+         util_format_##sn##_pack_rgba_8unorm(dst_row + x * 4, 0,              \
+                                             src_row + x * 4, 0,              \
+                                             width - x, 1);                   \
+      dst_row += dst_stride;                                                  \
+      src_row += src_stride;                                                  \
+   }                                                                          \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+util_format_##sn##_pack_rgba_float_avx2(uint8_t *restrict dst_row,            \
+                                        unsigned dst_stride,                  \
+                                        const float *restrict src_row,        \
+                                        unsigned src_stride,                  \
+                                        unsigned width, unsigned height)      \
+{                                                                             \
+   for (unsigned y = 0; y < height; y++) {                                    \
+      unsigned x = pack_8unorm_float(dst_row, src_row, width, swap_rb);       \
+      if (x < width)                                                          \
+         util_format_##sn##_pack_rgba_float(dst_row + x * 4, 0,               \
+                                            src_row + x * 4, 0,               \
+                                            width - x, 1);                    \
+      dst_row += dst_stride;                                                  \
+      src_row += src_stride / sizeof(*src_row);                               \
+   }                                                                          \
+}
+
+DEFINE_8UNORM_FUNCS(r8g8b8a8_unorm, false)
+DEFINE_8UNORM_FUNCS(b8g8r8a8_unorm, true)
+
+/*
+ * R16_FLOAT and R16G16B16A16_FLOAT
+ *
+ * The generic code converts with _mesa_half_to_float() and
+ * _mesa_float_to_float16_rtz(), which use the same F16C instructions.
+ */
+
+static void
+util_format_r16_float_unpack_rgba_float_avx2(void *restrict dst_row,
+                                             const uint8_t *restrict src,
+                                             unsigned width)
+{
+   float *dst = dst_row;
+   const __m128 zero_one = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      __m128 r = _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(src + x * 2)));
+      float *d = dst + x * 4;
+
+      _mm_storeu_ps(d + 0, _mm_blend_ps(zero_one, r, 0x1));
+      _mm_storeu_ps(d + 4, _mm_blend_ps(zero_one,
+                                        _mm_permute_ps(r, _MM_SHUFFLE(1, 1, 1, 1)), 0x1));
+      _mm_storeu_ps(d + 8, _mm_blend_ps(zero_one,
+                                        _mm_permute_ps(r, _MM_SHUFFLE(2, 2, 2, 2)), 0x1));
+      _mm_storeu_ps(d + 12, _mm_blend_ps(zero_one,
+                                         _mm_permute_ps(r, _MM_SHUFFLE(3, 3, 3, 3)), 0x1));
+   }
+
+   if (x < width)
+      util_format_r16_float_unpack_rgba_float(dst + x * 4, src + x * 2,
+                                              width - x);
+}
+
+static void
+util_format_r16_float_pack_rgba_float_avx2(uint8_t *restrict dst_row,
+                                           unsigned dst_stride,
+                                           const float *restrict src_row,
+                                           unsigned src_stride,
+                                           unsigned width, unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         const float *s = src_row + x * 4;
+         __m128 rg01 = _mm_unpacklo_ps(_mm_loadu_ps(s + 0), _mm_loadu_ps(s + 4));
+         __m128 rg23 = _mm_unpacklo_ps(_mm_loadu_ps(s + 8), _mm_loadu_ps(s + 12));
+         __m128i r = _mm_cvtps_ph(_mm_movelh_ps(rg01, rg23), _MM_FROUND_TO_ZERO);
+         _mm_storel_epi64((__m128i *)(dst_row + x * 2), r);
+      }
+
+      if (x < width)
+         util_format_r16_float_pack_rgba_float(dst_row + x * 2, 0,
+                                               src_row + x * 4, 0,
+                                               width - x, 1);
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static void
+util_format_r16g16b16a16_float_unpack_rgba_float_avx2(void *restrict dst_row,
+                                                      const uint8_t *restrict src,
+                                                      unsigned width)
+{
+   float *dst = dst_row;
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      const __m128i *s = (const __m128i *)(src + x * 8);
+      _mm256_storeu_ps(dst + x * 4, _mm256_cvtph_ps(_mm_loadu_si128(s)));
+      _mm256_storeu_ps(dst + x * 4 + 8, _mm256_cvtph_ps(_mm_loadu_si128(s + 1)));
+   }
+
+   if (x < width)
+      util_format_r16g16b16a16_float_unpack_rgba_float(dst + x * 4, src + x * 8,
+                                                       width - x);
+}
+
+static void
+util_format_r16g16b16a16_float_pack_rgba_float_avx2(uint8_t *restrict dst_row,
+                                                    unsigned dst_stride,
+                                                    const float *restrict src_row,
+                                                    unsigned src_stride,
+                                                    unsigned width,
+                                                    unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         const float *s = src_row + x * 4;
+         __m128i *d = (__m128i *)(dst_row + x * 8);
+         _mm_storeu_si128(d, _mm256_cvtps_ph(_mm256_loadu_ps(s),
+                                             _MM_FROUND_TO_ZERO));
+         _mm_storeu_si128(d + 1, _mm256_cvtps_ph(_mm256_loadu_ps(s + 8),
+                                                 _MM_FROUND_TO_ZERO));
+      }
+
+      if (x < width)
+         util_format_r16g16b16a16_float_pack_rgba_float(dst_row + x * 8, 0,
+                                                        src_row + x * 4, 0,
+                                                        width - x, 1);
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static const struct util_format_unpack_description util_format_unpack_descriptions_avx2[] = {
+   [PIPE_FORMAT_R8G8B8A8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r8g8b8a8_unorm_unpack_rgba_8unorm_avx2,
+      .unpack_rgba = &util_format_r8g8b8a8_unorm_unpack_rgba_float_avx2,
+   },
+   [PIPE_FORMAT_B8G8R8A8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_b8g8r8a8_unorm_unpack_rgba_8unorm_avx2,
+      .unpack_rgba = &util_format_b8g8r8a8_unorm_unpack_rgba_float_avx2,
+   },
+   [PIPE_FORMAT_R16_FLOAT] = {
+      .unpack_rgba_8unorm = &util_format_r16_float_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r16_float_unpack_rgba_float_avx2,
+   },
+   [PIPE_FORMAT_R16G16B16A16_FLOAT] = {
+      .unpack_rgba_8unorm = &util_format_r16g16b16a16_float_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r16g16b16a16_float_unpack_rgba_float_avx2,
+   },
+};
+
+static const struct util_format_pack_description util_format_pack_descriptions_avx2[] = {
+   [PIPE_FORMAT_R8G8B8A8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_r8g8b8a8_unorm_pack_rgba_8unorm_avx2,
+      .pack_rgba_float = &util_format_r8g8b8a8_unorm_pack_rgba_float_avx2,
+   },
+   [PIPE_FORMAT_B8G8R8A8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_b8g8r8a8_unorm_pack_rgba_8unorm_avx2,
+      .pack_rgba_float = &util_format_b8g8r8a8_unorm_pack_rgba_float_avx2,
+   },
+   [PIPE_FORMAT_R16_FLOAT] = {
+      .pack_rgba_8unorm = &util_format_r16_float_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r16_float_pack_rgba_float_avx2,
+   },
+   [PIPE_FORMAT_R16G16B16A16_FLOAT] = {
+      .pack_rgba_8unorm = &util_format_r16g16b16a16_float_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r16g16b16a16_float_pack_rgba_float_avx2,
+   },
+};
+
+const struct util_format_unpack_description *
+util_format_unpack_description_avx2(enum pipe_format format)
+{
+   if (format >= ARRAY_SIZE(util_format_unpack_descriptions_avx2))
+      return NULL;
+
+   if (!util_format_unpack_descriptions_avx2[format].unpack_rgba)
+      return NULL;
+
+   return &util_format_unpack_descriptions_avx2[format];
+}
+
+const struct util_format_pack_description *
+util_format_pack_description_avx2(enum pipe_format format)
+{
+   if (format >= ARRAY_SIZE(util_format_pack_descriptions_avx2))
+      return NULL;
+
+   if (!util_format_pack_descriptions_avx2[format].pack_rgba_float)
+      return NULL;
+
+   return &util_format_pack_descriptions_avx2[format];
+}
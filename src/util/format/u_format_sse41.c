@@ -0,0 +1,610 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * SSE4.1 versions of the pack/unpack functions of the most common formats.
+ *
+ * This file is built with -msse4.1, so only call into it once
+ * util_get_cpu_caps() has reported SSE4.1 support.  The results must match
+ * the generic code bit for bit, which is why the float conversions below
+ * mirror the exact arithmetic of the u_math.h helpers used by the generated
+ * code.  Pixels left over after the vector loops go through the generic
+ * functions.
+ */
+
+#include <smmintrin.h>
+#include <string.h>
+
+#include <u_format.h>
+#include "u_format_pack.h"
+#include "u_format_zs.h"
+
+/* float_to_ubyte() on four lanes: after clamping, scaling by 255/256 and
+ * adding 32768 leaves the rounded result in the low byte of the mantissa.
+ * Clamping with max(x, 0) first also maps NaN to 0.
+ */
+static inline __m128i
+float4_to_ubyte4(__m128 f)
+{
+   f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+   f = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f / 256.0f)),
+                  _mm_set1_ps(32768.0f));
+   return _mm_and_si128(_mm_castps_si128(f), _mm_set1_epi32(0xff));
+}
+
+/* util_iround(CLAMP(f, 0.0f, 1.0f) * scale) on four lanes. */
+static inline __m128i
+float4_to_unorm4(__m128 f, float scale)
+{
+   f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+   f = _mm_mul_ps(f, _mm_set1_ps(scale));
+#if defined(PIPE_ARCH_X86)
+   /* util_iround() uses fistp, which rounds to nearest even. */
+   return _mm_cvtps_epi32(f);
+#else
+   return _mm_cvttps_epi32(_mm_add_ps(f, _mm_set1_ps(0.5f)));
+#endif
+}
+
+static inline __m128
+ubyte4_to_float4(__m128i i)
+{
+   return _mm_mul_ps(_mm_cvtepi32_ps(i), _mm_set1_ps(1.0f / 255.0f));
+}
+
+static inline __m128i
+swap_rb_8unorm(__m128i pixels)
+{
+   return _mm_shuffle_epi8(pixels, _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                                 10, 9, 8, 11, 14, 13, 12, 15));
+}
+
+/*
+ * R8G8B8A8_UNORM and B8G8R8A8_UNORM
+ */
+
+static unsigned
+copy_8unorm(uint8_t *restrict dst, const uint8_t *restrict src,
+            unsigned width, bool swap_rb)
+{
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      if (swap_rb)
+         pixels = swap_rb_8unorm(pixels);
+      _mm_storeu_si128((__m128i *)(dst + x * 4), pixels);
+   }
+
+   return x;
+}
+
+static unsigned
+unpack_8unorm_float(float *restrict dst, const uint8_t *restrict src,
+                    unsigned width, bool swap_rb)
+{
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      if (swap_rb)
+         pixels = swap_rb_8unorm(pixels);
+
+      float *d = dst + x * 4;
+      _mm_storeu_ps(d + 0, ubyte4_to_float4(_mm_cvtepu8_epi32(pixels)));
+      _mm_storeu_ps(d + 4, ubyte4_to_float4(
+                       _mm_cvtepu8_epi32(_mm_srli_si128(pixels, 4))));
+      _mm_storeu_ps(d + 8, ubyte4_to_float4(
+                       _mm_cvtepu8_epi32(_mm_srli_si128(pixels, 8))));
+      _mm_storeu_ps(d + 12, ubyte4_to_float4(
+                       _mm_cvtepu8_epi32(_mm_srli_si128(pixels, 12))));
+   }
+
+   return x;
+}
+
+static unsigned
+pack_8unorm_float(uint8_t *restrict dst, const float *restrict src,
+                  unsigned width, bool swap_rb)
+{
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      const float *s = src + x * 4;
+      __m128i p0 = float4_to_ubyte4(_mm_loadu_ps(s + 0));
+      __m128i p1 = float4_to_ubyte4(_mm_loadu_ps(s + 4));
+      __m128i p2 = float4_to_ubyte4(_mm_loadu_ps(s + 8));
+      __m128i p3 = float4_to_ubyte4(_mm_loadu_ps(s + 12));
+      __m128i pixels = _mm_packus_epi16(_mm_packus_epi32(p0, p1),
+                                        _mm_packus_epi32(p2, p3));
+      if (swap_rb)
+         pixels = swap_rb_8unorm(pixels);
+      _mm_storeu_si128((__m128i *)(dst + x * 4), pixels);
+   }
+
+   return x;
+}
+
+#define DEFINE_8UNORM_FUNCS(sn, swap_rb)                                      \
+static void                                                                   \
+util_format_##sn##_unpack_rgba_8unorm_sse41(uint8_t *restrict dst,            \
+                                            const uint8_t *restrict src,      \
+                                            unsigned width)                   \
+{                                                                             \
+   unsigned x = copy_8unorm(dst, src, width, swap_rb);                        \
+   if (x < width)                                                             \
+      util_format_##sn##_unpack_rgba_8unorm(dst + x * 4, src + x * 4,         \
+                                            width - x);                       \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+util_format_##sn##_unpack_rgba_float_sse41(void *restrict dst,                \
+                                            const uint8_t *restrict src,      \
+                                            unsigned width)                   \
+{                                                                             \
+   unsigned x = unpack_8unorm_float(dst, src, width, swap_rb);                \
+   if (x < width)                                                             \
+      util_format_##sn##_unpack_rgba_float((float *)dst + x * 4, src + x * 4, \
+                                           width - x);                        \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+util_format_##sn##_pack_rgba_8unorm_sse41(uint8_t *restrict dst_row,          \
+                                          unsigned dst_stride,                \
+                                          const uint8_t *restrict src_row,    \
+                                          unsigned src_stride,                \
+                                          unsigned width, unsigned height)    \
+{                                                                             \
+   for (unsigned y = 0; y < height; y++) {                                    \
+      unsigned x = copy_8unorm(dst_row, src_row, width, swap_rb);             \
+      if (x < width)                                                          \
+         util_format_##sn##_pack_rgba_8unorm(dst_row + x * 4, 0,              \
+                                             src_row + x * 4, 0,              \
+                                             width - x, 1);                   \
+      dst_row += dst_stride;                                                  \
+      src_row += src_stride;                                                  \
+   }                                                                          \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+util_format_##sn##_pack_rgba_float_sse41(uint8_t *restrict dst_row,           \
+                                         unsigned dst_stride,                 \
+                                         const float *restrict src_row,       \
+                                         unsigned src_stride,                 \
+                                         unsigned width, unsigned height)     \
+{                                                                             \
+   for (unsigned y = 0; y < height; y++) {                                    \
+      unsigned x = pack_8unorm_float(dst_row, src_row, width, swap_rb);       \
+      if (x < width)                                                          \
+         util_format_##sn##_pack_rgba_float(dst_row + x * 4, 0,               \
+                                            src_row + x * 4, 0,               \
+                                            width - x, 1);                    \
+      dst_row += dst_stride;                                                  \
+      src_row += src_stride / sizeof(*src_row);                               \
+   }                                                                          \
+}
+
+DEFINE_8UNORM_FUNCS(r8g8b8a8_unorm, false)
+DEFINE_8UNORM_FUNCS(b8g8r8a8_unorm, true)
+
+/*
+ * R10G10B10A2_UNORM
+ */
+
+static void
+util_format_r10g10b10a2_unorm_unpack_rgba_float_sse41(void *restrict dst_row,
+                                                      const uint8_t *restrict src,
+                                                      unsigned width)
+{
+   float *dst = dst_row;
+   const __m128i mask10 = _mm_set1_epi32(0x3ff);
+   const __m128 scale10 = _mm_set1_ps(1.0f / 0x3ff);
+   const __m128 scale2 = _mm_set1_ps(1.0f / 0x3);
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(pixels, mask10)),
+                            scale10);
+      __m128 g = _mm_mul_ps(_mm_cvtepi32_ps(
+                               _mm_and_si128(_mm_srli_epi32(pixels, 10), mask10)),
+                            scale10);
+      __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(
+                               _mm_and_si128(_mm_srli_epi32(pixels, 20), mask10)),
+                            scale10);
+      __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(pixels, 30)),
+                            scale2);
+
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+      _mm_storeu_ps(dst + x * 4 + 0, r);
+      _mm_storeu_ps(dst + x * 4 + 4, g);
+      _mm_storeu_ps(dst + x * 4 + 8, b);
+      _mm_storeu_ps(dst + x * 4 + 12, a);
+   }
+
+   if (x < width)
+      util_format_r10g10b10a2_unorm_unpack_rgba_float(dst + x * 4, src + x * 4,
+                                                      width - x);
+}
+
+static void
+util_format_r10g10b10a2_unorm_pack_rgba_float_sse41(uint8_t *restrict dst_row,
+                                                    unsigned dst_stride,
+                                                    const float *restrict src_row,
+                                                    unsigned src_stride,
+                                                    unsigned width,
+                                                    unsigned height)
+{
+   const __m128i mask10 = _mm_set1_epi32(0x3ff);
+
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         const float *s = src_row + x * 4;
+         __m128 r = _mm_loadu_ps(s + 0);
+         __m128 g = _mm_loadu_ps(s + 4);
+         __m128 b = _mm_loadu_ps(s + 8);
+         __m128 a = _mm_loadu_ps(s + 12);
+         _MM_TRANSPOSE4_PS(r, g, b, a);
+
+         __m128i value = _mm_and_si128(float4_to_unorm4(r, 0x3ff), mask10);
+         value = _mm_or_si128(value, _mm_slli_epi32(
+                                 _mm_and_si128(float4_to_unorm4(g, 0x3ff), mask10), 10));
+         value = _mm_or_si128(value, _mm_slli_epi32(
+                                 _mm_and_si128(float4_to_unorm4(b, 0x3ff), mask10), 20));
+         value = _mm_or_si128(value, _mm_slli_epi32(float4_to_unorm4(a, 0x3), 30));
+         _mm_storeu_si128((__m128i *)(dst_row + x * 4), value);
+      }
+
+      if (x < width)
+         util_format_r10g10b10a2_unorm_pack_rgba_float(dst_row + x * 4, 0,
+                                                       src_row + x * 4, 0,
+                                                       width - x, 1);
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+/*
+ * R32_FLOAT
+ */
+
+static void
+util_format_r32_float_unpack_rgba_float_sse41(void *restrict dst_row,
+                                              const uint8_t *restrict src,
+                                              unsigned width)
+{
+   float *dst = dst_row;
+   const __m128 zero_one = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+   unsigned x;
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      __m128 r = _mm_loadu_ps((const float *)(src + x * 4));
+      float *d = dst + x * 4;
+
+      _mm_storeu_ps(d + 0, _mm_blend_ps(zero_one, r, 0x1));
+      _mm_storeu_ps(d + 4, _mm_blend_ps(zero_one,
+                                        _mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 1, 1, 1)), 0x1));
+      _mm_storeu_ps(d + 8, _mm_blend_ps(zero_one,
+                                        _mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 2, 2, 2)), 0x1));
+      _mm_storeu_ps(d + 12, _mm_blend_ps(zero_one,
+                                         _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)), 0x1));
+   }
+
+   if (x < width)
+      util_format_r32_float_unpack_rgba_float(dst + x * 4, src + x * 4,
+                                              width - x);
+}
+
+static void
+util_format_r32_float_pack_rgba_float_sse41(uint8_t *restrict dst_row,
+                                            unsigned dst_stride,
+                                            const float *restrict src_row,
+                                            unsigned src_stride,
+                                            unsigned width, unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         const float *s = src_row + x * 4;
+         __m128 rg01 = _mm_unpacklo_ps(_mm_loadu_ps(s + 0), _mm_loadu_ps(s + 4));
+         __m128 rg23 = _mm_unpacklo_ps(_mm_loadu_ps(s + 8), _mm_loadu_ps(s + 12));
+         _mm_storeu_ps((float *)(dst_row + x * 4), _mm_movelh_ps(rg01, rg23));
+      }
+
+      if (x < width)
+         util_format_r32_float_pack_rgba_float(dst_row + x * 4, 0,
+                                               src_row + x * 4, 0,
+                                               width - x, 1);
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+/*
+ * Z24_UNORM_S8_UINT
+ */
+
+static void
+util_format_z24_unorm_s8_uint_unpack_z_float_sse41(float *restrict dst_row,
+                                                   unsigned dst_stride,
+                                                   const uint8_t *restrict src_row,
+                                                   unsigned src_stride,
+                                                   unsigned width,
+                                                   unsigned height)
+{
+   /* Like z24_unorm_to_z32_float(), this scales in double precision. */
+   const __m128d scale = _mm_set1_pd(1.0 / 0xffffff);
+
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         __m128i z = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src_row + x * 4)),
+                                   _mm_set1_epi32(0xffffff));
+         __m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(z), scale));
+         __m128 hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(z, 8)),
+                                             scale));
+         _mm_storeu_ps(dst_row + x, _mm_movelh_ps(lo, hi));
+      }
+
+      if (x < width)
+         util_format_z24_unorm_s8_uint_unpack_z_float(dst_row + x, 0,
+                                                      src_row + x * 4, 0,
+                                                      width - x, 1);
+      src_row += src_stride;
+      dst_row += dst_stride / sizeof(*dst_row);
+   }
+}
+
+static void
+util_format_z24_unorm_s8_uint_pack_z_float_sse41(uint8_t *restrict dst_row,
+                                                 unsigned dst_stride,
+                                                 const float *restrict src_row,
+                                                 unsigned src_stride,
+                                                 unsigned width,
+                                                 unsigned height)
+{
+   /* Like z32_float_to_z24_unorm(), this scales in double precision and
+    * truncates.
+    */
+   const __m128d scale = _mm_set1_pd(0xffffff);
+
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         __m128 z = _mm_loadu_ps(src_row + x);
+         __m128i lo = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(z), scale));
+         __m128i hi = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(z, z)),
+                                                  scale));
+         __m128i z24 = _mm_and_si128(_mm_unpacklo_epi64(lo, hi),
+                                     _mm_set1_epi32(0xffffff));
+
+         __m128i *d = (__m128i *)(dst_row + x * 4);
+         __m128i s8 = _mm_and_si128(_mm_loadu_si128(d),
+                                    _mm_set1_epi32(0xff000000));
+         _mm_storeu_si128(d, _mm_or_si128(s8, z24));
+      }
+
+      if (x < width)
+         util_format_z24_unorm_s8_uint_pack_z_float(dst_row + x * 4, 0,
+                                                    src_row + x, 0,
+                                                    width - x, 1);
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static void
+util_format_z24_unorm_s8_uint_unpack_z_32unorm_sse41(uint32_t *restrict dst_row,
+                                                     unsigned dst_stride,
+                                                     const uint8_t *restrict src_row,
+                                                     unsigned src_stride,
+                                                     unsigned width,
+                                                     unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         __m128i z = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src_row + x * 4)),
+                                   _mm_set1_epi32(0xffffff));
+         /* z24_unorm_to_z32_unorm() */
+         z = _mm_or_si128(_mm_slli_epi32(z, 8), _mm_srli_epi32(z, 16));
+         _mm_storeu_si128((__m128i *)(dst_row + x), z);
+      }
+
+      if (x < width)
+         util_format_z24_unorm_s8_uint_unpack_z_32unorm(dst_row + x, 0,
+                                                        src_row + x * 4, 0,
+                                                        width - x, 1);
+      src_row += src_stride;
+      dst_row += dst_stride / sizeof(*dst_row);
+   }
+}
+
+static void
+util_format_z24_unorm_s8_uint_pack_z_32unorm_sse41(uint8_t *restrict dst_row,
+                                                   unsigned dst_stride,
+                                                   const uint32_t *restrict src_row,
+                                                   unsigned src_stride,
+                                                   unsigned width,
+                                                   unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         __m128i z24 = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)(src_row + x)), 8);
+         __m128i *d = (__m128i *)(dst_row + x * 4);
+         __m128i s8 = _mm_and_si128(_mm_loadu_si128(d),
+                                    _mm_set1_epi32(0xff000000));
+         _mm_storeu_si128(d, _mm_or_si128(s8, z24));
+      }
+
+      if (x < width)
+         util_format_z24_unorm_s8_uint_pack_z_32unorm(dst_row + x * 4, 0,
+                                                      src_row + x, 0,
+                                                      width - x, 1);
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static void
+util_format_z24_unorm_s8_uint_unpack_s_8uint_sse41(uint8_t *restrict dst_row,
+                                                   unsigned dst_stride,
+                                                   const uint8_t *restrict src_row,
+                                                   unsigned src_stride,
+                                                   unsigned width,
+                                                   unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 16 <= width; x += 16) {
+         const __m128i *s = (const __m128i *)(src_row + x * 4);
+         __m128i s0 = _mm_srli_epi32(_mm_loadu_si128(s + 0), 24);
+         __m128i s1 = _mm_srli_epi32(_mm_loadu_si128(s + 1), 24);
+         __m128i s2 = _mm_srli_epi32(_mm_loadu_si128(s + 2), 24);
+         __m128i s3 = _mm_srli_epi32(_mm_loadu_si128(s + 3), 24);
+         _mm_storeu_si128((__m128i *)(dst_row + x),
+                          _mm_packus_epi16(_mm_packus_epi32(s0, s1),
+                                           _mm_packus_epi32(s2, s3)));
+      }
+
+      if (x < width)
+         util_format_z24_unorm_s8_uint_unpack_s_8uint(dst_row + x, 0,
+                                                      src_row + x * 4, 0,
+                                                      width - x, 1);
+      src_row += src_stride;
+      dst_row += dst_stride;
+   }
+}
+
+static void
+util_format_z24_unorm_s8_uint_pack_s_8uint_sse41(uint8_t *restrict dst_row,
+                                                 unsigned dst_stride,
+                                                 const uint8_t *restrict src_row,
+                                                 unsigned src_stride,
+                                                 unsigned width,
+                                                 unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      unsigned x;
+
+      for (x = 0; x + 4 <= width; x += 4) {
+         uint32_t s;
+         memcpy(&s, src_row + x, sizeof(s));
+         __m128i s8 = _mm_slli_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(s)), 24);
+         __m128i *d = (__m128i *)(dst_row + x * 4);
+         __m128i z24 = _mm_and_si128(_mm_loadu_si128(d),
+                                     _mm_set1_epi32(0x00ffffff));
+         _mm_storeu_si128(d, _mm_or_si128(z24, s8));
+      }
+
+      if (x < width)
+         util_format_z24_unorm_s8_uint_pack_s_8uint(dst_row + x * 4, 0,
+                                                    src_row + x, 0,
+                                                    width - x, 1);
+      dst_row += dst_stride;
+      src_row += src_stride;
+   }
+}
+
+static const struct util_format_unpack_description util_format_unpack_descriptions_sse41[] = {
+   [PIPE_FORMAT_R8G8B8A8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r8g8b8a8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_r8g8b8a8_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B8G8R8A8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_b8g8r8a8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_b8g8r8a8_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R10G10B10A2_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r10g10b10a2_unorm_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r10g10b10a2_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R32_FLOAT] = {
+      .unpack_rgba_8unorm = &util_format_r32_float_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r32_float_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_Z24_UNORM_S8_UINT] = {
+      .unpack_z_32unorm = &util_format_z24_unorm_s8_uint_unpack_z_32unorm_sse41,
+      .unpack_z_float = &util_format_z24_unorm_s8_uint_unpack_z_float_sse41,
+      .unpack_s_8uint = &util_format_z24_unorm_s8_uint_unpack_s_8uint_sse41,
+   },
+};
+
+static const struct util_format_pack_description util_format_pack_descriptions_sse41[] = {
+   [PIPE_FORMAT_R8G8B8A8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_r8g8b8a8_unorm_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_r8g8b8a8_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B8G8R8A8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_b8g8r8a8_unorm_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_b8g8r8a8_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R10G10B10A2_UNORM] = {
+      .pack_rgba_8unorm = &util_format_r10g10b10a2_unorm_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r10g10b10a2_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R32_FLOAT] = {
+      .pack_rgba_8unorm = &util_format_r32_float_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r32_float_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_Z24_UNORM_S8_UINT] = {
+      .pack_z_32unorm = &util_format_z24_unorm_s8_uint_pack_z_32unorm_sse41,
+      .pack_z_float = &util_format_z24_unorm_s8_uint_pack_z_float_sse41,
+      .pack_s_8uint = &util_format_z24_unorm_s8_uint_pack_s_8uint_sse41,
+   },
+};
+
+const struct util_format_unpack_description *
+util_format_unpack_description_sse41(enum pipe_format format)
+{
+   if (format >= ARRAY_SIZE(util_format_unpack_descriptions_sse41))
+      return NULL;
+
+   if (!util_format_unpack_descriptions_sse41[format].unpack_rgba &&
+       !util_format_unpack_descriptions_sse41[format].unpack_z_32unorm)
+      return NULL;
+
+   return &util_format_unpack_descriptions_sse41[format];
+}
+
+const struct util_format_pack_description *
+util_format_pack_description_sse41(enum pipe_format format)
+{
+   if (format >= ARRAY_SIZE(util_format_pack_descriptions_sse41))
+      return NULL;
+
+   if (!util_format_pack_descriptions_sse41[format].pack_rgba_float &&
+       !util_format_pack_descriptions_sse41[format].pack_z_32unorm)
+      return NULL;
+
+   return &util_format_pack_descriptions_sse41[format];
+}
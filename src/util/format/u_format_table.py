@@ -174,7 +174,7 @@ def write_format_table(formats):
 
     def generate_table_getter(type):
         suffix = ""
-        if type == "unpack_":
+        if type == "unpack_" or type == "pack_":
             suffix = "_generic"
         print("const struct util_format_%sdescription *" % type)
         print("util_format_%sdescription%s(enum pipe_format format)" % (type, suffix))
@@ -26,6 +26,13 @@
  *
  * The format is compatible enough to allow the fossilize db tools to be used
  * to do things like merge db collections.
+ *
+ * Next to the default db we keep a foz_cache_lru.foz file holding the last
+ * time each entry of the index was used, as an array of 64bit nanosecond
+ * timestamps in the index's entry order. Once the default db grows past the maximum
+ * cache size it is rewritten with the most recently used entries only and
+ * renamed over the old files, so processes still reading the old ones
+ * through their mappings aren't disturbed.
  */
 
 #include "fossilize_db.h"
@@ -33,20 +40,39 @@
 #ifdef FOZ_DB_UTIL
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "crc32.h"
 #include "hash_table.h"
 #include "mesa-sha1.h"
 #include "ralloc.h"
+#include "u_math.h"
 
 #define FOZ_REF_MAGIC_SIZE 16
 
+/* An index entry is the hash string, a payload header and the offset of the
+ * entry in the db file.
+ */
+#define FOZ_IDX_ENTRY_SIZE (FOSSILIZE_BLOB_HASH_LENGTH + \
+                            sizeof(struct foz_payload_header) + \
+                            sizeof(uint64_t))
+
+/* Mappings are made this much larger than the db files, so entries appended
+ * by other processes can mostly be read without mapping the file again.
+ */
+#define FOZ_MAP_ALIGNMENT (16 * 1024 * 1024)
+
 static const uint8_t stream_reference_magic_and_version[FOZ_REF_MAGIC_SIZE] = {
    0x81, 'F', 'O', 'S',
    'S', 'I', 'L', 'I',
@@ -104,6 +130,141 @@ create_foz_db_filenames(char *cache_path, char *name, char **filename,
    return true;
 }
 
+/* Make sure the first end bytes of a db file are mapped. Entries handed out
+ * by foz_map_entry() point into the mappings, so old ones are only unmapped
+ * by foz_destroy().
+ */
+static bool
+map_foz_db(struct foz_db *foz_db, unsigned file_idx, uint64_t end)
+{
+   struct foz_db_map *map = &foz_db->map[file_idx];
+   struct stat st;
+
+   if (end <= map->file_size)
+      return true;
+
+   if (fstat(fileno(foz_db->file[file_idx]), &st) == -1 ||
+       (uint64_t)st.st_size < end)
+      return false;
+
+   if ((uint64_t)st.st_size > map->size) {
+      size_t size = align64(st.st_size + 1, FOZ_MAP_ALIGNMENT);
+      void *data = mmap(NULL, size, PROT_READ, MAP_SHARED,
+                        fileno(foz_db->file[file_idx]), 0);
+      if (data == MAP_FAILED)
+         return false;
+
+      if (map->data) {
+         struct foz_db_map *old = ralloc(foz_db->mem_ctx, struct foz_db_map);
+         *old = *map;
+         map->next = old;
+      }
+      map->data = data;
+      map->size = size;
+   }
+
+   map->file_size = st.st_size;
+   return true;
+}
+
+/* Set aside the mapping of a db file which is about to be replaced. */
+static void
+retire_foz_db_map(struct foz_db *foz_db, unsigned file_idx)
+{
+   struct foz_db_map *map = &foz_db->map[file_idx];
+
+   if (map->data) {
+      struct foz_db_map *old = ralloc(foz_db->mem_ctx, struct foz_db_map);
+      *old = *map;
+      map->next = old;
+   }
+   map->data = NULL;
+   map->size = 0;
+   map->file_size = 0;
+}
+
+static void
+unmap_foz_db(struct foz_db *foz_db, unsigned file_idx)
+{
+   struct foz_db_map *map = &foz_db->map[file_idx];
+
+   for (struct foz_db_map *m = map; m; m = m->next) {
+      if (m->data)
+         munmap(m->data, m->size);
+   }
+   memset(map, 0, sizeof(*map));
+}
+
+/* Map at least count slots of the lru file, if the file has them. */
+static bool
+map_foz_lru(struct foz_db *foz_db, size_t count)
+{
+   struct stat st;
+
+   if (count <= foz_db->lru_count)
+      return true;
+
+   if (foz_db->lru_fd == -1 || fstat(foz_db->lru_fd, &st) == -1)
+      return false;
+
+   size_t file_count = st.st_size / sizeof(uint64_t);
+   if (file_count < count)
+      return false;
+
+   uint64_t *lru = mmap(NULL, file_count * sizeof(uint64_t),
+                        PROT_READ | PROT_WRITE, MAP_SHARED,
+                        foz_db->lru_fd, 0);
+   if (lru == MAP_FAILED)
+      return false;
+
+   if (foz_db->lru)
+      munmap(foz_db->lru, foz_db->lru_count * sizeof(uint64_t));
+   foz_db->lru = lru;
+   foz_db->lru_count = file_count;
+   return true;
+}
+
+static uint64_t
+foz_time_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+touch_foz_entry(struct foz_db *foz_db, struct foz_db_entry *entry)
+{
+   if (entry->file_idx != 0 || !map_foz_lru(foz_db, entry->lru_idx + 1))
+      return;
+
+   foz_db->lru[entry->lru_idx] = foz_time_now();
+}
+
+/* Writing past the end of the lru file leaves zeroes, i.e. never used, in
+ * the slots of entries written by Mesa versions which don't track use.
+ */
+static bool
+stamp_new_foz_entry(struct foz_db *foz_db, struct foz_db_entry *entry)
+{
+   uint64_t now = foz_time_now();
+
+   if (foz_db->lru_fd == -1)
+      return false;
+
+   return pwrite(foz_db->lru_fd, &now, sizeof(now),
+                 (off_t)entry->lru_idx * sizeof(now)) == sizeof(now);
+}
+
+static uint64_t
+foz_entry_last_use(struct foz_db *foz_db, struct foz_db_entry *entry)
+{
+   if (!map_foz_lru(foz_db, entry->lru_idx + 1))
+      return 0;
+   return foz_db->lru[entry->lru_idx];
+}
+
 
 /* This looks at stuff that was added to the index since the last time we looked at it. This is safe
  * to do without locking the file as we assume the file is append only */
@@ -122,6 +283,7 @@ update_foz_index(struct foz_db *foz_db, FILE *db_idx, unsigned file_idx)
    while (offset < len) {
       char bytes_to_read[FOSSILIZE_BLOB_HASH_LENGTH + sizeof(struct foz_payload_header)];
       struct foz_payload_header *header;
+      uint64_t entry_offset = offset;
 
       /* Corrupt entry. Our process might have been killed before we
        * could write all data.
@@ -156,10 +318,11 @@ update_foz_index(struct foz_db *foz_db, FILE *db_idx, unsigned file_idx)
       offset += header->payload_size;
       parsed_offset = offset;
 
-      struct foz_db_entry *entry = ralloc(foz_db->mem_ctx,
-                                          struct foz_db_entry);
+      struct foz_db_entry *entry = rzalloc(foz_db->mem_ctx,
+                                           struct foz_db_entry);
       entry->header = *header;
       entry->file_idx = file_idx;
+      entry->lru_idx = (entry_offset - FOZ_REF_MAGIC_SIZE) / FOZ_IDX_ENTRY_SIZE;
       _mesa_sha1_hex_to_sha1(entry->key, hash_str);
 
       /* Truncate the entry's hash string to a 64bit hash for use with a
@@ -177,8 +340,8 @@ update_foz_index(struct foz_db *foz_db, FILE *db_idx, unsigned file_idx)
    fseek(db_idx, parsed_offset, SEEK_SET);
 }
 
-/* exclusive flock with timeout. timeout is in nanoseconds */
-static int lock_file_with_timeout(FILE *f, int64_t timeout)
+/* flock with timeout, op is LOCK_EX or LOCK_SH. timeout is in nanoseconds */
+static int lock_file_with_timeout(FILE *f, int op, int64_t timeout)
 {
    int err;
    int fd = fileno(f);
@@ -187,7 +350,7 @@ static int lock_file_with_timeout(FILE *f, int64_t timeout)
    /* Since there is no blocking flock with timeout and we don't want to totally spin on getting the
     * lock, use a nonblocking method and retry every millisecond. */
    for (int64_t iter = 0; iter < iterations; ++iter) {
-      err = flock(fd, LOCK_EX | LOCK_NB);
+      err = flock(fd, op | LOCK_NB);
       if (err == 0 || errno != EAGAIN)
          break;
       usleep(1000);
@@ -195,6 +358,59 @@ static int lock_file_with_timeout(FILE *f, int64_t timeout)
    return err;
 }
 
+/* Open the default db, its index and the lru file, creating them if needed.
+ *
+ * Compaction renames new files over all three while holding the exclusive
+ * lock of the db they replace, db last. So we open the others with a shared
+ * lock on the db, and start over if the db got replaced before we got the
+ * lock. If we can't get the lock in time we go ahead anyway, foz_map_entry()
+ * checks the hash of every entry before using it.
+ */
+static bool
+open_default_foz_db_files(struct foz_db *foz_db, FILE **file, FILE **db_idx,
+                          int *lru_fd)
+{
+   for (unsigned attempt = 0;; attempt++) {
+      struct stat fd_st, path_st;
+
+      *file = fopen(foz_db->filename, "a+b");
+      if (!*file)
+         return false;
+
+      /* Wait for 100 ms in case of contention, like load_foz_dbs(). */
+      bool locked =
+         lock_file_with_timeout(*file, LOCK_SH, 100000000) == 0;
+
+      if (locked && attempt < 2 &&
+          fstat(fileno(*file), &fd_st) == 0 &&
+          stat(foz_db->filename, &path_st) == 0 &&
+          (fd_st.st_dev != path_st.st_dev || fd_st.st_ino != path_st.st_ino)) {
+         fclose(*file);
+         continue;
+      }
+
+      *db_idx = fopen(foz_db->idx_filename, "a+b");
+
+      /* Without it the cache still works, eviction just can't tell which
+       * entries were used recently.
+       */
+      *lru_fd = open(foz_db->lru_filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+      if (locked)
+         flock(fileno(*file), LOCK_UN);
+
+      if (!check_files_opened_successfully(*file, *db_idx)) {
+         if (*lru_fd != -1)
+            close(*lru_fd);
+         *file = *db_idx = NULL;
+         *lru_fd = -1;
+         return false;
+      }
+
+      return true;
+   }
+}
+
 static bool
 load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
              bool read_only)
@@ -208,7 +424,8 @@ load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
     * lock to potentially initialize the files. */
    if (len < sizeof(stream_reference_magic_and_version)) {
       /* Wait for 100 ms in case of contention, after that we prioritize getting the app started. */
-      int err = lock_file_with_timeout(foz_db->file[file_idx], 100000000);
+      int err = lock_file_with_timeout(foz_db->file[file_idx], LOCK_EX,
+                                       100000000);
       if (err == -1)
          goto fail;
 
@@ -270,25 +487,30 @@ foz_prepare(struct foz_db *foz_db, char *cache_path)
 {
    char *filename = NULL;
    char *idx_filename = NULL;
+   foz_db->lru_fd = -1;
    if (!create_foz_db_filenames(cache_path, "foz_cache", &filename, &idx_filename))
       return false;
 
-   /* Open the default foz dbs for read/write. If the files didn't already exist
-    * create them.
-    */
-   foz_db->file[0] = fopen(filename, "a+b");
-   foz_db->db_idx = fopen(idx_filename, "a+b");
+   simple_mtx_init(&foz_db->mtx, mtx_plain);
+   simple_mtx_init(&foz_db->flock_mtx, mtx_plain);
+   foz_db->mem_ctx = ralloc_context(NULL);
+   foz_db->index_db = _mesa_hash_table_u64_create(NULL);
 
+   foz_db->filename = ralloc_strdup(foz_db->mem_ctx, filename);
+   foz_db->idx_filename = ralloc_strdup(foz_db->mem_ctx, idx_filename);
+   foz_db->lru_filename = ralloc_asprintf(foz_db->mem_ctx, "%s/foz_cache_lru.foz",
+                                          cache_path);
    free(filename);
    free(idx_filename);
 
-   if (!check_files_opened_successfully(foz_db->file[0], foz_db->db_idx))
+   /* Open the default foz dbs for read/write. If the files didn't already exist
+    * create them.
+    */
+   if (!open_default_foz_db_files(foz_db, &foz_db->file[0], &foz_db->db_idx,
+                                  &foz_db->lru_fd)) {
+      foz_destroy(foz_db);
       return false;
-
-   simple_mtx_init(&foz_db->mtx, mtx_plain);
-   simple_mtx_init(&foz_db->flock_mtx, mtx_plain);
-   foz_db->mem_ctx = ralloc_context(NULL);
-   foz_db->index_db = _mesa_hash_table_u64_create(NULL);
+   }
 
    if (!load_foz_dbs(foz_db, foz_db->db_idx, 0, false))
       return false;
@@ -346,10 +568,16 @@ foz_destroy(struct foz_db *foz_db)
    if (foz_db->db_idx)
       fclose(foz_db->db_idx);
    for (unsigned i = 0; i < FOZ_MAX_DBS; i++) {
+      unmap_foz_db(foz_db, i);
       if (foz_db->file[i])
          fclose(foz_db->file[i]);
    }
 
+   if (foz_db->lru)
+      munmap(foz_db->lru, foz_db->lru_count * sizeof(uint64_t));
+   if (foz_db->lru_fd != -1)
+      close(foz_db->lru_fd);
+
    if (foz_db->mem_ctx) {
       _mesa_hash_table_u64_destroy(foz_db->index_db);
       ralloc_free(foz_db->mem_ctx);
@@ -359,15 +587,16 @@ foz_destroy(struct foz_db *foz_db)
 }
 
 /* Here we lookup a cache entry in the index hash table. If an entry is found
- * we use the retrieved offset to read the cache entry from disk.
+ * we use the retrieved offset to find the cache entry in the mapped db file.
+ * The returned payload stays valid until foz_destroy().
  */
-void *
-foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
-               size_t *size)
+const void *
+foz_map_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+              size_t *size)
 {
    uint64_t hash = truncate_hash_to_64bits(cache_key_160bit);
-
-   void *data = NULL;
+   struct foz_payload_header header;
+   const uint8_t *data = NULL;
 
    if (!foz_db->alive)
       return NULL;
@@ -380,53 +609,343 @@ foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
       update_foz_index(foz_db, foz_db->db_idx, 0);
       entry = _mesa_hash_table_u64_search(foz_db->index_db, hash);
    }
-   if (!entry) {
-      simple_mtx_unlock(&foz_db->mtx);
-      return NULL;
-   }
-
-   uint8_t file_idx = entry->file_idx;
-   if (fseek(foz_db->file[file_idx], entry->offset, SEEK_SET) < 0)
-      goto fail;
-
-   uint32_t header_size = sizeof(struct foz_payload_header);
-   if (fread(&entry->header, 1, header_size, foz_db->file[file_idx]) !=
-       header_size)
-      goto fail;
+   if (!entry)
+      goto out;
 
    /* Check for collision using full 160bit hash for increased assurance
     * against potential collisions.
     */
-   for (int i = 0; i < 20; i++) {
-      if (cache_key_160bit[i] != entry->key[i])
-         goto fail;
-   }
+   if (memcmp(cache_key_160bit, entry->key, sizeof(entry->key)) != 0)
+      goto out;
 
-   uint32_t data_sz = entry->header.payload_size;
-   data = malloc(data_sz);
-   if (fread(data, 1, data_sz, foz_db->file[file_idx]) != data_sz)
-      goto fail;
+   uint8_t file_idx = entry->file_idx;
+   uint32_t header_size = sizeof(struct foz_payload_header);
+   if (entry->offset < FOSSILIZE_BLOB_HASH_LENGTH ||
+       !map_foz_db(foz_db, file_idx, entry->offset + header_size))
+      goto out;
 
-   /* verify checksum */
-   if (entry->header.crc != 0) {
-      if (util_hash_crc32(data, data_sz) != entry->header.crc)
-         goto fail;
+   memcpy(&header, foz_db->map[file_idx].data + entry->offset, header_size);
+   if (!map_foz_db(foz_db, file_idx,
+                   entry->offset + header_size + header.payload_size))
+      goto out;
+
+   const uint8_t *ptr = foz_db->map[file_idx].data + entry->offset;
+
+   if (!entry->verified) {
+      /* An index which was replaced while we were opening the db files
+       * may point anywhere in the db, so check that the entry's hash
+       * string is where we expect it.
+       */
+      char hash_str[FOSSILIZE_BLOB_HASH_LENGTH + 1];
+      _mesa_sha1_format(hash_str, entry->key);
+      if (strncasecmp((const char *)ptr - FOSSILIZE_BLOB_HASH_LENGTH,
+                      hash_str, FOSSILIZE_BLOB_HASH_LENGTH) != 0)
+         goto out;
+
+      /* verify checksum, entries never change once written */
+      if (header.crc != 0 &&
+          util_hash_crc32(ptr + header_size, header.payload_size) != header.crc)
+         goto out;
+
+      entry->verified = true;
    }
 
+   entry->header = header;
+   data = ptr + header_size;
+   touch_foz_entry(foz_db, entry);
+
+   if (size)
+      *size = header.payload_size;
+
+out:
    simple_mtx_unlock(&foz_db->mtx);
 
+   return data;
+}
+
+/* Same as foz_map_entry() but returns a copy of the entry, which the caller
+ * must free.
+ */
+void *
+foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+               size_t *size)
+{
+   size_t data_sz;
+   const void *entry = foz_map_entry(foz_db, cache_key_160bit, &data_sz);
+   if (!entry)
+      return NULL;
+
+   void *data = malloc(data_sz);
+   if (!data)
+      return NULL;
+   memcpy(data, entry, data_sz);
+
    if (size)
       *size = data_sz;
 
    return data;
+}
+
+/* Whether another process replaced the default db files with compacted ones
+ * since we opened them.
+ */
+static bool
+default_foz_db_replaced(struct foz_db *foz_db)
+{
+   struct stat fd_st, path_st;
+
+   if (fstat(fileno(foz_db->file[0]), &fd_st) == -1 ||
+       stat(foz_db->filename, &path_st) == -1)
+      return false;
+
+   if (fd_st.st_dev != path_st.st_dev || fd_st.st_ino != path_st.st_ino)
+      return true;
+
+   if (fstat(fileno(foz_db->db_idx), &fd_st) == -1 ||
+       stat(foz_db->idx_filename, &path_st) == -1)
+      return false;
+
+   return fd_st.st_dev != path_st.st_dev || fd_st.st_ino != path_st.st_ino;
+}
+
+/* Returns the entries of the default db, to be freed by the caller. */
+static struct foz_db_entry **
+get_default_foz_db_entries(struct foz_db *foz_db, unsigned *count)
+{
+   struct foz_db_entry **entries;
+   unsigned n = 0;
+
+   hash_table_u64_foreach(foz_db->index_db, he)
+      n++;
+
+   entries = malloc(MAX2(n, 1) * sizeof(*entries));
+   if (!entries)
+      return NULL;
+
+   n = 0;
+   hash_table_u64_foreach(foz_db->index_db, he) {
+      struct foz_db_entry *entry = he.data;
+      if (entry->file_idx == 0)
+         entries[n++] = entry;
+   }
+
+   *count = n;
+   return entries;
+}
+
+/* Load the default db again from the files now at its paths. The old
+ * mapping is kept, as entries returned by foz_map_entry() point into it.
+ * Called with mtx held.
+ */
+static bool
+reopen_default_foz_db(struct foz_db *foz_db)
+{
+   uint8_t magic[FOZ_REF_MAGIC_SIZE];
+   FILE *file, *db_idx;
+   int lru_fd;
+
+   if (!open_default_foz_db_files(foz_db, &file, &db_idx, &lru_fd))
+      return false;
+
+   /* Don't switch over to files which aren't set up yet. */
+   if (fread(magic, 1, FOZ_REF_MAGIC_SIZE, db_idx) != FOZ_REF_MAGIC_SIZE ||
+       memcmp(magic, stream_reference_magic_and_version,
+              FOZ_REF_MAGIC_SIZE - 1) ||
+       magic[FOZ_REF_MAGIC_SIZE - 1] > FOSSILIZE_FORMAT_VERSION ||
+       magic[FOZ_REF_MAGIC_SIZE - 1] < FOSSILIZE_FORMAT_MIN_COMPAT_VERSION) {
+      goto fail;
+   }
+
+   unsigned count;
+   struct foz_db_entry **entries = get_default_foz_db_entries(foz_db, &count);
+   if (!entries)
+      goto fail;
+
+   for (unsigned i = 0; i < count; i++) {
+      _mesa_hash_table_u64_remove(foz_db->index_db,
+                                  truncate_hash_to_64bits(entries[i]->key));
+   }
+   free(entries);
+
+   retire_foz_db_map(foz_db, 0);
+   fclose(foz_db->file[0]);
+   fclose(foz_db->db_idx);
+   foz_db->file[0] = file;
+   foz_db->db_idx = db_idx;
+
+   if (foz_db->lru)
+      munmap(foz_db->lru, foz_db->lru_count * sizeof(uint64_t));
+   if (foz_db->lru_fd != -1)
+      close(foz_db->lru_fd);
+   foz_db->lru = NULL;
+   foz_db->lru_count = 0;
+   foz_db->lru_fd = lru_fd;
+
+   update_foz_index(foz_db, foz_db->db_idx, 0);
+   return true;
 
 fail:
-   free(data);
+   fclose(file);
+   fclose(db_idx);
+   if (lru_fd != -1)
+      close(lru_fd);
+   return false;
+}
 
-   /* reading db entry failed. reset the file offset */
-   simple_mtx_unlock(&foz_db->mtx);
+struct foz_lru_entry {
+   struct foz_db_entry *entry;
+   uint64_t last_use;
+};
 
-   return NULL;
+static int
+cmp_foz_lru_entry(const void *a, const void *b)
+{
+   const struct foz_lru_entry *ea = a;
+   const struct foz_lru_entry *eb = b;
+
+   /* Most recently used first, then most recently added */
+   if (ea->last_use != eb->last_use)
+      return ea->last_use < eb->last_use ? 1 : -1;
+   if (ea->entry->lru_idx != eb->entry->lru_idx)
+      return ea->entry->lru_idx < eb->entry->lru_idx ? 1 : -1;
+   return 0;
+}
+
+/* Rewrite the default db with its most recently used entries, up to three
+ * quarters of the maximum size so that we don't have to do it again on the
+ * next write. The new files are renamed over the old ones, other processes
+ * pick them up before their next write. Called with the file lock and mtx
+ * held.
+ */
+static void
+compact_foz_db(struct foz_db *foz_db)
+{
+   const uint64_t target_size = foz_db->max_size / 4 * 3;
+   const uint32_t header_size = sizeof(struct foz_payload_header);
+   struct foz_lru_entry *lru = NULL;
+   FILE *file = NULL, *db_idx = NULL, *lru_file = NULL;
+   unsigned count;
+   bool ok = true;
+
+   struct foz_db_entry **entries = get_default_foz_db_entries(foz_db, &count);
+   if (!entries)
+      return;
+
+   lru = malloc(count * sizeof(*lru));
+   if (!lru) {
+      free(entries);
+      return;
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      lru[i].entry = entries[i];
+      lru[i].last_use = foz_entry_last_use(foz_db, entries[i]);
+   }
+   free(entries);
+
+   qsort(lru, count, sizeof(*lru), cmp_foz_lru_entry);
+
+   char *tmp_filename = ralloc_asprintf(NULL, "%s.tmp", foz_db->filename);
+   char *tmp_idx_filename = ralloc_asprintf(tmp_filename, "%s.tmp",
+                                            foz_db->idx_filename);
+   char *tmp_lru_filename = ralloc_asprintf(tmp_filename, "%s.tmp",
+                                            foz_db->lru_filename);
+
+   file = fopen(tmp_filename, "wb");
+   db_idx = fopen(tmp_idx_filename, "wb");
+   lru_file = fopen(tmp_lru_filename, "wb");
+   if (!file || !db_idx || !lru_file)
+      goto fail;
+
+   ok &= fwrite(stream_reference_magic_and_version, 1, FOZ_REF_MAGIC_SIZE,
+                file) == FOZ_REF_MAGIC_SIZE;
+   ok &= fwrite(stream_reference_magic_and_version, 1, FOZ_REF_MAGIC_SIZE,
+                db_idx) == FOZ_REF_MAGIC_SIZE;
+
+   uint64_t size = FOZ_REF_MAGIC_SIZE;
+   for (unsigned i = 0; i < count && ok; i++) {
+      struct foz_db_entry *entry = lru[i].entry;
+      struct foz_payload_header header;
+
+      if (!map_foz_db(foz_db, 0, entry->offset + header_size))
+         continue;
+
+      memcpy(&header, foz_db->map[0].data + entry->offset, header_size);
+
+      /* Always keep the newest entry, even if it's too big on its own. */
+      uint64_t entry_size = FOSSILIZE_BLOB_HASH_LENGTH + header_size +
+                            header.payload_size;
+      if (i > 0 && size + entry_size > target_size)
+         break;
+
+      if (!map_foz_db(foz_db, 0,
+                      entry->offset + header_size + header.payload_size))
+         continue;
+
+      const uint8_t *payload = foz_db->map[0].data + entry->offset +
+                               header_size;
+
+      char hash_str[FOSSILIZE_BLOB_HASH_LENGTH + 1];
+      _mesa_sha1_format(hash_str, entry->key);
+
+      uint64_t offset = size + FOSSILIZE_BLOB_HASH_LENGTH;
+      ok &= fwrite(hash_str, 1, FOSSILIZE_BLOB_HASH_LENGTH, file) ==
+            FOSSILIZE_BLOB_HASH_LENGTH;
+      ok &= fwrite(&header, 1, header_size, file) == header_size;
+      ok &= fwrite(payload, 1, header.payload_size, file) ==
+            header.payload_size;
+
+      header.uncompressed_size = sizeof(uint64_t);
+      header.format = FOSSILIZE_COMPRESSION_NONE;
+      header.payload_size = sizeof(uint64_t);
+      header.crc = 0;
+
+      ok &= fwrite(hash_str, 1, FOSSILIZE_BLOB_HASH_LENGTH, db_idx) ==
+            FOSSILIZE_BLOB_HASH_LENGTH;
+      ok &= fwrite(&header, 1, header_size, db_idx) == header_size;
+      ok &= fwrite(&offset, 1, sizeof(offset), db_idx) == sizeof(offset);
+
+      ok &= fwrite(&lru[i].last_use, 1, sizeof(uint64_t), lru_file) ==
+            sizeof(uint64_t);
+
+      size += entry_size;
+   }
+
+   /* Make sure the data is on disk before the renames are. */
+   ok &= fflush(file) == 0 && fsync(fileno(file)) == 0;
+   ok &= fflush(db_idx) == 0 && fsync(fileno(db_idx)) == 0;
+   ok &= fflush(lru_file) == 0;
+   if (!ok)
+      goto fail;
+
+   fclose(file);
+   fclose(db_idx);
+   fclose(lru_file);
+   file = db_idx = lru_file = NULL;
+
+   /* We hold the exclusive lock of the old db across all the renames, and
+    * the db is renamed last: processes opening the files either get the old
+    * db with its index, or wait for us and find the new db with the new
+    * index, see open_default_foz_db_files().
+    */
+   if (rename(tmp_lru_filename, foz_db->lru_filename) == 0 &&
+       rename(tmp_idx_filename, foz_db->idx_filename) == 0)
+      rename(tmp_filename, foz_db->filename);
+
+   reopen_default_foz_db(foz_db);
+
+fail:
+   if (file)
+      fclose(file);
+   if (db_idx)
+      fclose(db_idx);
+   if (lru_file)
+      fclose(lru_file);
+   unlink(tmp_filename);
+   unlink(tmp_idx_filename);
+   unlink(tmp_lru_filename);
+   ralloc_free(tmp_filename);
+   free(lru);
 }
 
 /* Here we write the cache entry to disk and store its offset in the index db.
@@ -445,13 +964,26 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
     * conditions between the write threads sharing the same file descriptor. */
    simple_mtx_lock(&foz_db->flock_mtx);
 
-   /* Wait for 1 second. This is done outside of the main mutex as I believe there is more potential
-    * for file contention than mtx contention of significant length. */
-   int err = lock_file_with_timeout(foz_db->file[0], 1000000000);
-   if (err == -1)
-      goto fail_file;
+   for (unsigned attempt = 0;; attempt++) {
+      /* Wait for 1 second. This is done outside of the main mutex as I believe there is more
+       * potential for file contention than mtx contention of significant length. */
+      int err = lock_file_with_timeout(foz_db->file[0], LOCK_EX, 1000000000);
+      if (err == -1)
+         goto fail_file;
 
-   simple_mtx_lock(&foz_db->mtx);
+      simple_mtx_lock(&foz_db->mtx);
+
+      /* If another process compacted the db while we waited for the lock, we hold the lock of the
+       * old files, which nobody else is going to look at. */
+      if (attempt == 2 || !default_foz_db_replaced(foz_db))
+         break;
+
+      flock(fileno(foz_db->file[0]), LOCK_UN);
+      bool reopened = reopen_default_foz_db(foz_db);
+      simple_mtx_unlock(&foz_db->mtx);
+      if (!reopened)
+         goto fail_file;
+   }
 
    update_foz_index(foz_db, foz_db->db_idx, 0);
 
@@ -493,6 +1025,10 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    /* Flush everything to file to reduce chance of cache corruption */
    fflush(foz_db->file[0]);
 
+   /* Our slot in the lru file follows from where the entry lands in the index. */
+   fseek(foz_db->db_idx, 0, SEEK_END);
+   uint32_t lru_idx = (ftell(foz_db->db_idx) - FOZ_REF_MAGIC_SIZE) / FOZ_IDX_ENTRY_SIZE;
+
    /* Write hash header to index db */
    if (fwrite(hash_str, 1, FOSSILIZE_BLOB_HASH_LENGTH, foz_db->db_idx) !=
        FOSSILIZE_BLOB_HASH_LENGTH)
@@ -514,13 +1050,19 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    /* Flush everything to file to reduce chance of cache corruption */
    fflush(foz_db->db_idx);
 
-   entry = ralloc(foz_db->mem_ctx, struct foz_db_entry);
+   entry = rzalloc(foz_db->mem_ctx, struct foz_db_entry);
    entry->header = header;
    entry->offset = offset;
    entry->file_idx = 0;
+   entry->lru_idx = lru_idx;
    _mesa_sha1_hex_to_sha1(entry->key, hash_str);
    _mesa_hash_table_u64_insert(foz_db->index_db, hash, entry);
 
+   stamp_new_foz_entry(foz_db, entry);
+
+   if (foz_db->max_size && (uint64_t)ftell(foz_db->file[0]) > foz_db->max_size)
+      compact_foz_db(foz_db);
+
    simple_mtx_unlock(&foz_db->mtx);
    flock(fileno(foz_db->file[0]), LOCK_UN);
    simple_mtx_unlock(&foz_db->flock_mtx);
@@ -550,6 +1092,13 @@ foz_destroy(struct foz_db *foz_db)
 {
 }
 
+const void *
+foz_map_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+              size_t *size)
+{
+   return NULL;
+}
+
 void *
 foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
                size_t *size)
@@ -68,10 +68,19 @@ struct foz_payload_header {
 struct foz_db_entry {
    uint8_t file_idx;
    uint8_t key[20];
+   bool verified;                    /* Payload crc has been checked */
+   uint32_t lru_idx;                 /* Slot in the default db's lru file */
    uint64_t offset;
    struct foz_payload_header header;
 };
 
+struct foz_db_map {
+   uint8_t *data;
+   size_t size;                      /* Bytes mapped, may go past EOF */
+   uint64_t file_size;               /* Bytes known to be in the file */
+   struct foz_db_map *next;          /* Older mappings of the same db */
+};
+
 struct foz_db {
    FILE *file[FOZ_MAX_DBS];          /* An array of all foz dbs */
    FILE *db_idx;                     /* The default writable foz db idx */
@@ -80,6 +89,16 @@ struct foz_db {
    void *mem_ctx;
    struct hash_table_u64 *index_db;  /* Hash table of all foz db entries */
    bool alive;
+
+   struct foz_db_map map[FOZ_MAX_DBS]; /* Read only mappings of the dbs */
+
+   char *filename;                   /* Paths of the default foz db files */
+   char *idx_filename;
+   char *lru_filename;
+   uint64_t max_size;                /* Default db size triggering eviction */
+   int lru_fd;                       /* Last use time of each default entry */
+   uint64_t *lru;
+   size_t lru_count;
 };
 
 bool
@@ -88,6 +107,10 @@ foz_prepare(struct foz_db *foz_db, char *cache_path);
 void
 foz_destroy(struct foz_db *foz_db);
 
+const void *
+foz_map_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+              size_t *size);
+
 void *
 foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
                size_t *size);
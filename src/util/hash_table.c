@@ -911,3 +911,50 @@ _mesa_hash_table_u64_remove(struct hash_table_u64 *ht, uint64_t key)
       free(_key);
    }
 }
+
+static uint64_t
+hash_table_u64_entry_key(struct hash_entry *entry)
+{
+   if (sizeof(void *) == 8)
+      return (uintptr_t)entry->key;
+   else
+      return ((const struct hash_key_u64 *)entry->key)->value;
+}
+
+/**
+ * Returns the entry following \p ent, or the first one if \p ent is NULL.
+ * The returned entry has NULL data once there are no more entries.
+ */
+struct hash_entry_u64
+_mesa_hash_table_u64_next_entry(struct hash_table_u64 *ht,
+                                struct hash_entry_u64 *ent)
+{
+   struct hash_entry_u64 next = { 0, NULL };
+   struct hash_entry *entry;
+
+   /* The entries for the reserved keys come first. */
+   if (!ent && ht->freed_key_data) {
+      next.key = FREED_KEY_VALUE;
+      next.data = ht->freed_key_data;
+      return next;
+   }
+
+   if ((!ent || ent->key == FREED_KEY_VALUE) && ht->deleted_key_data) {
+      next.key = DELETED_KEY_VALUE;
+      next.data = ht->deleted_key_data;
+      return next;
+   }
+
+   if (!ent || ent->key == FREED_KEY_VALUE || ent->key == DELETED_KEY_VALUE)
+      entry = _mesa_hash_table_next_entry(ht->table, NULL);
+   else
+      entry = _mesa_hash_table_next_entry(ht->table,
+                                          hash_table_u64_search(ht, ent->key));
+
+   if (entry) {
+      next.key = hash_table_u64_entry_key(entry);
+      next.data = entry->data;
+   }
+
+   return next;
+}
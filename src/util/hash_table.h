@@ -191,6 +191,27 @@ _mesa_hash_table_u64_remove(struct hash_table_u64 *ht, uint64_t key);
 void
 _mesa_hash_table_u64_clear(struct hash_table_u64 *ht);
 
+struct hash_entry_u64 {
+   uint64_t key;
+   void *data;
+};
+
+struct hash_entry_u64
+_mesa_hash_table_u64_next_entry(struct hash_table_u64 *ht,
+                                struct hash_entry_u64 *ent);
+
+/**
+ * Iterates over the entries of a u64 table, including the ones with the
+ * reserved keys.  The next entry is found by looking up the current key, so
+ * entries must not be inserted or removed while iterating.  Iteration stops
+ * at the first entry with NULL data.
+ */
+#define hash_table_u64_foreach(ht, entry)                                   \
+   for (struct hash_entry_u64 entry =                                       \
+           _mesa_hash_table_u64_next_entry(ht, NULL);                       \
+        entry.data != NULL;                                                 \
+        entry = _mesa_hash_table_u64_next_entry(ht, &entry))
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
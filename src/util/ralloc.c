@@ -28,6 +28,7 @@
 #include <string.h>
 #include <stdint.h>
 
+#include "util/list.h"
 #include "util/macros.h"
 #include "util/u_math.h"
 #include "util/u_printf.h"
@@ -892,3 +893,341 @@ linear_strcat(void *parent, char **dest, const char *str)
 {
    return linear_cat(parent, dest, str, strlen(str));
 }
+
+/***************************************************************************
+ * Garbage-collected allocator for many small objects.
+ ***************************************************************************
+ *
+ * Objects of up to GC_MAX_SLAB_OBJECT_SIZE bytes are rounded up to a size
+ * class and suballocated from slabs holding objects of that class only.
+ * Each object is preceded by a gc_block_header locating its slab, and freed
+ * objects are chained through their own memory into the slab's free list.
+ * Slabs with room left are kept on a per-class list, so an allocation only
+ * has to look at the first one.
+ *
+ * Larger objects are ralloc'd on their own and kept on a list for sweeping.
+ *
+ * Collections flip the context's generation bit: marking an object copies
+ * the current bit into its header, and whatever still carries the old bit
+ * at gc_sweep_end() is freed.
+ */
+
+#define GC_CONTEXT_CANARY 0xAF6B9C83
+#define GC_CANARY 0xAF6B
+
+#define GC_SIZE_CLASS_GRANULARITY 16
+#define GC_MAX_SLAB_OBJECT_SIZE 512
+#define GC_NUM_SIZE_CLASSES (GC_MAX_SLAB_OBJECT_SIZE / GC_SIZE_CLASS_GRANULARITY)
+
+/* The first slab of a size class holds GC_MIN_SLAB_OBJECTS objects, and
+ * each new one twice as many as the previous, up to about GC_MAX_SLAB_SIZE
+ * bytes.  Small shaders stay small, while large ones don't spend their time
+ * in malloc and page faults.
+ */
+#define GC_MIN_SLAB_OBJECTS 8
+#define GC_MAX_SLAB_SIZE 65536
+
+#define GC_IS_USED    (1 << 0)
+#define GC_IS_LARGE   (1 << 1)
+#define GC_GENERATION (1 << 2)
+
+typedef struct {
+#ifndef NDEBUG
+   uint16_t canary;
+#endif
+   uint8_t size_class;
+   uint8_t flags;
+   /* Distance from the start of the slab; unused for large objects. */
+   uint32_t slab_offset;
+} gc_block_header;
+
+typedef struct {
+   gc_ctx *ctx;
+   struct list_head link;        /* in gc_ctx::slabs */
+   struct list_head free_link;   /* in gc_ctx::free_slabs, if not full */
+   char *objects;                /* header of the first object */
+   char *next_unused;            /* objects from here on were never used */
+   char *end;
+   gc_block_header *freelist;
+   unsigned num_allocated;
+} gc_slab;
+
+typedef struct {
+   struct list_head link;        /* in gc_ctx::large_objects */
+   gc_block_header header;
+} gc_large_block;
+
+struct gc_ctx {
+#ifndef NDEBUG
+   unsigned canary;
+#endif
+   /* Either 0 or GC_GENERATION, see gc_sweep_start(). */
+   uint8_t current_generation;
+
+   struct list_head slabs[GC_NUM_SIZE_CLASSES];
+   struct list_head free_slabs[GC_NUM_SIZE_CLASSES];
+   struct list_head large_objects;
+
+   /* Number of objects in the next slab of each size class. */
+   unsigned slab_objects[GC_NUM_SIZE_CLASSES];
+};
+
+static inline size_t
+gc_object_stride(unsigned size_class)
+{
+   return sizeof(gc_block_header) +
+          (size_class + 1) * GC_SIZE_CLASS_GRANULARITY;
+}
+
+static gc_block_header *
+gc_get_header(const void *ptr)
+{
+   gc_block_header *header = (gc_block_header *)ptr - 1;
+   assert(header->canary == GC_CANARY);
+   return header;
+}
+
+static gc_slab *
+gc_get_slab(gc_block_header *header)
+{
+   assert(!(header->flags & GC_IS_LARGE));
+   return (gc_slab *)((char *)header - header->slab_offset);
+}
+
+static gc_large_block *
+gc_get_large_block(gc_block_header *header)
+{
+   assert(header->flags & GC_IS_LARGE);
+   return (gc_large_block *)((char *)header - offsetof(gc_large_block, header));
+}
+
+gc_ctx *
+gc_context(const void *parent)
+{
+   gc_ctx *ctx = rzalloc(parent, gc_ctx);
+   if (unlikely(!ctx))
+      return NULL;
+
+#ifndef NDEBUG
+   ctx->canary = GC_CONTEXT_CANARY;
+#endif
+   for (unsigned i = 0; i < GC_NUM_SIZE_CLASSES; i++) {
+      list_inithead(&ctx->slabs[i]);
+      list_inithead(&ctx->free_slabs[i]);
+      ctx->slab_objects[i] = GC_MIN_SLAB_OBJECTS;
+   }
+   list_inithead(&ctx->large_objects);
+
+   return ctx;
+}
+
+static gc_slab *
+gc_create_slab(gc_ctx *ctx, unsigned size_class)
+{
+   const size_t stride = gc_object_stride(size_class);
+   const size_t header_size = ALIGN_POT(sizeof(gc_slab), 8);
+   const unsigned count = ctx->slab_objects[size_class];
+
+   if (count * 2 * stride <= GC_MAX_SLAB_SIZE)
+      ctx->slab_objects[size_class] = count * 2;
+
+   gc_slab *slab = ralloc_size(ctx, header_size + count * stride);
+   if (unlikely(!slab))
+      return NULL;
+
+   slab->ctx = ctx;
+   slab->objects = (char *)slab + header_size;
+   slab->next_unused = slab->objects;
+   slab->end = slab->objects + count * stride;
+   slab->freelist = NULL;
+   slab->num_allocated = 0;
+
+   list_add(&slab->link, &ctx->slabs[size_class]);
+   list_add(&slab->free_link, &ctx->free_slabs[size_class]);
+
+   return slab;
+}
+
+static void
+gc_free_slab(gc_slab *slab)
+{
+   list_del(&slab->link);
+   if (list_is_linked(&slab->free_link))
+      list_del(&slab->free_link);
+   ralloc_free(slab);
+}
+
+static void *
+gc_alloc_large(gc_ctx *ctx, size_t size)
+{
+   gc_large_block *block = ralloc_size(ctx, sizeof(gc_large_block) + size);
+   if (unlikely(!block))
+      return NULL;
+
+   list_add(&block->link, &ctx->large_objects);
+
+#ifndef NDEBUG
+   block->header.canary = GC_CANARY;
+#endif
+   block->header.size_class = 0;
+   block->header.flags = GC_IS_USED | GC_IS_LARGE | ctx->current_generation;
+   block->header.slab_offset = 0;
+
+   return &block->header + 1;
+}
+
+void *
+gc_alloc_size(gc_ctx *ctx, size_t size)
+{
+   assert(ctx->canary == GC_CONTEXT_CANARY);
+
+   if (size > GC_MAX_SLAB_OBJECT_SIZE)
+      return gc_alloc_large(ctx, size);
+
+   const unsigned size_class = size ? (size - 1) / GC_SIZE_CLASS_GRANULARITY : 0;
+   gc_slab *slab;
+
+   if (list_is_empty(&ctx->free_slabs[size_class])) {
+      slab = gc_create_slab(ctx, size_class);
+      if (unlikely(!slab))
+         return NULL;
+   } else {
+      slab = list_first_entry(&ctx->free_slabs[size_class], gc_slab, free_link);
+   }
+
+   gc_block_header *header;
+   if (slab->freelist) {
+      header = slab->freelist;
+      slab->freelist = *(gc_block_header **)(header + 1);
+   } else {
+      header = (gc_block_header *)slab->next_unused;
+      slab->next_unused += gc_object_stride(size_class);
+
+#ifndef NDEBUG
+      header->canary = GC_CANARY;
+#endif
+      header->size_class = size_class;
+      header->slab_offset = (char *)header - (char *)slab;
+   }
+
+   header->flags = GC_IS_USED | ctx->current_generation;
+   slab->num_allocated++;
+
+   if (!slab->freelist && slab->next_unused == slab->end)
+      list_del(&slab->free_link);
+
+   return header + 1;
+}
+
+void *
+gc_zalloc_size(gc_ctx *ctx, size_t size)
+{
+   void *ptr = gc_alloc_size(ctx, size);
+
+   if (likely(ptr))
+      memset(ptr, 0, size);
+
+   return ptr;
+}
+
+/* Put a slab object back on its slab's free list. */
+static void
+gc_slab_release(gc_slab *slab, gc_block_header *header)
+{
+   header->flags = 0;
+   *(gc_block_header **)(header + 1) = slab->freelist;
+   slab->freelist = header;
+   slab->num_allocated--;
+
+   if (!list_is_linked(&slab->free_link))
+      list_add(&slab->free_link, &slab->ctx->free_slabs[header->size_class]);
+}
+
+void
+gc_free(void *ptr)
+{
+   if (ptr == NULL)
+      return;
+
+   gc_block_header *header = gc_get_header(ptr);
+   assert(header->flags & GC_IS_USED);
+
+   if (header->flags & GC_IS_LARGE) {
+      gc_large_block *block = gc_get_large_block(header);
+      list_del(&block->link);
+      ralloc_free(block);
+      return;
+   }
+
+   gc_slab *slab = gc_get_slab(header);
+   gc_slab_release(slab, header);
+
+   /* Give the memory back once another slab can take the allocations. */
+   if (slab->num_allocated == 0 &&
+       !list_is_singular(&slab->ctx->free_slabs[header->size_class]))
+      gc_free_slab(slab);
+}
+
+gc_ctx *
+gc_get_context(void *ptr)
+{
+   gc_block_header *header = gc_get_header(ptr);
+
+   if (header->flags & GC_IS_LARGE)
+      return ralloc_parent(gc_get_large_block(header));
+
+   return gc_get_slab(header)->ctx;
+}
+
+void
+gc_sweep_start(gc_ctx *ctx)
+{
+   assert(ctx->canary == GC_CONTEXT_CANARY);
+   ctx->current_generation ^= GC_GENERATION;
+}
+
+void
+gc_mark_live(gc_ctx *ctx, const void *ptr)
+{
+   gc_block_header *header = gc_get_header(ptr);
+
+   assert(header->flags & GC_IS_USED);
+   assert(gc_get_context((void *)ptr) == ctx);
+
+   header->flags = (header->flags & ~GC_GENERATION) | ctx->current_generation;
+}
+
+static inline bool
+gc_is_garbage(gc_ctx *ctx, const gc_block_header *header)
+{
+   return (header->flags & GC_IS_USED) &&
+          (header->flags & GC_GENERATION) != ctx->current_generation;
+}
+
+void
+gc_sweep_end(gc_ctx *ctx)
+{
+   assert(ctx->canary == GC_CONTEXT_CANARY);
+
+   for (unsigned i = 0; i < GC_NUM_SIZE_CLASSES; i++) {
+      const size_t stride = gc_object_stride(i);
+
+      list_for_each_entry_safe(gc_slab, slab, &ctx->slabs[i], link) {
+         for (char *p = slab->objects; p < slab->next_unused; p += stride) {
+            gc_block_header *header = (gc_block_header *)p;
+            if (gc_is_garbage(ctx, header))
+               gc_slab_release(slab, header);
+         }
+
+         if (slab->num_allocated == 0)
+            gc_free_slab(slab);
+      }
+   }
+
+   list_for_each_entry_safe(gc_large_block, block, &ctx->large_objects, link) {
+      if (gc_is_garbage(ctx, &block->header)) {
+         list_del(&block->link);
+         ralloc_free(block);
+      }
+   }
+}
@@ -597,6 +597,75 @@ bool linear_vasprintf_rewrite_tail(void *parent, char **str, size_t *start,
                                    const char *fmt, va_list args);
 bool linear_strcat(void *parent, char **dest, const char *str);
 
+/// \defgroup gc Garbage-Collected Allocator @{
+
+/**
+ * A garbage-collected allocator for large numbers of small objects.
+ *
+ * Small objects are suballocated from slabs of equally sized objects, and
+ * freed objects go on a free list for the next allocation of that size, so
+ * neither allocating nor freeing normally reaches malloc.  Larger objects
+ * get a ralloc allocation of their own.
+ *
+ * Objects can be freed individually with gc_free(), or collected in bulk:
+ * every object that isn't passed to gc_mark_live() between gc_sweep_start()
+ * and gc_sweep_end() is freed.  The slabs are ralloc children of the
+ * context, so freeing the context (or its parent) frees every object.
+ *
+ * Objects are aligned to 8 bytes and can't be used as ralloc contexts.
+ */
+typedef struct gc_ctx gc_ctx;
+
+/**
+ * Create a new garbage-collected allocation context.
+ *
+ * \param parent  ralloc context the gc_ctx is a child of
+ */
+gc_ctx *gc_context(const void *parent);
+
+/**
+ * Allocate an array of \p count elements of \p type from \p ctx.
+ */
+#define gc_alloc(ctx, type, count) \
+   ((type *) gc_alloc_size(ctx, sizeof(type) * (count)))
+
+/**
+ * Same as gc_alloc, but also clears memory.
+ */
+#define gc_zalloc(ctx, type, count) \
+   ((type *) gc_zalloc_size(ctx, sizeof(type) * (count)))
+
+void *gc_alloc_size(gc_ctx *ctx, size_t size) MALLOCLIKE;
+void *gc_zalloc_size(gc_ctx *ctx, size_t size) MALLOCLIKE;
+
+/**
+ * Free an object allocated from a gc_ctx.  NULL is ignored.
+ */
+void gc_free(void *ptr);
+
+/**
+ * Return the gc_ctx an object was allocated from.
+ */
+gc_ctx *gc_get_context(void *ptr);
+
+/**
+ * Start a collection.  Objects allocated from now on are considered live.
+ */
+void gc_sweep_start(gc_ctx *ctx);
+
+/**
+ * Keep \p ptr, allocated from \p ctx, alive through the current collection.
+ */
+void gc_mark_live(gc_ctx *ctx, const void *ptr);
+
+/**
+ * Finish a collection, freeing every object that wasn't marked live and
+ * returning the slabs left empty.
+ */
+void gc_sweep_end(gc_ctx *ctx);
+
+/// @}
+
 #ifdef __cplusplus
 } /* end of extern "C" */
 #endif
@@ -487,9 +487,117 @@ ra_get_adjacency_bit_index(unsigned n1, unsigned n2)
    return ra_get_num_adjacency_bits(k1) + k2;
 }
 
+#define RA_EDGE_EMPTY 0
+#define RA_EDGE_DELETED UINT64_MAX
+
+static uint64_t
+ra_get_edge_key(unsigned n1, unsigned n2)
+{
+   /* Bit index 0 is a valid edge, so shift keys up to keep 0 for empty
+    * slots.
+    */
+   return ra_get_adjacency_bit_index(n1, n2) + 1;
+}
+
+static unsigned
+ra_edge_set_hash(const struct ra_edge_set *set, uint64_t key)
+{
+   /* Fibonacci hashing: the top bits of the product are well mixed. */
+   return (key * 0x9e3779b97f4a7c15ull) >> (64 - set->size_log2);
+}
+
+static bool
+ra_edge_set_contains(const struct ra_edge_set *set, uint64_t key)
+{
+   unsigned mask = (1u << set->size_log2) - 1;
+
+   for (unsigned i = ra_edge_set_hash(set, key);; i = (i + 1) & mask) {
+      if (set->keys[i] == key)
+         return true;
+      if (set->keys[i] == RA_EDGE_EMPTY)
+         return false;
+   }
+}
+
+/* Inserts a key that isn't in the set, without checking the load. */
+static void
+ra_edge_set_insert_slot(struct ra_edge_set *set, uint64_t key)
+{
+   unsigned mask = (1u << set->size_log2) - 1;
+   unsigned i = ra_edge_set_hash(set, key);
+
+   while (set->keys[i] != RA_EDGE_EMPTY && set->keys[i] != RA_EDGE_DELETED)
+      i = (i + 1) & mask;
+
+   if (set->keys[i] == RA_EDGE_DELETED)
+      set->deleted--;
+   set->keys[i] = key;
+   set->entries++;
+}
+
+/* Rebuilds the set with room for at least min_entries at half load, which
+ * also drops any deleted slots.
+ */
+static void
+ra_edge_set_resize(struct ra_graph *g, struct ra_edge_set *set,
+                   unsigned min_entries)
+{
+   uint64_t *old_keys = set->keys;
+   unsigned old_size = old_keys ? 1u << set->size_log2 : 0;
+
+   set->size_log2 = 10;
+   while ((1ull << set->size_log2) < (uint64_t)min_entries * 2)
+      set->size_log2++;
+
+   set->keys = rzalloc_array(g, uint64_t, 1u << set->size_log2);
+   set->entries = 0;
+   set->deleted = 0;
+
+   for (unsigned i = 0; i < old_size; i++) {
+      if (old_keys[i] != RA_EDGE_EMPTY && old_keys[i] != RA_EDGE_DELETED)
+         ra_edge_set_insert_slot(set, old_keys[i]);
+   }
+
+   ralloc_free(old_keys);
+}
+
+static void
+ra_edge_set_insert(struct ra_graph *g, struct ra_edge_set *set, uint64_t key)
+{
+   /* Keep at least a quarter of the slots empty so that probes stay short
+    * and always terminate.
+    */
+   if ((uint64_t)(set->entries + set->deleted + 1) * 4 >
+       (3ull << set->size_log2))
+      ra_edge_set_resize(g, set, set->entries + 1);
+
+   ra_edge_set_insert_slot(set, key);
+}
+
+static void
+ra_edge_set_remove(struct ra_edge_set *set, uint64_t key)
+{
+   unsigned mask = (1u << set->size_log2) - 1;
+
+   for (unsigned i = ra_edge_set_hash(set, key);; i = (i + 1) & mask) {
+      if (set->keys[i] == key) {
+         set->keys[i] = RA_EDGE_DELETED;
+         set->entries--;
+         set->deleted++;
+         return;
+      }
+      if (set->keys[i] == RA_EDGE_EMPTY)
+         return;
+   }
+}
+
 static bool
 ra_test_adjacency_bit(struct ra_graph *g, unsigned n1, unsigned n2)
 {
+   if (g->sparse)
+      return ra_edge_set_contains(&g->sparse_adjacency,
+                                  ra_get_edge_key(n1, n2));
+
    uint64_t index = ra_get_adjacency_bit_index(n1, n2);
    return BITSET_TEST(g->adjacency, index);
 }
@@ -497,17 +605,64 @@ ra_test_adjacency_bit(struct ra_graph *g, unsigned n1, unsigned n2)
 static void
 ra_set_adjacency_bit(struct ra_graph *g, unsigned n1, unsigned n2)
 {
-   unsigned index = ra_get_adjacency_bit_index(n1, n2);
+   if (g->sparse) {
+      ra_edge_set_insert(g, &g->sparse_adjacency, ra_get_edge_key(n1, n2));
+      return;
+   }
+
+   uint64_t index = ra_get_adjacency_bit_index(n1, n2);
    BITSET_SET(g->adjacency, index);
 }
 
 static void
 ra_clear_adjacency_bit(struct ra_graph *g, unsigned n1, unsigned n2)
 {
-   unsigned index = ra_get_adjacency_bit_index(n1, n2);
+   if (g->sparse) {
+      ra_edge_set_remove(&g->sparse_adjacency, ra_get_edge_key(n1, n2));
+      return;
+   }
+
+   uint64_t index = ra_get_adjacency_bit_index(n1, n2);
    BITSET_CLEAR(g->adjacency, index);
 }
 
+/**
+ * Switches the graph from the triangular adjacency bit matrix to a hash set
+ * of edges.  The set costs memory per edge rather than per pair of nodes,
+ * which is what keeps huge shaders allocatable.  This happens automatically
+ * once the graph grows past RA_SPARSE_ADJACENCY_MIN_NODES.
+ *
+ * Only the edge membership test depends on the representation: simplify,
+ * select and spilling all walk the per-node adjacency lists, so allocation
+ * results are the same either way.
+ */
+void
+ra_make_adjacency_sparse(struct ra_graph *g)
+{
+   if (g->sparse)
+      return;
+
+   unsigned edges = 0;
+   for (unsigned n = 0; n < g->alloc; n++)
+      edges += util_dynarray_num_elements(&g->nodes[n].adjacency_list,
+                                          unsigned int);
+   edges /= 2;
+
+   ra_edge_set_resize(g, &g->sparse_adjacency, edges);
+
+   for (unsigned n1 = 0; n1 < g->alloc; n1++) {
+      util_dynarray_foreach(&g->nodes[n1].adjacency_list, unsigned int, n2p) {
+         if (*n2p < n1)
+            ra_edge_set_insert_slot(&g->sparse_adjacency,
+                                    ra_get_edge_key(n1, *n2p));
+      }
+   }
+
+   ralloc_free(g->adjacency);
+   g->adjacency = NULL;
+   g->sparse = true;
+}
+
 static void
 ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
@@ -546,9 +701,15 @@ ra_realloc_interference_graph(struct ra_graph *g, unsigned int alloc)
    assert(g->alloc % BITSET_WORDBITS == 0);
    alloc = align64(alloc, BITSET_WORDBITS);
    g->nodes = rerzalloc(g, g->nodes, struct ra_node, g->alloc, alloc);
-   g->adjacency = rerzalloc(g, g->adjacency, BITSET_WORD,
-                            BITSET_WORDS(ra_get_num_adjacency_bits(g->alloc)),
-                            BITSET_WORDS(ra_get_num_adjacency_bits(alloc)));
+
+   if (!g->sparse && alloc > RA_SPARSE_ADJACENCY_MIN_NODES)
+      ra_make_adjacency_sparse(g);
+
+   if (!g->sparse) {
+      g->adjacency = rerzalloc(g, g->adjacency, BITSET_WORD,
+                               BITSET_WORDS(ra_get_num_adjacency_bits(g->alloc)),
+                               BITSET_WORDS(ra_get_num_adjacency_bits(alloc)));
+   }
 
    /* Initialize new nodes. */
    for (unsigned i = g->alloc; i < alloc; i++) {
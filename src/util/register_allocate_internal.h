@@ -124,13 +124,39 @@ struct ra_node {
    } tmp;
 };
 
+/**
+ * Graphs with more nodes than this track their interference edges in a
+ * struct ra_edge_set instead of a triangular bit matrix, whose size grows
+ * with the square of the node count.
+ */
+#define RA_SPARSE_ADJACENCY_MIN_NODES 8192
+
+/**
+ * Open-addressed hash set of interference edges, keyed by the edge's
+ * index in the triangular bit matrix plus one.
+ */
+struct ra_edge_set {
+   uint64_t *keys;
+   unsigned int size_log2;
+   unsigned int entries;
+   unsigned int deleted;
+};
+
 struct ra_graph {
    struct ra_regs *regs;
    /**
     * the variables that need register allocation.
     */
    struct ra_node *nodes;
+
+   /**
+    * Whether interference edges are tracked in sparse_adjacency rather
+    * than the adjacency bit matrix.
+    */
+   bool sparse;
    BITSET_WORD *adjacency;
+   struct ra_edge_set sparse_adjacency;
+
    unsigned int count; /**< count of nodes. */
 
    unsigned int alloc; /**< count of nodes allocated. */
@@ -172,6 +198,8 @@ struct ra_graph {
 bool ra_class_allocations_conflict(struct ra_class *c1, unsigned int r1,
                                    struct ra_class *c2, unsigned int r2);
 
+void ra_make_adjacency_sparse(struct ra_graph *g);
+
 #ifdef __cplusplus
 } /* extern "C" */
 
@@ -121,6 +121,53 @@ TEST(BlobTest, WriteAndReadFunctions)
    blob_finish(&blob);
 }
 
+// Test that variable-length integers round-trip, take as few bytes as
+// expected and are not aligned.
+TEST(BlobTest, ULEB128)
+{
+   static const struct {
+      uint32_t value;
+      size_t size;
+   } tests[] = {
+      { 0, 1 },
+      { 1, 1 },
+      { 0x7f, 1 },
+      { 0x80, 2 },
+      { 0x3fff, 2 },
+      { 0x4000, 3 },
+      { 0x12345678, 5 },
+      { 0xffffffff, 5 },
+   };
+   struct blob blob;
+   struct blob_reader reader;
+
+   blob_init(&blob);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(tests); i++) {
+      size_t start = blob.size;
+      blob_write_uint8(&blob, 0xaa);
+      blob_write_uleb128(&blob, tests[i].value);
+      EXPECT_EQ(1 + tests[i].size, blob.size - start) << tests[i].value;
+   }
+
+   blob_reader_init(&reader, blob.data, blob.size);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(tests); i++) {
+      EXPECT_EQ(0xaa, blob_read_uint8(&reader));
+      EXPECT_EQ(tests[i].value, blob_read_uleb128(&reader));
+   }
+
+   EXPECT_EQ(reader.end - reader.data, reader.current - reader.data);
+   EXPECT_FALSE(reader.overrun);
+
+   // A truncated encoding is an overrun.
+   blob_reader_init(&reader, blob.data + blob.size - 3, 2);
+   EXPECT_EQ(0u, blob_read_uleb128(&reader));
+   EXPECT_TRUE(reader.overrun);
+
+   blob_finish(&blob);
+}
+
 // Test that data values are written and read with proper alignment.
 TEST(BlobTest, Alignment)
 {
@@ -519,6 +519,85 @@ test_put_and_get_between_instances()
    disk_cache_destroy(cache1);
    disk_cache_destroy(cache2);
 }
+
+/* Fill a buffer with data that neither zlib nor zstd can shrink, so the
+ * size of the items on disk is predictable.
+ */
+static uint8_t *
+make_incompressible_blob(size_t size, uint32_t seed)
+{
+   uint8_t *blob = (uint8_t *) malloc(size);
+
+   for (size_t i = 0; i < size; i++) {
+      seed = seed * 1103515245 + 12345;
+      blob[i] = seed >> 24;
+   }
+
+   return blob;
+}
+
+/* The single file cache compacts itself down to 3/4 of MAX_SIZE once it
+ * outgrows it, keeping the most recently used items.
+ */
+static void
+test_single_file_eviction()
+{
+   const size_t blob_size = 256 * 1024;
+   uint8_t *blobs[4];
+   uint8_t keys[4][20];
+
+#ifdef SHADER_CACHE_DISABLE_BY_DEFAULT
+   setenv("MESA_SHADER_CACHE_DISABLE", "false", 1);
+#endif /* SHADER_CACHE_DISABLE_BY_DEFAULT */
+
+   setenv("MESA_SHADER_CACHE_MAX_SIZE", "1M", 1);
+   struct disk_cache *cache = disk_cache_create("test_eviction",
+                                                "make_check", 0);
+
+   for (unsigned i = 0; i < 4; i++) {
+      blobs[i] = make_incompressible_blob(blob_size, i + 1);
+      disk_cache_compute_key(cache, blobs[i], blob_size, keys[i]);
+   }
+
+   /* Three items fit below the 1MB limit. */
+   for (unsigned i = 0; i < 3; i++) {
+      disk_cache_put(cache, keys[i], blobs[i], blob_size, NULL);
+      disk_cache_wait_for_idle(cache);
+   }
+
+   for (unsigned i = 0; i < 3; i++)
+      EXPECT_TRUE(does_cache_contain(cache, keys[i]))
+         << "no eviction before overflow (item " << i << ")";
+
+   /* Use the first item again, then overflow the cache with a fourth. Only
+    * the two most recently used items fit in the compacted file.
+    */
+   EXPECT_TRUE(does_cache_contain(cache, keys[0]));
+
+   disk_cache_put(cache, keys[3], blobs[3], blob_size, NULL);
+   disk_cache_wait_for_idle(cache);
+
+   for (unsigned pass = 0; pass < 2; pass++) {
+      EXPECT_TRUE(does_cache_contain(cache, keys[0]))
+         << "recently used item survives eviction (pass " << pass << ")";
+      EXPECT_FALSE(does_cache_contain(cache, keys[1]))
+         << "least recently used item is evicted (pass " << pass << ")";
+      EXPECT_FALSE(does_cache_contain(cache, keys[2]))
+         << "least recently used item is evicted (pass " << pass << ")";
+      EXPECT_TRUE(does_cache_contain(cache, keys[3]))
+         << "newly added item survives eviction (pass " << pass << ")";
+
+      /* Check that the compacted file is what a new instance sees too. */
+      disk_cache_destroy(cache);
+      cache = disk_cache_create("test_eviction", "make_check", 0);
+   }
+
+   disk_cache_destroy(cache);
+   unsetenv("MESA_SHADER_CACHE_MAX_SIZE");
+
+   for (unsigned i = 0; i < 4; i++)
+      free(blobs[i]);
+}
 #endif /* ENABLE_SHADER_CACHE */
 
 class Cache : public ::testing::Test {
@@ -558,8 +637,8 @@ TEST_F(Cache, SingleFile)
 
    test_disk_cache_create(mem_ctx, CACHE_DIR_NAME_SF);
 
-   /* We skip testing cache size limit as the single file cache currently
-    * doesn't have any functionality to enforce cache size limits.
+   /* The single file cache evicts by compacting the whole file, which
+    * test_put_and_get() can't observe, so it gets a test of its own.
     */
    test_put_and_get(false);
 
@@ -567,6 +646,8 @@ TEST_F(Cache, SingleFile)
 
    test_put_and_get_between_instances();
 
+   test_single_file_eviction();
+
    setenv("MESA_DISK_CACHE_SINGLE_FILE", "false", 1);
 
    int err = rmrf_local(CACHE_TEST_TMP);
@@ -28,9 +28,11 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <float.h>
 
 #include "util/half_float.h"
+#include "util/os_time.h"
 #include "util/u_math.h"
 #include "util/format/u_format.h"
 #include "util/format/u_format_tests.h"
@@ -865,11 +867,306 @@ test_all(void)
 }
 
 
+/*
+ * The CPU-specific pack/unpack paths work on several pixels at a time, which
+ * the single-block test cases never reach.  Run them on whole images
+ * instead, and check that they produce exactly what the generic code does.
+ */
+
+enum simd_func {
+   SIMD_UNPACK_RGBA_8UNORM,
+   SIMD_UNPACK_RGBA,
+   SIMD_UNPACK_Z_32UNORM,
+   SIMD_UNPACK_Z_FLOAT,
+   SIMD_UNPACK_S_8UINT,
+   SIMD_PACK_RGBA_8UNORM,
+   SIMD_PACK_RGBA_FLOAT,
+   SIMD_PACK_Z_32UNORM,
+   SIMD_PACK_Z_FLOAT,
+   SIMD_PACK_S_8UINT,
+   SIMD_FUNC_COUNT,
+};
+
+static const char *simd_func_names[SIMD_FUNC_COUNT] = {
+   "unpack_rgba_8unorm",
+   "unpack_rgba",
+   "unpack_z_32unorm",
+   "unpack_z_float",
+   "unpack_s_8uint",
+   "pack_rgba_8unorm",
+   "pack_rgba_float",
+   "pack_z_32unorm",
+   "pack_z_float",
+   "pack_s_8uint",
+};
+
+#define SIMD_TEST_WIDTH 67
+#define SIMD_TEST_HEIGHT 3
+
+static boolean
+simd_func_is_optimized(enum pipe_format format, enum simd_func func)
+{
+   const struct util_format_unpack_description *unpack =
+      util_format_unpack_description(format);
+   const struct util_format_unpack_description *unpack_generic =
+      util_format_unpack_description_generic(format);
+   const struct util_format_pack_description *pack =
+      util_format_pack_description(format);
+   const struct util_format_pack_description *pack_generic =
+      util_format_pack_description_generic(format);
+
+   if (!unpack || !pack)
+      return FALSE;
+
+   switch (func) {
+   case SIMD_UNPACK_RGBA_8UNORM:
+      return unpack->unpack_rgba_8unorm != unpack_generic->unpack_rgba_8unorm;
+   case SIMD_UNPACK_RGBA:
+      return unpack->unpack_rgba != unpack_generic->unpack_rgba;
+   case SIMD_UNPACK_Z_32UNORM:
+      return unpack->unpack_z_32unorm != unpack_generic->unpack_z_32unorm;
+   case SIMD_UNPACK_Z_FLOAT:
+      return unpack->unpack_z_float != unpack_generic->unpack_z_float;
+   case SIMD_UNPACK_S_8UINT:
+      return unpack->unpack_s_8uint != unpack_generic->unpack_s_8uint;
+   case SIMD_PACK_RGBA_8UNORM:
+      return pack->pack_rgba_8unorm != pack_generic->pack_rgba_8unorm;
+   case SIMD_PACK_RGBA_FLOAT:
+      return pack->pack_rgba_float != pack_generic->pack_rgba_float;
+   case SIMD_PACK_Z_32UNORM:
+      return pack->pack_z_32unorm != pack_generic->pack_z_32unorm;
+   case SIMD_PACK_Z_FLOAT:
+      return pack->pack_z_float != pack_generic->pack_z_float;
+   case SIMD_PACK_S_8UINT:
+      return pack->pack_s_8uint != pack_generic->pack_s_8uint;
+   default:
+      unreachable("bad simd_func");
+   }
+}
+
+static void
+simd_func_run(enum pipe_format format, enum simd_func func, boolean generic,
+              uint8_t *dst, const uint8_t *src, unsigned stride,
+              unsigned width, unsigned height)
+{
+   const struct util_format_unpack_description *unpack = generic ?
+      util_format_unpack_description_generic(format) :
+      util_format_unpack_description(format);
+   const struct util_format_pack_description *pack = generic ?
+      util_format_pack_description_generic(format) :
+      util_format_pack_description(format);
+
+   switch (func) {
+   case SIMD_UNPACK_RGBA_8UNORM:
+      for (unsigned y = 0; y < height; y++)
+         unpack->unpack_rgba_8unorm(dst + y * stride, src + y * stride, width);
+      break;
+   case SIMD_UNPACK_RGBA:
+      for (unsigned y = 0; y < height; y++)
+         unpack->unpack_rgba(dst + y * stride, src + y * stride, width);
+      break;
+   case SIMD_UNPACK_Z_32UNORM:
+      unpack->unpack_z_32unorm((uint32_t *)dst, stride, src, stride, width, height);
+      break;
+   case SIMD_UNPACK_Z_FLOAT:
+      unpack->unpack_z_float((float *)dst, stride, src, stride, width, height);
+      break;
+   case SIMD_UNPACK_S_8UINT:
+      unpack->unpack_s_8uint(dst, stride, src, stride, width, height);
+      break;
+   case SIMD_PACK_RGBA_8UNORM:
+      pack->pack_rgba_8unorm(dst, stride, src, stride, width, height);
+      break;
+   case SIMD_PACK_RGBA_FLOAT:
+      pack->pack_rgba_float(dst, stride, (const float *)src, stride, width, height);
+      break;
+   case SIMD_PACK_Z_32UNORM:
+      pack->pack_z_32unorm(dst, stride, (const uint32_t *)src, stride, width, height);
+      break;
+   case SIMD_PACK_Z_FLOAT:
+      pack->pack_z_float(dst, stride, (const float *)src, stride, width, height);
+      break;
+   case SIMD_PACK_S_8UINT:
+      pack->pack_s_8uint(dst, stride, src, stride, width, height);
+      break;
+   default:
+      unreachable("bad simd_func");
+   }
+}
+
+static uint32_t
+simd_rand(void)
+{
+   static uint32_t seed = 1;
+
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+/* Fills the source of a pack/unpack call: packed pixels can be any bit
+ * pattern, while unpacked floats are kept around the [0, 1] range (with
+ * NaNs thrown in when the format clamps them away).
+ */
+static void
+simd_fill_src(enum pipe_format format, enum simd_func func,
+              uint8_t *src, size_t size)
+{
+   if (func == SIMD_PACK_RGBA_FLOAT || func == SIMD_PACK_Z_FLOAT) {
+      float *f = (float *)src;
+      boolean depth = func == SIMD_PACK_Z_FLOAT;
+
+      for (size_t i = 0; i < size / sizeof(float); i++) {
+         if (depth)
+            f[i] = (simd_rand() & 0xffffff) / (float)0xffffff;
+         else if (util_format_is_unorm(format) && i % 13 == 0)
+            f[i] = NAN;
+         else
+            f[i] = (simd_rand() & 0xffffff) / (float)0xffffff * 1.5f - 0.25f;
+      }
+   } else {
+      for (size_t i = 0; i < size; i++)
+         src[i] = simd_rand();
+   }
+}
+
+static boolean
+simd_compare(enum simd_func func, const uint8_t *a, const uint8_t *b,
+             size_t size)
+{
+   if (func != SIMD_UNPACK_RGBA && func != SIMD_UNPACK_Z_FLOAT)
+      return memcmp(a, b, size) == 0;
+
+   /* Unpacking NaNs may produce different NaN bit patterns. */
+   for (size_t i = 0; i < size; i += sizeof(float)) {
+      float fa, fb;
+      memcpy(&fa, a + i, sizeof(fa));
+      memcpy(&fb, b + i, sizeof(fb));
+      if (memcmp(&fa, &fb, sizeof(fa)) != 0 && !(isnan(fa) && isnan(fb)))
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+static boolean
+test_simd_func(enum pipe_format format, enum simd_func func)
+{
+   const unsigned stride = SIMD_TEST_WIDTH * 16;
+   const size_t size = stride * SIMD_TEST_HEIGHT;
+   uint8_t *src = malloc(size);
+   uint8_t *dst = malloc(size);
+   uint8_t *ref = malloc(size);
+   boolean success = TRUE;
+
+   printf("Testing util_format_%s_%s against the generic code ...\n",
+          util_format_short_name(format), simd_func_names[func]);
+   fflush(stdout);
+
+   simd_fill_src(format, func, src, size);
+
+   /* Packing depth or stencil keeps the other half of the pixel, so start
+    * both destinations from the same garbage.
+    */
+   for (size_t i = 0; i < size; i++)
+      dst[i] = simd_rand();
+   memcpy(ref, dst, size);
+
+   for (unsigned width = 1; width <= SIMD_TEST_WIDTH; width++) {
+      simd_func_run(format, func, FALSE, dst, src, stride, width, SIMD_TEST_HEIGHT);
+      simd_func_run(format, func, TRUE, ref, src, stride, width, SIMD_TEST_HEIGHT);
+
+      if (!simd_compare(func, dst, ref, size)) {
+         printf("FAILED: results differ from the generic code at width %u\n",
+                width);
+         success = FALSE;
+         break;
+      }
+   }
+
+   free(src);
+   free(dst);
+   free(ref);
+
+   return success;
+}
+
+static boolean
+test_simd_all(void)
+{
+   boolean success = TRUE;
+
+   for (enum pipe_format format = 1; format < PIPE_FORMAT_COUNT; format++) {
+      for (enum simd_func func = 0; func < SIMD_FUNC_COUNT; func++) {
+         if (simd_func_is_optimized(format, func) &&
+             !test_simd_func(format, func))
+            success = FALSE;
+      }
+   }
+
+   return success;
+}
+
+/*
+ * "u_format_test --bench" reports the throughput of the CPU-specific paths
+ * next to the generic ones.
+ */
+static void
+bench_simd_func(enum pipe_format format, enum simd_func func)
+{
+   const unsigned width = 1024, height = 256, reps = 20;
+   const unsigned stride = width * 16;
+   const size_t size = (size_t)stride * height;
+   uint8_t *src = malloc(size);
+   uint8_t *dst = malloc(size);
+   double mpix[2];
+
+   simd_fill_src(format, func, src, size);
+   memset(dst, 0, size);
+
+   for (unsigned generic = 0; generic < 2; generic++) {
+      simd_func_run(format, func, generic, dst, src, stride, width, height);
+
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < reps; i++)
+         simd_func_run(format, func, generic, dst, src, stride, width, height);
+      int64_t elapsed = MAX2(os_time_get_nano() - start, 1);
+
+      mpix[generic] = (double)width * height * reps * 1000.0 / elapsed;
+   }
+
+   printf("%-28s %-20s %9.1f Mpix/s (generic %9.1f Mpix/s, %.2fx)\n",
+          util_format_short_name(format), simd_func_names[func],
+          mpix[0], mpix[1], mpix[0] / mpix[1]);
+
+   free(src);
+   free(dst);
+}
+
+static void
+bench_simd_all(void)
+{
+   for (enum pipe_format format = 1; format < PIPE_FORMAT_COUNT; format++) {
+      for (enum simd_func func = 0; func < SIMD_FUNC_COUNT; func++) {
+         if (simd_func_is_optimized(format, func))
+            bench_simd_func(format, func);
+      }
+   }
+}
+
+
 int main(int argc, char **argv)
 {
    boolean success;
 
+   if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+      bench_simd_all();
+      return 0;
+   }
+
    success = test_all();
 
+   if (!test_simd_all())
+      success = FALSE;
+
    return success ? 0 : 1;
 }
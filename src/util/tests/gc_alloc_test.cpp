@@ -0,0 +1,110 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include "util/ralloc.h"
+
+#include <stdint.h>
+#include <string.h>
+
+TEST(gc_alloc_test, alloc_free)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   gc_ctx *ctx = gc_context(mem_ctx);
+
+   const size_t sizes[] = { 0, 1, 8, 16, 17, 100, 512, 513, 4096 };
+   void *ptrs[ARRAY_SIZE(sizes)];
+
+   for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++) {
+      ptrs[i] = gc_zalloc_size(ctx, sizes[i]);
+      ASSERT_NE(ptrs[i], nullptr);
+      EXPECT_EQ((uintptr_t)ptrs[i] % 8, 0u);
+      EXPECT_EQ(gc_get_context(ptrs[i]), ctx);
+
+      for (unsigned j = 0; j < sizes[i]; j++)
+         EXPECT_EQ(((uint8_t *)ptrs[i])[j], 0);
+      memset(ptrs[i], 0xff, sizes[i]);
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++)
+      gc_free(ptrs[i]);
+   gc_free(NULL);
+
+   /* A freed object is handed out again for the next allocation of its
+    * size.
+    */
+   void *a = gc_alloc_size(ctx, 40);
+   gc_free(a);
+   EXPECT_EQ(gc_alloc_size(ctx, 48), a);
+
+   ralloc_free(mem_ctx);
+}
+
+TEST(gc_alloc_test, sweep)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   gc_ctx *ctx = gc_context(mem_ctx);
+
+   const unsigned count = 10000;
+   uint32_t **ptrs = (uint32_t **)calloc(count, sizeof(*ptrs));
+
+   for (unsigned i = 0; i < count; i++) {
+      size_t size = (i % 7 == 0) ? 1000 : 4 * (1 + i % 40);
+      ptrs[i] = (uint32_t *)gc_alloc_size(ctx, size);
+      ptrs[i][0] = i;
+   }
+
+   /* Keep every third object. */
+   gc_sweep_start(ctx);
+   for (unsigned i = 0; i < count; i += 3)
+      gc_mark_live(ctx, ptrs[i]);
+   uint32_t *fresh = gc_alloc(ctx, uint32_t, 1);
+   *fresh = 0xdeadbeef;
+   gc_sweep_end(ctx);
+
+   for (unsigned i = 0; i < count; i += 3)
+      EXPECT_EQ(ptrs[i][0], i);
+   EXPECT_EQ(*fresh, 0xdeadbeef);
+
+   /* The survivors can still be freed one by one, and the context stays
+    * usable after a sweep.
+    */
+   for (unsigned i = 0; i < count; i += 6)
+      gc_free(ptrs[i]);
+   for (unsigned i = 0; i < count; i++) {
+      ptrs[i] = gc_alloc(ctx, uint32_t, 1 + i % 50);
+      ptrs[i][0] = i;
+   }
+   for (unsigned i = 0; i < count; i++)
+      EXPECT_EQ(ptrs[i][0], i);
+
+   /* Nothing marked: everything goes, including the survivors of the
+    * previous collection.
+    */
+   gc_sweep_start(ctx);
+   gc_sweep_end(ctx);
+
+   free(ptrs);
+   ralloc_free(mem_ctx);
+}
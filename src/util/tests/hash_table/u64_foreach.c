@@ -0,0 +1,81 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include "hash_table.h"
+
+#define SIZE 1000
+
+/* Keys 0 and 1 are stored on the side, the others in the table.  Use some
+ * which don't fit in 32 bits too.
+ */
+static uint64_t key(uint64_t i)
+{
+   return i > 1 && i % 2 ? i << 32 : i;
+}
+
+int main()
+{
+   struct hash_table_u64 *ht;
+   bool seen[SIZE];
+   unsigned count;
+   uint64_t i;
+
+   ht = _mesa_hash_table_u64_create(NULL);
+
+   hash_table_u64_foreach(ht, entry)
+      assert(0);
+
+   for (i = 0; i < SIZE; ++i) {
+      seen[i] = false;
+      _mesa_hash_table_u64_insert(ht, key(i), &seen[i]);
+   }
+
+   count = 0;
+   hash_table_u64_foreach(ht, entry) {
+      bool *flag = entry.data;
+      i = flag - seen;
+      assert(i < SIZE);
+      assert(entry.key == key(i));
+      assert(!*flag);
+      *flag = true;
+      count++;
+   }
+   assert(count == SIZE);
+
+   _mesa_hash_table_u64_remove(ht, 0);
+   _mesa_hash_table_u64_remove(ht, 2);
+
+   count = 0;
+   hash_table_u64_foreach(ht, entry) {
+      assert(entry.key != 0 && entry.key != 2);
+      count++;
+   }
+   assert(count == SIZE - 2);
+
+   _mesa_hash_table_u64_destroy(ht);
+
+   return 0;
+}
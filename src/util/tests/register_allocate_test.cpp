@@ -279,3 +279,146 @@ TEST_F(ra_test, serialization_roundtrip)
    blob_finish(&blob);
 }
 
+
+static struct ra_regs *
+alloc_interval_reg_set(void *mem_ctx)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, 64, true);
+
+   struct ra_class *c1 = ra_alloc_contig_reg_class(regs, 1);
+   for (int i = 0; i < 64; i++)
+      ra_class_add_reg(c1, i);
+
+   struct ra_class *c2 = ra_alloc_contig_reg_class(regs, 2);
+   for (int i = 0; i < 64; i += 2)
+      ra_class_add_reg(c2, i);
+
+   ra_set_finalize(regs, NULL);
+
+   return regs;
+}
+
+/* Fills in an interval graph like the ones backends build from live ranges:
+ * node i is live for a pseudo-random number of instructions starting at i.
+ * Some edges are added twice to exercise de-duplication.
+ */
+static void
+add_interval_interference(struct ra_graph *g, unsigned count)
+{
+   uint32_t seed = 1;
+   unsigned *end = (unsigned *) malloc(count * sizeof(*end));
+
+   for (unsigned i = 0; i < count; i++) {
+      seed = seed * 1103515245 + 12345;
+      end[i] = i + 1 + (seed >> 16) % 24;
+      ra_set_node_spill_cost(g, i, (seed >> 8) % 100);
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      for (unsigned j = i + 1; j < MIN2(end[i], count); j++) {
+         ra_add_node_interference(g, i, j);
+         if (j % 7 == 0)
+            ra_add_node_interference(g, j, i);
+      }
+   }
+
+   free(end);
+}
+
+static struct ra_graph *
+build_interval_graph(struct ra_regs *regs, unsigned count, bool sparse)
+{
+   struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+   if (sparse)
+      ra_make_adjacency_sparse(g);
+
+   for (unsigned i = 0; i < count; i++)
+      ra_set_node_class(g, i, ra_get_class_from_index(regs, i % 3 == 0));
+
+   add_interval_interference(g, count);
+
+   /* Drop and rebuild some nodes' edges, as spilling does. */
+   for (unsigned i = 0; i < count; i += 97)
+      ra_reset_node_interference(g, i);
+   for (unsigned i = 0; i < count; i += 97) {
+      if (i + 1 < count)
+         ra_add_node_interference(g, i, i + 1);
+   }
+
+   return g;
+}
+
+static void
+check_interval_allocation(struct ra_graph *g)
+{
+   for (unsigned n = 0; n < g->count; n++) {
+      util_dynarray_foreach(&g->nodes[n].adjacency_list, unsigned int, n2p) {
+         ASSERT_FALSE(ra_class_allocations_conflict(
+                         ra_get_node_class(g, n), ra_get_node_reg(g, n),
+                         ra_get_node_class(g, *n2p), ra_get_node_reg(g, *n2p)))
+            << "nodes " << n << " and " << *n2p << " interfere";
+      }
+   }
+}
+
+TEST_F(ra_test, sparse_adjacency_matches_dense)
+{
+   const unsigned count = 2000;
+   struct ra_regs *regs = alloc_interval_reg_set(mem_ctx);
+
+   struct ra_graph *dense = build_interval_graph(regs, count, false);
+   struct ra_graph *sparse = build_interval_graph(regs, count, true);
+   ASSERT_FALSE(dense->sparse);
+   ASSERT_TRUE(sparse->sparse);
+
+   for (unsigned n = 0; n < count; n++) {
+      ASSERT_EQ(util_dynarray_num_elements(&dense->nodes[n].adjacency_list,
+                                           unsigned int),
+                util_dynarray_num_elements(&sparse->nodes[n].adjacency_list,
+                                           unsigned int));
+      ASSERT_EQ(dense->nodes[n].q_total, sparse->nodes[n].q_total);
+   }
+
+   bool dense_ok = ra_allocate(dense);
+   ASSERT_EQ(dense_ok, ra_allocate(sparse));
+
+   if (dense_ok) {
+      for (unsigned n = 0; n < count; n++)
+         ASSERT_EQ(ra_get_node_reg(dense, n), ra_get_node_reg(sparse, n));
+      check_interval_allocation(sparse);
+   } else {
+      ASSERT_EQ(ra_get_best_spill_node(dense), ra_get_best_spill_node(sparse));
+   }
+
+   ralloc_free(dense);
+   ralloc_free(sparse);
+}
+
+TEST_F(ra_test, sparse_adjacency_large_graph)
+{
+   const unsigned count = RA_SPARSE_ADJACENCY_MIN_NODES * 4;
+   struct ra_regs *regs = alloc_interval_reg_set(mem_ctx);
+
+   /* Grow the graph one node at a time so it switches representation on its
+    * own partway through.
+    */
+   struct ra_graph *g = ra_alloc_interference_graph(regs, 64);
+   ASSERT_FALSE(g->sparse);
+   for (unsigned i = 0; i < count; i++) {
+      if (i >= 64)
+         ra_add_node(g, ra_get_class_from_index(regs, i % 3 == 0));
+      else
+         ra_set_node_class(g, i, ra_get_class_from_index(regs, i % 3 == 0));
+   }
+   ASSERT_TRUE(g->sparse);
+   ASSERT_EQ(g->adjacency, nullptr);
+
+   add_interval_interference(g, count);
+
+   if (ra_allocate(g))
+      check_interval_allocation(g);
+   else
+      ASSERT_NE(ra_get_best_spill_node(g), -1);
+
+   ralloc_free(g);
+}
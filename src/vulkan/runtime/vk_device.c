@@ -26,6 +26,7 @@
 #include "vk_common_entrypoints.h"
 #include "vk_instance.h"
 #include "vk_log.h"
+#include "vk_nir.h"
 #include "vk_physical_device.h"
 #include "vk_queue.h"
 #include "vk_sync.h"
@@ -183,9 +184,23 @@ vk_device_finish(UNUSED struct vk_device *device)
    }
 #endif /* ANDROID */
 
+   vk_spirv_nir_cache_destroy(device->spirv_nir_cache);
+
    vk_object_base_finish(&device->base);
 }
 
+VkResult
+vk_device_enable_spirv_nir_cache(struct vk_device *device)
+{
+   assert(device->spirv_nir_cache == NULL);
+
+   device->spirv_nir_cache = vk_spirv_nir_cache_create();
+   if (device->spirv_nir_cache == NULL)
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   return VK_SUCCESS;
+}
+
 void
 vk_device_enable_threaded_submit(struct vk_device *device)
 {
@@ -247,6 +247,13 @@ struct vk_device {
     */
    enum vk_queue_submit_mode submit_mode;
 
+   /** Cache of translated SPIR-V
+    *
+    * Set by vk_device_enable_spirv_nir_cache().  If NULL, every call to
+    * vk_shader_module_to_nir() translates the SPIR-V again.
+    */
+   struct vk_spirv_nir_cache *spirv_nir_cache;
+
 #ifdef ANDROID
    mtx_t swapchain_private_mtx;
    struct hash_table *swapchain_private;
@@ -306,6 +313,16 @@ vk_device_finish(struct vk_device *device);
  */
 void vk_device_enable_threaded_submit(struct vk_device *device);
 
+/** Enables caching of the NIR produced by vk_shader_module_to_nir()
+ *
+ * With this enabled, translating the same SPIR-V, entrypoint and
+ * specialization constants with the same options again returns a clone of
+ * the NIR from the first translation instead of running spirv_to_nir() and
+ * the common lowering passes again.  The cached NIR is kept until the device
+ * is destroyed.
+ */
+VkResult vk_device_enable_spirv_nir_cache(struct vk_device *device);
+
 static inline bool
 vk_device_supports_threaded_submit(const struct vk_device *device)
 {
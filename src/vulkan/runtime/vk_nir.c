@@ -25,6 +25,11 @@
 #include "vk_nir.h"
 
 #include "compiler/spirv/nir_spirv.h"
+#include "util/hash_table.h"
+#include "util/list.h"
+#include "util/mesa-sha1.h"
+#include "util/ralloc.h"
+#include "vk_device.h"
 #include "vk_log.h"
 #include "vk_util.h"
 
@@ -138,3 +143,238 @@ vk_spirv_to_nir(struct vk_device *device,
 
    return nir;
 }
+
+/** In-memory cache of the NIR produced by vk_spirv_to_nir()
+ *
+ * Applications commonly create many pipelines from the same shader module
+ * and entrypoint with the same specialization constants.  The translated
+ * NIR only depends on those and the translation options, so we translate
+ * once and hand out clones afterwards.  Only the most recently used
+ * VK_SPIRV_NIR_CACHE_MAX_ENTRIES shaders are kept.
+ */
+#define VK_SPIRV_NIR_CACHE_MAX_ENTRIES 256
+
+struct vk_spirv_nir_cache_entry {
+   /* Link in vk_spirv_nir_cache::lru */
+   struct list_head link;
+
+   unsigned char key[20];
+
+   /* Allocated out of the entry */
+   nir_shader *nir;
+};
+
+struct vk_spirv_nir_cache {
+   mtx_t mutex;
+
+   /* SHA1 key -> vk_spirv_nir_cache_entry, allocated out of the cache */
+   struct hash_table *table;
+
+   /* Entries, most recently used first */
+   struct list_head lru;
+   unsigned num_entries;
+};
+
+static uint32_t
+sha1_hash(const void *key)
+{
+   return _mesa_hash_data(key, 20);
+}
+
+static bool
+sha1_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, 20) == 0;
+}
+
+struct vk_spirv_nir_cache *
+vk_spirv_nir_cache_create(void)
+{
+   struct vk_spirv_nir_cache *cache = ralloc(NULL, struct vk_spirv_nir_cache);
+   if (cache == NULL)
+      return NULL;
+
+   cache->table = _mesa_hash_table_create(cache, sha1_hash, sha1_equal);
+   if (cache->table == NULL) {
+      ralloc_free(cache);
+      return NULL;
+   }
+
+   list_inithead(&cache->lru);
+   cache->num_entries = 0;
+   mtx_init(&cache->mutex, mtx_plain);
+
+   return cache;
+}
+
+void
+vk_spirv_nir_cache_destroy(struct vk_spirv_nir_cache *cache)
+{
+   if (cache == NULL)
+      return;
+
+   mtx_destroy(&cache->mutex);
+   ralloc_free(cache);
+}
+
+static void
+spirv_nir_cache_key(const unsigned char *spirv_sha1,
+                    gl_shader_stage stage, const char *entrypoint_name,
+                    const VkSpecializationInfo *spec_info,
+                    const struct spirv_to_nir_options *spirv_options,
+                    const struct nir_shader_compiler_options *nir_options,
+                    unsigned char *key)
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, spirv_sha1, 20);
+   _mesa_sha1_update(&ctx, &stage, sizeof(stage));
+   _mesa_sha1_update(&ctx, entrypoint_name, strlen(entrypoint_name) + 1);
+
+   if (spec_info) {
+      for (unsigned i = 0; i < spec_info->mapEntryCount; i++) {
+         const VkSpecializationMapEntry *entry = &spec_info->pMapEntries[i];
+         _mesa_sha1_update(&ctx, &entry->constantID, sizeof(entry->constantID));
+         _mesa_sha1_update(&ctx, &entry->offset, sizeof(entry->offset));
+         _mesa_sha1_update(&ctx, &entry->size, sizeof(entry->size));
+      }
+      _mesa_sha1_update(&ctx, spec_info->pData, spec_info->dataSize);
+   }
+
+   /* Hash the options field by field so that struct padding doesn't end up
+    * in the key.  The debug callback doesn't affect the result and is
+    * replaced by vk_spirv_to_nir() anyway.
+    */
+   _mesa_sha1_update(&ctx, &spirv_options->environment,
+                     sizeof(spirv_options->environment));
+   _mesa_sha1_update(&ctx, &spirv_options->view_index_is_input,
+                     sizeof(spirv_options->view_index_is_input));
+   _mesa_sha1_update(&ctx, &spirv_options->create_library,
+                     sizeof(spirv_options->create_library));
+   _mesa_sha1_update(&ctx, &spirv_options->use_deref_buffer_array_length,
+                     sizeof(spirv_options->use_deref_buffer_array_length));
+   _mesa_sha1_update(&ctx, &spirv_options->float_controls_execution_mode,
+                     sizeof(spirv_options->float_controls_execution_mode));
+   _mesa_sha1_update(&ctx, &spirv_options->caps, sizeof(spirv_options->caps));
+   _mesa_sha1_update(&ctx, &spirv_options->ubo_addr_format,
+                     sizeof(spirv_options->ubo_addr_format));
+   _mesa_sha1_update(&ctx, &spirv_options->ssbo_addr_format,
+                     sizeof(spirv_options->ssbo_addr_format));
+   _mesa_sha1_update(&ctx, &spirv_options->phys_ssbo_addr_format,
+                     sizeof(spirv_options->phys_ssbo_addr_format));
+   _mesa_sha1_update(&ctx, &spirv_options->push_const_addr_format,
+                     sizeof(spirv_options->push_const_addr_format));
+   _mesa_sha1_update(&ctx, &spirv_options->shared_addr_format,
+                     sizeof(spirv_options->shared_addr_format));
+   _mesa_sha1_update(&ctx, &spirv_options->task_payload_addr_format,
+                     sizeof(spirv_options->task_payload_addr_format));
+   _mesa_sha1_update(&ctx, &spirv_options->global_addr_format,
+                     sizeof(spirv_options->global_addr_format));
+   _mesa_sha1_update(&ctx, &spirv_options->temp_addr_format,
+                     sizeof(spirv_options->temp_addr_format));
+   _mesa_sha1_update(&ctx, &spirv_options->constant_addr_format,
+                     sizeof(spirv_options->constant_addr_format));
+
+   /* The CLC library shader and the compiler options are compared by
+    * identity.  Drivers keep both around for as long as the device.
+    */
+   _mesa_sha1_update(&ctx, &spirv_options->clc_shader,
+                     sizeof(spirv_options->clc_shader));
+   _mesa_sha1_update(&ctx, &nir_options, sizeof(nir_options));
+
+   _mesa_sha1_final(&ctx, key);
+}
+
+/**
+ * Same as vk_spirv_to_nir() but goes through the device's SPIR-V to NIR
+ * cache if vk_device_enable_spirv_nir_cache() has been called.
+ *
+ * spirv_sha1 is the SHA1 of the SPIR-V, e.g. vk_shader_module::sha1.  If it
+ * is NULL, it is computed here.
+ */
+nir_shader *
+vk_spirv_to_nir_cached(struct vk_device *device,
+                       const unsigned char *spirv_sha1,
+                       uint32_t *spirv_data, size_t spirv_size_B,
+                       gl_shader_stage stage, const char *entrypoint_name,
+                       const VkSpecializationInfo *spec_info,
+                       const struct spirv_to_nir_options *spirv_options,
+                       const struct nir_shader_compiler_options *nir_options,
+                       void *mem_ctx)
+{
+   struct vk_spirv_nir_cache *cache = device->spirv_nir_cache;
+   if (cache == NULL) {
+      return vk_spirv_to_nir(device, spirv_data, spirv_size_B,
+                             stage, entrypoint_name, spec_info,
+                             spirv_options, nir_options, mem_ctx);
+   }
+
+   unsigned char spirv_sha1_local[20];
+   if (spirv_sha1 == NULL) {
+      _mesa_sha1_compute(spirv_data, spirv_size_B, spirv_sha1_local);
+      spirv_sha1 = spirv_sha1_local;
+   }
+
+   unsigned char key[20];
+   spirv_nir_cache_key(spirv_sha1, stage, entrypoint_name, spec_info,
+                       spirv_options, nir_options, key);
+
+   /* Entries may get evicted and freed as soon as the lock is dropped, so
+    * clone under the lock.
+    */
+   nir_shader *nir = NULL;
+   mtx_lock(&cache->mutex);
+   struct hash_entry *he = _mesa_hash_table_search(cache->table, key);
+   if (he != NULL) {
+      struct vk_spirv_nir_cache_entry *entry = he->data;
+      list_del(&entry->link);
+      list_add(&entry->link, &cache->lru);
+      nir = nir_shader_clone(mem_ctx, entry->nir);
+   }
+   mtx_unlock(&cache->mutex);
+
+   if (he != NULL)
+      return nir;
+
+   nir = vk_spirv_to_nir(device, spirv_data, spirv_size_B,
+                         stage, entrypoint_name, spec_info,
+                         spirv_options, nir_options, mem_ctx);
+   if (nir == NULL)
+      return NULL;
+
+   struct vk_spirv_nir_cache_entry *entry =
+      rzalloc(NULL, struct vk_spirv_nir_cache_entry);
+   if (entry != NULL) {
+      memcpy(entry->key, key, sizeof(key));
+      entry->nir = nir_shader_clone(entry, nir);
+      if (entry->nir == NULL) {
+         ralloc_free(entry);
+         entry = NULL;
+      }
+   }
+
+   mtx_lock(&cache->mutex);
+   if (entry != NULL &&
+       _mesa_hash_table_search(cache->table, key) == NULL) {
+      ralloc_steal(cache->table, entry);
+      _mesa_hash_table_insert(cache->table, entry->key, entry);
+      list_add(&entry->link, &cache->lru);
+      entry = NULL;
+
+      if (++cache->num_entries > VK_SPIRV_NIR_CACHE_MAX_ENTRIES) {
+         struct vk_spirv_nir_cache_entry *last =
+            list_last_entry(&cache->lru, struct vk_spirv_nir_cache_entry, link);
+         _mesa_hash_table_remove_key(cache->table, last->key);
+         list_del(&last->link);
+         ralloc_free(last);
+         cache->num_entries--;
+      }
+   }
+   mtx_unlock(&cache->mutex);
+
+   /* Somebody else translated the same shader in the mean time */
+   ralloc_free(entry);
+
+   return nir;
+}
@@ -29,6 +29,7 @@
 
 struct spirv_to_nir_options;
 struct vk_device;
+struct vk_spirv_nir_cache;
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,19 @@ vk_spirv_to_nir(struct vk_device *device,
                 const struct nir_shader_compiler_options *nir_options,
                 void *mem_ctx);
 
+nir_shader *
+vk_spirv_to_nir_cached(struct vk_device *device,
+                       const unsigned char *spirv_sha1,
+                       uint32_t *spirv_data, size_t spirv_size_B,
+                       gl_shader_stage stage, const char *entrypoint_name,
+                       const VkSpecializationInfo *spec_info,
+                       const struct spirv_to_nir_options *spirv_options,
+                       const struct nir_shader_compiler_options *nir_options,
+                       void *mem_ctx);
+
+struct vk_spirv_nir_cache *vk_spirv_nir_cache_create(void);
+void vk_spirv_nir_cache_destroy(struct vk_spirv_nir_cache *cache);
+
 #ifdef __cplusplus
 }
 #endif
@@ -119,11 +119,12 @@ vk_shader_module_to_nir(struct vk_device *device,
       *nir_out = clone;
       return VK_SUCCESS;
    } else {
-      nir_shader *nir = vk_spirv_to_nir(device,
-                                        (uint32_t *)mod->data, mod->size,
-                                        stage, entrypoint_name, spec_info,
-                                        spirv_options, nir_options,
-                                        mem_ctx);
+      nir_shader *nir = vk_spirv_to_nir_cached(device, mod->sha1,
+                                               (uint32_t *)mod->data,
+                                               mod->size,
+                                               stage, entrypoint_name,
+                                               spec_info, spirv_options,
+                                               nir_options, mem_ctx);
       if (nir == NULL)
          return vk_errorf(device, VK_ERROR_UNKNOWN, "spirv_to_nir failed");
 